@@ -31,6 +31,45 @@ function(pulsar_cxx_test dir test_name)
   pulsar_runtest(${test_name}_CPP $<TARGET_FILE:${test_name}>)
 endfunction()
 
+# Macro for defining a C++ test that is run on several MPI processes
+function(pulsar_mpi_cxx_test dir test_name nproc)
+  testing_library(${dir} ${test_name})
+  add_test(NAME ${test_name}_CPP
+      COMMAND ${MPIEXEC} ${MPIEXEC_NUMPROC_FLAG} ${nproc}
+              ${PYTHON_EXECUTABLE} ${PULSAR_RUNTEST} $<TARGET_FILE:${test_name}>
+  )
+endfunction()
+
+# Macro for defining a C++ benchmark. It is always run as a test, at sizes
+# small enough to check the results quickly. If PULSAR_BENCHMARKS is on, it
+# is also run at full size as ${test_name}_BENCH (with the label "benchmark",
+# so that ctest -L benchmark or -LE benchmark selects it)
+function(pulsar_cxx_benchmark dir test_name)
+  pulsar_cxx_test(${dir} ${test_name})
+  if(PULSAR_BENCHMARKS)
+    pulsar_runtest(${test_name}_BENCH $<TARGET_FILE:${test_name}>)
+    set_tests_properties(${test_name}_BENCH PROPERTIES
+        LABELS benchmark
+        ENVIRONMENT PULSAR_BENCHMARK=1
+    )
+  endif()
+endfunction()
+
+# Same as pulsar_cxx_benchmark, but run on several MPI processes
+function(pulsar_mpi_cxx_benchmark dir test_name nproc)
+  pulsar_mpi_cxx_test(${dir} ${test_name} ${nproc})
+  if(PULSAR_BENCHMARKS)
+    add_test(NAME ${test_name}_BENCH
+        COMMAND ${MPIEXEC} ${MPIEXEC_NUMPROC_FLAG} ${nproc}
+                ${PYTHON_EXECUTABLE} ${PULSAR_RUNTEST} $<TARGET_FILE:${test_name}>
+    )
+    set_tests_properties(${test_name}_BENCH PROPERTIES
+        LABELS benchmark
+        ENVIRONMENT PULSAR_BENCHMARK=1
+    )
+  endif()
+endfunction()
+
 # Macro for defining both a Python and C++ test
 function(pulsar_test dir test_name)
   pulsar_py_test(${dir} ${test_name} ${ARGN})
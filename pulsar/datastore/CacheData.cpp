@@ -5,17 +5,35 @@ namespace pulsar {
 
 std::set<std::string> CacheData::get_keys(void) const
 {
-    return get_my_keys_();
+    return parent_cmap_->get_module_keys(module_id_);
 }
 
 size_t CacheData::size(void) const noexcept
 {
-    return get_my_keys_().size();
+    return parent_cmap_->module_size(module_id_);
+}
+
+size_t CacheData::erase(const CacheKey & key)
+{
+    return parent_cmap_->erase(key);
 }
 
 size_t CacheData::erase(const std::string & key)
 {
-    return parent_cmap_->erase(make_full_key_(key));
+    return parent_cmap_->erase(make_key(key));
+}
+
+size_t CacheData::clear(void)
+{
+    return parent_cmap_->clear_module(module_id_);
+}
+
+size_t CacheData::prefetch(const std::vector<std::string> & keys)
+{
+    std::vector<CacheKey> ckeys;
+    for(const auto & it : keys)
+        ckeys.push_back(make_key(it));
+    return parent_cmap_->prefetch(ckeys);
 }
 
 } // close namespace pulsar
@@ -20,6 +20,10 @@ namespace pulsar {
  * Once data is stored, the data itself should be considered
  * constant, although this cannot be strictly enforced
  * in python.
+ *
+ * Data can be accessed via a string key or via a precomputed
+ * CacheKey (see make_key()). The latter avoids hashing the key
+ * on every access.
  */
 class CacheData
 {
@@ -34,7 +38,7 @@ class CacheData
 
 
         CacheData(CacheMap * parent_cmap, std::string module_key)
-            : module_key_(module_key + "%%"),  // use %% as a separator
+            : module_id_(parent_cmap->module_id(module_key)),
               parent_cmap_(parent_cmap)
         { }
 
@@ -47,6 +51,22 @@ class CacheData
         CacheData & operator=(CacheData &&)      = default;
 
 
+        /*! \brief Form the key used to store data in the cache
+         *
+         * The returned key can be used in place of \p key for any of the
+         * functions of this object, and is only valid for this object.
+         */
+        CacheKey make_key(const std::string & key) const noexcept
+        {
+            return CacheKey(module_id_, key);
+        }
+
+        //! \copydoc make_key(const std::string &) const
+        CacheKey make_key(const bphash::HashValue & key) const noexcept
+        {
+            return CacheKey(module_id_, key);
+        }
+
         /*! \brief Obtain all the keys contained in this object
          * 
          * \return A vector of strings containing all the keys
@@ -72,9 +92,16 @@ class CacheData
          * \return A const referance to the data
          */
         template<typename T>
+        std::shared_ptr<const T> get(const CacheKey & key, bool use_distcache)
+        {
+            return parent_cmap_->get<T>(key, use_distcache);
+        }
+
+        //! \copydoc get(const CacheKey &, bool)
+        template<typename T>
         std::shared_ptr<const T> get(const std::string & key, bool use_distcache)
         {
-            return parent_cmap_->get<T>(make_full_key_(key), use_distcache);
+            return parent_cmap_->get<T>(make_key(key), use_distcache);
         }
 
         /*! \brief Add data associated with a given key via copy
@@ -89,10 +116,39 @@ class CacheData
          * \param [in] policy Checkpointing policy for data
          */
         template<typename T>
+        void set(const CacheKey & key, T && value, unsigned int policy)
+        {
+            parent_cmap_->set(key, std::forward<T>(value), policy);
+        }
+
+        //! \copydoc set(const CacheKey &, T &&, unsigned int)
+        template<typename T>
         void set(const std::string & key, T && value, unsigned int policy)
         {
-            const std::string full_key = make_full_key_(key);
-            parent_cmap_->set(full_key, std::forward<T>(value), policy);
+            parent_cmap_->set_value_(make_key(key), key, std::forward<T>(value), policy);
+        }
+
+        /*! \brief Return the data for a key, computing it if needed
+         *
+         * If several threads request the same missing key at the same
+         * time, only one of them calls \p func. The others wait for
+         * its result.
+         *
+         * \copydetails CacheMap::get_or_compute(const CacheKey &, unsigned int, Functor &&)
+         */
+        template<typename Functor>
+        std::shared_ptr<const CacheMap::ComputedType_<Functor>>
+        get_or_compute(const CacheKey & key, unsigned int policy, Functor && func)
+        {
+            return parent_cmap_->get_or_compute_(key, nullptr, policy, std::forward<Functor>(func));
+        }
+
+        //! \copydoc get_or_compute(const CacheKey &, unsigned int, Functor &&)
+        template<typename Functor>
+        std::shared_ptr<const CacheMap::ComputedType_<Functor>>
+        get_or_compute(const std::string & key, unsigned int policy, Functor && func)
+        {
+            return parent_cmap_->get_or_compute_(make_key(key), &key, policy, std::forward<Functor>(func));
         }
 
         /*! \brief Remove a key from this data store
@@ -102,39 +158,33 @@ class CacheData
          * \param [in] key The key to the data
          * \return The number of elements removed
          */
+        size_t erase(const CacheKey & key);
+
+        //! \copydoc erase(const CacheKey &)
         size_t erase(const std::string & key);
 
+        /*! \brief Remove all data stored by this module
+         *
+         * \return The number of elements removed
+         */
+        size_t clear(void);
+
+        /*! \brief Obtain several entries of this module from other ranks
+         *
+         * See CacheMap::prefetch()
+         *
+         * \param [in] keys The keys to the data
+         * \return The number of entries obtained from other ranks
+         */
+        size_t prefetch(const std::vector<std::string> & keys);
+
 
     private:
-        //! A unique string representing the module that this belongs to
-        std::string module_key_;
+        //! Id of the module that this belongs to (see CacheMap::module_id)
+        uint32_t module_id_;
 
         //! Parent CacheMap object
         CacheMap * parent_cmap_;
-        
-
-        std::string make_full_key_(const std::string & data_key) const
-        {
-            return module_key_ + data_key;
-        }
-
-        /*! \brief Obtains all the keys from the parent that belong to this module */
-        std::set<std::string> get_my_keys_(void) const
-        {
-            std::set<std::string> my_keys;
-            auto all_keys = parent_cmap_->get_keys();
-            for(auto & k : all_keys)
-            {
-                // only gdo greate than, since the actual data key must be at
-                // least one character
-                if(k.size() > module_key_.size() &&
-                   k.substr(0, module_key_.size()) == module_key_)
-                    my_keys.emplace(std::move(k));
-            }
-
-            return my_keys;
-        }
-
 };
 
 
@@ -0,0 +1,113 @@
+/*! \file
+ *
+ * \brief Compact keys for cache data (source)
+ */
+
+#include "pulsar/datastore/CacheKey.hpp"
+
+
+namespace {
+
+//! Final mixing of a 64-bit hash (from splitmix64)
+inline uint64_t mix64(uint64_t h) noexcept
+{
+    h ^= h >> 30;
+    h *= UINT64_C(0xbf58476d1ce4e5b9);
+    h ^= h >> 27;
+    h *= UINT64_C(0x94d049bb133111eb);
+    h ^= h >> 31;
+    return h;
+}
+
+//! Value of a lowercase hex digit, or -1 if it isn't one
+inline int hex_value(char c) noexcept
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+//! Pack 16 bytes (in order) into two 64-bit integers
+inline void pack_bytes(const uint8_t * bytes, uint64_t * hash) noexcept
+{
+    hash[0] = hash[1] = 0;
+    for(size_t i = 0; i < 8; i++)
+    {
+        hash[0] = (hash[0] << 8) | bytes[i];
+        hash[1] = (hash[1] << 8) | bytes[i+8];
+    }
+}
+
+} // close anonymous namespace
+
+
+namespace pulsar {
+
+CacheKey::CacheKey(uint32_t module_id, const std::string & key) noexcept
+    : module(module_id)
+{
+    // Is this already a 128-bit hash (as a string)?
+    if(key.size() == 32)
+    {
+        uint8_t bytes[16];
+        bool is_hash = true;
+        for(size_t i = 0; i < 16 && is_hash; i++)
+        {
+            const int hi = hex_value(key[2*i]);
+            const int lo = hex_value(key[2*i+1]);
+            is_hash = (hi >= 0 && lo >= 0);
+            bytes[i] = static_cast<uint8_t>(hi*16 + lo);
+        }
+
+        if(is_hash)
+        {
+            pack_bytes(bytes, hash);
+            return;
+        }
+    }
+
+    // Two independent FNV-1a style passes, each
+    // finished off with a strong mixing function
+    uint64_t h0 = UINT64_C(0xcbf29ce484222325);
+    uint64_t h1 = UINT64_C(0x84222325cbf29ce4) ^ key.size();
+    for(const char c : key)
+    {
+        const uint8_t b = static_cast<uint8_t>(c);
+        h0 = (h0 ^ b) * UINT64_C(0x100000001b3);
+        h1 = (h1 ^ b) * UINT64_C(0x9e3779b97f4a7c15);
+    }
+
+    hash[0] = mix64(h0);
+    hash[1] = mix64(h1 ^ hash[0]);
+}
+
+
+CacheKey::CacheKey(uint32_t module_id, const bphash::HashValue & key) noexcept
+    : module(module_id)
+{
+    uint8_t bytes[16] = {0};
+    for(size_t i = 0; i < key.size(); i++)
+        bytes[i % 16] ^= key[i];
+
+    pack_bytes(bytes, hash);
+}
+
+
+std::string CacheKey::hash_string(void) const
+{
+    static const char digits[] = "0123456789abcdef";
+
+    std::string s(32, '0');
+    for(size_t i = 0; i < 16; i++)
+    {
+        const uint64_t h = hash[i / 8];
+        const unsigned int b = static_cast<unsigned int>((h >> (56 - 8*(i % 8))) & 0xff);
+        s[2*i]   = digits[b >> 4];
+        s[2*i+1] = digits[b & 0xf];
+    }
+    return s;
+}
+
+} // close namespace pulsar
@@ -0,0 +1,99 @@
+/*! \file
+ *
+ * \brief Compact keys for cache data (header)
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <bphash/Hash.hpp>
+
+namespace pulsar {
+
+
+/*! \brief A precomputed key into a CacheMap
+ *
+ * This is a 128-bit hash of the data key, plus the id of the module
+ * the data belongs to (see CacheMap::module_id()). Comparing and hashing
+ * these keys never touches strings, so lookups using a CacheKey don't
+ * allocate any memory.
+ *
+ * A key can be formed from a bphash::HashValue (the hash is used directly)
+ * or from a string. Strings that are the hexadecimal representation of
+ * a 128-bit hash (as returned by bphash::hash_to_string) are converted
+ * back into that hash, so that
+ * `CacheKey(m, bphash::hash_to_string(h)) == CacheKey(m, h)`.
+ * Other strings are hashed.
+ */
+struct CacheKey
+{
+    uint32_t module;   //!< Id of the module that owns the data (0 = none)
+    uint64_t hash[2];  //!< 128-bit hash of the data key
+
+    //! Construct an empty key (module 0 and a zero hash)
+    CacheKey(void) noexcept
+        : module(0), hash{0, 0}
+    { }
+
+    /*! \brief Form a key from a string
+     *
+     * \param [in] module_id Id of the module the data belongs to
+     * \param [in] key The key of the data (not including the module)
+     */
+    CacheKey(uint32_t module_id, const std::string & key) noexcept;
+
+    /*! \brief Form a key from a hash
+     *
+     * Hashes larger than 128 bits are folded into 128 bits
+     *
+     * \param [in] module_id Id of the module the data belongs to
+     * \param [in] key The hash of the data
+     */
+    CacheKey(uint32_t module_id, const bphash::HashValue & key) noexcept;
+
+    /*! \brief Return the hash part of the key as a string
+     *
+     * This is 32 hexadecimal characters, and can be used to reconstruct
+     * the key (see CacheKey(uint32_t, const std::string &))
+     */
+    std::string hash_string(void) const;
+
+    bool operator==(const CacheKey & rhs) const noexcept
+    {
+        return module == rhs.module && hash[0] == rhs.hash[0] && hash[1] == rhs.hash[1];
+    }
+
+    bool operator!=(const CacheKey & rhs) const noexcept
+    {
+        return !(*this == rhs);
+    }
+
+    bool operator<(const CacheKey & rhs) const noexcept
+    {
+        if(module != rhs.module)
+            return module < rhs.module;
+        if(hash[0] != rhs.hash[0])
+            return hash[0] < rhs.hash[0];
+        return hash[1] < rhs.hash[1];
+    }
+};
+
+
+/*! \brief Hash functor for CacheKey (for use in unordered containers)
+ *
+ * The key already is a hash, so this just mixes in the module id
+ */
+struct CacheKeyHasher
+{
+    size_t operator()(const CacheKey & key) const noexcept
+    {
+        return static_cast<size_t>(key.hash[1] ^ (key.module * UINT64_C(0x9e3779b97f4a7c15)));
+    }
+};
+
+
+} // close namespace pulsar
+
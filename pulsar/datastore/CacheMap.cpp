@@ -1,58 +1,401 @@
 #include "pulsar/datastore/CacheMap.hpp"
+#include "pulsar/modulemanager/CheckpointIO.hpp"
 #include "pulsar/output/Output.hpp"
+#include "pulsar/output/GlobalOutput.hpp"
 
 using namespace pulsar;
 
 namespace pulsar {
 
+constexpr size_t CacheMap::nshards_;
+
 CacheMap::CacheMap(void)
-        : sync_tag_(-1)
+        : module_names_(1), // id 0 = no module
+          clock_(0), nbytes_(0), max_bytes_(0),
+          nhits_(0), nmisses_(0), nevicted_(0), nreloaded_(0), nshared_(0),
+          sync_running_(false), nremote_(0)
 { }
 
 
+CacheMap::~CacheMap(void)
+{
+    // Don't throw from the destructor
+    try {
+        set_spill_backend(nullptr);
+    }
+    catch(std::exception & ex)
+    {
+        print_global_error("Error closing cache spill backend: %?\n", ex.what());
+    }
+}
+
+
+uint32_t CacheMap::module_id(const std::string & module_key)
+{
+    {
+        std::shared_lock<std::shared_timed_mutex> l(module_mutex_);
+        auto it = module_ids_.find(module_key);
+        if(it != module_ids_.end())
+            return it->second;
+    }
+
+    std::lock_guard<std::shared_timed_mutex> l(module_mutex_);
+
+    // may have been added since we checked
+    auto it = module_ids_.find(module_key);
+    if(it != module_ids_.end())
+        return it->second;
+
+    const uint32_t id = static_cast<uint32_t>(module_names_.size());
+    module_names_.push_back(module_key);
+    module_ids_.emplace(module_key, id);
+    return id;
+}
+
+
+CacheKey CacheMap::make_key(const std::string & key)
+{
+    const size_t sep = key.find("%%");
+    if(sep == std::string::npos)
+        return CacheKey(0, key);
+
+    return CacheKey(module_id(key.substr(0, sep)), key.substr(sep+2));
+}
+
+
+std::pair<CacheKey, std::string> CacheMap::split_key_(const std::string & key)
+{
+    const size_t sep = key.find("%%");
+    if(sep == std::string::npos)
+        return {CacheKey(0, key), key};
+
+    std::string name = key.substr(sep+2);
+    CacheKey ck(module_id(key.substr(0, sep)), name);
+    return {ck, std::move(name)};
+}
+
+
+std::string CacheMap::full_key_(const CacheKey & key, const std::string & name) const
+{
+    if(key.module == 0)
+        return name;
+
+    std::shared_lock<std::shared_timed_mutex> l(module_mutex_);
+    return module_names_.at(key.module) + "%%" + name;
+}
+
+
 std::set<std::string> CacheMap::get_keys(void) const
 {
     std::set<std::string> v;
 
-    std::lock_guard<std::mutex> l(mutex_);
-    for(const auto & it : cmap_)
+    for(const auto & it : snapshot_())
         v.insert(it.first);
 
+    std::lock_guard<std::mutex> l(spill_mutex_);
+    for(const auto & it : spilled_)
+        v.insert(full_key_(it.first, it.second));
+
+    return v;
+}
+
+
+std::set<std::string> CacheMap::get_module_keys(uint32_t module) const
+{
+    // Only the names are copied while holding the locks
+    std::vector<std::pair<CacheKey, std::string>> names;
+
+    for(const auto & shard : shards_)
+    {
+        std::shared_lock<std::shared_timed_mutex> l(shard.mutex);
+        for(const auto & it : shard.map)
+        {
+            if(it.first.module == module)
+                names.emplace_back(it.first, it.second.name);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> l(spill_mutex_);
+        for(const auto & it : spilled_)
+        {
+            if(it.first.module == module)
+                names.emplace_back(it);
+        }
+    }
+
+    std::set<std::string> v;
+    for(const auto & it : names)
+        v.insert(full_key_(it.first, it.second));
     return v;
 }
 
 
 size_t CacheMap::size(void) const noexcept
 {
-    std::lock_guard<std::mutex> l(mutex_);
-    return cmap_.size();
+    size_t s = 0;
+
+    for(const auto & shard : shards_)
+    {
+        std::shared_lock<std::shared_timed_mutex> l(shard.mutex);
+        s += shard.map.size();
+    }
+
+    std::lock_guard<std::mutex> l(spill_mutex_);
+    return s + spilled_.size();
 }
 
+
+size_t CacheMap::module_size(uint32_t module) const noexcept
+{
+    size_t s = 0;
+
+    for(const auto & shard : shards_)
+    {
+        std::shared_lock<std::shared_timed_mutex> l(shard.mutex);
+        for(const auto & it : shard.map)
+            s += (it.first.module == module);
+    }
+
+    std::lock_guard<std::mutex> l(spill_mutex_);
+    for(const auto & it : spilled_)
+        s += (it.first.module == module);
+    return s;
+}
+
+
 size_t CacheMap::erase(const std::string & key)
 {
-    std::lock_guard<std::mutex> l(mutex_);
-    return cmap_.erase(key);
+    return erase(make_key(key));
+}
+
+
+size_t CacheMap::erase(const CacheKey & key)
+{
+    size_t n = 0;
+    bool distributed = false;
+
+    {
+        Shard_ & shard = get_shard_(key);
+        std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+
+        auto it = shard.map.find(key);
+        if(it != shard.map.end())
+        {
+            distributed = (it->second.policy & DistributeGlobal);
+            nbytes_ -= it->second.size;
+            shard.map.erase(it);
+            n = 1;
+        }
+    }
+
+    // other ranks can't obtain it from us anymore
+    if(distributed)
+        notify_distcache_delete_(key);
+
+    std::lock_guard<std::mutex> l(spill_mutex_);
+    auto it = spilled_.find(key);
+    if(it == spilled_.end())
+        return n;
+
+    drop_spilled_(it);
+    return n + 1;
 }
 
 void CacheMap::clear(void)
 {
-    std::lock_guard<std::mutex> l(mutex_);
-    cmap_.clear();
+    for(auto & shard : shards_)
+    {
+        std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+        for(const auto & it : shard.map)
+            nbytes_ -= it.second.size;
+        shard.map.clear();
+    }
+
+    std::lock_guard<std::mutex> l(spill_mutex_);
+    spilled_.clear();
+    if(spill_backend_)
+        spill_backend_->clear();
 }
 
 
-void CacheMap::print(std::ostream & os) const
+size_t CacheMap::clear_module(uint32_t module)
 {
+    size_t n = 0;
+
+    for(auto & shard : shards_)
+    {
+        std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+        for(auto it = shard.map.begin(); it != shard.map.end(); )
+        {
+            if(it->first.module == module)
+            {
+                nbytes_ -= it->second.size;
+                it = shard.map.erase(it);
+                n++;
+            }
+            else
+                ++it;
+        }
+    }
+
+    std::lock_guard<std::mutex> l(spill_mutex_);
+    for(auto it = spilled_.begin(); it != spilled_.end(); )
+    {
+        if(it->first.module == module)
+        {
+            drop_spilled_(it++);
+            n++;
+        }
+        else
+            ++it;
+    }
+
+    return n;
+}
+
 
-    // We lock the mutex here. Therefore, we cannot call CacheMap::size(), etc.
-    std::lock_guard<std::mutex> l(mutex_);
+void CacheMap::print(std::ostream & os) const
+{
+    // Work on a copy so that we don't hold the locks while printing
+    const auto entries = snapshot_();
+    const auto st = stats();
 
-    print_output(os, "Cache data with %? entries\n", cmap_.size());
+    print_output(os, "Cache data with %? entries (%? spilled)\n", entries.size(), st.nspilled);
+    print_output(os, "  Memory: %? bytes of %? (0 = unlimited)\n", st.nbytes, st.max_bytes);
+    print_output(os, "  Hits: %?  Misses: %?  Evicted: %?  Reloaded: %?  Shared: %?  Remote: %?\n",
+                 st.nhits, st.nmisses, st.nevicted, st.nreloaded, st.nshared, st.nremote);
 
-    for(const auto & it : cmap_)
-        print_output(os, "  -Key: %-20?  Serializable: %?  Type: %?\n", it.first,
+    for(const auto & it : entries)
+        print_output(os, "  -Key: %-20?  Serializable: %?  Size: %-12?  Type: %?\n", it.first,
                      it.second.value->is_serializable() ? "Yes" : "No",
+                     it.second.size,
                      it.second.value->demangled_type());
 }
 
+
+void CacheMap::set_max_bytes(size_t max_bytes)
+{
+    max_bytes_ = max_bytes;
+    enforce_limit_();
+}
+
+
+size_t CacheMap::max_bytes(void) const noexcept
+{
+    return max_bytes_;
+}
+
+
+CacheMapStats CacheMap::stats(void) const
+{
+    size_t nentries = 0;
+    for(const auto & shard : shards_)
+    {
+        std::shared_lock<std::shared_timed_mutex> l(shard.mutex);
+        nentries += shard.map.size();
+    }
+
+    size_t nspilled = 0;
+    {
+        std::lock_guard<std::mutex> l(spill_mutex_);
+        nspilled = spilled_.size();
+    }
+
+    return CacheMapStats{nentries, nspilled, nbytes_, max_bytes_,
+                         nhits_, nmisses_, nevicted_, nreloaded_, nshared_,
+                         nremote_, directory_size_()};
+}
+
+
+void CacheMap::set_(const CacheKey & key, std::string name,
+                    std::shared_ptr<const detail::GenericBase> value,
+                    unsigned int policy)
+{
+    const size_t size = value->size_estimate();
+
+    {
+        Shard_ & shard = get_shard_(key);
+        std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+
+        const uint64_t now = ++clock_;
+
+        // overwrites the entry if it exists
+        auto it = shard.map.find(key);
+        if(it != shard.map.end())
+        {
+            nbytes_ -= it->second.size;
+            shard.map.erase(it);
+        }
+
+        shard.map.emplace(key, CacheMapEntry_(std::move(value), std::move(name),
+                                              policy, size, now));
+        nbytes_ += size;
+    }
+
+    // any spilled data is now out of date
+    forget_spilled_(key);
+
+    enforce_limit_();
+}
+
+
+bool CacheMap::replace_(const CacheKey & key,
+                        const std::shared_ptr<const detail::GenericBase> & old,
+                        std::unique_ptr<detail::GenericBase> && ptr)
+{
+    const size_t size = ptr->size_estimate();
+
+    {
+        Shard_ & shard = get_shard_(key);
+        std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+
+        auto it = shard.map.find(key);
+        if(it == shard.map.end() || it->second.value != old)
+            return false;
+
+        nbytes_ -= it->second.size;
+        nbytes_ += size;
+        it->second.value = std::move(ptr);
+        it->second.size = size;
+        it->second.last_used = ++clock_;
+    }
+
+    enforce_limit_();
+    return true;
+}
+
+
+CacheMap::CacheMapEntry_ CacheMap::get_entry_(const CacheKey & key) const
+{
+    const Shard_ & shard = get_shard_(key);
+    std::shared_lock<std::shared_timed_mutex> l(shard.mutex);
+
+    auto it = shard.map.find(key);
+    if(it == shard.map.end())
+        return CacheMapEntry_(nullptr, "", NoPolicy, 0, 0);
+
+    return it->second;
+}
+
+
+std::map<std::string, CacheMap::CacheMapEntry_> CacheMap::snapshot_(void) const
+{
+    std::vector<std::pair<CacheKey, CacheMapEntry_>> entries;
+
+    for(const auto & shard : shards_)
+    {
+        std::shared_lock<std::shared_timed_mutex> l(shard.mutex);
+        for(const auto & it : shard.map)
+            entries.emplace_back(it.first, it.second);
+    }
+
+    // form the full keys without holding the shard locks
+    std::map<std::string, CacheMapEntry_> ret;
+    for(const auto & it : entries)
+        ret.emplace(full_key_(it.first, it.second.name), it.second);
+
+    return ret;
+}
+
 } // close namespace pulsar
@@ -8,34 +8,82 @@
 
 #include <set>
 #include <map>
+#include <array>
+#include <atomic>
+#include <future>
 #include <mutex>
 #include <thread>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "pulsar/util/Pybind11.hpp"
 
+#include "pulsar/datastore/CacheKey.hpp"
 #include "pulsar/datastore/GenericHolder.hpp"
 #include "pulsar/datastore/GenericHolder_serialized.hpp"
 
 namespace pulsar {
+class CacheData;
 class Checkpoint;
+class CheckpointIO;
 }
 
 
 namespace pulsar {
 
 
+/*! \brief Usage statistics of a CacheMap */
+struct CacheMapStats
+{
+    size_t nentries;     //!< Number of entries currently in memory
+    size_t nspilled;     //!< Number of entries spilled to the backend
+    size_t nbytes;       //!< Estimated memory used by the entries in memory
+    size_t max_bytes;    //!< Memory budget (zero if unlimited)
+    size_t nhits;        //!< Number of successful lookups
+    size_t nmisses;      //!< Number of unsuccessful lookups
+    size_t nevicted;     //!< Number of entries evicted from memory
+    size_t nreloaded;    //!< Number of spilled entries read back from the backend
+    size_t nshared;      //!< Number of lookups that waited for a computation in progress
+    size_t nremote;      //!< Number of entries obtained from other ranks
+    size_t ndirectory;   //!< Number of keys in this rank's part of the distributed directory
+};
+
 
 /*! Storage of cache data
  *
- * This contains all cache data for all modules. The key given to
- * these functions should contain a module key (unique to each module) and
- * some unique string representing the data stored under that key
+ * This contains all cache data for all modules. Entries are indexed
+ * by a CacheKey, which contains the (integer) id of the module the data
+ * belongs to (see module_id()) and a 128-bit hash of the key of the data.
+ *
+ * Functions taking a string key are kept for compatibility. These keys
+ * are of the form `module_key%%data_key` (or just `data_key` for data
+ * that doesn't belong to a module) and are converted to a CacheKey
+ * (see make_key()). Entries stored via a CacheKey are listed (in get_keys(),
+ * checkpoints, etc) using the hash of their data key.
  *
  * Once data is stored, the data itself should be considered
  * constant, although this cannot be strictly enforced
  * in python.
  *
- * \todo thread safety
+ * Internally, the entries are split into a number of shards (based on
+ * the hash of the key). Each shard is a hash map protected by its own
+ * reader/writer lock. Lookups only take a shared lock on a single shard,
+ * so cache hits from different threads never block each other. Writes
+ * only block lookups of keys that map to the same shard.
+ *
+ * The memory used by the cache can be limited (see set_max_bytes()).
+ * When the estimated size of all entries goes over that limit, the least
+ * recently used entries are evicted. If a spill backend has been set (see
+ * set_spill_backend()), entries with the CheckpointLocal policy are written
+ * to it before being evicted, and are read back in (as serialized data)
+ * the next time they are requested.
+ *
+ * Data that is expensive to compute should be obtained via get_or_compute().
+ * If several threads request the same missing key at the same time,
+ * only one of them computes the data and the others wait for its result.
+ *
+ * \threadsafe
  */
 class CacheMap
 {
@@ -52,30 +100,105 @@ class CacheMap
 
         CacheMap(void);
 
-        virtual ~CacheMap(void) = default;
+        virtual ~CacheMap(void);
 
 
-        //std::mutex has no default move or copy operator so can't default
+        //mutexes have no default move or copy operator so can't default
         CacheMap(const CacheMap &)             = delete;
         CacheMap(CacheMap &&)                  = delete;
         CacheMap & operator=(const CacheMap &) = delete;
         CacheMap & operator=(CacheMap &&)      = delete;
 
 
+        /*! \brief Obtain the id of a module key
+         *
+         * The id is assigned the first time a module key is seen, and
+         * stays the same for the lifetime of this object.
+         *
+         * \param [in] module_key Key unique to a module (without separator)
+         * \return Id to use when forming a CacheKey. Never zero.
+         */
+        uint32_t module_id(const std::string & module_key);
+
+
+        /*! \brief Form a CacheKey from a string key
+         *
+         * \param [in] key Key of the form `module_key%%data_key` or `data_key`
+         */
+        CacheKey make_key(const std::string & key);
+
+
         /*! \brief Obtain all of the unique keys contained in this object
          * 
-         * This only returns the local keys
+         * This only returns the local keys (including those that
+         * have been spilled to the backend)
          */
         std::set<std::string> get_keys(void) const;
 
 
+        /*! \brief Obtain all keys belonging to a module
+         *
+         * \copydetails get_keys(void) const
+         *
+         * \param [in] module Id of the module (see module_id())
+         */
+        std::set<std::string> get_module_keys(uint32_t module) const;
+
+
         /*! \brief Return the number of elements contained
          * 
-         * This only returns the size of the local cache map
+         * This only returns the size of the local cache map (including
+         * entries that have been spilled to the backend)
          */
         size_t size(void) const noexcept;
 
 
+        /*! \brief Return the number of elements belonging to a module
+         *
+         * \copydetails size(void) const
+         *
+         * \param [in] module Id of the module (see module_id())
+         */
+        size_t module_size(uint32_t module) const noexcept;
+
+
+        /*! \brief Set the memory budget of the cache
+         *
+         * If the estimated memory used by the cache goes over this limit,
+         * the least recently used entries are evicted.
+         *
+         * \param [in] max_bytes Maximum memory to use (in bytes). Zero
+         *                       means unlimited
+         */
+        void set_max_bytes(size_t max_bytes);
+
+
+        /*! \brief Get the memory budget of the cache (in bytes)
+         *
+         * Zero means unlimited
+         */
+        size_t max_bytes(void) const noexcept;
+
+
+        /*! \brief Set the backend used to store evicted entries
+         *
+         * Entries with the CheckpointLocal policy are written to this
+         * backend (using the same format as Checkpoint) before being evicted.
+         *
+         * The backend should not be used by anything else (ie, a Checkpoint)
+         * at the same time. It is opened here, and stays open until another
+         * backend is set or the cache is destroyed.
+         *
+         * \param [in] backend The backend to use. May be null, in which case
+         *                     entries are simply dropped when evicted.
+         */
+        void set_spill_backend(const std::shared_ptr<CheckpointIO> & backend);
+
+
+        /*! \brief Obtain usage statistics of this cache */
+        CacheMapStats stats(void) const;
+
+
         /*! \brief Return the underlying data
          *
          * If the key does not exist or is of the wrong type,
@@ -88,7 +211,7 @@ class CacheMap
          * \return A const referance to the data
          */
         template<typename T>
-        std::shared_ptr<const T> get(const std::string & key, bool use_distcache)
+        std::shared_ptr<const T> get(const CacheKey & key, bool use_distcache)
         {
             static_assert(!std::is_reference<T>::value,
                           "Cannot get/store a reference type in the cache");
@@ -102,45 +225,59 @@ class CacheMap
             typedef typename std::remove_cv<T>::type HeldType;
             typedef detail::GenericHolder<HeldType> HolderType;
 
-            std::unique_lock<std::mutex> l(mutex_);
-
-            // Try to obtain the entry in the local cache
-            const CacheMapEntry_ * cme = nullptr;
+            Shard_ & shard = get_shard_(key);
 
-            if(cmap_.count(key))
-                cme = &cmap_.at(key);
-            else if(use_distcache)
-            {
-                // See if we can obtain it from the distributed cache.
-                // This will place it in the local cache
-                l.unlock();
-                obtain_from_distcache_(key);
-                l.lock();
-
-                if(cmap_.count(key)) 
-                    cme = &cmap_.at(key);
-            }
-            
-
-            if(cme == nullptr) // could not find data
-                return {};
-
-            auto ptr = cme->value.get();
-
-            // attempt to cast to a GenericHolder of the correct type
-            const HolderType * ph = dynamic_cast<const HolderType *>(ptr);
-            if(ph != nullptr) // found it
-                return ph->get();  //implicitly cast to std::shared_ptr<const T>
+            // If we find serialized data, we hold on to it here
+            // and unserialize it without holding the lock
+            std::shared_ptr<const GenericHolder<SerializedGenericData>> sdh;
 
-            // If we didn't find it, see if it is serialized data
-            const GenericHolder<SerializedGenericData> * sdh;
-            sdh = dynamic_cast<GenericHolder<SerializedGenericData> *>(ptr);
-            if(sdh == nullptr)
             {
-                // We didn't find the correct type nor did we find
-                // serialized data
-                return {};
-            }
+                // Try to obtain the entry in the local cache
+                // (only needs a reader lock)
+                std::shared_lock<std::shared_timed_mutex> l(shard.mutex);
+                auto it = shard.map.find(key);
+
+                if(it == shard.map.end())
+                {
+                    // See if it was spilled to the backend, or if we can
+                    // obtain it from the distributed cache.
+                    // Both will place it in the local cache
+                    l.unlock();
+                    if(!reload_spilled_(key) && use_distcache)
+                        obtain_from_distcache_(key);
+                    l.lock();
+
+                    it = shard.map.find(key);
+                }
+
+                if(it == shard.map.end()) // could not find data
+                {
+                    nmisses_++;
+                    return {};
+                }
+
+                it->second.touch(clock_);
+
+                const GenericBase * ptr = it->second.value.get();
+
+                // attempt to cast to a GenericHolder of the correct type
+                const HolderType * ph = dynamic_cast<const HolderType *>(ptr);
+                if(ph != nullptr) // found it
+                {
+                    nhits_++;
+                    return ph->get();  //implicitly cast to std::shared_ptr<const T>
+                }
+
+                // If we didn't find it, see if it is serialized data
+                sdh = std::dynamic_pointer_cast<const GenericHolder<SerializedGenericData>>(it->second.value);
+                if(!sdh)
+                {
+                    // We didn't find the correct type nor did we find
+                    // serialized data
+                    nmisses_++;
+                    return {};
+                }
+            } // unlocks the shard
 
             // We found serialized data with that key
             // See if the type is correct
@@ -148,36 +285,97 @@ class CacheMap
             const std::string serialized_type = sdh->type();
 
             if(heldtype_str != serialized_type)
+            {
+                nmisses_++;
                 return {}; // We have a serialized entry, but it
                            // doesn't store the correct type
-            
+            }
+
 
-            // convert to a new holder
+            // convert to a new holder. The data is unserialized in place,
+            // and the holder shares it (rather than moving it again)
             const SerializedGenericData & sgd = *(sdh->get()); // get() returns a shared_ptr
-            std::unique_ptr<HeldType> new_data = sdh->unserialize<HeldType>();
-            std::unique_ptr<HolderType> new_entry(new HolderType(std::move(*new_data)));
+            std::shared_ptr<const HeldType> new_data = sdh->unserialize<HeldType>();
+            std::unique_ptr<HolderType> new_entry(new HolderType(std::move(new_data)));
+
+            // the new holder has already computed the hash of the data
+            if(sgd.verify && sgd.hash.size() != 0 && new_entry->is_hashable() &&
+               new_entry->my_hash() != sgd.hash)
+                throw PulsarException("Cache data does not match its stored hash",
+                                      "module", key.module, "type", new_entry->demangled_type());
 
 
             // the shared_ptr we are actually returning
             // Why this is done here: We need the shared pointer (with
             // the incremented counter) in case the entry gets erased soon
-            // after unlocking the mutex.
+            // after we are done.
             std::shared_ptr<const T> retptr = new_entry->get();
 
-            // actually add to map (this replaces the old data)
-            set_(key, std::move(new_entry), sgd.policy);
-
-            // it should be safe now to unlock the mutex
-            l.unlock();
+            // actually add to map (this replaces the old data). This
+            // is only done if the entry still contains the serialized
+            // data we started with (it may have been overwritten or
+            // unserialized by another thread in the meantime)
+            bool replaced = replace_(key, sdh, std::move(new_entry));
+            nhits_++;
 
             // notify the dist cache
-            if(sgd.policy & DistributeGlobal)
+            if(replaced && (sgd.policy & DistributeGlobal))
                 notify_distcache_add_(key);
 
             return retptr;
         }
 
 
+        /*! \copydoc get(const CacheKey &, bool)
+         *
+         * \note \p key is converted using make_key()
+         */
+        template<typename T>
+        std::shared_ptr<const T> get(const std::string & key, bool use_distcache)
+        {
+            return get<T>(make_key(key), use_distcache);
+        }
+
+
+        /*! \brief Return the data for a key, computing it if needed
+         *
+         * If the key does not exist (or is of the wrong type), \p func
+         * is called and its result is stored with the given policy.
+         *
+         * If another thread is already computing the data for this key
+         * (via this function), this waits for that result instead. If that
+         * computation throws an exception, the exception is rethrown here.
+         *
+         * The distributed cache is not searched.
+         *
+         * \tparam Functor Callable with no arguments that returns the data
+         *
+         * \param [in] key The key to the data
+         * \param [in] policy Checkpointing policy for the data (if computed)
+         * \param [in] func Computes the data
+         * \return The data for the key. Never empty.
+         */
+        template<typename Functor>
+        std::shared_ptr<const typename std::decay<typename std::result_of<Functor()>::type>::type>
+        get_or_compute(const CacheKey & key, unsigned int policy, Functor && func)
+        {
+            return get_or_compute_(key, nullptr, policy, std::forward<Functor>(func));
+        }
+
+
+        /*! \copydoc get_or_compute(const CacheKey &, unsigned int, Functor &&)
+         *
+         * \note \p key is converted using make_key()
+         */
+        template<typename Functor>
+        std::shared_ptr<const typename std::decay<typename std::result_of<Functor()>::type>::type>
+        get_or_compute(const std::string & key, unsigned int policy, Functor && func)
+        {
+            auto k = split_key_(key);
+            return get_or_compute_(k.first, &k.second, policy, std::forward<Functor>(func));
+        }
+
+
         /*! \brief Add data associated with a given key via copy
          * 
          * Keys are overwritten if they exist. This should not affect any data
@@ -190,30 +388,21 @@ class CacheMap
          * \param [in] policy Checkpointing policy for data
          */
         template<typename T>
-        void set(const std::string & key, T && value, unsigned int policy)
+        void set(const CacheKey & key, T && value, unsigned int policy)
         {
-            static_assert(!std::is_pointer<T>::value,
-                          "Cannot get/store a pointer type in the cache");
-
-            using detail::GenericBase;
-            using detail::GenericHolder;
-            typedef typename std::remove_reference<T>::type HeldType_base;
-            typedef typename std::remove_cv<HeldType_base>::type HeldType;
-            typedef detail::GenericHolder<HeldType> HolderType;
+            set_value_(key, key.hash_string(), std::forward<T>(value), policy);
+        }
 
-            // construct outside of mutex locking
-            std::unique_ptr<GenericBase> newdata(new HolderType(std::forward<T>(value)));
-
-            // now lock and set
-            {
-                std::lock_guard<std::mutex> l(mutex_);
-                set_(key, std::move(newdata), policy);
-            }
-
-            // notify the dist cache
-            if(policy & DistributeGlobal)
-                notify_distcache_add_(key);
 
+        /*! \copydoc set(const CacheKey &, T &&, unsigned int)
+         *
+         * \note \p key is converted using make_key()
+         */
+        template<typename T>
+        void set(const std::string & key, T && value, unsigned int policy)
+        {
+            auto k = split_key_(key);
+            set_value_(k.first, std::move(k.second), std::forward<T>(value), policy);
         }
 
 
@@ -224,11 +413,24 @@ class CacheMap
          * \param [in] key The key to the data
          * \return The number of elements removed
          */
+        size_t erase(const CacheKey & key);
+
+        /*! \copydoc erase(const CacheKey &)
+         *
+         * \note \p key is converted using make_key()
+         */
         size_t erase(const std::string & key);
 
         /*! \brief Delete all elements in this cache */
         void clear(void);
 
+        /*! \brief Delete all elements belonging to a module
+         *
+         * \param [in] module Id of the module (see module_id())
+         * \return The number of elements removed
+         */
+        size_t clear_module(uint32_t module);
+
         /*! Print information about this cache object
          * 
          * \param [in] os The output stream to print to
@@ -237,76 +439,496 @@ class CacheMap
 
         /*! \brief Start synchronization across all ranks
          *
-         * \warning Two additional tags will be used (tag+1 and tag+2).
+         * Entries with the DistributeGlobal policy can then be obtained by
+         * other ranks. Which ranks hold which keys is tracked by a directory
+         * that is split between all ranks (based on the hash of the key).
+         *
+         * This must be called on all ranks.
+         *
+         * \warning One additional tag will be used (tag+1).
          *          Using these elsewhere will lead to problems.
          *
-         * \param [in] tag Which MPI tag to use (will also use tag+1 and tag+2)
+         * \param [in] tag Which MPI tag to use (will also use tag+1)
          */
         void start_sync(int tag);
 
-        /*! \brief Stop synchronization across all ranks */
+        /*! \brief Stop synchronization across all ranks
+         *
+         * This must be called on all ranks. Other threads must not
+         * use the cache while synchronization is being stopped.
+         */
         void stop_sync(void);
 
+        /*! \brief Wait until other ranks know about the entries of this rank
+         *
+         * Updates to the directory are sent in batches in the background.
+         * This waits until all updates made so far have been processed.
+         */
+        void flush_sync(void);
+
+        /*! \brief Obtain several entries from other ranks at once
+         *
+         * Keys that are not in the local cache are looked up in the
+         * directory and obtained from the ranks that hold them. Requests
+         * to the same rank are sent as a single message.
+         *
+         * Does nothing if synchronization is not running.
+         *
+         * \param [in] keys Keys of the entries to obtain
+         * \return The number of entries obtained from other ranks
+         */
+        size_t prefetch(const std::vector<CacheKey> & keys);
+
+        /*! \copydoc prefetch(const std::vector<CacheKey> &)
+         *
+         * \note \p keys are converted using make_key()
+         */
+        size_t prefetch(const std::vector<std::string> & keys);
+
 
     private:
+        friend class CacheData;
         friend class Checkpoint;
 
-        /*! \brief Mutex protecting this object during multi-threaded access */
-        mutable std::mutex mutex_;
-
         /*! \brief Stores a pointer to a placeholder, plus some other information
+         *
+         * The value is held via a shared_ptr so that a copy of
+         * an entry can be used after the lock on its shard is released
          */
         struct CacheMapEntry_
         {
-            std::unique_ptr<detail::GenericBase> value;  //!< The stored data
-            unsigned int policy;                         //!< Policy flags for this entry 
+            std::shared_ptr<const detail::GenericBase> value;  //!< The stored data
+            std::string name;                                  //!< Data key (without the module key)
+            unsigned int policy;                               //!< Policy flags for this entry
+            size_t size;                                       //!< Estimated size of the data (in bytes)
+            mutable std::atomic<uint64_t> last_used;           //!< Value of clock_ when last used
+
+            CacheMapEntry_(std::shared_ptr<const detail::GenericBase> v, std::string n,
+                           unsigned int p, size_t s, uint64_t t)
+                : value(std::move(v)), name(std::move(n)),
+                  policy(p), size(s), last_used(t)
+            { }
+
+            // we need a custom copy constructor due to the std::atomic
+            CacheMapEntry_(const CacheMapEntry_ & rhs)
+                : value(rhs.value), name(rhs.name), policy(rhs.policy), size(rhs.size),
+                  last_used(rhs.last_used.load(std::memory_order_relaxed))
+            { }
+
+            /*! \brief Mark this entry as used
+             *
+             * This may be called while only holding a shared lock. The
+             * store is skipped if it wouldn't change anything, so that
+             * lookups don't keep writing to memory shared between threads
+             */
+            void touch(const std::atomic<uint64_t> & clock) const noexcept
+            {
+                const uint64_t now = clock.load(std::memory_order_relaxed);
+                if(last_used.load(std::memory_order_relaxed) != now)
+                    last_used.store(now, std::memory_order_relaxed);
+            }
         };
 
-        //! The container to use to store the data
-        std::map<std::string, CacheMapEntry_> cmap_;
+
+        /*! \brief A portion of the cache, with its own lock */
+        struct Shard_
+        {
+            //! Protects this shard. Lookups take a shared (reader) lock
+            mutable std::shared_timed_mutex mutex;
+
+            //! The container to use to store the data
+            std::unordered_map<CacheKey, CacheMapEntry_, CacheKeyHasher> map;
+
+            //! Results of computations in progress (see get_or_compute())
+            std::unordered_map<CacheKey,
+                               std::shared_future<std::shared_ptr<const detail::GenericBase>>,
+                               CacheKeyHasher> inflight;
+        };
+
+
+        //! Number of shards the cache is split into
+        static constexpr size_t nshards_ = 64;
+
+        //! All the shards of the cache
+        std::array<Shard_, nshards_> shards_;
+
+
+        ///@{ \name Module ids
+
+        //! Protects module_ids_ and module_names_
+        mutable std::shared_timed_mutex module_mutex_;
+
+        //! Maps module keys to their id
+        std::unordered_map<std::string, uint32_t> module_ids_;
+
+        //! Module key for each id (id 0 is for data without a module)
+        std::vector<std::string> module_names_;
+
+        ///@}
+
+
+        ///@{ \name Memory limits and eviction
+
+        /*! \brief Logical clock used for LRU bookkeeping
+         *
+         * This is advanced on every modification of the cache, not on
+         * every lookup, so that lookups from different threads don't
+         * contend on it. Entries used between two modifications are
+         * therefore considered equally recent.
+         */
+        std::atomic<uint64_t> clock_;
+
+        std::atomic<size_t> nbytes_;     //!< Estimated size of all entries in memory
+        std::atomic<size_t> max_bytes_;  //!< Memory budget (zero = unlimited)
+        std::atomic<size_t> nhits_;      //!< Number of successful lookups
+        std::atomic<size_t> nmisses_;    //!< Number of unsuccessful lookups
+        std::atomic<size_t> nevicted_;   //!< Number of evicted entries
+        std::atomic<size_t> nreloaded_;  //!< Number of entries reloaded from the spill backend
+        std::atomic<size_t> nshared_;    //!< Number of lookups that waited for a computation
+
+        //! Only one thread does evictions at a time
+        std::mutex evict_mutex_;
+
+        /*! \brief Protects the spill backend and spilled_
+         *
+         * This is never held while locking a shard
+         */
+        mutable std::mutex spill_mutex_;
+
+        //! Where entries are spilled to when evicted
+        std::shared_ptr<CheckpointIO> spill_backend_;
+
+        //! Keys (and data keys) of the entries that are currently spilled to the backend
+        std::map<CacheKey, std::string> spilled_;
+
+        ///@}
 
 
         ////////////////////////////////
         // Private functions          //
         ////////////////////////////////
 
+        //! Obtain the shard a key belongs to
+        Shard_ & get_shard_(const CacheKey & key) noexcept
+        {
+            return shards_[key.hash[0] % nshards_];
+        }
+
+        //! \copydoc get_shard_
+        const Shard_ & get_shard_(const CacheKey & key) const noexcept
+        {
+            return shards_[key.hash[0] % nshards_];
+        }
+
+
+        /*! \brief Split a string key into a CacheKey and the data key */
+        std::pair<CacheKey, std::string> split_key_(const std::string & key);
+
+
+        /*! \brief Form the full string key from a CacheKey and its data key
+         *
+         * This is the inverse of split_key_()
+         */
+        std::string full_key_(const CacheKey & key, const std::string & name) const;
+
+
+        /*! \brief Add data to the cache via copy
+         *
+         * \param [in] key Key of the data to set
+         * \param [in] name Data key (for listing the entry)
+         * \param [in] value The data to store
+         * \param [in] policy Checkpointing policy for data
+         */
+        template<typename T>
+        void set_value_(const CacheKey & key, std::string name,
+                        T && value, unsigned int policy)
+        {
+            static_assert(!std::is_pointer<T>::value,
+                          "Cannot get/store a pointer type in the cache");
+
+            using detail::GenericBase;
+            using detail::GenericHolder;
+            typedef typename std::remove_reference<T>::type HeldType_base;
+            typedef typename std::remove_cv<HeldType_base>::type HeldType;
+            typedef detail::GenericHolder<HeldType> HolderType;
+
+            // construct outside of mutex locking
+            std::unique_ptr<GenericBase> newdata(new HolderType(std::forward<T>(value)));
+
+            // set_ locks the appropriate shard
+            set_(key, std::move(name), std::move(newdata), policy);
+
+            // notify the dist cache
+            if(policy & DistributeGlobal)
+                notify_distcache_add_(key);
+        }
+
 
         /*! \brief sets the data for a given key via a pointer
-         * 
+         *
+         * This locks the shard the key belongs to
+         *
          * \param [in] key Key of the data to set
+         * \param [in] name Data key (for listing the entry)
          * \param [in] value Pointer to the data to set
          */ 
-        void set_(const std::string & key,
-                  std::unique_ptr<detail::GenericBase> && ptr,
-                  unsigned int policy)
+        void set_(const CacheKey & key, std::string name,
+                  std::shared_ptr<const detail::GenericBase> value,
+                  unsigned int policy);
+
+
+        /*! \brief Wait for a result obtained by another thread
+         *
+         * The python GIL is released while waiting (if held), since
+         * obtaining the result may need it.
+         */
+        template<typename Future>
+        static void wait_for_(const Future & result)
         {
-            if(cmap_.count(key))
-                cmap_.erase(key);
+            if(Py_IsInitialized() && PyGILState_Check())
+            {
+                pybind11::gil_scoped_release nogil;
+                result.wait();
+            }
+            else
+                result.wait();
+        }
 
-            cmap_.emplace(key, CacheMapEntry_{std::move(ptr), policy,});
+
+        //! The type of data returned by a functor passed to get_or_compute()
+        template<typename Functor>
+        using ComputedType_ = typename std::decay<typename std::result_of<Functor()>::type>::type;
+
+
+        /*! \brief Implementation of get_or_compute()
+         *
+         * \param [in] name Data key (for listing the entry). If null,
+         *                  the hash of the key is used.
+         */
+        template<typename Functor>
+        std::shared_ptr<const ComputedType_<Functor>>
+        get_or_compute_(const CacheKey & key, const std::string * name,
+                        unsigned int policy, Functor && func)
+        {
+            typedef ComputedType_<Functor> HeldType;
+            typedef detail::GenericHolder<HeldType> HolderType;
+            typedef std::shared_ptr<const detail::GenericBase> ValuePtr;
+
+            static_assert(!std::is_pointer<HeldType>::value,
+                          "Cannot get/store a pointer type in the cache");
+
+            // the usual case: it's already there
+            auto ret = get<HeldType>(key, false);
+            if(ret)
+                return ret;
+
+            // Is someone else computing it? If not, we are
+            std::promise<ValuePtr> promise;
+            std::shared_future<ValuePtr> result;
+            bool compute = false;
+
+            Shard_ & shard = get_shard_(key);
+
+            {
+                std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+
+                // Another thread may have finished computing it since we
+                // looked (and so is no longer in inflight)
+                auto mit = shard.map.find(key);
+                if(mit != shard.map.end())
+                {
+                    const HolderType * ph = dynamic_cast<const HolderType *>(mit->second.value.get());
+                    if(ph != nullptr)
+                    {
+                        mit->second.touch(clock_);
+                        return ph->get();
+                    }
+                }
+
+                auto it = shard.inflight.find(key);
+                if(it != shard.inflight.end())
+                    result = it->second;
+                else
+                {
+                    result = promise.get_future().share();
+                    shard.inflight.emplace(key, result);
+                    compute = true;
+                }
+            }
+
+            if(!compute)
+            {
+                nshared_++;
+
+                // rethrows if the computation failed
+                wait_for_(result);
+                const ValuePtr value = result.get();
+                const HolderType * ph = dynamic_cast<const HolderType *>(value.get());
+                if(ph != nullptr)
+                    return ph->get();
+
+                // Computed by something expecting a different type.
+                // Compute our own (which replaces it)
+                std::shared_ptr<const HolderType> holder(new HolderType(func()));
+                set_(key, name ? *name : key.hash_string(), holder, policy);
+                return holder->get();
+            }
+
+            try {
+                std::shared_ptr<const HolderType> holder(new HolderType(func()));
+                set_(key, name ? *name : key.hash_string(), holder, policy);
+
+                // Now that it's in the cache, new lookups will find it there
+                {
+                    std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+                    shard.inflight.erase(key);
+                }
+                promise.set_value(holder);
+
+                if(policy & DistributeGlobal)
+                    notify_distcache_add_(key);
+
+                return holder->get();
+            }
+            catch(...)
+            {
+                {
+                    std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+                    shard.inflight.erase(key);
+                }
+                promise.set_exception(std::current_exception());
+                throw;
+            }
         }
 
 
+        /*! \brief Replace serialized data with its unserialized version
+         *
+         * This is only done if the entry still contains \p old
+         *
+         * \return True if the entry was replaced
+         */
+        bool replace_(const CacheKey & key,
+                      const std::shared_ptr<const detail::GenericBase> & old,
+                      std::unique_ptr<detail::GenericBase> && ptr);
+
+
+        /*! \brief Obtain a copy of an entry
+         *
+         * The copy shares the data with the entry in the map. If the
+         * key doesn't exist, the value of the returned entry is empty.
+         */
+        CacheMapEntry_ get_entry_(const CacheKey & key) const;
+
+
+        /*! \brief Obtain a copy of all entries in the cache
+         *
+         * The copies share the data with the entries in the map, and
+         * are sorted by their full string key. Only one shard is locked
+         * at a time.
+         */
+        std::map<std::string, CacheMapEntry_> snapshot_(void) const;
+
+
+        /*! \brief Remove a key from the spilled keys
+         *
+         * Its data is also removed from the backend.
+         */
+        void forget_spilled_(const CacheKey & key);
+
+
+        /*! \brief Remove a spilled entry and its data in the backend
+         *
+         * spill_mutex_ must be held by the caller.
+         */
+        void drop_spilled_(std::map<CacheKey, std::string>::iterator it);
+
+
+        /*! \brief Evict entries until the cache is within its budget
+         *
+         * Entries are evicted in least-recently-used order until the
+         * cache is at 90% of its budget, so that this doesn't have
+         * to be done on every modification of the cache.
+         */
+        void enforce_limit_(void);
+
+
+        /*! \brief Evict a single entry
+         *
+         * The entry is only evicted if it hasn't been used since \p last_used
+         * and hasn't been replaced.
+         */
+        void evict_(const CacheKey & key, uint64_t last_used);
+
+
+        /*! \brief Read an entry back in from the spill backend
+         *
+         * \return True if the key was found in the backend
+         */
+        bool reload_spilled_(const CacheKey & key);
+
+
         ///@{ \name Distributed synchronization of the cache
 
-        //! \brief Allows only one thread to use the sync facility at a time
-        std::mutex sync_comm_mutex_;
+        //! State of the synchronization (defined in CacheMap_sync.cpp)
+        struct SyncState_;
+
+        //! Serializes starting and stopping the synchronization
+        std::mutex sync_mutex_;
+
+        //! Protects sync_ and changes to sync_running_
+        mutable std::mutex sync_state_mutex_;
 
-        /*! \brief The separate synchronization thread */
-        std::thread sync_thread_;
+        //! Whether synchronization is running
+        std::atomic<bool> sync_running_;
+
+        /*! \brief State of the synchronization
+         *
+         * This is only created or destroyed while sync_running_ is false
+         * and sync_mutex_ is held. Other than starting and stopping, only
+         * the synchronization thread uses this directly; everything else
+         * uses a copy from sync_state_().
+         */
+        std::shared_ptr<SyncState_> sync_;
+
+        /*! \brief Obtain (a copy of) the synchronization state
+         *
+         * \return The state, or null if synchronization isn't running
+         */
+        std::shared_ptr<SyncState_> sync_state_(void) const;
 
-        /*! \brief The current MPI tag being used to sync this manager */
-        int sync_tag_;
+        //! Number of entries obtained from other ranks
+        std::atomic<size_t> nremote_;
 
-        /*! \brief Function run by the synchronization thread */
+        /*! \brief Function run by the synchronization thread
+         *
+         * This does all the communication with other ranks
+         * (using nonblocking calls).
+         */
         void sync_thread_func_(void);
 
+        //! Handle a message received from another rank
+        void sync_handle_(int src, int cmd, uint64_t id, const ByteArray & payload);
+
+        //! Send the data of some entries to another rank
+        ByteArray sync_get_entries_(const ByteArray & payload);
+
+        //! Number of keys in this rank's part of the directory
+        size_t directory_size_(void) const;
+
+        /*! \brief The key used to identify an entry between ranks
+         *
+         * Module ids are local to each rank, so this contains the module key
+         * and the hash of the data key.
+         */
+        std::string sync_key_(const CacheKey & key) const;
+
         /*! \brief Obtain data from another rank, if possible */
-        void obtain_from_distcache_(const std::string & key);
+        void obtain_from_distcache_(const CacheKey & key);
 
-        void notify_distcache_add_(const std::string & key);
+        void notify_distcache_add_(const CacheKey & key);
 
-        void notify_distcache_delete_(const std::string & key);
+        void notify_distcache_delete_(const CacheKey & key);
 
         ///@}
 
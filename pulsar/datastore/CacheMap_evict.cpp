@@ -0,0 +1,229 @@
+/*! \file
+ *
+ * \brief Eviction of cache data (source)
+ */
+
+#include <algorithm>
+
+#include "pulsar/datastore/CacheMap.hpp"
+#include "pulsar/modulemanager/CheckpointIO.hpp"
+#include "pulsar/modulemanager/CheckpointFormat.hpp"
+#include "pulsar/modulemanager/CheckpointCodec.hpp"
+#include "pulsar/output/GlobalOutput.hpp"
+#include "pulsar/util/Serialization.hpp"
+
+using namespace pulsar::detail;
+
+using namespace pulsar;
+
+
+namespace {
+
+//! An entry that may be evicted
+struct EvictCandidate
+{
+    pulsar::CacheKey key;
+    uint64_t last_used;
+};
+
+} // close anonymous namespace
+
+
+namespace pulsar {
+
+
+void CacheMap::set_spill_backend(const std::shared_ptr<CheckpointIO> & backend)
+{
+    std::lock_guard<std::mutex> l(spill_mutex_);
+
+    if(backend == spill_backend_)
+        return;
+
+    // The backend stays open while we use it. Closing it
+    // syncs it to disk, which is too slow to do for every entry
+    if(backend)
+        backend->open();
+
+    std::shared_ptr<CheckpointIO> old = std::move(spill_backend_);
+    spill_backend_ = backend;
+
+    // spilled data in the old backend can't be read anymore
+    spilled_.clear();
+
+    if(old)
+        old->close();
+}
+
+
+void CacheMap::forget_spilled_(const CacheKey & key)
+{
+    std::lock_guard<std::mutex> l(spill_mutex_);
+    auto it = spilled_.find(key);
+    if(it != spilled_.end())
+        drop_spilled_(it);
+}
+
+
+void CacheMap::drop_spilled_(std::map<CacheKey, std::string>::iterator it)
+{
+    const std::string full_key = full_key_(it->first, it->second);
+    spilled_.erase(it);
+
+    if(!spill_backend_)
+        return;
+
+    // Backends may not reuse the space of erased data, so
+    // start over once nothing in the backend is needed
+    if(spilled_.empty())
+        spill_backend_->clear();
+    else
+    {
+        spill_backend_->erase(make_cache_key(full_key));
+        spill_backend_->erase(make_meta_key(full_key));
+    }
+}
+
+
+void CacheMap::enforce_limit_(void)
+{
+    const size_t max_bytes = max_bytes_;
+    if(max_bytes == 0 || nbytes_ <= max_bytes)
+        return;
+
+    // Don't wait for another thread that is already evicting
+    std::unique_lock<std::mutex> l(evict_mutex_, std::try_to_lock);
+    if(!l.owns_lock())
+        return;
+
+    const size_t target = max_bytes - max_bytes/10;
+
+    // Gather the candidates. We only need to know the key and
+    // when it was last used
+    std::vector<EvictCandidate> candidates;
+    for(const auto & shard : shards_)
+    {
+        std::shared_lock<std::shared_timed_mutex> sl(shard.mutex);
+        for(const auto & it : shard.map)
+            candidates.push_back({it.first, it.second.last_used.load(std::memory_order_relaxed)});
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const EvictCandidate & a, const EvictCandidate & b)
+              { return a.last_used < b.last_used; });
+
+    for(const auto & it : candidates)
+    {
+        if(nbytes_ <= target)
+            break;
+        evict_(it.key, it.last_used);
+    }
+}
+
+
+void CacheMap::evict_(const CacheKey & key, uint64_t last_used)
+{
+    Shard_ & shard = get_shard_(key);
+
+    // Copy of the entry. Shares the data, so we don't need
+    // to hold the lock while serializing
+    const CacheMapEntry_ cme = get_entry_(key);
+    if(!cme.value || cme.last_used != last_used)
+        return; // gone or used since we gathered the candidates
+
+    // Spill to the backend if we should
+    bool spilled = false;
+    if((cme.policy & CheckpointLocal) && cme.value->is_serializable())
+    {
+        const std::string full_key = full_key_(key, cme.name);
+
+        std::lock_guard<std::mutex> l(spill_mutex_);
+
+        if(spill_backend_)
+        {
+            ByteArray ba_data = cme.value->to_byte_array();
+
+            bphash::HashValue h;
+            if(cme.value->is_hashable())
+                h = cme.value->my_hash();
+
+            // not compressed, since it may be read back soon
+            CacheEntryMetadata meta{full_key, cme.value->type(), h,
+                                    ba_data.size(), cme.policy, CodecNone};
+
+            print_global_debug("Spilling: (%10? bytes)   %?\n", ba_data.size(), full_key);
+
+            spill_backend_->write(make_cache_key(full_key), ba_data);
+            spill_backend_->write(make_meta_key(full_key), to_byte_array(meta));
+
+            spilled_.emplace(key, cme.name);
+            spilled = true;
+        }
+    }
+
+    // Actually remove it, but only if it hasn't been changed in the meantime
+    bool removed = false;
+    {
+        std::lock_guard<std::shared_timed_mutex> l(shard.mutex);
+        auto it = shard.map.find(key);
+        if(it != shard.map.end() && it->second.value == cme.value)
+        {
+            nbytes_ -= it->second.size;
+            shard.map.erase(it);
+            removed = true;
+        }
+    }
+
+    if(removed)
+    {
+        nevicted_++;
+
+        // other ranks can't obtain it from us anymore
+        // (spilled entries are read back in when requested)
+        if(!spilled && (cme.policy & DistributeGlobal))
+            notify_distcache_delete_(key);
+    }
+    else if(spilled)
+        forget_spilled_(key);
+}
+
+
+bool CacheMap::reload_spilled_(const CacheKey & key)
+{
+    ByteArray ba_data;
+    CheckpointView view{nullptr, 0};
+    CacheEntryMetadata meta;
+    std::string name;
+
+    {
+        std::lock_guard<std::mutex> l(spill_mutex_);
+        if(!spill_backend_)
+            return false;
+
+        auto it = spilled_.find(key);
+        if(it == spilled_.end())
+            return false;
+
+        name = it->second;
+        const std::string full_key = full_key_(key, name);
+
+        print_global_debug("Reloading spilled entry %?\n", full_key);
+
+        // Use the data in place if the backend allows it
+        view = spill_backend_->read_view(make_cache_key(full_key));
+        if(!view.data)
+            ba_data = spill_backend_->read(make_cache_key(full_key));
+        meta = from_byte_array<CacheEntryMetadata>(spill_backend_->read(make_meta_key(full_key)));
+    }
+
+    SerializedGenericData sgd{std::move(ba_data), meta.type, meta.hash, meta.policy,
+                              std::move(view.data), view.size, false, nullptr};
+    std::unique_ptr<GenericHolder<SerializedGenericData>> sdh(new GenericHolder<SerializedGenericData>(std::move(sgd)));
+
+    nreloaded_++;
+
+    // also removes it from spilled_ and the backend
+    set_(key, std::move(name), std::move(sdh), meta.policy);
+    return true;
+}
+
+} // close namespace pulsar
@@ -1,9 +1,15 @@
 /*! \file
  *
- * \brief Main module database class (source)
+ * \brief Distributed synchronization of cache data (source)
  * \author Benjamin Pritchard (ben@bennyp.org)
  */
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+
 #include "pulsar/datastore/CacheMap.hpp"
 #include "pulsar/exception/PulsarException.hpp"
 #include "pulsar/parallel/Parallel.hpp"
@@ -16,343 +22,802 @@ using namespace pulsar::detail;
 using namespace pulsar;
 
 
-
-// Commands that are sent through MPI
-#define MM_SYNC_NACK     -1
-#define MM_SYNC_ACK       0
-#define MM_SYNC_PING      1
-#define MM_SYNC_QUERY     2
-#define MM_SYNC_ADD       3
-#define MM_SYNC_DELETE    4
-#define MM_SYNC_GET       5
-#define MM_SYNC_STOP    100
+/* Developer note
+ *
+ * All communication is done by the synchronization thread, using
+ * nonblocking calls. Other threads queue messages for it, and wait
+ * (on a future) for the reply, if there is one. No locks are held
+ * while waiting for another rank.
+ *
+ * Each message is a fixed-size header (sent with the tag), followed by
+ * the payload (sent with tag+1) if the payload isn't empty. Payloads are
+ * sent in chunks of at most max_chunk_size bytes, since MPI counts are ints.
+ * Only one thread per rank sends messages, and MPI doesn't reorder messages
+ * between two ranks with the same tag, so payloads are matched to headers
+ * by source.
+ *
+ * All sends are synchronous (MPI_Issend), so when they complete we know
+ * the other rank has started receiving them. This is used when stopping.
+ *
+ * The directory (which ranks have which keys) is split between all ranks.
+ * The rank responsible for a key is determined from the hash of the key.
+ * Changes to the directory are batched per rank and sent in the
+ * background.
+ */
 
 
 namespace {
 
-struct MetaData
+//! Largest piece of a payload sent with a single MPI call
+const size_t max_chunk_size = size_t(1) << 30;
+
+
+//! Commands that are sent between ranks
+enum SyncCommand : int32_t
+{
+    SYNC_DIR_UPDATE = 1,  //!< Add/remove keys from the directory (payload: DirUpdates)
+    SYNC_DIR_QUERY  = 2,  //!< Which ranks have these keys? (payload: KeyList)
+    SYNC_GET        = 3,  //!< Send the data for these keys (payload: KeyList)
+    SYNC_REPLY      = 4   //!< Reply to a request (payload depends on the request)
+};
+
+
+//! Header of every message
+struct SyncHeader
+{
+    int32_t cmd;    //!< What to do (a SyncCommand)
+    int32_t pad;    //!< Unused
+    uint64_t id;    //!< Id of the request (zero if no reply is needed)
+    uint64_t size;  //!< Size of the payload (in bytes)
+};
+
+
+//! A message that is queued or being sent
+struct OutMessage
 {
+    int dest;
+    SyncHeader header;
+    ByteArray payload;
+    std::vector<MPI_Request> reqs;  //!< Header, then each chunk of the payload
+};
+
+
+//! A message whose payload is being received
+struct InMessage
+{
+    int src;
+    SyncHeader header;
+    ByteArray payload;
+    std::vector<MPI_Request> reqs;  //!< Each chunk of the payload
+};
+
+
+//! Start sending a payload, in chunks of at most max_chunk_size
+void isend_payload(ByteArray & payload, int dest, int tag, std::vector<MPI_Request> & reqs)
+{
+    for(size_t start = 0; start < payload.size(); start += max_chunk_size)
+    {
+        const size_t n = std::min(max_chunk_size, payload.size() - start);
+        reqs.push_back(MPI_REQUEST_NULL);
+        MPI_Issend(payload.data() + start, static_cast<int>(n), MPI_BYTE,
+                   dest, tag, MPI_COMM_WORLD, &reqs.back());
+    }
+}
+
+
+//! Start receiving a payload sent by isend_payload()
+void irecv_payload(ByteArray & payload, int src, int tag, std::vector<MPI_Request> & reqs)
+{
+    for(size_t start = 0; start < payload.size(); start += max_chunk_size)
+    {
+        const size_t n = std::min(max_chunk_size, payload.size() - start);
+        reqs.push_back(MPI_REQUEST_NULL);
+        MPI_Irecv(payload.data() + start, static_cast<int>(n), MPI_BYTE,
+                  src, tag, MPI_COMM_WORLD, &reqs.back());
+    }
+}
+
+
+//! Data of an entry sent to another rank
+struct RemoteEntry
+{
+    bool found;
     std::string type;
     bphash::HashValue hash;
     unsigned int policy;
+    ByteArray data;
 
     template<typename Archive>
     void serialize(Archive & ar)
     {
-        ar(type, hash, policy);
+        ar(found, type, hash, policy, data);
     }
 };
 
 
-void send_int(int rank, int tag, int i)
-{
-    MPI_Send(&i, 1, MPI_INT, rank, tag, MPI_COMM_WORLD);
-}
+typedef std::vector<std::string> KeyList;
 
-int recv_int(int rank, int tag)
-{
-    int r;
-    MPI_Recv(&r, 1, MPI_INT, rank, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    return r;
-}
+//! Changes to the directory (true = add)
+typedef std::vector<std::pair<bool, std::string>> DirUpdates;
 
-void send_str(int rank, int tag, const std::string & s)
+
+//! Rank responsible for the directory entry of a key
+int directory_rank(const std::string & key, int nproc)
 {
-    MPI_Send(const_cast<char*>(s.c_str()), pulsar::numeric_cast<int>(s.size()), MPI_CHAR, rank, tag, 
-            MPI_COMM_WORLD);
+    return static_cast<int>(CacheKey(0, key).hash[0] % static_cast<uint64_t>(nproc));
 }
 
-std::string recv_str(int rank, int tag)
+
+//! Releases the python GIL (if held by this thread) during its lifetime
+class ReleaseGIL
 {
-    MPI_Status stat;
-    int size;
+    public:
+        ReleaseGIL(void)
+        {
+            if(Py_IsInitialized() && PyGILState_Check())
+                release_.reset(new pybind11::gil_scoped_release);
+        }
 
-    MPI_Probe(rank, tag, MPI_COMM_WORLD, &stat);
-    MPI_Get_count(&stat, MPI_CHAR, &size);
+    private:
+        std::unique_ptr<pybind11::gil_scoped_release> release_;
+};
 
-    std::vector<char> vkey(size+1);
-    MPI_Recv(vkey.data(), size, MPI_CHAR, rank, tag,
-             MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    vkey[size] = '\0';
 
-    return std::string(vkey.data());
-}
+} // close anonymous namespace
 
-void send_data(int rank, int tag, const ByteArray & ba)
-{
-    MPI_Send(const_cast<char*>(ba.data()), pulsar::numeric_cast<int>(ba.size()), MPI_BYTE, rank, tag, MPI_COMM_WORLD);
-}
 
-ByteArray recv_data(int rank, int tag)
+namespace pulsar {
+
+
+struct CacheMap::SyncState_
 {
-    MPI_Status stat;
-    int size;
+    const int tag;    //!< Tag for headers (payloads use tag+1)
+    const int rank;   //!< Rank of this process
+    const int nproc;  //!< Total number of processes
 
-    MPI_Probe(rank, tag, MPI_COMM_WORLD, &stat);
-    MPI_Get_count(&stat, MPI_CHAR, &size);
+    //! The synchronization thread
+    std::thread thread;
 
-    ByteArray ba(size);
-    MPI_Recv(ba.data(), size, MPI_BYTE, rank, tag,
-             MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    //! Set when the thread should finish sending everything it has
+    std::atomic<bool> draining;
 
-    return ba;
-}
+    //! Set when the thread should exit
+    std::atomic<bool> stop;
 
-void send_ack(int rank, int tag)
-{
-    send_int(rank, tag, MM_SYNC_ACK);
-}
 
-void send_nack(int rank, int tag)
-{
-    send_int(rank, tag, MM_SYNC_NACK);
-}
+    //! Protects all members below (up to dir_mutex)
+    std::mutex mutex;
 
+    //! Wakes the thread when there are messages to send
+    std::condition_variable wake;
 
-} // close anonymous namespace
+    //! Signals that everything has been sent (when draining)
+    std::condition_variable drained_cv;
+    bool drained;
 
+    //! Messages waiting to be sent
+    std::deque<std::unique_ptr<OutMessage>> queue;
 
-namespace pulsar {
+    //! Directory updates waiting to be sent (per rank)
+    std::vector<DirUpdates> batches;
+
+    //! Id of the next request
+    uint64_t next_id;
+
+    //! Requests waiting for a reply
+    std::map<uint64_t, std::promise<ByteArray>> pending;
+
+
+    //! Protects the directory
+    mutable std::mutex dir_mutex;
+
+    //! The part of the directory this rank is responsible for
+    std::unordered_map<std::string, std::vector<int>> directory;
+
+
+    SyncState_(int t, int r, int n)
+        : tag(t), rank(r), nproc(n), draining(false), stop(false),
+          drained(false), batches(n), next_id(1)
+    { }
+
+
+    //! Queue a message (mutex must be held)
+    void queue_message(int dest, int cmd, uint64_t id, ByteArray payload)
+    {
+        std::unique_ptr<OutMessage> msg(new OutMessage);
+        msg->dest = dest;
+        msg->header = SyncHeader{cmd, 0, id, payload.size()};
+        msg->payload = std::move(payload);
+        queue.push_back(std::move(msg));
+        wake.notify_one();
+    }
+
+
+    //! Send a message that needs a reply
+    std::future<ByteArray> request(int dest, int cmd, ByteArray payload)
+    {
+        std::lock_guard<std::mutex> l(mutex);
+        const uint64_t id = next_id++;
+        std::future<ByteArray> f = pending[id].get_future();
+        queue_message(dest, cmd, id, std::move(payload));
+        return f;
+    }
+
+
+    //! Send a reply to a request
+    void reply(int dest, uint64_t id, ByteArray payload)
+    {
+        std::lock_guard<std::mutex> l(mutex);
+        queue_message(dest, SYNC_REPLY, id, std::move(payload));
+    }
+
+
+    //! Add a change to the directory to the batch
+    void update_directory(bool add, std::string key)
+    {
+        const int dest = directory_rank(key, nproc);
+        std::lock_guard<std::mutex> l(mutex);
+        batches[dest].emplace_back(add, std::move(key));
+        wake.notify_one();
+    }
+
+
+    /*! \brief Queue the batched directory updates
+     *
+     * The mutex must be held
+     *
+     * \param [in] want_reply If true, the updates are sent as requests
+     *                        and the futures for the replies are returned.
+     */
+    std::vector<std::future<ByteArray>> queue_batches(bool want_reply)
+    {
+        std::vector<std::future<ByteArray>> ret;
+
+        for(int dest = 0; dest < nproc; dest++)
+        {
+            if(batches[dest].empty())
+                continue;
+
+            uint64_t id = 0;
+            if(want_reply)
+            {
+                id = next_id++;
+                ret.push_back(pending[id].get_future());
+            }
+
+            queue_message(dest, SYNC_DIR_UPDATE, id, to_byte_array(batches[dest]));
+            batches[dest].clear();
+        }
+
+        return ret;
+    }
+
+
+    //! Is there anything left to send? (mutex must be held)
+    bool have_outgoing(void) const
+    {
+        if(!queue.empty())
+            return true;
+
+        for(const auto & it : batches)
+            if(!it.empty())
+                return true;
+
+        return false;
+    }
+};
+
+
+std::shared_ptr<CacheMap::SyncState_> CacheMap::sync_state_(void) const
+{
+    if(!sync_running_)
+        return nullptr;
+
+    std::lock_guard<std::mutex> l(sync_state_mutex_);
+    return sync_running_ ? sync_ : nullptr;
+}
 
 
 void CacheMap::start_sync(int tag)
 {
-    std::lock_guard<std::mutex> l(mutex_);
+    std::lock_guard<std::mutex> l(sync_mutex_);
 
-    if(sync_tag_ >= 0)
+    if(sync_running_)
         return; // already running
 
     if(tag < 0)
         throw PulsarException("Attempting to use a negative tag number for the sync thread");
 
-    sync_tag_ = tag;
-    sync_thread_ = std::thread(&CacheMap::sync_thread_func_, this);
+    const int my_rank = numeric_cast<int>(get_proc_id());
+    const int nproc = numeric_cast<int>(get_nproc());
+
+    {
+        std::lock_guard<std::mutex> sl(sync_state_mutex_);
+        sync_.reset(new SyncState_(tag, my_rank, nproc));
+        sync_->thread = std::thread(&CacheMap::sync_thread_func_, this);
+        sync_running_ = true;
+    }
+
+    // Tell the directory what we have
+    std::vector<CacheKey> my_keys;
+    for(const auto & shard : shards_)
+    {
+        std::shared_lock<std::shared_timed_mutex> sl(shard.mutex);
+        for(const auto & it : shard.map)
+        {
+            if( (it.second.policy & DistributeGlobal) &&
+                it.second.value->is_serializable())
+                my_keys.push_back(it.first);
+        }
+    }
+
+    for(const auto & it : my_keys)
+        notify_distcache_add_(it);
+
+    // Make sure all ranks know about everything before returning
+    flush_sync();
+
+    ReleaseGIL nogil;
+    MPI_Barrier(MPI_COMM_WORLD);
 }
 
+
 void CacheMap::stop_sync(void)
 {
-    MPI_Barrier(MPI_COMM_WORLD);
-    std::lock_guard<std::mutex> l(sync_comm_mutex_);
+    std::lock_guard<std::mutex> l(sync_mutex_);
 
-    if(sync_tag_ < 0)
+    if(!sync_running_)
         return; // not running
 
-    int my_rank = numeric_cast<int>(get_proc_id());
+    // Another rank may need us to handle its requests (which
+    // may need the GIL) until it gets here
+    ReleaseGIL nogil;
 
-    send_int(my_rank, sync_tag_, MM_SYNC_STOP);
-    send_str(my_rank, sync_tag_, "Called from CacheMap::stop_sync");
-    sync_thread_.join();
-    sync_tag_ = -1;
-}
+    // After this, nobody is making requests anymore. The only
+    // messages left are directory updates
+    MPI_Barrier(MPI_COMM_WORLD);
 
+    {
+        std::lock_guard<std::mutex> sl(sync_state_mutex_);
+        sync_running_ = false;
+    }
 
-void CacheMap::sync_thread_func_(void)
-{
+    {
+        std::unique_lock<std::mutex> sl(sync_->mutex);
+        sync_->draining = true;
+        sync_->wake.notify_one();
+        sync_->drained_cv.wait(sl, [this](void) { return sync_->drained; });
+    }
 
-    const int my_rank = numeric_cast<int>(get_proc_id());
-    const int nproc = numeric_cast<int>(get_nproc());
+    // After this, every message sent by any rank has been received
+    MPI_Barrier(MPI_COMM_WORLD);
 
-    print_global_debug("Starting sync event loop for rank %? (using tag %?)\n",
-                       my_rank, sync_tag_);
+    sync_->stop = true;
+    sync_->wake.notify_one();
+    sync_->thread.join();
 
+    // Other threads may still have the state. Anything waiting
+    // for a reply gets an exception (std::future_error)
+    {
+        std::lock_guard<std::mutex> sl(sync_->mutex);
+        sync_->pending.clear();
+    }
 
-    // This keeps track of what ranks have what keys
-    // This is only used for rank 0
-    std::multimap<std::string, int> key_rank_map;
+    std::lock_guard<std::mutex> sl(sync_state_mutex_);
+    sync_.reset();
+}
 
-    // Initial set up: See what ranks have what cache data
-    // Collect what cache keys I have
-    std::set<std::string> my_cache_keys;
+
+void CacheMap::flush_sync(void)
+{
+    const auto st = sync_state_();
+    if(!st)
+        return;
+
+    std::vector<std::future<ByteArray>> replies;
 
     {
-        std::lock_guard<std::mutex> l(mutex_);
-        for(const auto & it : cmap_)
-        {
-            if( (it.second.policy & DistributeGlobal) &&
-                it.second.value->is_serializable())
-                my_cache_keys.insert(it.first);
-        }
+        std::lock_guard<std::mutex> l(st->mutex);
+        replies = st->queue_batches(true);
     }
-        
-    if(my_rank == 0)
-    {
-        for(const auto & it : my_cache_keys)
-            key_rank_map.emplace(it, 0);
 
-        // receive from all other ranks
-        for(int src = 1; src < nproc; src++)
-        {
-            ByteArray ba = recv_data(src, sync_tag_+2);
-            auto recv_keys = from_byte_array<std::set<std::string>>(ba);
-            for(const auto & it : recv_keys)
-                key_rank_map.emplace(it, src);
-        }
-    }
-    else
+    for(auto & it : replies)
     {
-        auto ckey_dat = to_byte_array(my_cache_keys);
-        send_data(0, sync_tag_+2, ckey_dat);
+        wait_for_(it);
+        it.get();
     }
+}
+
+
+size_t CacheMap::directory_size_(void) const
+{
+    const auto st = sync_state_();
+    if(!st)
+        return 0;
+
+    std::lock_guard<std::mutex> l(st->dir_mutex);
+    return st->directory.size();
+}
+
+
+void CacheMap::sync_thread_func_(void)
+{
+    SyncState_ & st = *sync_;
+
+    print_global_debug("Starting sync event loop for rank %? (using tag %?)\n",
+                       st.rank, st.tag);
+
+    // Always have a receive posted for the next header
+    SyncHeader in_header;
+    MPI_Request header_req;
+    MPI_Irecv(&in_header, sizeof(SyncHeader), MPI_BYTE, MPI_ANY_SOURCE,
+              st.tag, MPI_COMM_WORLD, &header_req);
+
+    std::list<std::unique_ptr<InMessage>> receiving;
+    std::list<std::unique_ptr<OutMessage>> sending;
 
-    bool keep_running = true;
-    while(keep_running)
+    // Start receiving a message with the given header
+    auto start_receive = [&](int src, const SyncHeader & header)
     {
-        // receive a command message
-        MPI_Status stat;
-        int cmd = 0;
-        MPI_Recv(&cmd, 1, MPI_INT, MPI_ANY_SOURCE, sync_tag_, MPI_COMM_WORLD, &stat);
-        const int src = stat.MPI_SOURCE; 
-        const std::string msg = recv_str(src, sync_tag_);
+        std::unique_ptr<InMessage> msg(new InMessage{src, header,
+                                                     ByteArray(header.size), {}});
+        irecv_payload(msg->payload, src, st.tag+1, msg->reqs);
 
-        print_global_debug("Received command %? from rank %? with msg %?\n", cmd, src, msg);
+        receiving.push_back(std::move(msg));
+    };
 
-        if(cmd == MM_SYNC_PING)
+    size_t nidle = 0;
+
+    while(true)
+    {
+        bool progress = false;
+
+        // 1. Is there a new message?
+        int flag = 0;
+        MPI_Status status;
+        MPI_Test(&header_req, &flag, &status);
+        if(flag)
         {
-            send_ack(src, sync_tag_+1);
+            progress = true;
+            start_receive(status.MPI_SOURCE, in_header);
+            MPI_Irecv(&in_header, sizeof(SyncHeader), MPI_BYTE, MPI_ANY_SOURCE,
+                      st.tag, MPI_COMM_WORLD, &header_req);
         }
-        else if(cmd == MM_SYNC_QUERY)
+
+        // 2. Handle received messages, in the order they arrived
+        while(!receiving.empty())
         {
-            if(key_rank_map.count(msg))
+            InMessage & msg = *receiving.front();
+            MPI_Testall(static_cast<int>(msg.reqs.size()), msg.reqs.data(),
+                        &flag, MPI_STATUSES_IGNORE);
+            if(!flag)
+                break;
+
+            sync_handle_(msg.src, msg.header.cmd, msg.header.id, msg.payload);
+            receiving.pop_front();
+            progress = true;
+        }
+
+        // 3. Start sending queued messages
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> l(st.mutex);
+            st.queue_batches(false);
+
+            while(!st.queue.empty())
             {
-                auto range = key_rank_map.equal_range(msg);
-                int r = range.first->second;
-                send_int(src, sync_tag_+1, r);
+                std::unique_ptr<OutMessage> msg = std::move(st.queue.front());
+                st.queue.pop_front();
+
+                msg->reqs.push_back(MPI_REQUEST_NULL);
+                MPI_Issend(&msg->header, sizeof(SyncHeader), MPI_BYTE, msg->dest,
+                           st.tag, MPI_COMM_WORLD, &msg->reqs.back());
+                isend_payload(msg->payload, msg->dest, st.tag+1, msg->reqs);
+
+                sending.push_back(std::move(msg));
+                progress = true;
             }
-            else
+
+            // 4. Free completed sends
+            for(auto it = sending.begin(); it != sending.end(); )
             {
-                send_nack(src, sync_tag_+1);
+                MPI_Testall(static_cast<int>((*it)->reqs.size()), (*it)->reqs.data(),
+                            &flag, MPI_STATUSES_IGNORE);
+                if(flag)
+                {
+                    it = sending.erase(it);
+                    progress = true;
+                }
+                else
+                    ++it;
             }
-        }
-        else if(cmd == MM_SYNC_ADD)
-        {
-            print_global_debug("Received message to add %? from rank %?\n",
-                               msg, src);
-            key_rank_map.emplace(msg, src);
-        }
-        else if(cmd == MM_SYNC_DELETE)
-        {
-            print_global_debug("Received message to delete %? from rank %?\n",
-                               msg, src);
 
-            auto range = key_rank_map.equal_range(msg);
-            for(auto it = range.first; it != range.second; ++it)
+            if(st.draining && !st.drained && sending.empty() && !st.have_outgoing())
             {
-                if(it->second == src)
-                    key_rank_map.erase(it);
+                st.drained = true;
+                st.drained_cv.notify_all();
             }
-        
+
+            stop = st.stop && receiving.empty();
+
+            // Wait a bit if there is nothing to do. Spin for a while
+            // first, since a reply is often only a short time away
+            if(progress)
+                nidle = 0;
+            else if(!stop && ++nidle > 1000)
+                st.wake.wait_for(l, std::chrono::microseconds(100),
+                                 [&st](void) { return st.stop || st.have_outgoing(); });
         }
-        else if(cmd == MM_SYNC_GET)
+
+        if(stop)
+            break;
+
+        if(!progress)
+            std::this_thread::yield();
+    }
+
+    // A header may have arrived just before stopping. Its payload would
+    // have been empty (otherwise the sender would still be waiting for us)
+    MPI_Status status;
+    MPI_Cancel(&header_req);
+    MPI_Wait(&header_req, &status);
+
+    int cancelled = 0;
+    MPI_Test_cancelled(&status, &cancelled);
+    if(!cancelled)
+        sync_handle_(status.MPI_SOURCE, in_header.cmd, in_header.id, ByteArray());
+
+    print_global_debug("Sync event loop ended for rank %? (using tag %?)\n", st.rank, st.tag);
+}
+
+
+void CacheMap::sync_handle_(int src, int cmd, uint64_t id, const ByteArray & payload)
+{
+    SyncState_ & st = *sync_;
+
+    if(cmd == SYNC_DIR_UPDATE)
+    {
+        const auto updates = from_byte_array<DirUpdates>(payload);
+
         {
-            print_global_debug("Rank %? wants key %? from rank %?\n",
-                               src, msg, my_rank);
+            std::lock_guard<std::mutex> l(st.dir_mutex);
+            for(const auto & it : updates)
+            {
+                auto & ranks = st.directory[it.second];
+                auto pos = std::find(ranks.begin(), ranks.end(), src);
 
-            bool found = false;
-            ByteArray ba;
-            MetaData md;
-            
+                if(it.first && pos == ranks.end())
+                    ranks.push_back(src);
+                else if(!it.first && pos != ranks.end())
+                    ranks.erase(pos);
+
+                if(ranks.empty())
+                    st.directory.erase(it.second);
+            }
+        }
+
+        if(id != 0)
+            st.reply(src, id, ByteArray());
+    }
+    else if(cmd == SYNC_DIR_QUERY)
+    {
+        const auto keys = from_byte_array<KeyList>(payload);
+        std::vector<int> holders(keys.size(), -1);
+
+        {
+            std::lock_guard<std::mutex> l(st.dir_mutex);
+            for(size_t i = 0; i < keys.size(); i++)
             {
-                std::lock_guard<std::mutex> l(mutex_);
+                auto it = st.directory.find(keys[i]);
+                if(it == st.directory.end())
+                    continue;
 
-                if(cmap_.count(msg))
+                // Spread the requests over the ranks that have the key
+                const auto & ranks = it->second;
+                for(size_t j = 0; j < ranks.size(); j++)
                 {
-                    const CacheMapEntry_ & cme = cmap_.at(msg);
-                    if(cme.value->is_serializable())
+                    const int r = ranks[(src + j) % ranks.size()];
+                    if(r != src)
                     {
-                        ba = cme.value->to_byte_array();
-                        md = MetaData{cme.value->type(), {}, cme.policy}; 
-
-                        if(cme.value->is_hashable())
-                            md.hash == cme.value->my_hash();
-                            
-                        found = true;
+                        holders[i] = r;
+                        break;
                     }
                 }
-            } // unlocks the map
-
-            if(found)
-            {
-                auto ba_meta = to_byte_array(md);
-                send_ack(src, sync_tag_+1);
-                send_data(src, sync_tag_+1, ba_meta);
-                send_data(src, sync_tag_+1, ba);
-            }
-            else
-            {
-                send_nack(src, sync_tag_+1);
             }
         }
-        else if(cmd == MM_SYNC_STOP)
+
+        st.reply(src, id, to_byte_array(holders));
+    }
+    else if(cmd == SYNC_GET)
+    {
+        st.reply(src, id, sync_get_entries_(payload));
+    }
+    else if(cmd == SYNC_REPLY)
+    {
+        std::lock_guard<std::mutex> l(st.mutex);
+        auto it = st.pending.find(id);
+        if(it != st.pending.end())
+        {
+            it->second.set_value(payload);
+            st.pending.erase(it);
+        }
+    }
+    else
+        print_global_error("Rank %? received unknown sync command %? from rank %?\n",
+                           st.rank, cmd, src);
+}
+
+
+ByteArray CacheMap::sync_get_entries_(const ByteArray & payload)
+{
+    const auto keys = from_byte_array<KeyList>(payload);
+    std::vector<RemoteEntry> entries(keys.size());
+
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        RemoteEntry & re = entries[i];
+        re.found = false;
+
+        const CacheKey key = make_key(keys[i]);
+
+        if(!get_entry_(key).value)
+            reload_spilled_(key);
+
+        // Only python objects need the GIL. Other entries are sent without
+        // it, since the rank waiting for them may be in a collective with
+        // the thread that holds it here. (Declared before the entry, so that
+        // the entry is released with the GIL held.)
+        std::unique_ptr<pybind11::gil_scoped_acquire> gil;
+
+        // the copy of the entry shares the data, so we
+        // don't need to hold the lock while serializing
+        const CacheMapEntry_ cme = get_entry_(key);
+
+        if(cme.value && cme.value->is_serializable())
         {
-            print_global_debug("Recieved STOP command with msg: %?\n", msg);
-            keep_running = false;
+            if(Py_IsInitialized() &&
+               dynamic_cast<const GenericHolder<pybind11::object> *>(cme.value.get()) != nullptr)
+                gil.reset(new pybind11::gil_scoped_acquire);
+
+            re.found = true;
+            re.type = cme.value->type();
+            re.policy = cme.policy;
+            re.data = cme.value->to_byte_array();
+
+            if(cme.value->is_hashable())
+                re.hash = cme.value->my_hash();
         }
     }
 
-    print_global_debug("Sync event loop ended for rank %? (using tag %?)\n", my_rank, sync_tag_);
+    return to_byte_array(entries);
 }
 
-void CacheMap::notify_distcache_add_(const std::string & key)
+
+std::string CacheMap::sync_key_(const CacheKey & key) const
 {
-    std::lock_guard<std::mutex> l(sync_comm_mutex_);
-    send_int(0, sync_tag_, MM_SYNC_ADD);
-    send_str(0, sync_tag_, key);
+    return full_key_(key, key.hash_string());
 }
 
-void CacheMap::notify_distcache_delete_(const std::string & key)
+
+void CacheMap::notify_distcache_add_(const CacheKey & key)
 {
-    std::lock_guard<std::mutex> l(sync_comm_mutex_);
-    send_int(0, sync_tag_, MM_SYNC_DELETE);
-    send_str(0, sync_tag_, key);
+    if(const auto st = sync_state_())
+        st->update_directory(true, sync_key_(key));
 }
 
 
-void CacheMap::obtain_from_distcache_(const std::string & key)
+void CacheMap::notify_distcache_delete_(const CacheKey & key)
 {
-    // are we currently syncing?
-    if(sync_tag_ < 0)
-        return;
+    if(const auto st = sync_state_())
+        st->update_directory(false, sync_key_(key));
+}
+
 
-    print_global_debug("Looking to obtain %? from dist cache\n", key);
+size_t CacheMap::prefetch(const std::vector<std::string> & keys)
+{
+    std::vector<CacheKey> ckeys;
+    for(const auto & it : keys)
+        ckeys.push_back(make_key(it));
+    return prefetch(ckeys);
+}
 
-    ByteArray ba_data, ba_meta;
 
+size_t CacheMap::prefetch(const std::vector<CacheKey> & keys)
+{
+    // a copy, since the synchronization may be stopped meanwhile
+    const auto pst = sync_state_();
+    if(!pst)
+        return 0;
+
+    SyncState_ & st = *pst;
+
+    // What we don't have, grouped by the rank with the directory entry
+    std::map<std::string, CacheKey> wanted;
+    std::vector<KeyList> queries(st.nproc);
+
+    for(const auto & it : keys)
     {
-        std::lock_guard<std::mutex> l(sync_comm_mutex_);
+        if(get_entry_(it).value)
+            continue;
 
-        // ask rank 0 for who I should ask for the data
-        send_int(0, sync_tag_, MM_SYNC_QUERY);
-        send_str(0, sync_tag_, key);
-        int r = recv_int(0, sync_tag_+1);
+        std::string skey = sync_key_(it);
+        if(wanted.emplace(skey, it).second)
+            queries[directory_rank(skey, st.nproc)].push_back(std::move(skey));
+    }
 
-        print_global_debug("Looking to get key %? from rank %?\n", key, r);
+    if(wanted.empty())
+        return 0;
 
-        if(r < 0)
-            return;
+    print_global_debug("Looking to obtain %? keys from dist cache\n", wanted.size());
 
-        // get the info from the desired rank
-        send_int(r, sync_tag_, MM_SYNC_GET);
-        send_str(r, sync_tag_, key);
+    // Send all the queries, then wait for all the replies
+    std::vector<std::future<ByteArray>> replies(st.nproc);
+    for(int r = 0; r < st.nproc; r++)
+    {
+        if(!queries[r].empty())
+            replies[r] = st.request(r, SYNC_DIR_QUERY, to_byte_array(queries[r]));
+    }
 
-        int ack = recv_int(r, sync_tag_+1);
-        if(ack == MM_SYNC_ACK)
+    // Group what we found by the rank that has it
+    std::vector<KeyList> gets(st.nproc);
+    for(int r = 0; r < st.nproc; r++)
+    {
+        if(!replies[r].valid())
+            continue;
+
+        wait_for_(replies[r]);
+        const auto holders = from_byte_array<std::vector<int>>(replies[r].get());
+
+        for(size_t i = 0; i < holders.size(); i++)
         {
-            ba_meta = recv_data(r, sync_tag_+1);
-            ba_data = recv_data(r, sync_tag_+1);
+            if(holders[i] >= 0)
+                gets[holders[i]].push_back(queries[r][i]);
         }
-        else
-            return;
     }
 
-    MetaData md = from_byte_array<MetaData>(ba_meta);
+    // Obtain the data
+    for(int r = 0; r < st.nproc; r++)
+    {
+        replies[r] = std::future<ByteArray>();
+        if(!gets[r].empty())
+            replies[r] = st.request(r, SYNC_GET, to_byte_array(gets[r]));
+    }
+
+    size_t nobtained = 0;
+    for(int r = 0; r < st.nproc; r++)
+    {
+        if(!replies[r].valid())
+            continue;
+
+        wait_for_(replies[r]);
+        auto entries = from_byte_array<std::vector<RemoteEntry>>(replies[r].get());
+
+        for(size_t i = 0; i < entries.size(); i++)
+        {
+            RemoteEntry & re = entries[i];
+            if(!re.found)
+                continue;
+
+            const CacheKey & key = wanted.at(gets[r][i]);
 
-    SerializedGenericData scd{std::move(ba_data), md.type, md.hash, md.policy};
-    std::unique_ptr<GenericHolder<SerializedGenericData>> sdh(new GenericHolder<SerializedGenericData>(std::move(scd)));
+            SerializedGenericData sgd{std::move(re.data), re.type, re.hash, re.policy,
+                                      nullptr, 0, false, nullptr};
+            std::unique_ptr<GenericHolder<SerializedGenericData>> sdh(new GenericHolder<SerializedGenericData>(std::move(sgd)));
+
+            set_(key, key.hash_string(), std::move(sdh), re.policy);
+            nobtained++;
+        }
+    }
 
-    std::lock_guard<std::mutex> l(mutex_);
-    set_(key, std::move(sdh), md.policy);
+    nremote_ += nobtained;
+    return nobtained;
 }
 
 
+void CacheMap::obtain_from_distcache_(const CacheKey & key)
+{
+    prefetch(std::vector<CacheKey>{key});
+}
+
 
 } // close namespace pulsar
@@ -95,6 +95,15 @@ class GenericBase
          *        hashable
          */
         virtual bphash::HashValue my_hash(void) const = 0;
+
+
+        /*! \brief Estimate the memory used by the stored data
+         *
+         * This is meant for bookkeeping only, and does not have to be exact.
+         *
+         * \return The approximate size of the data (in bytes)
+         */
+        virtual size_t size_estimate(void) const noexcept = 0;
 };
 
 
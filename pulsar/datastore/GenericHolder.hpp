@@ -8,6 +8,7 @@
 
 #include "pulsar/util/Mangle.hpp"
 #include "pulsar/datastore/GenericBase.hpp"
+#include "pulsar/datastore/SizeEstimate.hpp"
 #include "pulsar/exception/PulsarException.hpp"
 #include "pulsar/util/Serialization.hpp"
 #include "pulsar/util/PythonHelper.hpp"
@@ -55,6 +56,16 @@ class GenericHolder : public GenericBase
         GenericHolder(T && m);
 
 
+        /*! \brief Construct by sharing an existing data object
+         *
+         * The object is not copied. It should not be modified
+         * by anything else afterwards.
+         *
+         * \param [in] m The object to share
+         */
+        explicit GenericHolder(std::shared_ptr<const T> m);
+
+
         // no other constructors, etc
         GenericHolder(void)                                   = delete;
         GenericHolder(const GenericHolder & oph)              = delete;
@@ -99,6 +110,11 @@ class GenericHolder : public GenericBase
 
         virtual bphash::HashValue my_hash(void) const;
 
+        ///////////////////////////////
+        // Memory
+        ///////////////////////////////
+        virtual size_t size_estimate(void) const noexcept;
+
 
     private:
         //! The actual data
@@ -107,6 +123,9 @@ class GenericHolder : public GenericBase
         //! Hash of the object (if hashable)
         bphash::HashValue hash_;
 
+        //! Estimated size of the object (in bytes)
+        size_t size_;
+
 
         // These are all helper function that may throw exceptions if you
         // are trying to do something invalid.
@@ -144,7 +163,7 @@ class GenericHolder : public GenericBase
 /////////////////////////////////////////////
 template<typename T>
 GenericHolder<T>::GenericHolder(const T & m)
-    : obj(std::make_shared<const T>(m))
+    : obj(std::make_shared<const T>(m)), size_(estimate_size(*obj))
 {
     if(is_hashable())
         make_my_hash_();
@@ -152,7 +171,15 @@ GenericHolder<T>::GenericHolder(const T & m)
 
 template<typename T>
 GenericHolder<T>::GenericHolder(T && m)
-    : obj(std::make_shared<const T>(std::move(m)))
+    : obj(std::make_shared<const T>(std::move(m))), size_(estimate_size(*obj))
+{
+    if(is_hashable())
+        make_my_hash_();
+}
+
+template<typename T>
+GenericHolder<T>::GenericHolder(std::shared_ptr<const T> m)
+    : obj(std::move(m)), size_(estimate_size(*obj))
 {
     if(is_hashable())
         make_my_hash_();
@@ -204,6 +231,12 @@ bphash::HashValue GenericHolder<T>::my_hash(void) const
         throw PulsarException("hash called for unhashable cache data");
 }
 
+template<typename T>
+size_t GenericHolder<T>::size_estimate(void) const noexcept
+{
+    return size_;
+}
+
 
 
 template<typename T>
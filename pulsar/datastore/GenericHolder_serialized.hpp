@@ -8,18 +8,45 @@
 
 #include "pulsar/datastore/GenericHolder.hpp"
 
+#include <functional>
+
 
 namespace pulsar {
 namespace detail {
 
 
-/*! \brief Storage type for serialized data */
+/*! \brief Storage type for serialized data
+ *
+ * The serialized bytes are normally stored in \p data. Alternatively,
+ * they may be stored elsewhere (for example, in a memory-mapped checkpoint
+ * file), in which case \p view points to them and keeps them alive.
+ * If \p fetch is set, it is called to obtain the bytes
+ * each time they are needed (for example, to decompress them).
+ */
 struct SerializedGenericData
 {
     ByteArray data;
     std::string type;
     bphash::HashValue hash;
     unsigned int policy;
+
+    std::shared_ptr<const char> view;  //!< Serialized bytes, if not stored in data
+    size_t view_size;                  //!< Number of bytes pointed to by view
+
+    bool verify;                        //!< Check the hash when unserializing?
+    std::function<ByteArray(void)> fetch;  //!< Obtains the serialized bytes, if set
+
+    //! Pointer to the serialized bytes
+    const char * bytes(void) const noexcept
+    {
+        return view ? view.get() : data.data();
+    }
+
+    //! Number of serialized bytes
+    size_t nbytes(void) const noexcept
+    {
+        return view ? view_size : data.size();
+    }
 };
 
 
@@ -53,9 +80,16 @@ class GenericHolder<SerializedGenericData> : public GenericBase
         get(void) const noexcept;
 
 
+        /*! \brief Unserialize the stored data
+         *
+         * The object is unserialized directly from the stored
+         * bytes, without any intermediate copies.
+         *
+         * \throw pulsar::PulsarException if \p T is not the stored type
+         */
         template<typename T>
         typename std::enable_if<SerializeCheck<T>::value,
-                                std::unique_ptr<T>>::type
+                                std::shared_ptr<T>>::type
         unserialize(void) const
         {
             std::string desired_type = typeid(T).name();
@@ -64,12 +98,18 @@ class GenericHolder<SerializedGenericData> : public GenericBase
                                                   "desired", demangle_cpp(desired_type),
                                                   "stored", demangle_cpp(obj->type));
 
-            return new_from_byte_array<T>(obj->data);
+            if(obj->fetch)
+            {
+                const ByteArray bytes = obj->fetch();
+                return make_shared_from_byte_array<T>(bytes.data(), bytes.size());
+            }
+
+            return make_shared_from_byte_array<T>(obj->bytes(), obj->nbytes());
         }
 
         template<typename T>
         typename std::enable_if<!SerializeCheck<T>::value,
-                                std::unique_ptr<T>>::type
+                                std::shared_ptr<T>>::type
         unserialize(void) const
         {
             // this is mostly to make compilers happy, since calls
@@ -107,6 +147,11 @@ class GenericHolder<SerializedGenericData> : public GenericBase
 
         virtual bphash::HashValue my_hash(void) const;
 
+        ///////////////////////////////
+        // Memory
+        ///////////////////////////////
+        virtual size_t size_estimate(void) const noexcept;
+
 
     private:
         //! The actual data
@@ -157,6 +202,10 @@ inline
 ByteArray GenericHolder<SerializedGenericData>::to_byte_array(void) const
 {
     // it's already been serialized!
+    if(obj->fetch)
+        return obj->fetch();
+    if(obj->view)
+        return ByteArray(obj->bytes(), obj->bytes() + obj->nbytes());
     return obj->data;
 }
 
@@ -176,6 +225,13 @@ bphash::HashValue GenericHolder<SerializedGenericData>::my_hash(void) const
         throw PulsarException("hash called for unhashable cache data");
 }
 
+inline
+size_t GenericHolder<SerializedGenericData>::size_estimate(void) const noexcept
+{
+    // Data in a view is not held in memory by us
+    return sizeof(SerializedGenericData) + obj->data.size() + obj->type.size();
+}
+
 
 } //closing namespace detail
 } //closing namespace pulsar
@@ -0,0 +1,132 @@
+/*! \file
+ *
+ * \brief Estimation of the memory used by objects (header)
+ */
+
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "pulsar/math/TensorImpl.hpp"
+
+namespace pulsar {
+namespace detail {
+
+/* Developer note
+ *
+ * All overloads are declared before any are defined. Otherwise, the
+ * overloads for containers would not be able to find the overloads
+ * for the types they contain (name lookup happens at the point of
+ * definition for types in namespace std).
+ */
+
+
+/*! \brief Does a class report the memory it uses?
+ *
+ * Classes that hold data on the heap may have a member function
+ * size_t memory_size(void) const, which is then used by estimate_size().
+ */
+template<typename T, typename = void>
+struct HasMemorySize : public std::false_type { };
+
+template<typename T>
+struct HasMemorySize<T, decltype(static_cast<void>(std::declval<const T &>().memory_size()))>
+    : public std::true_type { };
+
+
+/*! \brief Estimate the memory used by an object (in bytes)
+ *
+ * By default, this is the result of the memory_size() member of the
+ * object, if it has one, or else just the size of the object itself.
+ * Overloads exist for common types that hold data on the heap.
+ */
+template<typename T>
+size_t estimate_size(const T & obj);
+
+template<typename T>
+size_t estimate_size_(const T & obj, std::true_type);
+
+template<typename T>
+size_t estimate_size_(const T & obj, std::false_type);
+
+template<typename T>
+size_t estimate_size(const std::shared_ptr<T> & obj);
+
+template<typename T>
+size_t estimate_size(const std::vector<T> & obj);
+
+template<typename K, typename V>
+size_t estimate_size(const std::map<K, V> & obj);
+
+inline size_t estimate_size(const std::string & obj);
+
+template<size_t Rank, typename DataType>
+size_t estimate_size(const TensorImpl<Rank, DataType> & obj);
+
+
+
+template<typename T>
+size_t estimate_size(const T & obj)
+{
+    return estimate_size_(obj, HasMemorySize<T>());
+}
+
+template<typename T>
+size_t estimate_size_(const T & obj, std::true_type)
+{
+    return obj.memory_size();
+}
+
+template<typename T>
+size_t estimate_size_(const T & /*obj*/, std::false_type)
+{
+    return sizeof(T);
+}
+
+template<typename T>
+size_t estimate_size(const std::shared_ptr<T> & obj)
+{
+    return sizeof(obj) + (obj ? estimate_size(*obj) : 0);
+}
+
+template<typename T>
+size_t estimate_size(const std::vector<T> & obj)
+{
+    size_t s = sizeof(obj) + (obj.capacity() - obj.size()) * sizeof(T);
+    for(const auto & it : obj)
+        s += estimate_size(it);
+    return s;
+}
+
+template<typename K, typename V>
+size_t estimate_size(const std::map<K, V> & obj)
+{
+    size_t s = sizeof(obj);
+    for(const auto & it : obj)
+        s += estimate_size(it.first) + estimate_size(it.second);
+    return s;
+}
+
+inline size_t estimate_size(const std::string & obj)
+{
+    return sizeof(obj) + obj.capacity();
+}
+
+template<size_t Rank, typename DataType>
+size_t estimate_size(const TensorImpl<Rank, DataType> & obj)
+{
+    size_t n = 1;
+    for(size_t s : obj.sizes())
+        n *= s;
+    return sizeof(obj) + n * sizeof(DataType);
+}
+
+
+} // close namespace detail
+} // close namespace pulsar
+
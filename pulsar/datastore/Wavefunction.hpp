@@ -70,6 +70,25 @@ class Wavefunction
 
         bphash::HashValue my_hash(void) const;
 
+        /*! \brief Estimate of the memory used by this wavefunction (in bytes)
+         *
+         * The system is not included, since it is usually shared
+         * with other data.
+         */
+        size_t memory_size(void) const
+        {
+            size_t s = sizeof(*this);
+            if(cmat)
+                s += detail::estimate_size(*cmat);
+            if(opdm)
+                s += detail::estimate_size(*opdm);
+            if(epsilon)
+                s += detail::estimate_size(*epsilon);
+            if(occupations)
+                s += detail::estimate_size(*occupations);
+            return s;
+        }
+
     private:
 
         //! \name Serialization and Hashing
@@ -97,6 +97,24 @@ void export_datastore(pybind11::module & m)
     ;
   
 
+    ////////////////////////////////////////
+    // Statistics for the cache
+    ////////////////////////////////////////
+    pybind11::class_<CacheMapStats>(m, "CacheMapStats")
+    .def_readonly("nentries", &CacheMapStats::nentries)
+    .def_readonly("nspilled", &CacheMapStats::nspilled)
+    .def_readonly("nbytes", &CacheMapStats::nbytes)
+    .def_readonly("max_bytes", &CacheMapStats::max_bytes)
+    .def_readonly("nhits", &CacheMapStats::nhits)
+    .def_readonly("nmisses", &CacheMapStats::nmisses)
+    .def_readonly("nevicted", &CacheMapStats::nevicted)
+    .def_readonly("nreloaded", &CacheMapStats::nreloaded)
+    .def_readonly("nshared", &CacheMapStats::nshared)
+    .def_readonly("nremote", &CacheMapStats::nremote)
+    .def_readonly("ndirectory", &CacheMapStats::ndirectory)
+    ;
+
+
     ////////////////////////////////////////
     // CacheData
     // Can just store python object
@@ -105,7 +123,9 @@ void export_datastore(pybind11::module & m)
     pybind11::class_<CacheData> cd(m, "CacheData");
     cd.def("size", &CacheData::size)
       .def("get_keys", &CacheData::get_keys)
-      .def("erase", &CacheData::erase)
+      .def("erase", static_cast<size_t (CacheData::*)(const std::string &)>(&CacheData::erase))
+      .def("clear", &CacheData::clear)
+      .def("prefetch", &CacheData::prefetch)
       .def("get", [](CacheData & cdin, const std::string & key, bool use_distcache)
                   { 
                       auto r = cdin.get<pybind11::object>(key, use_distcache);
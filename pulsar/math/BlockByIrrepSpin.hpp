@@ -12,6 +12,7 @@
 #include "pulsar/util/Serialization.hpp"
 #include "pulsar/exception/PulsarException.hpp"
 #include "pulsar/math/Irrep.hpp"
+#include "pulsar/datastore/SizeEstimate.hpp"
 
 #include "bphash/types/map.hpp"
 
@@ -147,6 +148,12 @@ class BlockByIrrepSpin
         {
             return bphash::make_hash(bphash::HashType::Hash128, *this);
         }
+
+        //! Estimate of the memory used by this object and its data (in bytes)
+        size_t memory_size(void) const
+        {
+            return detail::estimate_size(data_);
+        }
         
         ///Prints the tensor by passing underlying tensor type to ostream
         std::ostream& print(std::ostream& os)const;
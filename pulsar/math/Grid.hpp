@@ -64,6 +64,29 @@ struct GridPointT
 
 
 
+namespace detail {
+
+/*! \brief Hashes grid points for the index of a Universe
+ *
+ * Unlike GridPointT::my_hash(), coordinates and values of 0.0 and -0.0
+ * (which compare equal) hash the same. The second template argument
+ * makes this more specialized than the version for types with my_hash().
+ */
+template<typename T>
+struct UniverseHasher<GridPointT<T>, decltype(void(std::declval<const GridPointT<T>&>().my_hash()))>
+{
+    size_t operator()(const GridPointT<T> & point) const
+    {
+        size_t seed = hash_float(point.value);
+        for(size_t i = 0; i < 3; i++)
+            hash_combine(seed, hash_float(point.coords[i]));
+        return seed;
+    }
+};
+
+} // close namespace detail
+
+
 // A grid is just a MathSet of grid points
 template<typename T>
 using GridT = MathSet<GridPointT<T>>;
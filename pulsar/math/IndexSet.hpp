@@ -0,0 +1,354 @@
+/*! \file
+ *
+ * \brief Storage of indices for MathSet
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <set>
+#include <vector>
+
+namespace pulsar{
+
+namespace detail {
+
+//! Number of set bits in a word
+inline size_t popcount_(uint64_t w) noexcept
+{
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_popcountll(w));
+#else
+    size_t n = 0;
+    for(; w; n++)
+        w &= w - 1;
+    return n;
+#endif
+}
+
+//! Position of the lowest set bit of a word. \p w must not be zero
+inline size_t find_first_set_(uint64_t w) noexcept
+{
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_ctzll(w));
+#else
+    size_t n = 0;
+    for(; !(w & 1); n++)
+        w >>= 1;
+    return n;
+#endif
+}
+
+} // close namespace detail
+
+
+
+/** \brief Indices stored as a bitset
+ *
+ *  Bit \p i of the words is set if index \p i is in the set. Set
+ *  operations are done a word (64 indices) at a time, and iterating
+ *  skips directly to the next set bit. Memory use is one bit per
+ *  index in the universe, regardless of the number of indices in the
+ *  set.
+ *
+ *  Words past the last set bit may or may not be stored, so sets
+ *  that compare equal may have a different number of words.
+ *
+ *  This is the default storage of MathSet.
+ */
+class BitsetIndexSet {
+private:
+    typedef uint64_t Word_t;
+    static constexpr size_t nbits_ = 64;///<Bits in a word
+
+public:
+    typedef size_t value_type;///<The type of the indices
+
+    /** \brief Iterates over the indices in the set, in increasing order
+     *
+     *  The end iterator is at the first bit past the stored words.
+     */
+    class const_iterator : public std::iterator<std::forward_iterator_tag, const size_t> {
+    private:
+        const Word_t * Words_;///<The words of the set
+        size_t NWords_;///<Number of words
+        size_t Pos_;///<Current index
+
+        friend BitsetIndexSet;
+        const_iterator(const Word_t * Words, size_t NWords, size_t Pos) noexcept :
+            Words_(Words), NWords_(NWords), Pos_(next_(Pos)) { }
+
+        ///Returns the first set bit at or after \p Pos, or the end
+        size_t next_(size_t Pos) const noexcept
+        {
+            size_t w = Pos / nbits_;
+            if(w >= NWords_)
+                return NWords_ * nbits_;
+            Word_t word = Words_[w] & (~Word_t(0) << (Pos % nbits_));
+            while(!word)
+            {
+                if(++w == NWords_)
+                    return NWords_ * nbits_;
+                word = Words_[w];
+            }
+            return w * nbits_ + detail::find_first_set_(word);
+        }
+
+    public:
+        const_iterator(const const_iterator&) = default;
+        const_iterator& operator=(const const_iterator&) = default;
+
+        bool operator==(const const_iterator& RHS)const noexcept{return Pos_ == RHS.Pos_;}
+        bool operator!=(const const_iterator& RHS)const noexcept{return Pos_ != RHS.Pos_;}
+
+        const size_t & operator*()const noexcept{return Pos_;}
+        const size_t * operator->()const noexcept{return &Pos_;}
+
+        const_iterator& operator++() noexcept{Pos_ = next_(Pos_+1);return *this;}
+        const_iterator operator++(int) noexcept{const_iterator ret(*this);++(*this);return ret;}
+    };
+
+
+    BitsetIndexSet() = default;
+    BitsetIndexSet(const BitsetIndexSet &) = default;
+    BitsetIndexSet & operator=(const BitsetIndexSet &) = default;
+
+    ///Moves the indices, leaving \p RHS empty
+    BitsetIndexSet(BitsetIndexSet && RHS) noexcept
+        : Words_(std::move(RHS.Words_)), Size_(RHS.Size_)
+    {
+        RHS.clear();
+    }
+
+    ///\copydoc BitsetIndexSet(BitsetIndexSet&&)
+    BitsetIndexSet & operator=(BitsetIndexSet && RHS) noexcept
+    {
+        if(this != &RHS)
+        {
+            Words_ = std::move(RHS.Words_);
+            Size_ = RHS.Size_;
+            RHS.clear();
+        }
+        return *this;
+    }
+
+    ///Makes a set from a range of indices
+    template<typename Itr>
+    BitsetIndexSet(Itr First, Itr Last)
+    {
+        for(; First != Last; ++First)
+            insert(*First);
+    }
+
+    ///Makes a set containing all indices in [0, N) (or none, if \p fill is false)
+    BitsetIndexSet(size_t N, bool fill)
+    {
+        if(!fill)
+            return;
+        Words_.assign((N + nbits_ - 1) / nbits_, ~Word_t(0));
+        if(N % nbits_)
+            Words_.back() = (Word_t(1) << (N % nbits_)) - 1;
+        Size_ = N;
+    }
+
+    ///Returns the number of indices in the set
+    size_t size(void)const noexcept{return Size_;}
+
+    ///Returns true if there are no indices in the set
+    bool empty(void)const noexcept{return Size_ == 0;}
+
+    ///Removes all indices
+    void clear(void) noexcept{Words_.clear();Size_ = 0;}
+
+    const_iterator begin()const noexcept{return const_iterator(Words_.data(), Words_.size(), 0);}
+    const_iterator end()const noexcept{return const_iterator(Words_.data(), Words_.size(), Words_.size() * nbits_);}
+
+    ///Returns 1 if \p Idx is in the set, 0 otherwise
+    size_t count(size_t Idx)const noexcept
+    {
+        const size_t w = Idx / nbits_;
+        return (w < Words_.size()) ? static_cast<size_t>((Words_[w] >> (Idx % nbits_)) & 1) : 0;
+    }
+
+    ///Adds \p Idx to the set
+    void insert(size_t Idx)
+    {
+        const size_t w = Idx / nbits_;
+        if(w >= Words_.size())
+            Words_.resize(w + 1, 0);
+        const Word_t bit = Word_t(1) << (Idx % nbits_);
+        Size_ += !(Words_[w] & bit);
+        Words_[w] |= bit;
+    }
+
+    ///Adds all indices in \p RHS to this set
+    BitsetIndexSet & union_assign(const BitsetIndexSet & RHS)
+    {
+        if(RHS.Words_.size() > Words_.size())
+            Words_.resize(RHS.Words_.size(), 0);
+        Size_ = 0;
+        for(size_t w = 0; w < RHS.Words_.size(); w++)
+            Size_ += detail::popcount_(Words_[w] |= RHS.Words_[w]);
+        for(size_t w = RHS.Words_.size(); w < Words_.size(); w++)
+            Size_ += detail::popcount_(Words_[w]);
+        return *this;
+    }
+
+    ///Removes all indices not in \p RHS
+    BitsetIndexSet & intersection_assign(const BitsetIndexSet & RHS) noexcept
+    {
+        if(RHS.Words_.size() < Words_.size())
+            Words_.resize(RHS.Words_.size());
+        Size_ = 0;
+        for(size_t w = 0; w < Words_.size(); w++)
+            Size_ += detail::popcount_(Words_[w] &= RHS.Words_[w]);
+        return *this;
+    }
+
+    ///Removes all indices in \p RHS
+    BitsetIndexSet & difference_assign(const BitsetIndexSet & RHS) noexcept
+    {
+        const size_t nw = std::min(Words_.size(), RHS.Words_.size());
+        for(size_t w = 0; w < nw; w++)
+        {
+            Size_ -= detail::popcount_(Words_[w] & RHS.Words_[w]);
+            Words_[w] &= ~RHS.Words_[w];
+        }
+        return *this;
+    }
+
+    ///Returns the indices in [0, N) not in this set
+    BitsetIndexSet complement(size_t N)const
+    {
+        BitsetIndexSet ret(N, true);
+        ret.difference_assign(*this);
+        return ret;
+    }
+
+    ///Returns true if all indices in this set are also in \p RHS
+    bool is_subset_of(const BitsetIndexSet & RHS)const noexcept
+    {
+        if(Size_ > RHS.Size_)
+            return false;
+        for(size_t w = 0; w < Words_.size(); w++)
+        {
+            const Word_t rhsw = (w < RHS.Words_.size()) ? RHS.Words_[w] : 0;
+            if(Words_[w] & ~rhsw)
+                return false;
+        }
+        return true;
+    }
+
+    bool operator==(const BitsetIndexSet & RHS)const noexcept
+    {
+        if(Size_ != RHS.Size_)
+            return false;
+        const size_t nw = std::min(Words_.size(), RHS.Words_.size());
+        for(size_t w = 0; w < nw; w++)
+            if(Words_[w] != RHS.Words_[w])
+                return false;
+        // Any remaining words are zero, since the sizes are the same
+        return true;
+    }
+
+    bool operator!=(const BitsetIndexSet & RHS)const noexcept{return !(*this == RHS);}
+
+    ///Returns the indices as a std::set (used for serialization and hashing)
+    std::set<size_t> as_set(void)const
+    {
+        return std::set<size_t>(begin(), end());
+    }
+
+private:
+    std::vector<Word_t> Words_;///<Bit i of word w is index w*64+i
+    size_t Size_ = 0;///<Number of set bits
+};
+
+
+
+/** \brief Indices stored in a std::set
+ *
+ *  Memory use and the cost of set operations scale with the number
+ *  of indices in the set rather than the size of the universe.
+ *  This was the storage of MathSet before BitsetIndexSet, and may
+ *  still be preferable for very sparse sets of very large universes.
+ */
+class TreeIndexSet {
+public:
+    typedef size_t value_type;///<The type of the indices
+    typedef std::set<size_t>::const_iterator const_iterator;///<Iterates over the indices
+
+    TreeIndexSet() = default;
+
+    ///Makes a set from a range of indices
+    template<typename Itr>
+    TreeIndexSet(Itr First, Itr Last) : Elems_(First, Last) { }
+
+    ///Makes a set containing all indices in [0, N) (or none, if \p fill is false)
+    TreeIndexSet(size_t N, bool fill)
+    {
+        for(size_t i = 0; i < (fill ? N : 0); i++)
+            Elems_.insert(Elems_.end(), i);
+    }
+
+    size_t size(void)const noexcept{return Elems_.size();}
+    bool empty(void)const noexcept{return Elems_.empty();}
+    void clear(void) noexcept{Elems_.clear();}
+    const_iterator begin()const noexcept{return Elems_.begin();}
+    const_iterator end()const noexcept{return Elems_.end();}
+    size_t count(size_t Idx)const{return Elems_.count(Idx);}
+    void insert(size_t Idx){Elems_.insert(Idx);}
+
+    TreeIndexSet & union_assign(const TreeIndexSet & RHS)
+    {
+        Elems_.insert(RHS.Elems_.begin(), RHS.Elems_.end());
+        return *this;
+    }
+
+    TreeIndexSet & intersection_assign(const TreeIndexSet & RHS)
+    {
+        std::set<size_t> NewTemp;
+        std::set_intersection(Elems_.begin(), Elems_.end(),
+                              RHS.Elems_.begin(), RHS.Elems_.end(),
+                              std::inserter(NewTemp, NewTemp.begin()));
+        Elems_ = std::move(NewTemp);
+        return *this;
+    }
+
+    TreeIndexSet & difference_assign(const TreeIndexSet & RHS)
+    {
+        std::set<size_t> NewTemp;
+        std::set_difference(Elems_.begin(), Elems_.end(),
+                            RHS.Elems_.begin(), RHS.Elems_.end(),
+                            std::inserter(NewTemp, NewTemp.begin()));
+        Elems_ = std::move(NewTemp);
+        return *this;
+    }
+
+    TreeIndexSet complement(size_t N)const
+    {
+        TreeIndexSet ret;
+        for(size_t i = 0; i < N; i++)
+            if(!Elems_.count(i))
+                ret.Elems_.insert(ret.Elems_.end(), i);
+        return ret;
+    }
+
+    bool is_subset_of(const TreeIndexSet & RHS)const
+    {
+        return std::includes(RHS.Elems_.begin(), RHS.Elems_.end(),
+                             Elems_.begin(), Elems_.end());
+    }
+
+    bool operator==(const TreeIndexSet & RHS)const{return Elems_ == RHS.Elems_;}
+    bool operator!=(const TreeIndexSet & RHS)const{return Elems_ != RHS.Elems_;}
+
+    const std::set<size_t> & as_set(void)const noexcept{return Elems_;}
+
+private:
+    std::set<size_t> Elems_;
+};
+
+}//End namespace pulsar
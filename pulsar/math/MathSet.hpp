@@ -9,26 +9,27 @@
 
 #include "pulsar/exception/Assert.hpp"
 #include "pulsar/math/Universe.hpp"
+#include "pulsar/math/IndexSet.hpp"
 #include "pulsar/util/IterTools.hpp"
 #include <iterator>
 namespace pulsar{
 
-template<typename T,typename U> class MathSet;
+template<typename T,typename U,typename S> class MathSet;
 
 /** An iterator to go with the MathSet class, returns actual objects
  *
  * The iterator only allows accessing the data, not modifying. That is,
  * this only behaves like a const_iterator
  */
-template<typename T, typename U>
+template<typename T, typename U, typename S>
 class ConstSetItr : public std::iterator<std::input_iterator_tag, const T> {
 private:
-    typedef ConstSetItr<T, U> My_t;///<Type of the iterator
+    typedef ConstSetItr<T, U, S> My_t;///<Type of the iterator
     typedef Universe<T,U> Universe_t;///<Type of Universe in MathSet
-    typedef std::set<size_t>::const_iterator Itr_t;///<Type of iterator to index
+    typedef typename S::const_iterator Itr_t;///<Type of iterator to index
     Itr_t CurrIdx_;///<An iterator to the indices in the current MathSet
     const Universe_t* Set_;///<The Universe with the real data
-    friend MathSet<T, U>;
+    friend MathSet<T, U, S>;
     ///Only MathSet can make a working iterator
     ConstSetItr(Itr_t CurrIdx, const Universe_t* Set) :
         CurrIdx_(CurrIdx), Set_(Set) { }
@@ -83,18 +84,27 @@ public:
  *     the values contained in this set. The hash will be
  *     the same even if the pointers point to different locations.
  *
+ * \par Storage of indices
+ *     The indices are stored in an object of type \p S. By default,
+ *     this is a BitsetIndexSet, which does set operations a word
+ *     at a time. TreeIndexSet (a std::set of indices) uses less
+ *     memory for very sparse sets of very large universes. The
+ *     storage does not affect serialization or hashing.
+ *
  *   \param T The type of the object in the set
      \param U The type of the container holding the objects
+     \param S The type storing the indices of the set
  *
  */
-template<typename T, typename U = std::vector<T>>
+template<typename T, typename U = std::vector<T>, typename S = BitsetIndexSet>
 class MathSet {
 private:
-    typedef MathSet<T, U> My_t;///<This class's type
+    typedef MathSet<T, U, S> My_t;///<This class's type
 public:
-    typedef ConstSetItr<T, U> const_iterator;///<An iterator to this class
+    typedef ConstSetItr<T, U, S> const_iterator;///<An iterator to this class
     typedef T value_type;///<The type of the elements
     typedef U store_type;///<The type of the container
+    typedef S index_set_type;///<The type storing the indices
     typedef Universe<T, U> Universe_t;///<Type of the universe in this class
     ///Type of a function capable of selecting elements
     typedef std::function<bool(const T &) > SelectorFunc;
@@ -109,17 +119,14 @@ public:
     // set of elements
     MathSet(std::shared_ptr<const Universe_t> AUniverse,
             const std::set<size_t> & Elems)
-    : Universe_(AUniverse)
+    : Universe_(AUniverse), Elems_(Elems.begin(), Elems.end())
     {
-        this->Elems_ = Elems;
     }
     
     ///Makes a set in the universe and fills in all elements if fill==true
     explicit MathSet(std::shared_ptr<const Universe_t> AUniverse, bool fill)
-          : Universe_(AUniverse)
+          : Universe_(AUniverse), Elems_(AUniverse->size(), fill)
     {
-            for(size_t i : Range<0>(fill?AUniverse->size():0))
-                Elems_.insert(i);
     }
     
     MathSet(const My_t&) = default;///<copies indices, aliases universe
@@ -164,7 +171,9 @@ public:
     ///Returns a deep copy of everything
     My_t clone()const
     {
-        return My_t(std::make_shared<Universe_t>(*Universe_), this->Elems_);
+        My_t ret(std::make_shared<Universe_t>(*Universe_), false);
+        ret.Elems_ = Elems_;
+        return ret;
     }
 
 
@@ -238,7 +247,7 @@ public:
     My_t& union_assign(const My_t & RHS)
     {
         if(!SameUniverse(RHS))throw PulsarException("Incompatible universes");
-        Elems_.insert(RHS.Elems_.begin(), RHS.Elems_.end());
+        Elems_.union_assign(RHS.Elems_);
         return *this;
     }
 
@@ -269,10 +278,8 @@ public:
     ///Returns the complement of this set
     My_t complement()const
     {
-        My_t Temp(Universe_,{});
-        for (const T& EI : *Universe_) {
-            if(!this->count(EI))Temp.insert(EI);
-        }
+        My_t Temp(Universe_,false);
+        Temp.Elems_ = Elems_.complement(Universe_->size());
         return Temp;
     }
 
@@ -306,6 +313,8 @@ public:
     bool is_subset_of(const My_t& RHS)const
     {
         if(!SameUniverse(RHS)) return false;
+        if(Universe_==RHS.Universe_)
+            return Elems_.is_subset_of(RHS.Elems_);
         for(const auto & it : *this)
             if(!RHS.count(it))
                 return false;
@@ -378,13 +387,17 @@ public:
     }
     ///@}
 
-        /** \brief Applies a function to each element in this set
+    /** \brief Applies a function to each element in this set
      * 
      *  This function takes a function of the signature:
      *  \code
      *  T transformer(const T& elem_in);
      *  \endcode
      *  which given some element, returns that elements new value.
+     *
+     *  Every element is inserted into a new universe. If the new values
+     *  are known to be distinct from each other and from the rest of the
+     *  universe, replace() avoids that.
      *  
      * \param[in] transformer the function to apply
      * \return A new, non-aliased, trasformed version of this set
@@ -403,7 +416,28 @@ public:
             else
                 newuniverse->insert(it);
         }
-        return My_t(newuniverse, this->Elems_);
+        My_t ret(newuniverse, false);
+        ret.Elems_ = Elems_;
+        return ret;
+    }
+
+    /** \brief Returns a copy of this set with some elements replaced
+     *
+     *  Each pair in \p NewElems is the index of an element in the
+     *  universe and its new value. The new universe is a full copy of the
+     *  old one (unchanged elements are copied, but not hashed or compared
+     *  again), with the elements replaced as in Universe::replace. The
+     *  copy contains the same indices as this set.
+     *
+     *  \throw pulsar::PulsarException if the replacement is invalid
+     */
+    My_t replace(std::vector<std::pair<size_t,T>> NewElems)const
+    {
+        auto newuniverse = std::make_shared<Universe_t>(*Universe_);
+        newuniverse->replace(std::move(NewElems));
+        My_t ret(newuniverse, false);
+        ret.Elems_ = Elems_;
+        return ret;
     }
 
     /** \brief Partitions the set in two based on some criteria
@@ -422,13 +456,13 @@ public:
      */
     My_t partition(SelectorFunc selector) const
     {
-        std::set<size_t> newelems;
+        My_t ret(Universe_, false);
         for(const auto & idx : Elems_) {
             const auto & el = (*Universe_)[idx];
             if(selector(el))
-                newelems.insert(idx);
+                ret.Elems_.insert(idx);
         }
-        return My_t(Universe_, newelems);
+        return ret;
     }
 
 
@@ -459,7 +493,7 @@ private:
     std::shared_ptr<const Universe_t> Universe_;
     
     ///Which elements of the universe are in the set
-    std::set<size_t> Elems_;
+    S Elems_;
 
     ///Does the universe contain the element
     void universe_contains(const T& Elem)const
@@ -499,24 +533,29 @@ private:
     /* We have to split load/save since the
      * the shared_ptr points to const data, and
      * cereal can't serialize to const data
+     *
+     * The indices are always serialized and hashed
+     * as a std::set, whatever the storage
      */
     template<class Archive>
     void save(Archive & ar) const
     {
-        ar(Universe_,Elems_);
+        ar(Universe_,Elems_.as_set());
     }
 
     template<class Archive>
     void load(Archive & ar)
     {
         std::shared_ptr<Universe_t> Newuniverse;
-        ar(Newuniverse,Elems_);
+        std::set<size_t> NewElems;
+        ar(Newuniverse,NewElems);
         Universe_=std::move(Newuniverse);
+        Elems_=S(NewElems.begin(),NewElems.end());
     }
 
     void hash(bphash::Hasher & h) const
     {
-        h(Universe_,Elems_);
+        h(Universe_,Elems_.as_set());
     }
 
     ///@}
@@ -526,51 +565,41 @@ private:
 
 /*********************** Implementations **************************************/
 
-template<typename T,typename U>
-MathSet<T,U>& MathSet<T,U>::intersection_assign(const MathSet<T,U>& RHS)
+template<typename T,typename U,typename S>
+MathSet<T,U,S>& MathSet<T,U,S>::intersection_assign(const MathSet<T,U,S>& RHS)
 {
         if(!SameUniverse(RHS))throw PulsarException("Universes are incompatible");
         if(&RHS==this)return *this;
-        std::set<size_t> NewTemp;
-        std::set_intersection(Elems_.begin(),Elems_.end(),
-                RHS.Elems_.begin(), RHS.Elems_.end(),
-                std::inserter<std::set<size_t>>(
-                NewTemp, NewTemp.begin()));
-        Elems_ = std::move(NewTemp);
+        Elems_.intersection_assign(RHS.Elems_);
         return *this;
 }
 
 
-template<typename T,typename U>
-MathSet<T,U>& MathSet<T,U>::difference_assign(const MathSet<T,U>& RHS)
+template<typename T,typename U,typename S>
+MathSet<T,U,S>& MathSet<T,U,S>::difference_assign(const MathSet<T,U,S>& RHS)
     {
         if(!SameUniverse(RHS))throw PulsarException("Universes are incompatible");
         if(&RHS==this){
-            Elems_=std::set<size_t>();
+            Elems_.clear();
             return *this;
         }
-        std::set<size_t> NewTemp;
-        std::set_difference(Elems_.begin(),Elems_.end(),
-                RHS.Elems_.begin(), RHS.Elems_.end(),
-                std::inserter<std::set < size_t >> (
-                NewTemp, NewTemp.begin()));
-        Elems_ = std::move(NewTemp);
+        Elems_.difference_assign(RHS.Elems_);
         return *this;
     }
 
 #define MATHSET_OP(op,name)\
-template<typename T,typename U>\
-MathSet<T,U> op(const MathSet<T,U>& LHS,const MathSet<T,U>& RHS) {\
+template<typename T,typename U,typename S>\
+MathSet<T,U,S> op(const MathSet<T,U,S>& LHS,const MathSet<T,U,S>& RHS) {\
    return LHS.name(RHS);\
 }
 #define MATHSET_OP2(op,name)\
-template<typename T,typename U>\
-MathSet<T,U>& op(MathSet<T,U>& LHS,const MathSet<T,U>& RHS) {\
+template<typename T,typename U,typename S>\
+MathSet<T,U,S>& op(MathSet<T,U,S>& LHS,const MathSet<T,U,S>& RHS) {\
    return LHS.name(RHS);\
 }
 #define MATHSET_COMP(op,name)\
-template<typename T,typename U>\
-bool op(const MathSet<T,U>& LHS,const MathSet<T,U>& RHS) {\
+template<typename T,typename U,typename S>\
+bool op(const MathSet<T,U,S>& LHS,const MathSet<T,U,S>& RHS) {\
     return LHS.name(RHS);\
 }
 
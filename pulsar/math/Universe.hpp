@@ -12,6 +12,10 @@
 #include <algorithm> //For std::find
 #include <sstream> //For printing
 #include <vector> //For default set container
+#include <limits> //For marking the end of a chain
+#include <type_traits> //For choosing the hasher
+#include <unordered_map> //For the index
+#include <utility> //For std::pair
 
 #include "pulsar/exception/PulsarException.hpp"
 #include "pulsar/util/Serialization.hpp"
@@ -24,6 +28,49 @@
 
 namespace pulsar{
 
+namespace detail {
+
+/** \brief Hashes elements for the index of a Universe
+ *
+ *  Uses std::hash, or my_hash() for types that have it. Elements that
+ *  compare equal must have the same hash. Specialize this for types
+ *  where a cheaper hash (of some of the compared members) is possible.
+ */
+template<typename T, typename = void>
+struct UniverseHasher
+{
+    size_t operator()(const T& Elem)const{return std::hash<T>()(Elem);}
+};
+
+/** \brief Hash of a floating-point number
+ *
+ *  0.0 and -0.0 compare equal, so they are given the same hash
+ */
+template<typename T>
+size_t hash_float(T x)
+{
+    // Adding +0.0 turns -0.0 into +0.0 and leaves any other value alone
+    return std::hash<T>()(x + T(0));
+}
+
+/** \brief Combines a hash into \p seed */
+inline void hash_combine(size_t & seed, size_t h)
+{
+    seed ^= h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+///Hashes elements via their my_hash() member
+template<typename T>
+struct UniverseHasher<T, decltype(void(std::declval<const T&>().my_hash()))>
+{
+    size_t operator()(const T& Elem)const
+    {
+        return bphash::convert_hash<size_t>(Elem.my_hash());
+    }
+};
+
+}//End namespace detail
+
 /** \brief A class that implements a mathematical ordered set.
  * 
  *   The Universe and MathSet classes are closesly related.  The main difference
@@ -36,9 +83,11 @@ namespace pulsar{
  *  std::vector with some additional functionality related to sets like union,
  *  intersection, uniqueness of elements, etc.
  * 
- *  \todo Is it better to switch to an std::unordered_map<T,size_t>, which maps
- *  each element to an arbitrary unique index?  Look-up and union would be
- *  constant.
+ *  Alongside the elements, the Universe keeps an index from the hash of
+ *  each element (see detail::UniverseHasher) to its position, so count(),
+ *  idx(), and insert() take constant time, and union, intersection, and
+ *  comparison take linear time. Elements with the same hash are chained
+ *  in order of their position.
  *
  * \par Hashing
  *     The hash value of a Universe is unique with respect to the values
@@ -72,6 +121,93 @@ private:
     ///Where the actual elements are stored
     U Storage_;
 
+    ///Marks the end of a chain in Next_
+    static constexpr size_t npos_=std::numeric_limits<size_t>::max();
+
+    ///Maps the hash of an element to the first position with that hash
+    std::unordered_map<size_t,size_t> Index_;
+
+    ///The next position with the same hash as each element (or npos_)
+    std::vector<size_t> Next_;
+
+    ///Returns the position of \p Elem, or npos_ if it isn't present
+    size_t find_(const T& Elem)const
+    {
+        auto it=Index_.find(detail::UniverseHasher<T>()(Elem));
+        if(it==Index_.end())return npos_;
+        for(size_t i=it->second;i!=npos_;i=Next_[i])
+            if(Storage_[i]==Elem)return i;
+        return npos_;
+    }
+
+    ///Adds the element at position \p i (the last element) to the index
+    void index_back_(size_t i)
+    {
+        auto it=Index_.emplace(detail::UniverseHasher<T>()(Storage_[i]),i);
+        Next_.push_back(npos_);
+        if(!it.second)
+        {
+            // append to the end of the chain
+            size_t last=it.first->second;
+            while(Next_[last]!=npos_)last=Next_[last];
+            Next_[last]=i;
+        }
+    }
+
+    ///Removes position \p i from the chain for hash \p h
+    void unindex_(size_t i,size_t h)
+    {
+        auto it=Index_.find(h);
+        if(it->second==i)
+        {
+            if(Next_[i]==npos_)Index_.erase(it);
+            else it->second=Next_[i];
+        }
+        else
+        {
+            size_t prev=it->second;
+            while(Next_[prev]!=i)prev=Next_[prev];
+            Next_[prev]=Next_[i];
+        }
+        Next_[i]=npos_;
+    }
+
+    ///Adds position \p i to the chain for hash \p h, keeping it in order
+    void index_(size_t i,size_t h)
+    {
+        auto it=Index_.emplace(h,i);
+        if(it.second)return;
+        if(i<it.first->second)
+        {
+            Next_[i]=it.first->second;
+            it.first->second=i;
+            return;
+        }
+        size_t prev=it.first->second;
+        while(Next_[prev]!=npos_ && Next_[prev]<i)prev=Next_[prev];
+        Next_[i]=Next_[prev];
+        Next_[prev]=i;
+    }
+
+    ///Rebuilds the index after Storage_ is changed
+    void rebuild_index_()
+    {
+        Index_.clear();
+        Next_.clear();
+        Index_.reserve(Storage_.size());
+        Next_.reserve(Storage_.size());
+        for(size_t i=0;i<Storage_.size();++i)index_back_(i);
+    }
+
+    ///Appends \p elem if it isn't already present
+    template<typename V>
+    void insert_(V&& elem)
+    {
+        if(find_(elem)!=npos_)return;
+        Storage_.insert(Storage_.end(),std::forward<V>(elem));
+        index_back_(Storage_.size()-1);
+    }
+
 public:
     ///The type of the element
     using value_type=T;
@@ -89,23 +225,32 @@ public:
     Universe(){ }
     
     ///Deep copies the universe
-    Universe(const My_t& RHS) : Storage_(RHS.Storage_) { }
+    Universe(const My_t& RHS)
+        : Storage_(RHS.Storage_),Index_(RHS.Index_),Next_(RHS.Next_) { }
     
     ///Move constructs a universe
-    Universe(My_t&& RHS) : Storage_(std::move(RHS.Storage_)){}
+    Universe(My_t&& RHS)
+        : Storage_(std::move(RHS.Storage_)),Index_(std::move(RHS.Index_)),
+          Next_(std::move(RHS.Next_)){}
     
     ///Initializes the elements of the universe to the arguments
     template<typename...Args>
-    Universe(T arg1,Args...args): Storage_({arg1,args...}){}
+    Universe(T arg1,Args...args): Storage_({arg1,args...}){rebuild_index_();}
        
     ///Creates universe that contains elements in initializer list
-    Universe(std::initializer_list<T> l):Storage_(l){}
+    Universe(std::initializer_list<T> l):Storage_(l){rebuild_index_();}
 
     ///Deep copies during assignment
     My_t& operator=(const My_t & RHS);
     
     ///Move assignment
-    My_t& operator=(My_t && RHS){Storage_=std::move(RHS.Storage_);return *this;}
+    My_t& operator=(My_t && RHS)
+    {
+        Storage_=std::move(RHS.Storage_);
+        Index_=std::move(RHS.Index_);
+        Next_=std::move(RHS.Next_);
+        return *this;
+    }
     ///@}
 
     ///@{
@@ -116,7 +261,7 @@ public:
     
     ///Returns the number of times \p Elem is present in the universe
     bool count(const T& Elem)const{
-        return std::find(begin(),end(), Elem) != end();
+        return find_(Elem) != npos_;
     }
        
     ///Returns the index of \p Elem, which is good for the life of this instance
@@ -158,14 +303,14 @@ public:
     ///Inserts \p elem into the set at the end (satisfies std::set API)
     Universe<T,U>& insert(const T& elem)
     {
-        if(!count(elem))Storage_.insert(Storage_.end(),elem);
+        insert_(elem);
         return *this;
     }
     
     ///\copydoc insert
     Universe<T,U>& insert(T&& elem)
     {
-        if(!count(elem))Storage_.insert(Storage_.end(),std::move(elem));
+        insert_(std::move(elem));
         return *this;
     }
     
@@ -176,6 +321,74 @@ public:
         while(b!=e)insert(*b++);
         return *this;
     }
+
+    /** \brief Replaces elements of the universe, keeping their indices
+     *
+     *  Each pair in \p NewElems is the index of an element and the value
+     *  that replaces it. Only the new elements are hashed and compared,
+     *  so the cost depends on the number of replaced elements, rather
+     *  than the size of the universe. The replaced elements may be
+     *  permuted amongst themselves.
+     *
+     *  \throw pulsar::PulsarException if an index is out of range or
+     *         repeated, or if the replacement would make two elements of
+     *         the universe equal. The universe is unchanged if so.
+     */
+    Universe<T,U>& replace(std::vector<std::pair<size_t,T>> NewElems)
+    {
+        const detail::UniverseHasher<T> hasher;
+
+        std::vector<size_t> idxs;
+        idxs.reserve(NewElems.size());
+        for(const auto& it : NewElems)
+        {
+            if(it.first>=size())
+                throw PulsarException("Requested element is out of range","EI",it.first);
+            idxs.push_back(it.first);
+        }
+        std::sort(idxs.begin(),idxs.end());
+        auto repeated=std::adjacent_find(idxs.begin(),idxs.end());
+        if(repeated!=idxs.end())
+            throw PulsarException("Element is replaced more than once","EI",*repeated);
+
+        // New elements must not equal elements that are staying, or
+        // each other (which are compared by sorting on their hashes)
+        std::vector<std::pair<size_t,size_t>> hashes;
+        hashes.reserve(NewElems.size());
+        for(size_t i=0;i<NewElems.size();++i)
+        {
+            const size_t current=find_(NewElems[i].second);
+            if(current!=npos_ && !std::binary_search(idxs.begin(),idxs.end(),current))
+                throw PulsarException("Replacement element is already in the universe",
+                                      "EI",NewElems[i].first,"current",current);
+            hashes.emplace_back(hasher(NewElems[i].second),i);
+        }
+        std::sort(hashes.begin(),hashes.end());
+        for(size_t i=0;i<hashes.size();++i)
+            for(size_t j=i+1;j<hashes.size() && hashes[j].first==hashes[i].first;++j)
+                if(NewElems[hashes[i].second].second==NewElems[hashes[j].second].second)
+                    throw PulsarException("Replacement elements are equal",
+                                          "EI",NewElems[hashes[i].second].first,
+                                          "EJ",NewElems[hashes[j].second].first);
+
+        for(const auto& it : NewElems)
+            unindex_(it.first,hasher(Storage_[it.first]));
+        for(const auto& h : hashes)
+        {
+            auto& it=NewElems[h.second];
+            Storage_[it.first]=std::move(it.second);
+            index_(it.first,h.first);
+        }
+        return *this;
+    }
+
+    ///Replaces the element at index \p EI with \p elem (see above)
+    Universe<T,U>& replace(size_t EI,T elem)
+    {
+        std::vector<std::pair<size_t,T>> NewElems;
+        NewElems.emplace_back(EI,std::move(elem));
+        return replace(std::move(NewElems));
+    }
     ///@}
 
 
@@ -233,6 +446,7 @@ public:
             if (RHS.count(Element)) 
                 Temp.push_back(std::move(Element));
         Storage_ = std::move(Temp);
+        rebuild_index_();
         return *this;
     }
 
@@ -255,6 +469,7 @@ public:
             if (!RHS.count(Element))
                 Temp.push_back(std::move(Element));
         Storage_ = std::move(Temp);
+        rebuild_index_();
         return *this;
     }
 
@@ -391,7 +606,7 @@ public:
     template<class Archive> void save(Archive & ar) const{ar(Storage_);}
     
     ///Loads the Universe from an archive
-    template<class Archive> void load(Archive & ar){ar(Storage_);}
+    template<class Archive> void load(Archive & ar){ar(Storage_);rebuild_index_();}
 
     ///Hashes the Storage_ instance
     void hash(bphash::Hasher & h) const{h(Storage_);}
@@ -409,12 +624,15 @@ Universe<T,U>& Universe<T,U>::operator=(const Universe<T,U>& RHS)
     return *this;
 }
 
+template<typename T,typename U>
+constexpr size_t Universe<T,U>::npos_;
+
 template<typename T,typename U>
 size_t Universe<T,U>::idx(const T& Elem)const
 {
-    auto it = std::find(begin(), end(), Elem);
-    if(it != end())
-        return std::distance(begin(), it);
+    const size_t i = find_(Elem);
+    if(i != npos_)
+        return i;
     else 
         throw PulsarException("Element is not part of this universe");
 }
@@ -18,26 +18,24 @@ size_t EnergyMethod::max_deriv_()const{
 class FDFunctor:public FDiffVisitor<double,Return_t>{
 private:
     size_t Order_;
-    const std::vector<Atom>& Atoms_;
+    std::shared_ptr<const AtomArrays> Arrays_;
     const Wavefunction & Wfn_;
     ModulePtr<EnergyMethod> EMeth_;
 public:
-    double coord(size_t i)const{return Atoms_[(i-i%3)/3][i%3];}
+    double coord(size_t i)const{
+        const std::vector<double>& Comp=i%3==0?Arrays_->x:(i%3==1?Arrays_->y:Arrays_->z);
+        return Comp[i/3];
+    }
     double shift(const double& Old,const double& H,double Shift)const{
         return Old+H*Shift;
     }
     Return_t run(size_t i,const double& newcoord)const{
-        const Atom& AtomI=Atoms_[(i-i%3)/3];
-        Atom AtomJ(AtomI);
-        AtomJ[i%3]=newcoord;
+        //Only the displaced atom is replaced in the new system
+        std::vector<double> x(Arrays_->x),y(Arrays_->y),z(Arrays_->z);
+        (i%3==0?x:(i%3==1?y:z))[i/3]=newcoord;
         Wavefunction NewWfn(Wfn_);
-        NewWfn.system=std::make_shared<const System>(std::move(
-            Wfn_.system->transform(
-                [&](const Atom& ai){
-                    return ai!=AtomI?ai:AtomJ;
-                }
-            )
-        ));
+        NewWfn.system=std::make_shared<const System>(
+            Wfn_.system->with_coordinates(x,y,z));
         auto temp=EMeth_->deriv(Order_-1,NewWfn).second;
         return temp;
     }
@@ -52,9 +50,9 @@ public:
         for(size_t j=0;j<Element.size();j++)RV[j]+=Element[j]/H;
     }
 
-    FDFunctor(size_t Order,const std::vector<Atom>& Atoms,
+    FDFunctor(size_t Order,std::shared_ptr<const AtomArrays> Arrays,
               const Wavefunction & Wfn,ModulePtr<EnergyMethod>&& EMeth):
-        Order_(Order),Atoms_(Atoms),Wfn_(Wfn),EMeth_(std::move(EMeth)){}
+        Order_(Order),Arrays_(std::move(Arrays)),Wfn_(Wfn),EMeth_(std::move(EMeth)){}
 };
 
 
@@ -64,15 +62,12 @@ EnergyMethod::finite_difference_(size_t Order, const Wavefunction & Wfn){
         throw PulsarException("I do not know how to obtain an energy via "
                                "finite difference.");
     const System& Mol=*(Wfn.system);
-    std::vector<Atom> Atoms(Mol.begin(),Mol.end());
     std::vector<Return_t> TempDeriv;
-    //I don't know why the fill constructor is not working...
-    //for(const Atom& AnAtom: Mol)Atoms.push_back(AnAtom);
     
     CentralDiff<double,Return_t> FD;
     auto EMeth=create_child<EnergyMethod>(key());
 
-    TempDeriv=FD.Run(FDFunctor(Order,Atoms,Wfn,std::move(EMeth)),3*Mol.size(),
+    TempDeriv=FD.Run(FDFunctor(Order,Mol.get_arrays(),Wfn,std::move(EMeth)),3*Mol.size(),
                      options().get<double>("FDIFF_DISPLACEMENT"),
                      options().get<size_t>("FDIFF_STENCIL_SIZE"));
     
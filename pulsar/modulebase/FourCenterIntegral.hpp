@@ -12,6 +12,8 @@
 #include "pulsar/system/BasisSet.hpp"
 #include "pulsar/util/PythonIntegralHelper.hpp"
 
+#include <array>
+
 namespace pulsar{
 
 /*! \brief Two-electron integral implementation
@@ -27,6 +29,9 @@ public:
         typedef FourCenterIntegral BaseType;
         typedef std::string HashType;
 
+        //! Shell indices of each center, for calculating a batch of integrals
+        typedef std::array<uint64_t, 4> ShellTuple;
+
         FourCenterIntegral(ID_t id)
             : ModuleBase(id, "FourCenterIntegral"), initialized_(false)
         { }
@@ -87,8 +92,11 @@ public:
         const double* calculate(uint64_t shell1, uint64_t shell2,
                            uint64_t shell3, uint64_t shell4)
         {
-            ModuleBase::call_function(&FourCenterIntegral::initialized_or_throw_);
-            return ModuleBase::call_function(&FourCenterIntegral::calculate_,
+            // hot path - only call initialized_or_throw_ when it will throw
+            if(!initialized_)
+                ModuleBase::call_function(&FourCenterIntegral::initialized_or_throw_);
+
+            return ModuleBase::call_function_fast(&FourCenterIntegral::calculate_,
                                                 shell1, shell2, shell3, shell4);
         }
 
@@ -112,15 +120,41 @@ public:
                                                   shells1, shells2, shells3, shells4);
         }
 
+        /*! \brief calculate integrals for many shell quartets at once
+         *
+         * The integrals of each quartet are placed in \p outbuffer one after
+         * the other, and where they start is stored in \p offsets. This
+         * avoids the overhead of calling calculate() for every quartet.
+         *
+         * \throw pulsar::PulsarException if \p outbuffer is too small
+         *
+         * \param [in] shells Shell indices of each quartet
+         * \param [in] outbuffer Where to place the completed integrals
+         * \param [in] bufsize Size of \p outbuffer (as the number of doubles)
+         * \param [out] offsets Where the integrals of each quartet start in \p outbuffer.
+         *             Must have room for shells.size()+1 elements. The last
+         *             element is set to the total number of integrals.
+         * \return Number of integrals calculated
+         */
+        uint64_t calculate_batch(const std::vector<ShellTuple> & shells,
+                                 double * outbuffer, size_t bufsize,
+                                 uint64_t * offsets)
+        {
+            ModuleBase::call_function(&FourCenterIntegral::initialized_or_throw_);
+            return ModuleBase::call_function_fast(&FourCenterIntegral::calculate_batch_,
+                                                  shells, outbuffer, bufsize, offsets);
+        }
+
+
         /*! \brief calculate an integral (for use from python)
          *
          * \param [in] shell1 Shell index on the first center
          * \param [in] shell2 Shell index on the second center
          * \param [in] shell3 Shell index on the third center
          * \param [in] shell4 Shell index on the fourth center
-         * \return Integrals in a Python list
+         * \return Integrals in a NumPy array (see PythonIntegralHelper for when they are copied)
          */
-        pybind11::list calculate_py(uint64_t shell1, uint64_t shell2,
+        pybind11::array_t<double> calculate_py(uint64_t shell1, uint64_t shell2,
                                           uint64_t shell3, uint64_t shell4)
         {
                const double* ints =
@@ -136,12 +170,12 @@ public:
          * \param [in] shells2 Shell indicies on the second center
          * \param [in] shells3 Shell indicies on the third center
          * \param [in] shells4 Shell indicies on the fourth center
-         * \return The integrals in a Python list
+         * \return The integrals in a NumPy array (see PythonIntegralHelper for when they are copied)
          */
-        pybind11::list calculate_multi_py(const std::vector<uint64_t> & shells1,
-                                    const std::vector<uint64_t> & shells2,
-                                    const std::vector<uint64_t> & shells3,
-                                    const std::vector<uint64_t> & shells4)
+        pybind11::array_t<double> calculate_multi_py(const std::vector<uint64_t> & shells1,
+                                                     const std::vector<uint64_t> & shells2,
+                                                     const std::vector<uint64_t> & shells3,
+                                                     const std::vector<uint64_t> & shells4)
         {
             const double* ints=
               ModuleBase::call_function(&FourCenterIntegral::calculate_multi_,
@@ -209,6 +243,38 @@ public:
 
 
 
+        //! \copydoc calculate_batch
+        virtual uint64_t calculate_batch_(const std::vector<ShellTuple> & shells,
+                                          double * outbuffer, size_t bufsize,
+                                          uint64_t * offsets)
+        {
+            //////////////////////////////////////////////////////////
+            // default implementation - just loop over and do them all
+            //////////////////////////////////////////////////////////
+            const uint64_t ncomponents = n_components_();
+            uint64_t ntotal = 0;
+
+            for(size_t i = 0; i < shells.size(); i++)
+            {
+                const ShellTuple & s = shells[i];
+                const uint64_t nints = ncomponents * helper_.size(s[0], s[1], s[2], s[3]);
+
+                // be safe with unsigned types (ntotal <= bufsize)
+                if(nints > bufsize - ntotal)
+                    throw PulsarException("Output buffer is too small for the integrals",
+                                          "bufsize", bufsize, "needed", ntotal + nints);
+
+                const double * ints = calculate_(s[0], s[1], s[2], s[3]);
+                std::copy(ints, ints + nints, outbuffer + ntotal);
+                offsets[i] = ntotal;
+                ntotal += nints;
+            }
+
+            offsets[shells.size()] = ntotal;
+            return ntotal;
+        }
+
+
     private:
         bool initialized_; //!< Has initialize() been called
 
@@ -268,8 +334,9 @@ class FourCenterIntegral_Py : public FourCenterIntegral
         virtual const double* calculate_(uint64_t shell1, uint64_t shell2,
                                     uint64_t shell3, uint64_t shell4)
         {
-                pybind11::list ints =
-                    call_py_override<pybind11::list>(this,"calculate_",shell1,shell2,shell3,shell4);
+                pybind11::gil_scoped_acquire gil;
+                pybind11::object ints =
+                    call_py_override<pybind11::object>(this,"calculate_",shell1,shell2,shell3,shell4);
 
                 return helper_.py_2_int(ints);
         }
@@ -283,8 +350,9 @@ class FourCenterIntegral_Py : public FourCenterIntegral
 
               if(has_py_override<FourCenterIntegral>(this, "calculate_multi_"))
               {
-                  pybind11::list ints=
-                          call_py_override<pybind11::list>(this,"calculate_multi_",shells1,shells2,shells3,shells4);
+                  pybind11::gil_scoped_acquire gil;
+                  pybind11::object ints=
+                          call_py_override<pybind11::object>(this,"calculate_multi_",shells1,shells2,shells3,shells4);
                   return helper_.py_2_int(ints);
               }
 
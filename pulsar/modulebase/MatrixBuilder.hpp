@@ -39,13 +39,16 @@ class MatrixBuilder : public ModuleBase
                              unsigned int deriv, const Wavefunction & wfn,
                              const BasisSet & bs1, const BasisSet & bs2)
         {
-            auto hash=my_hash(key,deriv,wfn,bs1,bs2);
-            auto cache_value=cache().get<ReturnType>(hash,false);
-            if(cache_value)return *cache_value;
-            auto rv = ModuleBase::call_function(&MatrixBuilder::calculate_,
-                                                key, deriv, wfn, bs1, bs2);
-            cache().set(hash,rv,CacheMap::CachePolicy::CheckpointLocal);
-            return rv;
+            const CacheKey hash=cache().make_key(my_hash(key,deriv,wfn,bs1,bs2));
+            // Only one thread computes the matrix. Others asking for
+            // the same matrix at the same time wait for that result
+            auto rv = cache().get_or_compute(hash, CacheMap::CachePolicy::CheckpointLocal,
+                                             [&](void)
+                                             {
+                                                 return ModuleBase::call_function(&MatrixBuilder::calculate_,
+                                                                                  key, deriv, wfn, bs1, bs2);
+                                             });
+            return *rv;
         }
 
         HashType my_hash(const std::string & key,
@@ -21,7 +21,7 @@ ModuleBase::ModuleBase(ID_t id, const char * modtype)
     : tbts_(get_global_output().rdbuf(), nullptr),
       out(&tbts_),
       id_(id), modtype_(modtype), mlocator_(nullptr),
-      treenode_(nullptr)
+      treenode_(nullptr), fast_dispatch_(false)
 {
     out.debug("Constructed %? module [%?]\n", modtype, id);
 }
@@ -98,6 +98,11 @@ bool ModuleBase::debug_enabled(void) const noexcept
     return out.debug_enabled();
 }
 
+bool ModuleBase::fast_dispatch_enabled(void) const noexcept
+{
+    return fast_dispatch_;
+}
+
 const ModuleTreeNode & ModuleBase::my_node(void) const
 {
     if(treenode_ == nullptr)
@@ -142,6 +147,11 @@ CacheData & ModuleBase::cache(void) const noexcept
     return *cache_;
 }
 
+CacheData & ModuleBase::shared_cache(void) const
+{
+    return module_manager().shared_cache();
+}
+
 
 ////////////////////////////////
 // Private functions
@@ -175,4 +185,32 @@ void ModuleBase::set_cache_(CacheData && cache)
     cache_ = std::unique_ptr<CacheData>(new CacheData(std::move(cache)));
 }
 
+void ModuleBase::set_fast_dispatch_(bool fast) noexcept
+{
+    fast_dispatch_ = fast;
+}
+
+void ModuleBase::rethrow_with_info_(void) const
+{
+    // Same as what call_function does
+    try {
+        throw;
+    }
+    catch(PulsarException & ex)
+    {
+        ex.append_info("from", exception_desc());
+        throw;
+    }
+    catch(std::exception & ex)
+    {
+        throw PulsarException(ex, "what", ex.what(),
+                               "from", exception_desc());
+    }
+    catch(...)
+    {
+        throw PulsarException("Caught unknown exception. Get your debugger warmed up.",
+                               "from", exception_desc());
+    }
+}
+
 } // close namespace pulsar
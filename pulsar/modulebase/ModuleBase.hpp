@@ -124,6 +124,14 @@ class ModuleBase
         bool debug_enabled(void) const noexcept;
 
 
+        /*! \brief Are hot calls dispatched directly for this module
+         *
+         * This is decided when the module is created
+         * (see ModuleManager::enable_fast_dispatch)
+         */
+        bool fast_dispatch_enabled(void) const noexcept;
+
+
 
         /*! \brief Return a pointer to my node on the module tree
          *
@@ -196,6 +204,14 @@ class ModuleBase
         CacheData & cache(void) const noexcept;
 
 
+        /*! \brief Get the cache object shared by all modules
+         *
+         * For data that doesn't depend on which module computed it
+         * (see ModuleManager::shared_cache())
+         */
+        CacheData & shared_cache(void) const;
+
+
 
         ////////////////////////////////////////////////////
         // WRAPPERS FOR DERIVED CLASS FUNCTION CALLS
@@ -283,6 +299,38 @@ class ModuleBase
         }
 
 
+        /*! \brief Call a function on a hot path
+         *
+         * If fast dispatch was enabled when this module was created
+         * (and it is a C++ module), the function is called directly.
+         * There is no dynamic_cast, and information about this module is
+         * only added to exceptions after they are thrown. Otherwise,
+         * this is the same as call_function().
+         *
+         * \warning \p P must be the class making this call (or one of its
+         *          bases), so that this object is known to be a \p P
+         *
+         * \copydetails call_function
+         */
+        template<typename R, typename P, typename ... Targs1, typename ... Targs2>
+        R call_function_fast( R(P::*func)(Targs1...), Targs2 &&... args)
+        {
+            static_assert(std::is_base_of<ModuleBase, P>::value, "Cannot call function of unrelated class");
+
+            if(!fast_dispatch_)
+                return call_function(func, std::forward<Targs2>(args)...);
+
+            try {
+                P * ptr = static_cast<P *>(this);
+                return ((*ptr).*func)(std::forward<Targs1>(args)...);
+            }
+            catch(...)
+            {
+                rethrow_with_info_();
+            }
+        }
+
+
         /*! \brief Calls a python function that overrides a virtual function
          */
         template<typename R, typename D, typename ... Targs>
@@ -381,6 +429,9 @@ class ModuleBase
         //! My cache
         std::unique_ptr<CacheData> cache_;
 
+        //! Are hot calls dispatched directly? (set by ModuleManager)
+        bool fast_dispatch_;
+
 
         ////////////////////
         // Functions
@@ -406,6 +457,19 @@ class ModuleBase
         /*! \brief Move-Create my CacheData object
          */
         void set_cache_(CacheData && cache);
+
+
+        /*! \brief Set whether hot calls are dispatched directly
+         */
+        void set_fast_dispatch_(bool fast) noexcept;
+
+
+        /*! \brief Rethrow the current exception with information about this module
+         *
+         * This is kept out of line, so that it doesn't affect the
+         * code of the fast path of call_function_fast.
+         */
+        [[noreturn]] void rethrow_with_info_(void) const;
 };
 
 
@@ -26,13 +26,16 @@ class Rank3Builder : public ModuleBase
                              const BasisSet& bs2,
                              const BasisSet& bs3)
         {
-            auto hash=my_hash(key,deriv,wfn,bs1,bs2,bs3);
-            auto cache_value=cache().get<ReturnType>(hash,false);
-            if(cache_value)return *cache_value;
-            auto rv = ModuleBase::call_function(&Rank3Builder::calculate_,
-                                                key, deriv, wfn, bs1, bs2,bs3);
-            cache().set(hash,rv,CacheMap::CachePolicy::CheckpointLocal);
-            return rv;
+            const CacheKey hash=cache().make_key(my_hash(key,deriv,wfn,bs1,bs2,bs3));
+            // Only one thread computes the matrix. Others asking for
+            // the same matrix at the same time wait for that result
+            auto rv = cache().get_or_compute(hash, CacheMap::CachePolicy::CheckpointLocal,
+                                             [&](void)
+                                             {
+                                                 return ModuleBase::call_function(&Rank3Builder::calculate_,
+                                                                                  key, deriv, wfn, bs1, bs2,bs3);
+                                             });
+            return *rv;
         }
 
         HashType my_hash(const std::string & key,
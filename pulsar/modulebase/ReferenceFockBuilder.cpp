@@ -0,0 +1,338 @@
+/*! \file
+ *
+ * \brief Reference implementation of a Fock builder (source)
+ */
+
+#include "pulsar/modulebase/ReferenceFockBuilder.hpp"
+#include "pulsar/math/EigenImpl.hpp"
+#include "pulsar/parallel/Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+namespace pulsar{
+
+namespace {
+
+// Number of ket shell pairs in a tile
+const size_t ket_tile_size = 32;
+
+
+//! A bra shell pair and a range of ket shell pairs
+struct Tile_
+{
+    size_t bra;        //!< Position of the bra pair in the significant pairs
+    size_t ket_begin;  //!< First position of the ket pairs
+    size_t ket_end;    //!< One past the last position of the ket pairs
+};
+
+
+/*! \brief Tiles given to a thread
+ *
+ * Tiles are taken from the front by the owner and by any
+ * other thread that has run out of work.
+ */
+struct TileRange_
+{
+    std::atomic<size_t> next;
+    size_t end;
+};
+
+
+//! Matrices accumulated by a single thread
+struct Accumulator_
+{
+    std::vector<Eigen::MatrixXd> J;
+    std::vector<Eigen::MatrixXd> K;
+
+    Accumulator_(size_t ndens, size_t nbf)
+        : J(ndens, Eigen::MatrixXd::Zero(nbf, nbf)),
+          K(ndens, Eigen::MatrixXd::Zero(nbf, nbf))
+    { }
+};
+
+
+/*! \brief Calculate the contributions from all quartets of a tile
+ *
+ * Contributions are accumulated without the factors from the
+ * symmetrization (see build_jk)
+ */
+void process_tile_(const Tile_ & tile,
+                   FourCenterIntegral & eri,
+                   const BasisSet & bs,
+                   const ShellPairList & pairs,
+                   const std::vector<size_t> & significant,
+                   const std::vector<Eigen::MatrixXd> & densities,
+                   double threshold,
+                   Accumulator_ & acc)
+{
+    const size_t ndens = densities.size();
+
+    const size_t ij = significant[tile.bra];
+    const uint64_t i = pairs.shell1(ij);
+    const uint64_t j = pairs.shell2(ij);
+    const double bound_ij = pairs.bound(ij);
+
+    const size_t ni = bs.shell(i).n_functions();
+    const size_t nj = bs.shell(j).n_functions();
+    const size_t si = bs.shell_start(i);
+    const size_t sj = bs.shell_start(j);
+    const double deg_ij = (i == j) ? 1.0 : 2.0;
+
+    for(size_t pos = tile.ket_begin; pos < tile.ket_end; pos++)
+    {
+        const size_t kl = significant[pos];
+        if(bound_ij * pairs.bound(kl) < threshold)
+            continue;
+
+        const uint64_t k = pairs.shell1(kl);
+        const uint64_t l = pairs.shell2(kl);
+
+        const size_t nk = bs.shell(k).n_functions();
+        const size_t nl = bs.shell(l).n_functions();
+        const size_t sk = bs.shell_start(k);
+        const size_t sl = bs.shell_start(l);
+
+        // degeneracy of this quartet within the 8-fold symmetry
+        const double deg = deg_ij * ((k == l) ? 1.0 : 2.0) * ((ij == kl) ? 1.0 : 2.0);
+
+        const double * ints = eri.calculate(i, j, k, l);
+
+        for(size_t d = 0; d < ndens; d++)
+        {
+            const Eigen::MatrixXd & D = densities[d];
+            Eigen::MatrixXd & J = acc.J[d];
+            Eigen::MatrixXd & K = acc.K[d];
+
+            const double * v = ints;
+            for(size_t a = 0; a < ni; a++)
+            {
+                const Eigen::Index p = static_cast<Eigen::Index>(si + a);
+                for(size_t b = 0; b < nj; b++)
+                {
+                    const Eigen::Index q = static_cast<Eigen::Index>(sj + b);
+                    for(size_t c = 0; c < nk; c++)
+                    {
+                        const Eigen::Index r = static_cast<Eigen::Index>(sk + c);
+                        for(size_t e = 0; e < nl; e++, v++)
+                        {
+                            const Eigen::Index s = static_cast<Eigen::Index>(sl + e);
+                            const double val = deg * (*v);
+
+                            J(p, q) += D(r, s) * val;
+                            J(r, s) += D(p, q) * val;
+                            K(p, r) += D(q, s) * val;
+                            K(q, s) += D(p, r) * val;
+                            K(p, s) += D(q, r) * val;
+                            K(q, r) += D(p, s) * val;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // close anonymous namespace
+
+
+
+JKMatrices build_jk(const std::vector<FourCenterIntegral *> & eris,
+                    const BasisSet & bs,
+                    const ShellPairList & pairs,
+                    const std::vector<Eigen::MatrixXd> & densities,
+                    double threshold)
+{
+    const size_t nthreads = eris.size();
+    const size_t ndens = densities.size();
+    const size_t nbf = bs.n_functions();
+    const Eigen::Index nbf_idx = static_cast<Eigen::Index>(nbf);
+
+    if(nthreads == 0)
+        throw PulsarException("No integral modules given to build_jk");
+    if(!pairs.is_symmetric())
+        throw PulsarException("build_jk requires the shell pairs of a single basis set");
+    if(pairs.n_shell_pairs() != bs.n_shell()*(bs.n_shell()+1)/2)
+        throw PulsarException("Shell pairs are not from this basis set",
+                              "npairs", pairs.n_shell_pairs(), "nshell", bs.n_shell());
+    for(const auto & D : densities)
+        if(D.rows() != nbf_idx || D.cols() != nbf_idx)
+            throw PulsarException("Density matrix does not match the basis set",
+                                  "rows", D.rows(), "cols", D.cols(), "nbf", nbf);
+
+    // Pairs that can contribute to any quartet above the threshold
+    double maxbound = 0.0;
+    for(size_t n = 0; n < pairs.n_shell_pairs(); n++)
+        maxbound = std::max(maxbound, pairs.bound(n));
+
+    std::vector<size_t> significant;
+    if(maxbound > 0.0)
+        for(const auto & pair : pairs.significant(threshold / maxbound))
+            significant.push_back(pair.index);
+
+    // Unique quartets are (ij|kl) with kl <= ij
+    std::vector<Tile_> tiles;
+    for(size_t bra = 0; bra < significant.size(); bra++)
+        for(size_t ket = 0; ket <= bra; ket += ket_tile_size)
+            tiles.push_back(Tile_{bra, ket, std::min(ket + ket_tile_size, bra + 1)});
+
+    // Initial distribution of the tiles
+    std::vector<TileRange_> ranges(nthreads);
+    const size_t ntiles = tiles.size();
+    for(size_t t = 0; t < nthreads; t++)
+    {
+        ranges[t].next = (ntiles * t) / nthreads;
+        ranges[t].end = (ntiles * (t+1)) / nthreads;
+    }
+
+    std::vector<Accumulator_> acc(nthreads, Accumulator_(ndens, nbf));
+    std::vector<std::exception_ptr> errors(nthreads);
+
+    auto worker = [&](size_t t)
+    {
+        try {
+            // own tiles first, then take from the other threads
+            for(size_t n = 0; n < nthreads; n++)
+            {
+                TileRange_ & range = ranges[(t + n) % nthreads];
+                for(size_t pos = range.next++; pos < range.end; pos = range.next++)
+                    process_tile_(tiles[pos], *eris[t], bs, pairs, significant,
+                                  densities, threshold, acc[t]);
+            }
+        }
+        catch(...)
+        {
+            errors[t] = std::current_exception();
+
+            // stop the other threads from starting new tiles
+            for(auto & range : ranges)
+                range.next = range.end;
+        }
+    };
+
+    {
+        // Python integral modules take the GIL in calculate(), so
+        // the other threads would deadlock if we kept holding it
+        std::unique_ptr<pybind11::gil_scoped_release> nogil;
+        if(nthreads > 1 && Py_IsInitialized() && PyGILState_Check())
+            nogil.reset(new pybind11::gil_scoped_release);
+
+        std::vector<std::thread> threads;
+        for(size_t t = 1; t < nthreads; t++)
+            threads.emplace_back(worker, t);
+        worker(0);
+        for(auto & th : threads)
+            th.join();
+    }
+
+    for(const auto & err : errors)
+        if(err)
+            std::rethrow_exception(err);
+
+    // Reduction, followed by symmetrization. The factors account
+    // for the (unsymmetrized) contributions from process_tile_
+    JKMatrices ret;
+    for(size_t d = 0; d < ndens; d++)
+    {
+        Eigen::MatrixXd J = acc[0].J[d];
+        Eigen::MatrixXd K = acc[0].K[d];
+        for(size_t t = 1; t < nthreads; t++)
+        {
+            J += acc[t].J[d];
+            K += acc[t].K[d];
+        }
+
+        ret.J.push_back(0.25 * (J + J.transpose()));
+        ret.K.push_back(0.125 * (K + K.transpose()));
+    }
+
+    return ret;
+}
+
+
+
+void ReferenceFockBuilder::initialize_(unsigned int deriv,
+                                       const Wavefunction & wfn,
+                                       const BasisSet & bs)
+{
+    if(deriv != 0)
+        throw PulsarException("ReferenceFockBuilder only supports deriv == 0",
+                              "deriv", deriv);
+
+    bs_ = bs;
+
+    const OptionMap & opt = options();
+    if(opt.has("SCREENING_THRESHOLD"))
+        threshold_ = opt.get<double>("SCREENING_THRESHOLD");
+
+    size_t nthreads = get_nthreads();
+    if(opt.has("NTHREADS"))
+        nthreads = opt.get<size_t>("NTHREADS");
+    nthreads = std::max<size_t>(nthreads, 1);
+
+    // One module per thread, since modules are not thread safe
+    eris_.clear();
+    for(size_t t = 0; t < nthreads; t++)
+    {
+        eris_.push_back(create_child_from_option<FourCenterIntegral>("KEY_FOUR_CENTER"));
+        eris_.back()->initialize(deriv, wfn, bs, bs, bs, bs);
+    }
+
+    pairs_ = get_shell_pair_list(shared_cache(), deriv, wfn, bs, bs, *eris_[0]);
+}
+
+
+IrrepSpinMatrixD ReferenceFockBuilder::calculate_(const Wavefunction & wfn)
+{
+    if(eris_.empty())
+        throw PulsarException("ReferenceFockBuilder has not been initialized");
+    if(!wfn.opdm)
+        throw PulsarException("Wavefunction does not have a density");
+
+    const IrrepSpinMatrixD & opdm = *wfn.opdm;
+    const auto irreps = opdm.get_irreps();
+    if(irreps.size() != 1)
+        throw PulsarException("ReferenceFockBuilder only supports densities in the AO basis "
+                              "(a single irrep)", "nirrep", irreps.size());
+
+    const Irrep irrep = *irreps.begin();
+    const auto spins = opdm.get_spins(irrep);
+    const std::vector<int> spinlist(spins.begin(), spins.end());
+
+    std::vector<Eigen::MatrixXd> densities;
+    for(int s : spinlist)
+        densities.push_back(*convert_to_eigen(*opdm.get(irrep, s)));
+
+    std::vector<FourCenterIntegral *> eris;
+    for(auto & eri : eris_)
+        eris.push_back(&(*eri));
+
+    const JKMatrices jk = build_jk(eris, bs_, *pairs_, densities, threshold_);
+
+    IrrepSpinMatrixD ret;
+    if(spinlist.size() == 1)
+    {
+        Eigen::MatrixXd G = jk.J[0] - 0.5 * jk.K[0];
+        ret.set(irrep, spinlist[0], std::make_shared<EigenMatrixImpl>(std::move(G)));
+    }
+    else
+    {
+        // J is linear in the density
+        Eigen::MatrixXd Jtotal = jk.J[0];
+        for(size_t s = 1; s < spinlist.size(); s++)
+            Jtotal += jk.J[s];
+
+        for(size_t s = 0; s < spinlist.size(); s++)
+        {
+            Eigen::MatrixXd G = Jtotal - jk.K[s];
+            ret.set(irrep, spinlist[s], std::make_shared<EigenMatrixImpl>(std::move(G)));
+        }
+    }
+
+    return ret;
+}
+
+} // close namespace pulsar
@@ -0,0 +1,95 @@
+/*! \file
+ *
+ * \brief Reference implementation of a Fock builder (header)
+ */
+
+
+#ifndef PULSAR_GUARD_MODULEBASE__REFERENCEFOCKBUILDER_HPP_
+#define PULSAR_GUARD_MODULEBASE__REFERENCEFOCKBUILDER_HPP_
+
+#include "pulsar/modulebase/FockBuilder.hpp"
+#include "pulsar/modulebase/FourCenterIntegral.hpp"
+#include "pulsar/system/ShellPairList.hpp"
+
+#include <Eigen/Dense>
+
+namespace pulsar{
+
+//! Coulomb and exchange matrices, one for each density
+struct JKMatrices
+{
+    std::vector<Eigen::MatrixXd> J;
+    std::vector<Eigen::MatrixXd> K;
+};
+
+
+/*! \brief Build Coulomb and exchange matrices from four-center integrals
+ *
+ * For each density D,
+ *
+ *     J(p,q) = sum_rs (pq|rs) D(r,s)
+ *     K(p,q) = sum_rs (pr|qs) D(r,s)
+ *
+ * Only shell quartets unique under the 8-fold permutational symmetry
+ * of the integrals are calculated, and quartets with a Schwarz bound
+ * below \p threshold are skipped.
+ *
+ * The quartets are split into tiles (a bra shell pair and a block of
+ * ket shell pairs). Each thread starts with a contiguous range of tiles,
+ * and takes tiles from the ranges of other threads once its own is done.
+ * Each thread uses its own integral module (and therefore its own
+ * integral buffer) and accumulates into its own matrices, which are
+ * summed at the end. The python GIL is released (if held) while the
+ * threads run, since python integral modules need it.
+ *
+ * \param [in] eris Integral modules, one for each thread. Each must already
+ *                  be initialized with (bs, bs, bs, bs), and must calculate
+ *                  the integrals (first component only) in row-major order.
+ * \param [in] bs Basis set used for all four centers
+ * \param [in] pairs Shell pairs of (bs, bs), with Schwarz bounds
+ * \param [in] densities Density matrices (symmetric, in the basis of \p bs)
+ * \param [in] threshold Screening threshold for the integrals
+ *
+ * \throw pulsar::PulsarException if the arguments are not consistent,
+ *        or if calculating the integrals throws
+ */
+JKMatrices build_jk(const std::vector<FourCenterIntegral *> & eris,
+                    const BasisSet & bs,
+                    const ShellPairList & pairs,
+                    const std::vector<Eigen::MatrixXd> & densities,
+                    double threshold);
+
+
+/*! \brief A Fock builder that works with any four-center integral module
+ *
+ * calculate() returns the two-electron part of the Fock matrix
+ * (the core Hamiltonian is not included). For a density with a single
+ * spin block (closed shell), this is J - K/2. Otherwise, for each spin
+ * it is J[D_total] - K[D_spin].
+ *
+ * Options (used if present):
+ *   - KEY_FOUR_CENTER: Module key of the four-center integrals (required)
+ *   - SCREENING_THRESHOLD: Schwarz screening threshold (default 1e-12)
+ *   - NTHREADS: Number of threads (default get_nthreads())
+ */
+class ReferenceFockBuilder : public FockBuilder
+{
+    public:
+        using FockBuilder::FockBuilder;
+
+        virtual void initialize_(unsigned int deriv,
+                                 const Wavefunction & wfn,
+                                 const BasisSet & bs);
+
+        virtual IrrepSpinMatrixD calculate_(const Wavefunction & wfn);
+
+    private:
+        BasisSet bs_;
+        double threshold_ = 1e-12;
+        std::vector<ModulePtr<FourCenterIntegral>> eris_;
+        std::shared_ptr<const ShellPairList> pairs_;
+};
+
+} // close namespace pulsar
+
+#endif
@@ -0,0 +1,570 @@
+/*! \file
+ *
+ * \brief Storage of four-center integrals between calls (source)
+ */
+
+#include "pulsar/modulebase/StoredFourCenterIntegral.hpp"
+#include "pulsar/util/Memwatch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace pulsar{
+
+namespace {
+
+// Smallest chunk of memory storage to allocate
+const size_t min_chunk_size = 1 << 20;
+
+
+//! Index of the shell pair (i,j) with i >= j
+inline uint64_t pair_index_(uint64_t i, uint64_t j)
+{
+    return i*(i+1)/2 + j;
+}
+
+
+//! Bytes needed to store \p nints integrals, rounded up to keep doubles aligned
+inline size_t packed_size_(uint8_t packing, size_t nints)
+{
+    size_t n = 0;
+    if(packing == 1)
+        n = nints * sizeof(float);
+    else if(packing == 2)
+        n = nints * sizeof(double);
+    return (n + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+
+//! Shell pairs in order of decreasing Schwarz bound, and their bounds
+void sort_by_bound_(const ShellPairList & pairs, std::vector<size_t> & order,
+                    std::vector<double> & bounds)
+{
+    const size_t npair = pairs.n_shell_pairs();
+    order.resize(npair);
+    for(size_t n = 0; n < npair; n++)
+        order[n] = n;
+    std::sort(order.begin(), order.end(),
+              [&pairs](size_t a, size_t b) { return pairs.bound(a) > pairs.bound(b); });
+
+    bounds.resize(npair);
+    for(size_t n = 0; n < npair; n++)
+        bounds[n] = pairs.bound(order[n]);
+}
+
+
+//! Number of the (decreasing) \p bounds whose product with \p bound is at least \p precision
+inline size_t n_significant_(const std::vector<double> & bounds, double bound, double precision)
+{
+    if(bound <= 0.0)
+        return 0;
+
+    const double minbound = precision / bound;
+    return static_cast<size_t>(std::lower_bound(bounds.begin(), bounds.end(), minbound,
+                                                [](double a, double b) { return a >= b; })
+                               - bounds.begin());
+}
+
+} // close anonymous namespace
+
+
+size_t integral_storage_budget(void) noexcept
+{
+    const size_t limit = memwatch_running() ? memwatch_getlimit() : 0;
+    if(limit == 0)
+        return std::numeric_limits<size_t>::max();
+
+    const size_t allocated = memwatch_allocated();
+    return (allocated < limit) ? (limit - allocated) / 2 : 0;
+}
+
+
+IntegralStorageTier choose_storage_tier(size_t nbytes, bool disk_allowed) noexcept
+{
+    if(nbytes <= integral_storage_budget())
+        return IntegralStorageTier::Memory;
+    if(disk_allowed)
+        return IntegralStorageTier::Disk;
+    return IntegralStorageTier::Recompute;
+}
+
+
+
+////////////////////////////////
+// FourCenterIntegralStore
+////////////////////////////////
+FourCenterIntegralStore::FourCenterIntegralStore(const BasisSet & bs, const ShellPairList & pairs,
+                                                 unsigned int ncomponents, IntegralStorageTier tier,
+                                                 double precision, const std::string & directory)
+    : tier_(tier), precision_(precision), ncomponents_(ncomponents), bs_(bs),
+      chunk_used_(0), chunk_size_(0), file_(nullptr), remove_file_(false),
+      nrequested_(0), nstored_(0), nbytes_(0), memory_size_(sizeof(FourCenterIntegralStore))
+{
+    if(tier_ == IntegralStorageTier::Recompute)
+        return;
+
+    if(!pairs.is_symmetric() || !pairs.has_schwarz_bounds() ||
+       pairs.n_shell_pairs() != pair_index_(bs.n_shell(), 0))
+        throw PulsarException("Storing integrals requires the Schwarz bounds of the shell pairs of the basis set",
+                              "nshell", bs.n_shell(), "nshellpairs", pairs.n_shell_pairs());
+
+    std::vector<size_t> order;
+    std::vector<double> bounds;
+    sort_by_bound_(pairs, order, bounds);
+
+    const size_t npair = order.size();
+    rank_.resize(npair);
+    slot_start_.assign(npair+1, 0);
+    for(size_t r = 0; r < npair; r++)
+    {
+        rank_[order[r]] = r;
+        const size_t nket = std::min(r+1, n_significant_(bounds, bounds[r], precision_));
+        slot_start_[r+1] = slot_start_[r] + nket;
+    }
+
+    slots_ = std::vector<Slot_>(slot_start_[npair]);
+    for(auto & slot : slots_)
+        slot.state = 0;
+
+    if(tier_ == IntegralStorageTier::Memory)
+        memory_size_ += estimate_size(pairs, ncomponents_, precision_);
+    else
+        memory_size_ += slots_.size() * sizeof(Slot_) + 2 * npair * sizeof(size_t);
+
+    if(tier_ == IntegralStorageTier::Disk)
+    {
+        if(directory.empty())
+        {
+            file_ = std::tmpfile();
+            if(file_ == nullptr)
+                throw PulsarException("Unable to create a temporary file for storing integrals",
+                                      "what", std::strerror(errno));
+        }
+        else
+        {
+            // mkstemp creates a new file, so nothing already there is overwritten
+            std::string path = directory + "/pulsar_integrals_XXXXXX";
+            const int fd = mkstemp(&path[0]);
+            if(fd == -1)
+                throw PulsarException("Unable to create a file for storing integrals",
+                                      "what", std::strerror(errno), "directory", directory);
+
+            path_ = path;
+            file_ = fdopen(fd, "w+b");
+            if(file_ == nullptr)
+            {
+                close(fd);
+                std::remove(path_.c_str());
+                throw PulsarException("Unable to open file for storing integrals",
+                                      "what", std::strerror(errno), "path", path_);
+            }
+            remove_file_ = true;
+        }
+    }
+}
+
+
+FourCenterIntegralStore::~FourCenterIntegralStore()
+{
+    if(file_ != nullptr)
+        std::fclose(file_);
+    if(remove_file_)
+        std::remove(path_.c_str());
+}
+
+
+size_t FourCenterIntegralStore::estimate_size(const ShellPairList & pairs,
+                                              unsigned int ncomponents, double precision)
+{
+    // Pairs sorted by decreasing bound, with the running
+    // total of the number of functions
+    std::vector<size_t> order;
+    std::vector<double> bounds;
+    sort_by_bound_(pairs, order, bounds);
+
+    const size_t npair = order.size();
+    std::vector<double> nfunc_total(npair+1, 0.0);
+    for(size_t n = 0; n < npair; n++)
+        nfunc_total[n+1] = nfunc_total[n] + static_cast<double>(pairs.n_functions(order[n]));
+
+    // For each bra, the unique ket pairs with a product of bounds
+    // above the precision (the slots made by the constructor)
+    double nints = 0.0;
+    double nslots = 0.0;
+    for(size_t n = 0; n < npair; n++)
+    {
+        const size_t nket = std::min(n+1, n_significant_(bounds, bounds[n], precision));
+        nints += static_cast<double>(pairs.n_functions(order[n])) * nfunc_total[nket];
+        nslots += static_cast<double>(nket);
+    }
+
+    const double nbytes = nints * ncomponents * sizeof(double)
+                        + nslots * sizeof(Slot_)
+                        + 2.0 * static_cast<double>(npair) * sizeof(size_t);
+
+    if(nbytes >= static_cast<double>(std::numeric_limits<size_t>::max()))
+        return std::numeric_limits<size_t>::max();
+    return static_cast<size_t>(nbytes);
+}
+
+
+const double * FourCenterIntegralStore::calculate(FourCenterIntegral & eri, Workspace & ws,
+                                                  uint64_t shell1, uint64_t shell2,
+                                                  uint64_t shell3, uint64_t shell4)
+{
+    const uint64_t req[4] = {shell1, shell2, shell3, shell4};
+    size_t n[4];
+    for(int m = 0; m < 4; m++)
+        n[m] = bs_.shell(req[m]).n_functions();
+    const size_t nfunc = n[0]*n[1]*n[2]*n[3];
+    const size_t nints = ncomponents_ * nfunc;
+
+    nrequested_ += nints;
+
+    if(tier_ == IntegralStorageTier::Recompute)
+        return eri.calculate(shell1, shell2, shell3, shell4);
+
+    // Find the unique quartet, and where each
+    // requested shell is within it
+    int perm[4] = {0, 1, 2, 3};
+    uint64_t canon[4] = {shell1, shell2, shell3, shell4};
+    if(canon[0] < canon[1])
+    {
+        std::swap(canon[0], canon[1]);
+        std::swap(perm[0], perm[1]);
+    }
+    if(canon[2] < canon[3])
+    {
+        std::swap(canon[2], canon[3]);
+        std::swap(perm[2], perm[3]);
+    }
+
+    size_t bra = rank_[pair_index_(canon[0], canon[1])];
+    size_t ket = rank_[pair_index_(canon[2], canon[3])];
+    if(bra < ket)
+    {
+        std::swap(bra, ket);
+        std::swap(canon[0], canon[2]);
+        std::swap(canon[1], canon[3]);
+        for(int m = 0; m < 4; m++)
+            perm[m] = (perm[m] + 2) % 4;
+    }
+
+    // Quartets below the precision have no slot, and
+    // are zero (like quartets stored with Packing_::Zero)
+    if(ket >= slot_start_[bra+1] - slot_start_[bra])
+    {
+        nstored_ += nints;
+        ws.ints.assign(nints, 0.0);
+        return ws.ints.data();
+    }
+
+    Slot_ & slot = slots_[slot_start_[bra] + ket];
+
+    // Packed data for the unique quartet (or the integrals
+    // if they are calculated now)
+    const char * packed = nullptr;
+    const double * calculated = nullptr;
+    uint8_t packing = 2;
+
+    uint8_t state = slot.state.load(std::memory_order_acquire);
+    if(state == 2)
+    {
+        packing = static_cast<uint8_t>(slot.packing);
+        packed = load_(slot, nints, ws);
+        nstored_ += nints;
+    }
+    else
+    {
+        calculated = eri.calculate(canon[0], canon[1], canon[2], canon[3]);
+
+        // If someone else is storing it, just use what we calculated
+        if(state == 0 && slot.state.compare_exchange_strong(state, 1))
+        {
+            store_(slot, calculated, nints);
+            slot.state.store(2, std::memory_order_release);
+        }
+
+        if(perm[0] == 0 && perm[1] == 1 && perm[2] == 2 && perm[3] == 3)
+            return calculated;
+    }
+
+    // Stored in the requested order already
+    if(packing == 2 && packed && perm[0] == 0 && perm[1] == 1 && perm[2] == 2 && perm[3] == 3)
+        return reinterpret_cast<const double *>(packed);
+
+    ws.ints.resize(nints);
+    if(packing == 0)
+    {
+        std::fill(ws.ints.begin(), ws.ints.end(), 0.0);
+        return ws.ints.data();
+    }
+
+    // Strides of the unique quartet, in the order of the request
+    size_t ncanon[4];
+    for(int m = 0; m < 4; m++)
+        ncanon[perm[m]] = n[m];
+    const size_t canon_stride[4] = {ncanon[1]*ncanon[2]*ncanon[3], ncanon[2]*ncanon[3], ncanon[3], 1};
+    size_t stride[4];
+    for(int m = 0; m < 4; m++)
+        stride[m] = canon_stride[perm[m]];
+
+    const float * fsrc = reinterpret_cast<const float *>(packed);
+    const double * dsrc = calculated ? calculated : reinterpret_cast<const double *>(packed);
+
+    double * dest = ws.ints.data();
+    for(size_t c = 0; c < ncomponents_; c++)
+    {
+        const size_t start = c * nfunc;
+        for(size_t a = 0; a < n[0]; a++)
+        for(size_t b = 0; b < n[1]; b++)
+        for(size_t d = 0; d < n[2]; d++)
+        for(size_t e = 0; e < n[3]; e++)
+        {
+            const size_t idx = start + a*stride[0] + b*stride[1] + d*stride[2] + e*stride[3];
+            *dest++ = (packing == 1) ? static_cast<double>(fsrc[idx]) : dsrc[idx];
+        }
+    }
+
+    return ws.ints.data();
+}
+
+
+void FourCenterIntegralStore::store_(Slot_ & slot, const double * ints, size_t nints)
+{
+    double maxint = 0.0;
+    for(size_t i = 0; i < nints; i++)
+        maxint = std::max(maxint, std::fabs(ints[i]));
+
+    uint8_t packing = 2;
+    if(maxint <= precision_)
+        packing = 0;
+    else if(maxint * FLT_EPSILON <= precision_)
+        packing = 1;
+
+    slot.packing = static_cast<Packing_>(packing);
+
+    const size_t nbytes = packed_size_(packing, nints);
+    if(nbytes == 0)
+        return;
+
+    // pack into memory, or into a buffer for writing to disk
+    std::vector<char> diskbuf;
+    char * dest = nullptr;
+    if(tier_ == IntegralStorageTier::Memory)
+        dest = allocate_(nbytes);
+    else
+    {
+        diskbuf.resize(nbytes);
+        dest = diskbuf.data();
+    }
+
+    if(packing == 1)
+    {
+        float * fdest = reinterpret_cast<float *>(dest);
+        for(size_t i = 0; i < nints; i++)
+            fdest[i] = static_cast<float>(ints[i]);
+    }
+    else
+        std::memcpy(dest, ints, nints * sizeof(double));
+
+    if(tier_ == IntegralStorageTier::Memory)
+        slot.location = reinterpret_cast<uintptr_t>(dest);
+    else
+    {
+        std::lock_guard<std::mutex> l(mutex_);
+        std::fseek(file_, 0, SEEK_END);
+        slot.location = static_cast<uint64_t>(std::ftell(file_));
+        if(std::fwrite(diskbuf.data(), 1, nbytes, file_) != nbytes)
+            throw PulsarException("Unable to write integrals to file", "path", path_);
+    }
+
+    nbytes_ += nbytes;
+}
+
+
+const char * FourCenterIntegralStore::load_(const Slot_ & slot, size_t nints, Workspace & ws)
+{
+    const uint8_t packing = static_cast<uint8_t>(slot.packing);
+    const size_t nbytes = packed_size_(packing, nints);
+    if(nbytes == 0)
+        return nullptr;
+
+    if(tier_ == IntegralStorageTier::Memory)
+        return reinterpret_cast<const char *>(static_cast<uintptr_t>(slot.location));
+
+    // keep the buffer aligned for doubles
+    ws.packed.resize(nbytes + sizeof(double));
+    char * dest = ws.packed.data();
+    dest += (sizeof(double) - reinterpret_cast<uintptr_t>(dest) % sizeof(double)) % sizeof(double);
+
+    std::lock_guard<std::mutex> l(mutex_);
+    std::fseek(file_, static_cast<long>(slot.location), SEEK_SET);
+    if(std::fread(dest, 1, nbytes, file_) != nbytes)
+        throw PulsarException("Unable to read integrals from file", "path", path_);
+    return dest;
+}
+
+
+char * FourCenterIntegralStore::allocate_(size_t nbytes)
+{
+    std::lock_guard<std::mutex> l(mutex_);
+    if(chunks_.empty() || chunk_used_ + nbytes > chunk_size_)
+    {
+        chunk_size_ = std::max(nbytes, min_chunk_size);
+        chunks_.emplace_back(new char[chunk_size_]);
+        chunk_used_ = 0;
+    }
+
+    char * ret = chunks_.back().get() + chunk_used_;
+    chunk_used_ += nbytes;
+    return ret;
+}
+
+
+FourCenterIntegralStore::Statistics FourCenterIntegralStore::statistics(void) const noexcept
+{
+    return Statistics{tier_, nrequested_.load(), nstored_.load(), nbytes_.load()};
+}
+
+
+double FourCenterIntegralStore::percent_from_storage(void) const noexcept
+{
+    const uint64_t nreq = nrequested_.load();
+    if(nreq == 0)
+        return 0.0;
+    return 100.0 * static_cast<double>(nstored_.load()) / static_cast<double>(nreq);
+}
+
+
+
+////////////////////////////////
+// StoredFourCenterIntegral
+////////////////////////////////
+StoredFourCenterIntegral::~StoredFourCenterIntegral()
+{
+    if(store_ && store_.unique())
+    {
+        const auto stats = store_->statistics();
+        out.output("Integral storage: %? of %? integrals (%.1? percent) served from storage\n",
+                   stats.n_from_storage, stats.n_requested, store_->percent_from_storage());
+    }
+}
+
+
+FourCenterIntegralStore::Statistics StoredFourCenterIntegral::storage_statistics(void) const
+{
+    if(!store_)
+        throw PulsarException("Integrals are not being stored");
+    return store_->statistics();
+}
+
+
+FourCenterIntegral & StoredFourCenterIntegral::child_or_create_(void)
+{
+    if(!has_child_)
+    {
+        child_ = create_child_from_option<FourCenterIntegral>("KEY_FOUR_CENTER");
+        has_child_ = true;
+    }
+    return *child_;
+}
+
+
+void StoredFourCenterIntegral::initialize_(unsigned int deriv,
+                                           const Wavefunction & wfn,
+                                           const BasisSet & bs1,
+                                           const BasisSet & bs2,
+                                           const BasisSet & bs3,
+                                           const BasisSet & bs4)
+{
+    FourCenterIntegral & child = child_or_create_();
+    child.initialize(deriv, wfn, bs1, bs2, bs3, bs4);
+    ncomponents_ = child.n_components();
+
+    if(bs1 != bs2 || bs1 != bs3 || bs1 != bs4)
+        return;
+
+    const OptionMap & opt = options();
+    const std::string tiername = opt.has("STORAGE_TIER") ? opt.get<std::string>("STORAGE_TIER") : "AUTO";
+    const std::string directory = opt.has("STORAGE_PATH") ? opt.get<std::string>("STORAGE_PATH") : "";
+    const double precision = opt.has("STORAGE_PRECISION") ? opt.get<double>("STORAGE_PRECISION") : 1e-12;
+
+    if(tiername == "RECOMPUTE")
+        return;
+    if(tiername != "AUTO" && tiername != "MEMORY" && tiername != "DISK")
+        throw PulsarException("Unknown integral storage tier", "tier", tiername);
+
+    auto pairs = get_shell_pair_list(shared_cache(), deriv, wfn, bs1, bs1, child);
+
+    IntegralStorageTier tier = IntegralStorageTier::Memory;
+    if(tiername == "DISK")
+        tier = IntegralStorageTier::Disk;
+    else if(tiername == "AUTO")
+    {
+        const size_t nbytes = FourCenterIntegralStore::estimate_size(*pairs, ncomponents_, precision);
+        tier = choose_storage_tier(nbytes, !directory.empty());
+    }
+
+    if(tier == IntegralStorageTier::Recompute)
+        return;
+
+    // Stores are shared by modules calculating the same integrals
+    std::ostringstream precisionstr;
+    precisionstr << std::setprecision(17) << precision;
+
+    const std::string key = "FourCenterIntegralStore:" + bphash::hash_to_string(bs1.my_hash())
+                          + ":" + child.name() + "_v" + child.version()
+                          + ":" + bphash::hash_to_string(child.options().my_hash())
+                          + ":" + child.my_hash(deriv, wfn, bs1, bs2, bs3, bs4)
+                          + ":" + std::to_string(deriv) + ":" + tiername
+                          + ":" + precisionstr.str();
+
+    store_ = *shared_cache().get_or_compute(key, CacheData::NoPolicy,
+                                            [&](void)
+                                            {
+                                                return std::make_shared<FourCenterIntegralStore>(
+                                                        bs1, *pairs, ncomponents_, tier, precision, directory);
+                                            });
+
+    out.output("Storing integrals in %?\n", (tier == IntegralStorageTier::Memory) ? "memory" : "a file");
+}
+
+
+StoredFourCenterIntegral::HashType
+StoredFourCenterIntegral::my_hash_(unsigned int deriv,
+                                   const Wavefunction & wfn,
+                                   const BasisSet & bs1,
+                                   const BasisSet & bs2,
+                                   const BasisSet & bs3,
+                                   const BasisSet & bs4)
+{
+    // stored integrals are the same as the originals
+    return child_or_create_().my_hash(deriv, wfn, bs1, bs2, bs3, bs4);
+}
+
+
+unsigned int StoredFourCenterIntegral::n_components_(void) const
+{
+    return ncomponents_;
+}
+
+
+const double* StoredFourCenterIntegral::calculate_(uint64_t shell1, uint64_t shell2,
+                                                   uint64_t shell3, uint64_t shell4)
+{
+    if(store_)
+        return store_->calculate(*child_, ws_, shell1, shell2, shell3, shell4);
+    return child_->calculate(shell1, shell2, shell3, shell4);
+}
+
+} // close namespace pulsar
@@ -0,0 +1,276 @@
+/*! \file
+ *
+ * \brief Storage of four-center integrals between calls (header)
+ */
+
+
+#ifndef PULSAR_GUARD_MODULEBASE__STOREDFOURCENTERINTEGRAL_HPP_
+#define PULSAR_GUARD_MODULEBASE__STOREDFOURCENTERINTEGRAL_HPP_
+
+#include "pulsar/modulebase/FourCenterIntegral.hpp"
+#include "pulsar/system/ShellPairList.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+namespace pulsar{
+
+//! Where integrals are kept between calls
+enum class IntegralStorageTier
+{
+    Memory,    //!< Packed blocks in memory
+    Disk,      //!< Packed blocks in a local file
+    Recompute  //!< Not kept (calculated every time)
+};
+
+
+/*! \brief Memory available for storing integrals (in bytes)
+ *
+ * This is half of what remains under the memwatch limit
+ * (see memwatch_getlimit()). If memwatch is not running or
+ * there is no limit, this is the largest value of size_t.
+ */
+size_t integral_storage_budget(void) noexcept;
+
+
+/*! \brief Choose where to store integrals
+ *
+ * Memory is used if \p nbytes fits in integral_storage_budget().
+ * Otherwise, disk is used if \p disk_allowed.
+ */
+IntegralStorageTier choose_storage_tier(size_t nbytes, bool disk_allowed) noexcept;
+
+
+/*! \brief Integrals of a basis set, kept between calls
+ *
+ * Only the integrals of shell quartets unique under permutational
+ * symmetry are stored. Requests for other permutations are served
+ * by reordering the stored integrals. Quartets whose Schwarz bound
+ * is below the precision are never calculated or stored (they are
+ * zero), and no space is reserved for them, so the size of the
+ * store is bounded by the number of significant quartets.
+ *
+ * Each quartet is calculated the first time it is requested and
+ * packed based on its largest integral: not stored at all if
+ * it is below the precision, stored in single precision if the
+ * rounding error is below the precision, and stored in double
+ * precision otherwise.
+ *
+ * The store may be used by several threads at once, as long as each
+ * uses its own integral module and Workspace.
+ */
+class FourCenterIntegralStore
+{
+    public:
+        //! Buffers used by a single thread
+        struct Workspace
+        {
+            std::vector<double> ints;  //!< Integrals returned from calculate()
+            std::vector<char> packed;  //!< Packed integrals read from disk
+        };
+
+        //! Usage of the store
+        struct Statistics
+        {
+            IntegralStorageTier tier;  //!< Where integrals are stored
+            uint64_t n_requested;      //!< Number of integrals requested
+            uint64_t n_from_storage;   //!< Number of those that were stored
+            size_t n_bytes;            //!< Bytes used for the packed integrals
+        };
+
+
+        /*! \brief Create an (empty) store
+         *
+         * \param [in] bs Basis set used for all four centers
+         * \param [in] pairs Shell pairs of the basis set, with Schwarz bounds
+         * \param [in] ncomponents Number of components calculated by the integral module
+         * \param [in] tier Where to store the integrals
+         * \param [in] precision Maximum error from packing the integrals
+         * \param [in] directory Where to create the file for IntegralStorageTier::Disk.
+         *                       The file is given a unique name, and is removed by
+         *                       the destructor. If empty, a temporary file is used.
+         *
+         * \throw pulsar::PulsarException if \p pairs aren't the symmetric pairs
+         *        of \p bs with Schwarz bounds, or if the file can't be created
+         */
+        FourCenterIntegralStore(const BasisSet & bs, const ShellPairList & pairs,
+                                unsigned int ncomponents, IntegralStorageTier tier,
+                                double precision, const std::string & directory = "");
+
+        FourCenterIntegralStore(const FourCenterIntegralStore &)             = delete;
+        FourCenterIntegralStore & operator=(const FourCenterIntegralStore &) = delete;
+
+        //! Closes and removes the disk file, if there is one
+        ~FourCenterIntegralStore();
+
+
+        /*! \brief Estimate the size of a store, in bytes
+         *
+         * Quartets whose Schwarz bound is below \p precision
+         * take no space. Others are assumed to be stored in double
+         * precision.
+         *
+         * \param [in] pairs Shell pairs of the basis set, with Schwarz bounds
+         * \param [in] ncomponents Number of components calculated by the integral module
+         * \param [in] precision See the constructor
+         */
+        static size_t estimate_size(const ShellPairList & pairs,
+                                    unsigned int ncomponents, double precision);
+
+
+        //! Where integrals are stored
+        IntegralStorageTier tier(void) const noexcept { return tier_; }
+
+
+        /*! \brief Obtain integrals, calculating them with \p eri if they aren't stored
+         *
+         * \param [in] eri Module for calculating integrals, initialized with the basis set
+         * \param [in] ws Buffers for this thread
+         * \return The integrals, in the same layout as eri.calculate(). Valid
+         *         until the next call with the same workspace.
+         */
+        const double * calculate(FourCenterIntegral & eri, Workspace & ws,
+                                 uint64_t shell1, uint64_t shell2,
+                                 uint64_t shell3, uint64_t shell4);
+
+
+        /*! \brief Number of unique quartets that may be stored
+         *
+         * These are the quartets with a Schwarz bound of at least the precision.
+         */
+        size_t n_quartets(void) const noexcept { return slots_.size(); }
+
+
+        /*! \brief Memory used by the store, in bytes
+         *
+         * For storage in memory, this includes the space for integrals
+         * that haven't been stored yet.
+         */
+        size_t memory_size(void) const noexcept { return memory_size_; }
+
+
+        //! Usage of the store so far
+        Statistics statistics(void) const noexcept;
+
+
+        //! Percentage of the requested integrals that were stored
+        double percent_from_storage(void) const noexcept;
+
+
+    private:
+        //! How a quartet is stored
+        enum class Packing_ : uint8_t { Zero, Float, Double };
+
+        //! A stored quartet
+        struct Slot_
+        {
+            std::atomic<uint8_t> state;  //!< 0 = empty, 1 = being stored, 2 = stored
+            Packing_ packing;
+            uint64_t location;           //!< Address (memory) or offset (disk) of the data
+        };
+
+        IntegralStorageTier tier_;
+        double precision_;
+        unsigned int ncomponents_;
+        BasisSet bs_;
+
+        // Slots are only kept for significant quartets. Shell pairs are ranked
+        // by decreasing Schwarz bound; a quartet is stored under the pair with
+        // the larger rank (the bra), and the significant kets of each bra are
+        // the ranks [0, nket) for some nket <= rank+1.
+        std::vector<size_t> rank_;        //!< Rank of each shell pair
+        std::vector<size_t> slot_start_;  //!< First slot of each bra (by rank)
+        std::vector<Slot_> slots_;
+
+        // Memory storage is allocated in chunks
+        std::mutex mutex_;  //!< For allocating chunks and for the file
+        std::vector<std::unique_ptr<char[]>> chunks_;
+        size_t chunk_used_;
+        size_t chunk_size_;
+
+        std::string path_;
+        FILE * file_;
+        bool remove_file_;
+
+        std::atomic<uint64_t> nrequested_;
+        std::atomic<uint64_t> nstored_;
+        std::atomic<size_t> nbytes_;
+
+        size_t memory_size_;  //!< See memory_size()
+
+        //! Pack and store the integrals of a quartet
+        void store_(Slot_ & slot, const double * ints, size_t nints);
+
+        //! Obtain the packed data of a stored quartet
+        const char * load_(const Slot_ & slot, size_t nints, Workspace & ws);
+
+        //! Reserve \p nbytes of memory storage
+        char * allocate_(size_t nbytes);
+};
+
+
+/*! \brief A four-center integral module that stores the integrals of another
+ *
+ * Useful when the same integrals are needed many times (for example,
+ * every SCF iteration). Modules using the same basis set and integral
+ * module share storage (through ModuleBase::shared_cache()), so each
+ * thread of a parallel calculation may use its own instance.
+ *
+ * Integrals are only stored when all four basis sets are the same.
+ *
+ * Options (used if present):
+ *   - KEY_FOUR_CENTER: Module key of the integrals to store (required)
+ *   - STORAGE_TIER: AUTO (default), MEMORY, DISK, or RECOMPUTE. AUTO
+ *                   chooses based on the memory budget (see choose_storage_tier()),
+ *                   using disk only if STORAGE_PATH is set.
+ *   - STORAGE_PATH: Directory in which to create the file for disk storage
+ *   - STORAGE_PRECISION: Maximum error from packing the integrals (default 1e-12)
+ */
+class StoredFourCenterIntegral : public FourCenterIntegral
+{
+    public:
+        using FourCenterIntegral::FourCenterIntegral;
+
+        //! Prints how many integrals were served from storage
+        ~StoredFourCenterIntegral();
+
+        /*! \brief Usage of the storage
+         *
+         * \throw pulsar::PulsarException if integrals aren't being stored
+         */
+        FourCenterIntegralStore::Statistics storage_statistics(void) const;
+
+        virtual void initialize_(unsigned int deriv,
+                                 const Wavefunction & wfn,
+                                 const BasisSet & bs1,
+                                 const BasisSet & bs2,
+                                 const BasisSet & bs3,
+                                 const BasisSet & bs4);
+
+        virtual HashType my_hash_(unsigned int deriv,
+                                  const Wavefunction & wfn,
+                                  const BasisSet & bs1,
+                                  const BasisSet & bs2,
+                                  const BasisSet & bs3,
+                                  const BasisSet & bs4);
+
+        virtual unsigned int n_components_(void) const;
+
+        virtual const double* calculate_(uint64_t shell1, uint64_t shell2,
+                                         uint64_t shell3, uint64_t shell4);
+
+    private:
+        ModulePtr<FourCenterIntegral> child_;
+        bool has_child_ = false;
+        unsigned int ncomponents_ = 1;
+        std::shared_ptr<FourCenterIntegralStore> store_;
+        FourCenterIntegralStore::Workspace ws_;
+
+        //! Create the module for the integrals, if needed
+        FourCenterIntegral & child_or_create_(void);
+};
+
+} // close namespace pulsar
+
+#endif
@@ -10,6 +10,8 @@
 #include "pulsar/system/BasisSet.hpp"
 #include "pulsar/util/PythonIntegralHelper.hpp"
 
+#include <array>
+
 
 namespace pulsar{
 
@@ -23,6 +25,10 @@ protected:
     public:
         typedef ThreeCenterIntegral BaseType;
         typedef std::string HashType;
+
+        //! Shell indices of each center, for calculating a batch of integrals
+        typedef std::array<uint64_t, 3> ShellTuple;
+
         ThreeCenterIntegral(ID_t id)
             : ModuleBase(id, "ThreeCenterIntegral"), initialized_(false)
         { }
@@ -79,8 +85,11 @@ protected:
         const double* calculate(uint64_t shell1, uint64_t shell2,
                            uint64_t shell3)
         {
-            ModuleBase::call_function(&ThreeCenterIntegral::initialized_or_throw_);
-            return ModuleBase::call_function(&ThreeCenterIntegral::calculate_,
+            // hot path - only call initialized_or_throw_ when it will throw
+            if(!initialized_)
+                ModuleBase::call_function(&ThreeCenterIntegral::initialized_or_throw_);
+
+            return ModuleBase::call_function_fast(&ThreeCenterIntegral::calculate_,
                                                 shell1, shell2, shell3);
         }
 
@@ -103,14 +112,40 @@ protected:
         }
 
 
+        /*! \brief calculate integrals for many shell triplets at once
+         *
+         * The integrals of each triplet are placed in \p outbuffer one after
+         * the other, and where they start is stored in \p offsets. This
+         * avoids the overhead of calling calculate() for every triplet.
+         *
+         * \throw pulsar::PulsarException if \p outbuffer is too small
+         *
+         * \param [in] shells Shell indices of each triplet
+         * \param [in] outbuffer Where to place the completed integrals
+         * \param [in] bufsize Size of \p outbuffer (as the number of doubles)
+         * \param [out] offsets Where the integrals of each triplet start in \p outbuffer.
+         *             Must have room for shells.size()+1 elements. The last
+         *             element is set to the total number of integrals.
+         * \return Number of integrals calculated
+         */
+        uint64_t calculate_batch(const std::vector<ShellTuple> & shells,
+                                 double * outbuffer, size_t bufsize,
+                                 uint64_t * offsets)
+        {
+            ModuleBase::call_function(&ThreeCenterIntegral::initialized_or_throw_);
+            return ModuleBase::call_function_fast(&ThreeCenterIntegral::calculate_batch_,
+                                                  shells, outbuffer, bufsize, offsets);
+        }
+
+
         /*! \brief calculate an integral (for use from python)
          *
          * \param [in] shell1 Shell index on the first center
          * \param [in] shell2 Shell index on the second center
          * \param [in] shell3 Shell index on the third center
-         * \return Integrals in a Python list
+         * \return Integrals in a NumPy array (see PythonIntegralHelper for when they are copied)
          */
-        pybind11::list calculate_py(uint64_t shell1, uint64_t shell2,uint64_t shell3)
+        pybind11::array_t<double> calculate_py(uint64_t shell1, uint64_t shell2,uint64_t shell3)
         {
                const double* ints =
                 ModuleBase::call_function(&ThreeCenterIntegral::calculate_,
@@ -124,11 +159,11 @@ protected:
          * \param [in] shells1 Shell indicies on the first center
          * \param [in] shells2 Shell indicies on the second center
          * \param [in] shells3 Shell indicies on the third center
-         * \return The integrals in a Python list
+         * \return The integrals in a NumPy array (see PythonIntegralHelper for when they are copied)
          */
-        pybind11::list calculate_multi_py(const std::vector<uint64_t> & shells1,
-                                    const std::vector<uint64_t> & shells2,
-                                    const std::vector<uint64_t> & shells3)
+        pybind11::array_t<double> calculate_multi_py(const std::vector<uint64_t> & shells1,
+                                                     const std::vector<uint64_t> & shells2,
+                                                     const std::vector<uint64_t> & shells3)
         {
             const double* ints=
               ModuleBase::call_function(&ThreeCenterIntegral::calculate_multi_,
@@ -193,6 +228,38 @@ protected:
 
 
 
+        //! \copydoc calculate_batch
+        virtual uint64_t calculate_batch_(const std::vector<ShellTuple> & shells,
+                                          double * outbuffer, size_t bufsize,
+                                          uint64_t * offsets)
+        {
+            //////////////////////////////////////////////////////////
+            // default implementation - just loop over and do them all
+            //////////////////////////////////////////////////////////
+            const uint64_t ncomponents = n_components_();
+            uint64_t ntotal = 0;
+
+            for(size_t i = 0; i < shells.size(); i++)
+            {
+                const ShellTuple & s = shells[i];
+                const uint64_t nints = ncomponents * helper_.size(s[0], s[1], s[2]);
+
+                // be safe with unsigned types (ntotal <= bufsize)
+                if(nints > bufsize - ntotal)
+                    throw PulsarException("Output buffer is too small for the integrals",
+                                          "bufsize", bufsize, "needed", ntotal + nints);
+
+                const double * ints = calculate_(s[0], s[1], s[2]);
+                std::copy(ints, ints + nints, outbuffer + ntotal);
+                offsets[i] = ntotal;
+                ntotal += nints;
+            }
+
+            offsets[shells.size()] = ntotal;
+            return ntotal;
+        }
+
+
     private:
         bool initialized_; //!< Has initialize() been called
 
@@ -248,8 +315,9 @@ class ThreeCenterIntegral_Py : public ThreeCenterIntegral
         virtual const double* calculate_(uint64_t shell1, uint64_t shell2,
                                     uint64_t shell3)
         {
-                pybind11::list ints =
-                    call_py_override<pybind11::list>(this,"calculate_",shell1,shell2,shell3);
+                pybind11::gil_scoped_acquire gil;
+                pybind11::object ints =
+                    call_py_override<pybind11::object>(this,"calculate_",shell1,shell2,shell3);
 
                 return helper_.py_2_int(ints);
         }
@@ -262,8 +330,9 @@ class ThreeCenterIntegral_Py : public ThreeCenterIntegral
 
               if(has_py_override<ThreeCenterIntegral>(this, "calculate_multi_"))
               {
-                  pybind11::list ints=
-                          call_py_override<pybind11::list>(this,"calculate_multi_",shells1,shells2,shells3);
+                  pybind11::gil_scoped_acquire gil;
+                  pybind11::object ints=
+                          call_py_override<pybind11::object>(this,"calculate_multi_",shells1,shells2,shells3);
                   return helper_.py_2_int(ints);
               }
 
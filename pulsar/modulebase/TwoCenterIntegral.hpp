@@ -12,6 +12,8 @@
 #include "pulsar/system/BasisSet.hpp"
 #include "pulsar/util/PythonIntegralHelper.hpp"
 
+#include <array>
+
 namespace pulsar{
 
 /*! \brief One-electron integral implementation
@@ -24,6 +26,9 @@ public:
         typedef TwoCenterIntegral BaseType;
         typedef std::string HashType;
 
+        //! Shell indices of each center, for calculating a batch of integrals
+        typedef std::array<uint64_t, 2> ShellTuple;
+
         TwoCenterIntegral(ID_t id)
             : ModuleBase(id, "TwoCenterIntegral"), initialized_(false)
         { }
@@ -75,9 +80,11 @@ public:
          */
         const double* calculate(uint64_t shell1, uint64_t shell2)
         {
-            ModuleBase::call_function(&TwoCenterIntegral::initialized_or_throw_);
+            // hot path - only call initialized_or_throw_ when it will throw
+            if(!initialized_)
+                ModuleBase::call_function(&TwoCenterIntegral::initialized_or_throw_);
 
-            return ModuleBase::call_function(&TwoCenterIntegral::calculate_,
+            return ModuleBase::call_function_fast(&TwoCenterIntegral::calculate_,
                                               shell1, shell2);
         }
 
@@ -99,13 +106,39 @@ public:
         }
 
 
+        /*! \brief calculate integrals for many shell pairs at once
+         *
+         * The integrals of each pair are placed in \p outbuffer one after
+         * the other, and where they start is stored in \p offsets. This
+         * avoids the overhead of calling calculate() for every pair.
+         *
+         * \throw pulsar::PulsarException if \p outbuffer is too small
+         *
+         * \param [in] shells Shell indices of each pair
+         * \param [in] outbuffer Where to place the completed integrals
+         * \param [in] bufsize Size of \p outbuffer (as the number of doubles)
+         * \param [out] offsets Where the integrals of each pair start in \p outbuffer.
+         *             Must have room for shells.size()+1 elements. The last
+         *             element is set to the total number of integrals.
+         * \return Number of integrals calculated
+         */
+        uint64_t calculate_batch(const std::vector<ShellTuple> & shells,
+                                 double * outbuffer, size_t bufsize,
+                                 uint64_t * offsets)
+        {
+            ModuleBase::call_function(&TwoCenterIntegral::initialized_or_throw_);
+            return ModuleBase::call_function_fast(&TwoCenterIntegral::calculate_batch_,
+                                                  shells, outbuffer, bufsize, offsets);
+        }
+
+
         /*! \brief calculate an integral (for use from python)
          *
          * \param [in] shell1 Shell index on the first center
          * \param [in] shell2 Shell index on the second center
-         * \return Integrals in a Python list
+         * \return Integrals in a NumPy array (see PythonIntegralHelper for when they are copied)
          */
-        pybind11::list calculate_py(uint64_t shell1, uint64_t shell2)
+        pybind11::array_t<double> calculate_py(uint64_t shell1, uint64_t shell2)
         {
                const double* ints =
                 ModuleBase::call_function(&TwoCenterIntegral::calculate_,
@@ -118,10 +151,10 @@ public:
          *
          * \param [in] shells1 Shell indicies on the first center
          * \param [in] shells2 Shell indicies on the second center
-         * \return The integrals in a Python list
+         * \return The integrals in a NumPy array (see PythonIntegralHelper for when they are copied)
          */
-        pybind11::list calculate_multi_py(const std::vector<uint64_t> & shells1,
-                                    const std::vector<uint64_t> & shells2)
+        pybind11::array_t<double> calculate_multi_py(const std::vector<uint64_t> & shells1,
+                                                     const std::vector<uint64_t> & shells2)
         {
             const double* ints=
               ModuleBase::call_function(&TwoCenterIntegral::calculate_multi_,
@@ -181,6 +214,38 @@ public:
         }
 
 
+        //! \copydoc calculate_batch
+        virtual uint64_t calculate_batch_(const std::vector<ShellTuple> & shells,
+                                          double * outbuffer, size_t bufsize,
+                                          uint64_t * offsets)
+        {
+            //////////////////////////////////////////////////////////
+            // default implementation - just loop over and do them all
+            //////////////////////////////////////////////////////////
+            const uint64_t ncomponents = n_components_();
+            uint64_t ntotal = 0;
+
+            for(size_t i = 0; i < shells.size(); i++)
+            {
+                const ShellTuple & s = shells[i];
+                const uint64_t nints = ncomponents * helper_.size(s[0], s[1]);
+
+                // be safe with unsigned types (ntotal <= bufsize)
+                if(nints > bufsize - ntotal)
+                    throw PulsarException("Output buffer is too small for the integrals",
+                                          "bufsize", bufsize, "needed", ntotal + nints);
+
+                const double * ints = calculate_(s[0], s[1]);
+                std::copy(ints, ints + nints, outbuffer + ntotal);
+                offsets[i] = ntotal;
+                ntotal += nints;
+            }
+
+            offsets[shells.size()] = ntotal;
+            return ntotal;
+        }
+
+
     private:
         bool initialized_; //!< Has initialize() been called
 
@@ -235,8 +300,9 @@ class TwoCenterIntegral_Py : public TwoCenterIntegral
 
         virtual const double* calculate_(uint64_t shell1, uint64_t shell2)
         {
-                pybind11::list ints =
-                    call_py_override<pybind11::list>(this,"calculate_",shell1,shell2);
+                pybind11::gil_scoped_acquire gil;
+                pybind11::object ints =
+                    call_py_override<pybind11::object>(this,"calculate_",shell1,shell2);
 
                 return helper_.py_2_int(ints);
         }
@@ -248,8 +314,9 @@ class TwoCenterIntegral_Py : public TwoCenterIntegral
 
               if(has_py_override<TwoCenterIntegral>(this, "calculate_multi_"))
               {
-                  pybind11::list ints=
-                          call_py_override<pybind11::list>(this,"calculate_multi_",shells1,shells2);
+                  pybind11::gil_scoped_acquire gil;
+                  pybind11::object ints=
+                          call_py_override<pybind11::object>(this,"calculate_multi_",shells1,shells2);
                   return helper_.py_2_int(ints);
               }
 
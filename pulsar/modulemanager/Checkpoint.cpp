@@ -5,74 +5,29 @@
 
 #include "pulsar/modulemanager/Checkpoint.hpp"
 #include "pulsar/modulemanager/CheckpointIO.hpp"
+#include "pulsar/modulemanager/CheckpointFormat.hpp"
+#include "pulsar/modulemanager/CheckpointCodec.hpp"
 #include "pulsar/modulemanager/ModuleManager.hpp"
 #include "pulsar/output/GlobalOutput.hpp"
 #include "pulsar/util/Serialization.hpp"
 #include "pulsar/parallel/Parallel.hpp"
 
-using namespace pulsar;
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
+using namespace pulsar;
+using namespace pulsar::detail;
 
 
 namespace {
 
-struct CacheEntryMetadata
-{
-    std::string cachekey;
-    std::string type;
-    bphash::HashValue hash;  //!< Hash of original data, NOT serialized data
-    size_t size;             //!< Size of serialized data
-    unsigned int policy;     //!< Storage policy
-
-    template<typename Archive>
-    void serialize(Archive & ar)
-    {
-        ar(cachekey, type, hash, size, policy);
-    }
-};
-
-bool is_meta_key(const std::string & s)
-{
-    if(s.size() <= 6)
-        return false; // needs at least one char + "##META"
-
-    std::string last5 = s.substr(s.size()-6, 6);
-
-    if(last5 == "##META")
-        return true;
-    else
-        return false;
-}
-
-bool is_cache_key(const std::string & s)
-{
-    if(s.size() <= 13)
-        return false; // Needs at least "CHKPT_CACHE__" + one char
-
-    std::string first13 = s.substr(0, 13);
-
-    if(first13 != "CHKPT_CACHE__")
-        return false;
-    else
-        return true;
-}
-
-
-std::string make_cache_key(const std::string & datakey)
-{
-    return std::string("CHKPT_CACHE__") + datakey;
-}
-
-std::string
-split_cache_key(const std::string & key)
-{
-    if(!is_cache_key(key))
-        throw pulsar::PulsarException("Unknown key format: not a cache key",
-                               "key", key);
-
-    return key.substr(13); // remove "CHKPT_CACHE__"
-}
+//! Entries at least this large are attached lazily when loading (if possible)
+const size_t lazy_load_size = 65536;
 
+//! Maximum amount of serialized data waiting to be written when saving
+const size_t max_pending_bytes = 268435456;
 
 } // close anonymous namespace
 
@@ -84,30 +39,36 @@ namespace pulsar {
 Checkpoint::Checkpoint(const std::shared_ptr<CheckpointIO> & backend_local,
                        const std::shared_ptr<CheckpointIO> & backend_global)
     : backend_local_(backend_local),
-      backend_global_(backend_global)
+      backend_global_(backend_global),
+      lazy_restore_(false)
 {
     if(backend_local == backend_global)
         throw PulsarException("Local and Global backends are the same! This will lead to problems");
 }
 
 
+void Checkpoint::set_lazy_restore(bool lazy) noexcept
+{
+    lazy_restore_ = lazy;
+}
+
+
 
         
 std::vector<std::string>
-Checkpoint::form_cache_save_list_(const ModuleManager & mm,
-                                  CheckpointIO & backend,
+Checkpoint::form_cache_save_list_(const CacheEntries_ & entries,
+                                  const CheckpointManifest & manifest,
                                   std::function<bool(unsigned int)> policy_check)
 {
     using pulsar::detail::GenericHolder;
     using pulsar::detail::SerializedGenericData;
 
-    // modulemanager should be locked already!
     // print out some info and get what we should be checkpointing
     print_global_output("Cache entries in the module manager:\n");
 
     std::vector<std::string> to_save;
 
-    for(const auto & data : mm.cachemap_.cmap_)
+    for(const auto & data : entries)
     {
         const auto * gb = data.second.value.get();
 
@@ -120,20 +81,15 @@ Checkpoint::form_cache_save_list_(const ModuleManager & mm,
 
         if(policy_check(data.second.policy) && (is_serialized || gb->is_serializable()))
         {
-            std::string full_key = make_cache_key(data.first);
-            std::string full_metakey = full_key + "##META";
-
             // does the data already exist in the checkpoint backend?
-            if(backend.count(full_key))
+            auto mit = manifest.find(data.first);
+            if(mit != manifest.end())
             {
-                // if it's hashable, read the metadata and compare the hashes
+                // if it's hashable, compare with the hash in the manifest
                 if(gb->is_hashable())
                 {
-                    ByteArray ba_meta = backend.read(full_metakey);
-                    auto meta = from_byte_array<CacheEntryMetadata>(ba_meta);
-
                     auto newhash = gb->my_hash();
-                    if(newhash != meta.hash)
+                    if(newhash != mit->second.hash)
                     {
                         save = true;
                         stat = 'O';
@@ -172,52 +128,214 @@ Checkpoint::form_cache_save_list_(const ModuleManager & mm,
 
 
 
+CheckpointManifest Checkpoint::read_manifest_(const CheckpointIO & backend)
+{
+    if(backend.count(manifest_key))
+        return from_byte_array<CheckpointManifest>(backend.read(manifest_key));
+
+    // Written without a manifest (or a save didn't finish), so
+    // we have to read the metadata of every entry
+    CheckpointManifest manifest;
+    for(const auto & key : backend.all_keys())
+    {
+        if(is_cache_key(key) && !is_meta_key(key))
+        {
+            auto cem = from_byte_array<CacheEntryMetadata>(backend.read(key + "##META"));
+            manifest.emplace(split_cache_key(key), std::move(cem));
+        }
+    }
+
+    return manifest;
+}
+
+
+Checkpoint::SavedEntry_
+Checkpoint::serialize_entry_(const std::string & cachekey,
+                             const CacheMap::CacheMapEntry_ & cdat)
+{
+    using pulsar::detail::GenericHolder;
+
+    const auto & gb = *(cdat.value);
+
+    // Pickling python objects needs the GIL
+    std::unique_ptr<pybind11::gil_scoped_acquire> gil;
+    if(dynamic_cast<const GenericHolder<pybind11::object> *>(&gb) != nullptr)
+        gil.reset(new pybind11::gil_scoped_acquire);
+
+    // serialize the data
+    SavedEntry_ ret;
+    ret.cachekey = cachekey;
+    ret.data = gb.to_byte_array();
+
+    bphash::HashValue h;
+    if(gb.is_hashable())
+        h = gb.my_hash();
+
+    gil.reset();
+
+    const size_t size = ret.data.size();
+    const CheckpointCodec codec = compress_checkpoint_data(ret.data);
+
+    // construct the metadata
+    ret.meta = CacheEntryMetadata{cachekey, 
+                                  gb.type(),
+                                  h,
+                                  size,
+                                  cdat.policy,
+                                  codec};
+    return ret;
+}
+
+
 void Checkpoint::save_cache_(const ModuleManager & mm,
                              CheckpointIO & backend,
                              std::function<bool(unsigned int)> policy_check)
 {
-     // to/from_byte_array
+    typedef std::chrono::steady_clock clock;
+    const auto start = clock::now();
 
-    // Actually save the data
-    backend.open();
+    // Copy of the entries. This shares the data with the cache, but
+    // does not hold any of the locks of the cache. The module manager
+    // is only locked while copying.
+    CacheEntries_ entries;
+    {
+        std::lock_guard<std::mutex> l_mm(mm.mutex_);
+        entries = mm.cachemap_.snapshot_();
+    }
+    const std::chrono::duration<double> stall_time = clock::now() - start;
 
-    // we have to lock the module manager for a while
-    std::lock_guard<std::mutex> l_mm(mm.mutex_);
+    backend.open();
 
-    // print out some info and get what we should be checkpointing
-    auto to_save = form_cache_save_list_(mm, backend, policy_check);
+    // Entries are serialized and compressed by the workers, and written
+    // by this thread as they become ready
+    std::mutex mtx;
+    std::condition_variable cv_ready, cv_space;
+    std::deque<SavedEntry_> ready;
+    size_t ready_bytes = 0;
+    size_t next = 0;
+    size_t nworking = 0;
+    bool abort = false;
+    std::exception_ptr error;
+
+    size_t nbytes = 0, nbytes_stored = 0;
+
+    // Stop everything after an exception
+    auto set_error = [&](std::exception_ptr ex)
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        if(!error)
+            error = ex;
+        abort = true;
+        cv_ready.notify_all();
+        cv_space.notify_all();
+    };
 
     try {
+        // Which entries are already stored is decided from the manifest alone
+        const bool manifest_stored = (backend.count(manifest_key) > 0);
+        CheckpointManifest manifest = read_manifest_(backend);
+
+        // print out some info and get what we should be checkpointing
+        const auto to_save = form_cache_save_list_(entries, manifest, policy_check);
+
+        // The manifest is out of date while we are writing. If we don't
+        // finish, loading falls back to the metadata of each entry
+        if(manifest_stored && !to_save.empty())
+            backend.erase(manifest_key);
 
-        for(const auto & cachekey : to_save)
+        auto worker = [&](void)
         {
-            const auto & cdat = mm.cachemap_.cmap_.at(cachekey);
-            const auto & gb = *(cdat.value);
-            unsigned int policy = cdat.policy;
-            const std::string full_key = make_cache_key(cachekey);
-            const std::string full_metakey = full_key + "##META";
-            
-            // serialize the data
-            ByteArray ba_data = gb.to_byte_array();
-
-            bphash::HashValue h;
-            if(gb.is_hashable())
-                h = gb.my_hash();
-
-            // construct the metadata
-            CacheEntryMetadata meta{cachekey, 
-                                    gb.type(),
-                                    h,
-                                    ba_data.size(),
-                                    policy};
-            ByteArray ba_meta = to_byte_array(meta);
-
-            print_global_debug("Saving: (%10? bytes)   %?\n", ba_data.size(), cachekey);
-
-            // write to the backend
-            backend.write(full_key, ba_data); 
-            backend.write(full_metakey, ba_meta); 
+            while(true)
+            {
+                size_t idx;
+                {
+                    std::lock_guard<std::mutex> l(mtx);
+                    if(abort || next >= to_save.size())
+                        break;
+                    idx = next++;
+                }
+
+                try {
+                    SavedEntry_ se = serialize_entry_(to_save[idx], entries.at(to_save[idx]));
+
+                    // don't get too far ahead of the writer
+                    std::unique_lock<std::mutex> l(mtx);
+                    cv_space.wait(l, [&](void) { return abort || ready.empty() ||
+                                                        ready_bytes + se.data.size() <= max_pending_bytes; });
+                    if(abort)
+                        break;
+
+                    ready_bytes += se.data.size();
+                    ready.push_back(std::move(se));
+                    cv_ready.notify_one();
+                }
+                catch(...)
+                {
+                    set_error(std::current_exception());
+                    break;
+                }
+            }
+
+            std::lock_guard<std::mutex> l(mtx);
+            nworking--;
+            cv_ready.notify_all();
+        };
+
+        // The workers may need the GIL, so we can't hold it while waiting for them
+        std::unique_ptr<pybind11::gil_scoped_release> nogil;
+        if(Py_IsInitialized() && PyGILState_Check())
+            nogil.reset(new pybind11::gil_scoped_release);
+
+        const size_t nthreads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u),
+                                                 to_save.size());
+        nworking = nthreads;
+
+        std::vector<std::thread> threads;
+        for(size_t i = 0; i < nthreads; i++)
+            threads.emplace_back(worker);
+
+        while(true)
+        {
+            SavedEntry_ se;
+            {
+                std::unique_lock<std::mutex> l(mtx);
+                cv_ready.wait(l, [&](void) { return abort || !ready.empty() || nworking == 0; });
+                if(abort || ready.empty())
+                    break;
+
+                se = std::move(ready.front());
+                ready.pop_front();
+                ready_bytes -= se.data.size();
+                cv_space.notify_all();
+            }
+
+            print_global_debug("Saving: (%10? bytes, %10? stored)   %?\n",
+                               se.meta.size, se.data.size(), se.cachekey);
+
+            try {
+                const std::string full_key = make_cache_key(se.cachekey);
+                backend.write(full_key, se.data); 
+                backend.write(full_key + "##META", to_byte_array(se.meta)); 
+            }
+            catch(...)
+            {
+                set_error(std::current_exception());
+                break;
+            }
+
+            nbytes += se.meta.size;
+            nbytes_stored += se.data.size();
+            manifest[se.cachekey] = std::move(se.meta);
         }
+
+        for(auto & it : threads)
+            it.join();
+
+        if(error)
+            std::rethrow_exception(error);
+
+        if(!manifest_stored || !to_save.empty())
+            backend.write(manifest_key, to_byte_array(manifest));
     }
     catch(...)
     {
@@ -226,6 +344,51 @@ void Checkpoint::save_cache_(const ModuleManager & mm,
     }
 
     backend.close();
+
+    const std::chrono::duration<double> total_time = clock::now() - start;
+    const double mb = static_cast<double>(nbytes)/(1024.0*1024.0);
+    const double mb_stored = static_cast<double>(nbytes_stored)/(1024.0*1024.0);
+
+    print_global_output("Saved %.2? MB (%.2? MB after compression) in %.3? s: %.1? MB/s\n",
+                        mb, mb_stored, total_time.count(), mb/total_time.count());
+    print_global_output("Cache was locked for %.3? s while saving\n", stall_time.count());
+}
+
+
+SerializedGenericData
+Checkpoint::lazy_entry_(const CacheEntryMetadata & cem,
+                        CheckpointIO & backend, const std::string & key)
+{
+    SerializedGenericData scd{ByteArray(), cem.type, cem.hash, cem.policy,
+                              nullptr, 0, true, nullptr};
+
+    // If the backend can't give us a view, we have to read
+    // the data now (but it's still stored compressed)
+    CheckpointView view = backend.read_view(key);
+    if(!view.data)
+    {
+        auto stored = std::make_shared<const ByteArray>(backend.read(key));
+        view.size = stored->size();
+        view.data = std::shared_ptr<const char>(stored, stored->data());
+    }
+
+    if(cem.codec == CodecNone)
+    {
+        scd.view = std::move(view.data);
+        scd.view_size = view.size;
+    }
+    else
+    {
+        const unsigned int codec = cem.codec;
+        const size_t orig_size = cem.size;
+
+        scd.fetch = [view, codec, orig_size](void)
+        {
+            return decompress_checkpoint_data(codec, view.data.get(), view.size, orig_size);
+        };
+    }
+
+    return scd;
 }
 
 
@@ -235,35 +398,66 @@ void Checkpoint::load_cache_(ModuleManager & mm, CheckpointIO & backend)
      // to/from_byte_array
 
     // not sure if I really have to lock mm, byt why not
+    // (the cache map locks itself in set_)
     std::lock_guard<std::mutex> l_mm(mm.mutex_);
-    std::lock_guard<std::mutex> c_mm(mm.cachemap_.mutex_);
 
     backend.open();
 
     try {
-        auto all_keys = backend.all_keys();
-
-        print_global_debug("Checkpoint keys:\n");
-        for(const auto & key : all_keys)
-            print_global_debug("    %?\n", key);
+        // The metadata of all entries is in the manifest
+        const CheckpointManifest manifest = read_manifest_(backend);
 
         // load the data
-        for(const auto & it : all_keys)
+        for(const auto & mit : manifest)
         {
-            if(is_cache_key(it) && !is_meta_key(it))
-            {
-                const std::string metakey = it + "##META";
+            const std::string & cachekey = mit.first;
+            const CacheEntryMetadata & cem = mit.second;
+            const std::string it = make_cache_key(cachekey);
 
-                std::string cachekey = split_cache_key(it);
+            if(backend.count(it))
+            {
                 print_global_debug("Loading %?\n", cachekey);
 
-                ByteArray data = backend.read(it);
-                ByteArray metadata = backend.read(metakey);
-                auto cem = from_byte_array<CacheEntryMetadata>(metadata);
+                SerializedGenericData scd{ByteArray(), cem.type, cem.hash, cem.policy,
+                                          nullptr, 0, false, nullptr};
+                CheckpointView view{nullptr, 0};
+
+                if(lazy_restore_)
+                    scd = lazy_entry_(cem, backend, it);
+                else if(cem.codec == CodecNone)
+                {
+                    // Large entries are attached lazily if the backend supports it.
+                    // They aren't read until they are unserialized.
+                    if(cem.size >= lazy_load_size)
+                        view = backend.read_view(it);
+
+                    if(view.data)
+                    {
+                        scd.view = std::move(view.data);
+                        scd.view_size = view.size;
+                    }
+                    else
+                        scd.data = backend.read(it);
+                }
+                else
+                {
+                    // Decompress directly from the backend's data if possible
+                    view = backend.read_view(it);
+
+                    ByteArray stored;
+                    if(!view.data)
+                    {
+                        stored = backend.read(it);
+                        view.size = stored.size();
+                    }
+
+                    const char * stored_ptr = view.data ? view.data.get() : stored.data();
+                    scd.data = decompress_checkpoint_data(cem.codec, stored_ptr, view.size, cem.size);
+                }
 
-                SerializedGenericData scd{std::move(data), cem.type, cem.hash, cem.policy};
                 std::unique_ptr<GenericHolder<SerializedGenericData>> sdh(new GenericHolder<SerializedGenericData>(std::move(scd)));
-                mm.cachemap_.set_(cachekey, std::move(sdh), cem.policy); // set_ won't lock the mutex
+                auto key = mm.cachemap_.split_key_(cachekey);
+                mm.cachemap_.set_(key.first, std::move(key.second), std::move(sdh), cem.policy);
             }
         }
     }
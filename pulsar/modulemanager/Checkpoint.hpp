@@ -5,6 +5,7 @@
 #pragma once
 
 #include "pulsar/modulemanager/ModuleManager.hpp"
+#include "pulsar/modulemanager/CheckpointFormat.hpp"
 #include <memory>
 #include <vector>
 
@@ -40,19 +41,76 @@ class Checkpoint
 
         void load_global_cache(ModuleManager & mm);
 
+        /*! \brief Restore cache entries lazily
+         *
+         * When loading, only the metadata of the entries is read up front.
+         * The data of an entry is decompressed and unserialized the first
+         * time it is obtained from the cache, and its hash is checked
+         * against the hash stored in the checkpoint.
+         *
+         * The data itself is only read when needed if the backend
+         * supports views (see CheckpointIO::read_view). Otherwise, it is
+         * read when loading.
+         *
+         * \param [in] lazy Whether future loads should be lazy
+         */
+        void set_lazy_restore(bool lazy) noexcept;
+
     private:
         std::shared_ptr<CheckpointIO> backend_local_;
         std::shared_ptr<CheckpointIO> backend_global_;
 
+        //! Restore entries lazily (see set_lazy_restore)
+        bool lazy_restore_;
+
+        //! A copy of the entries of a CacheMap
+        typedef std::map<std::string, CacheMap::CacheMapEntry_> CacheEntries_;
+
+        //! An entry that is ready to be written to a backend
+        struct SavedEntry_
+        {
+            std::string cachekey;  //!< Key of the entry in the cache
+            ByteArray data;        //!< Serialized (and maybe compressed) data
+            detail::CacheEntryMetadata meta;  //!< Metadata of the entry
+        };
+
+        /*! \brief Serialize and compress an entry of the cache
+         *
+         * This may be called from several threads at once
+         */
+        static SavedEntry_ serialize_entry_(const std::string & cachekey,
+                                            const CacheMap::CacheMapEntry_ & cdat);
+
+        /*! \brief Read the manifest of the entries stored in a backend
+         *
+         * If the backend doesn't contain a manifest, it is formed from
+         * the metadata of each entry.
+         */
+        static detail::CheckpointManifest read_manifest_(const CheckpointIO & backend);
+
         static std::vector<std::string>
-        form_cache_save_list_(const ModuleManager & mm,
-                              CheckpointIO & backend,
+        form_cache_save_list_(const CacheEntries_ & entries,
+                              const detail::CheckpointManifest & manifest,
                               std::function<bool(unsigned int)> policy_check);
 
         void perform_on_all_ranks_(const std::string & description, std::function<void(void)> func);
 
         void load_cache_(ModuleManager & mm, CheckpointIO & backend);
 
+        /*! \brief Create a placeholder for an entry stored in a backend
+         *
+         * The data is not read, decompressed, or unserialized until needed
+         */
+        static detail::SerializedGenericData
+        lazy_entry_(const detail::CacheEntryMetadata & cem,
+                    CheckpointIO & backend, const std::string & key);
+
+        /*! \brief Save entries of the cache to a backend
+         *
+         * The module manager is only locked while the entries are copied
+         * (which only copies pointers). The entries are then serialized and
+         * compressed by several threads, and written by the calling thread.
+         */
         void save_cache_(const ModuleManager & mm, CheckpointIO & backend,
                          std::function<bool(unsigned int)> policy_check);
 };
@@ -0,0 +1,76 @@
+/*! \file
+ *
+ * \brief Compression of data stored in a checkpoint (source)
+ */
+
+#include "pulsar/modulemanager/CheckpointCodec.hpp"
+#include "pulsar/exception/PulsarException.hpp"
+#include "pulsar/math/Cast.hpp"
+
+#include <zlib.h>
+
+
+namespace {
+
+//! Data smaller than this isn't compressed
+const size_t min_compress_size = 512;
+
+//! Compression level (favor speed, since checkpointing stalls the calculation)
+const int zlib_level = 1;
+
+} // close anonymous namespace
+
+
+namespace pulsar {
+namespace detail {
+
+
+CheckpointCodec compress_checkpoint_data(ByteArray & data)
+{
+    if(data.size() < min_compress_size)
+        return CodecNone;
+
+    const uLong src_size = numeric_cast<uLong>(data.size());
+    uLongf dest_size = compressBound(src_size);
+    ByteArray compressed(dest_size);
+
+    int ret = compress2(reinterpret_cast<Bytef *>(compressed.data()), &dest_size,
+                        reinterpret_cast<const Bytef *>(data.data()), src_size,
+                        zlib_level);
+
+    // Only keep the compressed data if it saves at least 1/8 of the space
+    if(ret != Z_OK || dest_size > src_size - src_size/8)
+        return CodecNone;
+
+    compressed.resize(dest_size);
+    data = std::move(compressed);
+    return CodecZlib;
+}
+
+
+ByteArray decompress_checkpoint_data(unsigned int codec, const char * data,
+                                     size_t size, size_t orig_size)
+{
+    if(codec == CodecNone)
+        return ByteArray(data, data + size);
+
+    if(codec != CodecZlib)
+        throw PulsarException("Unknown codec for checkpoint data", "codec", codec);
+
+    ByteArray ret(orig_size);
+    uLongf dest_size = numeric_cast<uLongf>(orig_size);
+
+    int ret_z = uncompress(reinterpret_cast<Bytef *>(ret.data()), &dest_size,
+                           reinterpret_cast<const Bytef *>(data), numeric_cast<uLong>(size));
+
+    if(ret_z != Z_OK || dest_size != orig_size)
+        throw PulsarException("Error decompressing checkpoint data",
+                              "zlib error", ret_z,
+                              "size", dest_size,
+                              "expected size", orig_size);
+    return ret;
+}
+
+
+} // close namespace detail
+} // close namespace pulsar
@@ -0,0 +1,52 @@
+/*! \file
+ *
+ * \brief Compression of data stored in a checkpoint (header)
+ */
+
+#pragma once
+
+#include "pulsar/util/Serialization_fwd.hpp"
+
+#include <cstddef>
+
+namespace pulsar {
+namespace detail {
+
+
+/*! \brief How cache data is encoded in a checkpoint
+ *
+ * This is stored in the metadata of each entry (see CacheEntryMetadata)
+ */
+enum CheckpointCodec : unsigned int
+{
+    CodecNone = 0,  //!< Stored as serialized
+    CodecZlib = 1   //!< Compressed with zlib
+};
+
+
+/*! \brief Compress data to be stored in a checkpoint
+ *
+ * If compression doesn't save enough space, the data is left as is.
+ *
+ * \param [in,out] data The data to compress. Replaced by the compressed data
+ * \return The codec the data is now encoded with
+ */
+CheckpointCodec compress_checkpoint_data(ByteArray & data);
+
+
+/*! \brief Decompress data read from a checkpoint
+ *
+ * \throw pulsar::PulsarException if the codec is unknown or
+ *        the data can't be decompressed
+ *
+ * \param [in] codec The codec the data is encoded with
+ * \param [in] data The stored data
+ * \param [in] size Number of bytes of stored data
+ * \param [in] orig_size Size of the data before compression
+ */
+ByteArray decompress_checkpoint_data(unsigned int codec, const char * data,
+                                     size_t size, size_t orig_size);
+
+
+} // close namespace detail
+} // close namespace pulsar
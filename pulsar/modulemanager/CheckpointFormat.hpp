@@ -0,0 +1,97 @@
+/*! \file
+ *
+ * \brief Format of cache entries stored in a checkpoint backend
+ *
+ * This is shared between Checkpoint and CacheMap (which may spill
+ * entries to a checkpoint backend), so that entries written by one can be
+ * read by the other.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <bphash/Hash.hpp>
+#include "pulsar/exception/PulsarException.hpp"
+
+namespace pulsar {
+namespace detail {
+
+/*! \brief Metadata stored alongside each cache entry in a checkpoint */
+struct CacheEntryMetadata
+{
+    std::string cachekey;
+    std::string type;
+    bphash::HashValue hash;  //!< Hash of original data, NOT serialized data
+    size_t size;             //!< Size of serialized data (before compression)
+    unsigned int policy;     //!< Storage policy
+    unsigned int codec;      //!< How the data is stored (see CheckpointCodec)
+
+    template<typename Archive>
+    void serialize(Archive & ar)
+    {
+        ar(cachekey, type, hash, size, policy, codec);
+    }
+};
+
+/*! \brief Metadata of all cache entries stored in a checkpoint
+ *
+ * This is stored as a single record (under manifest_key), so the
+ * metadata doesn't have to be read separately for each entry. The key
+ * is the cache key (without the "CHKPT_CACHE__" prefix).
+ */
+typedef std::map<std::string, CacheEntryMetadata> CheckpointManifest;
+
+//! Key of the manifest in a checkpoint backend
+static const char manifest_key[] = "CHKPT_MANIFEST";
+
+inline bool is_meta_key(const std::string & s)
+{
+    if(s.size() <= 6)
+        return false; // needs at least one char + "##META"
+
+    std::string last5 = s.substr(s.size()-6, 6);
+
+    if(last5 == "##META")
+        return true;
+    else
+        return false;
+}
+
+inline bool is_cache_key(const std::string & s)
+{
+    if(s.size() <= 13)
+        return false; // Needs at least "CHKPT_CACHE__" + one char
+
+    std::string first13 = s.substr(0, 13);
+
+    if(first13 != "CHKPT_CACHE__")
+        return false;
+    else
+        return true;
+}
+
+
+inline std::string make_cache_key(const std::string & datakey)
+{
+    return std::string("CHKPT_CACHE__") + datakey;
+}
+
+inline std::string make_meta_key(const std::string & datakey)
+{
+    return make_cache_key(datakey) + "##META";
+}
+
+inline std::string
+split_cache_key(const std::string & key)
+{
+    if(!is_cache_key(key))
+        throw pulsar::PulsarException("Unknown key format: not a cache key",
+                               "key", key);
+
+    return key.substr(13); // remove "CHKPT_CACHE__"
+}
+
+
+} // close namespace detail
+} // close namespace pulsar
@@ -9,11 +9,24 @@
 
 #include "pulsar/util/Serialization_fwd.hpp"
 
+#include <memory>
 #include <string>
 #include <set>
 
 namespace pulsar {
 
+/*! \brief Data read from a checkpoint backend without copying it
+ *
+ * The data stays valid (for example, the file stays mapped into memory)
+ * as long as the view exists. A view with a null \p data means
+ * the backend doesn't support views.
+ */
+struct CheckpointView
+{
+    std::shared_ptr<const char> data;
+    size_t size;
+};
+
 /*! \brief Interface to an IO backend for checkpointing
  */
 class CheckpointIO
@@ -41,6 +54,15 @@ class CheckpointIO
 
         virtual ByteArray read(const std::string & key) const = 0;
 
+        /*! \brief Read data without copying it
+         *
+         * By default, views are not supported and an empty view is returned
+         */
+        virtual CheckpointView read_view(const std::string & /*key*/) const
+        {
+            return CheckpointView{nullptr, 0};
+        }
+
         virtual void erase(const std::string & key) = 0;
 
         virtual void clear(void) = 0; 
@@ -25,7 +25,8 @@ namespace pulsar{
 
 ModuleManager::ModuleManager()
     : debugall_(false),
-      curid_(100)
+      curid_(100),
+      shared_cache_(new CacheData(&cachemap_, "pulsar_shared"))
 {
     // add the handlers
     loadhandlers_.emplace("c_module", std::unique_ptr<SupermoduleLoaderBase>(new CppSupermoduleLoader()));
@@ -202,6 +203,16 @@ void ModuleManager::enable_debug_all(bool debug) noexcept
 }
 
 
+void ModuleManager::enable_fast_dispatch(const std::string & modulekey, bool fast)
+{
+    std::lock_guard<std::mutex> l(mutex_);
+    if(fast)
+        keyfast_.insert(modulekey);
+    else
+        keyfast_.erase(modulekey); // ok if it doesn't exist
+}
+
+
 
 /////////////////////////////////////////
 // Module Loading
@@ -342,6 +353,11 @@ ModuleManager::create_module_(const std::string & modulekey, ID_t parentid)
     if(debugall_ || keydebug_.count(modulekey))
         p->enable_debug(true);
 
+    // Hot calls of C++ modules can skip the checks in call_function.
+    // Calls to python modules need the GIL anyway.
+    const bool is_python = (dynamic_cast<detail::PyModuleIMPLHolder *>(umbptr.get()) != nullptr);
+    p->set_fast_dispatch_(!is_python && keyfast_.count(modulekey));
+
     // create a CacheData for this module
     const std::string ckey = se.mi.name + "_v" + se.mi.version;
     p->set_cache_(CacheData(&cachemap_, ckey));
@@ -416,4 +432,24 @@ void ModuleManager::stop_cache_sync(void)
     cachemap_.stop_sync();
 }
 
+void ModuleManager::set_cache_max_bytes(size_t max_bytes)
+{
+    cachemap_.set_max_bytes(max_bytes);
+}
+
+void ModuleManager::set_cache_spill_backend(const std::shared_ptr<CheckpointIO> & backend)
+{
+    cachemap_.set_spill_backend(backend);
+}
+
+CacheMapStats ModuleManager::cache_stats(void) const
+{
+    return cachemap_.stats();
+}
+
+CacheData & ModuleManager::shared_cache(void)
+{
+    return *shared_cache_;
+}
+
 } // close namespace pulsar
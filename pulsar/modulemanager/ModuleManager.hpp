@@ -11,6 +11,7 @@
 #include <thread>
 
 #include "pulsar/datastore/CacheMap.hpp"
+#include "pulsar/datastore/CacheData.hpp"
 #include "pulsar/exception/PulsarException.hpp"
 #include "pulsar/modulemanager/ModuleCreationFuncs.hpp"
 #include "pulsar/modulemanager/ModuleTree.hpp"
@@ -23,6 +24,7 @@ namespace pulsar{
 // forward declaration
 class SupermoduleLoaderBase;
 class Checkpoint;
+class CheckpointIO;
 
 
 /*! \brief Handles loading of supermodules and creation of modules
@@ -296,6 +298,18 @@ class ModuleManager : public std::enable_shared_from_this<ModuleManager>
         void enable_debug_all(bool debug) noexcept;
 
 
+        /*! \brief Enable fast dispatch of hot calls for a specific key
+         *
+         * Functions called very often (such as calculate() of the integral
+         * base classes) are then called without the checks done by
+         * ModuleBase::call_function. This only affects modules created
+         * after this call, and is ignored for modules written in python.
+         *
+         * The key doesn't have to exist -- it will be used if it is ever loaded
+         */
+        void enable_fast_dispatch(const std::string & modulekey, bool fast);
+
+
         /*! \brief Start syncronizing this module manager's cache
          *         across all ranks
          */
@@ -307,6 +321,33 @@ class ModuleManager : public std::enable_shared_from_this<ModuleManager>
         void stop_cache_sync(void);
 
 
+        /*! \brief Set the memory budget of this module manager's cache
+         *
+         * \param [in] max_bytes Maximum memory to use (in bytes). Zero
+         *                       means unlimited
+         */
+        void set_cache_max_bytes(size_t max_bytes);
+
+
+        /*! \brief Set where evicted cache entries with the
+         *         CheckpointLocal policy are written to
+         */
+        void set_cache_spill_backend(const std::shared_ptr<CheckpointIO> & backend);
+
+
+        /*! \brief Obtain usage statistics of this module manager's cache
+         */
+        CacheMapStats cache_stats(void) const;
+
+
+        /*! \brief Obtain cache data shared by all modules
+         *
+         * Used for data that doesn't belong to a particular module
+         * (such as shell pair lists).
+         */
+        CacheData & shared_cache(void);
+
+
     private:
         friend class Checkpoint;
 
@@ -350,6 +391,10 @@ class ModuleManager : public std::enable_shared_from_this<ModuleManager>
         std::atomic<bool> debugall_;
 
 
+        /*! \brief List of keys with fast dispatch enabled */
+        std::set<std::string> keyfast_;
+
+
         /*! \brief Tree for storing created module information
          */
         ModuleTree mtree_;
@@ -362,6 +407,9 @@ class ModuleManager : public std::enable_shared_from_this<ModuleManager>
         /*! \brief All of the cache data */
         CacheMap cachemap_;
 
+        /*! \brief Cache data shared by all modules (stored in cachemap_) */
+        std::unique_ptr<CacheData> shared_cache_;
+
 
         /*! \brief Obtain stored internal info for a module (via module key)
          *         or throw an exception
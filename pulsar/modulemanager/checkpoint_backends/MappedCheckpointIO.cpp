@@ -0,0 +1,560 @@
+/*! \file
+ *
+ * \brief Checkpointing backend using a memory-mapped, append-only file
+ */
+
+
+#include "pulsar/modulemanager/checkpoint_backends/MappedCheckpointIO.hpp"
+#include "pulsar/util/Serialization.hpp"
+#include "pulsar/exception/PulsarException.hpp"
+#include "pulsar/output/GlobalOutput.hpp"
+#include "pulsar/math/Cast.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/* Developer note
+ *
+ * Format of the file:
+ *
+ *   [ 8 bytes: file magic ]
+ *   [ record ] [ record ] ...
+ *   [ index record ] [ trailer ]   <- only if the file was closed properly
+ *
+ * Each record is a RecordHeader, the key, and then the data. The key and
+ * the data are each padded to a multiple of 8 bytes. An erased key is a
+ * record with no data and a data size of erased_size. The index is stored
+ * as a record with an empty key.
+ *
+ * When the file is opened again, new records overwrite the old
+ * index record and trailer.
+ */
+
+
+namespace {
+
+const char file_magic[8]  = {'P', 'S', 'R', 'C', 'H', 'K', 'P', 'T'};
+const char index_magic[8] = {'P', 'S', 'R', 'I', 'N', 'D', 'E', 'X'};
+
+//! Data size that marks an erased key
+const uint64_t erased_size = UINT64_MAX;
+
+//! Writes larger than this skip the buffer
+const size_t direct_write_size = 65536;
+
+//! The buffer is written to the file when it gets larger than this
+const size_t max_buffer_size = 1048576;
+
+struct RecordHeader
+{
+    uint64_t key_size;
+    uint64_t data_size;
+};
+
+struct Trailer
+{
+    uint64_t index_offset;  //!< Start of the index record
+    char magic[8];
+};
+
+//! Round up to a multiple of 8
+inline uint64_t padded(uint64_t n)
+{
+    return (n + 7) & ~UINT64_C(7);
+}
+
+} // close anonymous namespace
+
+
+
+namespace pulsar {
+
+
+struct MappedCheckpointIO::Mapping_
+{
+    const char * addr;
+    size_t size;
+
+    Mapping_(int fd, size_t map_size, const std::string & path)
+        : addr(nullptr), size(map_size)
+    {
+        void * p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+            throw PulsarException("Error mapping checkpoint file into memory",
+                                  "what", std::strerror(errno),
+                                  "path", path,
+                                  "size", size);
+        addr = static_cast<const char *>(p);
+    }
+
+    ~Mapping_()
+    {
+        munmap(const_cast<char *>(addr), size);
+    }
+
+    Mapping_(const Mapping_ &)             = delete;
+    Mapping_ & operator=(const Mapping_ &) = delete;
+};
+
+
+
+MappedCheckpointIO::MappedCheckpointIO(const std::string & path)
+    : path_(path), fd_(-1), file_size_(0), closed_size_(0),
+      reopen_offset_(0), truncate_(false), dirty_(false)
+{
+}
+
+MappedCheckpointIO::~MappedCheckpointIO()
+{
+    // Don't throw from the destructor. Without the index,
+    // the records will be scanned next time
+    try {
+        close();
+    }
+    catch(std::exception & ex)
+    {
+        print_global_error("Error closing checkpoint file %?: %?\n", path_, ex.what());
+    }
+}
+
+
+void MappedCheckpointIO::open(void)
+{
+    if(fd_ >= 0)
+        return;
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd_ < 0)
+        throw PulsarException("Error opening checkpoint file",
+                              "what", std::strerror(errno),
+                              "path", path_);
+
+    struct stat st;
+    if(fstat(fd_, &st) != 0)
+    {
+        const int err = errno;
+        ::close(fd_);
+        fd_ = -1;
+        throw PulsarException("Error reading size of checkpoint file",
+                              "what", std::strerror(err),
+                              "path", path_);
+    }
+
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+
+    buffer_.clear();
+    dirty_ = false;
+    truncate_ = false;
+    file_size_ = 0;
+
+    try {
+        if(size == 0)
+        {
+            // new file
+            index_.clear();
+            write_at_(0, file_magic, sizeof(file_magic));
+            file_size_ = sizeof(file_magic);
+            dirty_ = true;
+        }
+        else
+        {
+            char magic[sizeof(file_magic)] = {0};
+            if(size >= sizeof(magic))
+                read_at_(0, magic, sizeof(magic));
+
+            if(std::memcmp(magic, file_magic, sizeof(magic)) != 0)
+                throw PulsarException("File is not a checkpoint file", "path", path_);
+
+            if(size == closed_size_ && reopen_offset_ > 0)
+                file_size_ = reopen_offset_; // we closed it last, so index_ is current
+            else if(!read_index_(size))
+            {
+                print_global_debug("Index missing from checkpoint file %?. Scanning records\n", path_);
+                scan_records_(size);
+                dirty_ = true; // so that the index is written
+            }
+
+            truncate_ = (size > file_size_);
+        }
+    }
+    catch(...)
+    {
+        ::close(fd_);
+        fd_ = -1;
+        throw;
+    }
+
+    closed_size_ = size;
+    reopen_offset_ = file_size_;
+}
+
+
+void MappedCheckpointIO::close(void)
+{
+    if(fd_ < 0)
+        return;
+
+    if(dirty_)
+    {
+        // Write the index
+        const uint64_t index_offset = file_size_ + buffer_.size();
+        const ByteArray ba_index = to_byte_array(index_);
+        append_record_("", ba_index.data(), ba_index.size(), ba_index.size());
+        flush_();
+
+        // The records and index must be on disk before
+        // the trailer that points to them
+        if(fdatasync(fd_) != 0)
+            throw PulsarException("Error syncing checkpoint file",
+                                  "what", std::strerror(errno),
+                                  "path", path_);
+
+        Trailer tr;
+        tr.index_offset = index_offset;
+        std::memcpy(tr.magic, index_magic, sizeof(index_magic));
+        write_at_(file_size_, reinterpret_cast<const char *>(&tr), sizeof(tr));
+
+        if(fsync(fd_) != 0)
+            throw PulsarException("Error syncing checkpoint file",
+                                  "what", std::strerror(errno),
+                                  "path", path_);
+
+        closed_size_ = file_size_ + sizeof(tr);
+        reopen_offset_ = index_offset;
+        dirty_ = false;
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+}
+
+
+void MappedCheckpointIO::check_open_(void) const
+{
+    if(fd_ < 0)
+        throw PulsarException("Checkpoint file is not open", "path", path_);
+}
+
+
+size_t MappedCheckpointIO::count(const std::string & key) const
+{
+    return index_.count(key);
+}
+
+
+std::set<std::string> MappedCheckpointIO::all_keys(void) const
+{
+    std::set<std::string> ret;
+    for(const auto & it : index_)
+        ret.insert(ret.end(), it.first);
+    return ret;
+}
+
+
+void MappedCheckpointIO::write(const std::string & key, const ByteArray & data)
+{
+    check_open_();
+
+    if(key.empty())
+        throw PulsarException("Cannot write to a checkpoint file with an empty key",
+                              "path", path_);
+
+    const uint64_t offset = append_record_(key, data.data(), data.size(), data.size());
+    index_[key] = Record_{offset, data.size()};
+    dirty_ = true;
+}
+
+
+const MappedCheckpointIO::Record_ &
+MappedCheckpointIO::find_(const std::string & key) const
+{
+    auto it = index_.find(key);
+    if(it == index_.end())
+        throw PulsarException("Cannot read data from checkpoint file - key doesn't exist",
+                              "key", key);
+    return it->second;
+}
+
+
+const char * MappedCheckpointIO::data_ptr_(const Record_ & rec,
+                                           std::shared_ptr<const Mapping_> & mapping) const
+{
+    // not written to the file yet
+    if(rec.offset >= file_size_)
+    {
+        mapping.reset();
+        return buffer_.data() + (rec.offset - file_size_);
+    }
+
+    // Map the file again if it has grown past the current mapping.
+    // The old mapping stays valid as long as views use it.
+    std::lock_guard<std::mutex> l(mapping_mutex_);
+    if(!mapping_ || mapping_->size < rec.offset + rec.size)
+        mapping_ = std::make_shared<const Mapping_>(fd_, file_size_, path_);
+
+    mapping = mapping_;
+    return mapping->addr + rec.offset;
+}
+
+
+ByteArray MappedCheckpointIO::read(const std::string & key) const
+{
+    check_open_();
+
+    const Record_ & rec = find_(key);
+    std::shared_ptr<const Mapping_> mapping;
+    const char * p = data_ptr_(rec, mapping);
+    return ByteArray(p, p + rec.size);
+}
+
+
+CheckpointView MappedCheckpointIO::read_view(const std::string & key) const
+{
+    check_open_();
+
+    const Record_ & rec = find_(key);
+    std::shared_ptr<const Mapping_> mapping;
+    const char * p = data_ptr_(rec, mapping);
+
+    if(mapping)
+        return CheckpointView{std::shared_ptr<const char>(mapping, p), rec.size};
+
+    // Still in the buffer, which will change. So the view gets a copy
+    auto copy = std::make_shared<const ByteArray>(p, p + rec.size);
+    return CheckpointView{std::shared_ptr<const char>(copy, copy->data()), rec.size};
+}
+
+
+void MappedCheckpointIO::erase(const std::string & key)
+{
+    check_open_();
+
+    if(index_.count(key) == 0)
+        return;
+
+    append_record_(key, nullptr, 0, erased_size);
+    index_.erase(key);
+    dirty_ = true;
+}
+
+
+void MappedCheckpointIO::clear(void)
+{
+    const bool was_open = (fd_ >= 0);
+    if(was_open)
+        ::close(fd_);
+
+    fd_ = -1;
+    buffer_.clear();
+    index_.clear();
+    mapping_.reset();
+    dirty_ = false;
+    closed_size_ = 0;
+    reopen_offset_ = 0;
+
+    // Remove the file rather than truncating it, so that
+    // existing views (which map the old file) stay valid
+    if(::unlink(path_.c_str()) != 0 && errno != ENOENT)
+        throw PulsarException("Error removing checkpoint file",
+                              "what", std::strerror(errno),
+                              "path", path_);
+
+    if(was_open)
+        open();
+}
+
+
+void MappedCheckpointIO::read_at_(uint64_t offset, char * data, size_t size) const
+{
+    while(size > 0)
+    {
+        const ssize_t n = pread(fd_, data, size, numeric_cast<off_t>(offset));
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            throw PulsarException("Error reading from checkpoint file",
+                                  "what", (n < 0 ? std::strerror(errno) : "unexpected end of file"),
+                                  "path", path_);
+
+        const size_t nread = static_cast<size_t>(n);
+        data += nread;
+        size -= nread;
+        offset += nread;
+    }
+}
+
+
+void MappedCheckpointIO::write_at_(uint64_t offset, const char * data, size_t size)
+{
+    // remove the old index (and anything else past the records)
+    // before writing anything
+    if(truncate_)
+    {
+        if(ftruncate(fd_, numeric_cast<off_t>(file_size_)) != 0)
+            throw PulsarException("Error truncating checkpoint file",
+                                  "what", std::strerror(errno),
+                                  "path", path_);
+        truncate_ = false;
+    }
+
+    while(size > 0)
+    {
+        const ssize_t n = pwrite(fd_, data, size, numeric_cast<off_t>(offset));
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0)
+            throw PulsarException("Error writing to checkpoint file",
+                                  "what", std::strerror(errno),
+                                  "path", path_);
+
+        const size_t nwritten = static_cast<size_t>(n);
+        data += nwritten;
+        size -= nwritten;
+        offset += nwritten;
+    }
+}
+
+
+void MappedCheckpointIO::flush_(void)
+{
+    if(buffer_.empty())
+        return;
+
+    write_at_(file_size_, buffer_.data(), buffer_.size());
+    file_size_ += buffer_.size();
+    buffer_.clear();
+}
+
+
+uint64_t MappedCheckpointIO::append_record_(const std::string & key, const char * data,
+                                            size_t size, uint64_t data_size)
+{
+    const uint64_t start = file_size_ + buffer_.size();
+    const uint64_t data_offset = start + padded(sizeof(RecordHeader) + key.size());
+
+    // header and key (padded)
+    const RecordHeader header{key.size(), data_size};
+    const char * header_ptr = reinterpret_cast<const char *>(&header);
+    buffer_.insert(buffer_.end(), header_ptr, header_ptr + sizeof(header));
+    buffer_.insert(buffer_.end(), key.begin(), key.end());
+    buffer_.resize(data_offset - file_size_, 0);
+
+    // the data. Large data is written directly from the caller's buffer
+    if(size >= direct_write_size)
+    {
+        flush_();
+        write_at_(data_offset, data, size);
+        file_size_ += size;
+    }
+    else
+        buffer_.insert(buffer_.end(), data, data + size);
+
+    const uint64_t end = data_offset + size;
+    buffer_.resize(buffer_.size() + (padded(end) - end), 0);
+
+    if(buffer_.size() >= max_buffer_size)
+        flush_();
+
+    return data_offset;
+}
+
+
+bool MappedCheckpointIO::read_index_(uint64_t size)
+{
+    if(size < sizeof(file_magic) + sizeof(RecordHeader) + sizeof(Trailer))
+        return false;
+
+    const uint64_t trailer_offset = size - sizeof(Trailer);
+
+    Trailer tr;
+    read_at_(trailer_offset, reinterpret_cast<char *>(&tr), sizeof(tr));
+
+    if(std::memcmp(tr.magic, index_magic, sizeof(index_magic)) != 0)
+        return false;
+
+    if(tr.index_offset < sizeof(file_magic) ||
+       tr.index_offset > trailer_offset - sizeof(RecordHeader))
+        return false;
+
+    RecordHeader header;
+    read_at_(tr.index_offset, reinterpret_cast<char *>(&header), sizeof(header));
+
+    const uint64_t data_offset = tr.index_offset + sizeof(RecordHeader);
+    if(header.key_size != 0 || header.data_size > trailer_offset - data_offset)
+        return false;
+
+    ByteArray ba_index(header.data_size);
+    read_at_(data_offset, ba_index.data(), ba_index.size());
+
+    std::map<std::string, Record_> index;
+    try {
+        index = from_byte_array<std::map<std::string, Record_>>(ba_index);
+    }
+    catch(std::exception &)
+    {
+        return false;
+    }
+
+    // All the data must be before the index
+    for(const auto & it : index)
+    {
+        if(it.second.offset > tr.index_offset ||
+           it.second.size > tr.index_offset - it.second.offset)
+            return false;
+    }
+
+    index_ = std::move(index);
+    file_size_ = tr.index_offset;
+    return true;
+}
+
+
+void MappedCheckpointIO::scan_records_(uint64_t size)
+{
+    index_.clear();
+
+    uint64_t pos = sizeof(file_magic);
+    while(size - pos >= sizeof(RecordHeader))
+    {
+        RecordHeader header;
+        read_at_(pos, reinterpret_cast<char *>(&header), sizeof(header));
+
+        // stop at anything that isn't a complete record
+        if(header.key_size > size - pos)
+            break;
+
+        const uint64_t data_offset = pos + padded(sizeof(RecordHeader) + header.key_size);
+        const uint64_t data_size = (header.data_size == erased_size) ? 0 : header.data_size;
+        if(data_offset > size || data_size > size - data_offset)
+            break;
+
+        const uint64_t end = padded(data_offset + data_size);
+        if(end > size)
+            break;
+
+        // An empty key is an old index
+        if(header.key_size > 0)
+        {
+            std::string key(header.key_size, '\0');
+            read_at_(pos + sizeof(RecordHeader), &key[0], key.size());
+
+            if(header.data_size == erased_size)
+                index_.erase(key);
+            else
+                index_[key] = Record_{data_offset, data_size};
+        }
+
+        pos = end;
+    }
+
+    file_size_ = pos;
+}
+
+} // close namespace pulsar
+
@@ -0,0 +1,139 @@
+/*! \file
+ *
+ * \brief Checkpointing backend using a memory-mapped, append-only file
+ */
+
+
+#pragma once
+
+#include "pulsar/modulemanager/CheckpointIO.hpp"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+namespace pulsar {
+
+
+/*! \brief Checkpointing backend using a memory-mapped, append-only file
+ *
+ * Data is appended to the end of the file as records (key + data).
+ * When the file is closed, an index of the records is appended, so that
+ * opening the file again doesn't need to read all the data. If the index
+ * is missing (for example, the program crashed before closing the file),
+ * the records are scanned instead.
+ *
+ * Small writes are buffered, and the file is only synced to disk
+ * when it is closed. Space used by overwritten or erased data is
+ * not reclaimed until clear() is called.
+ *
+ * Data is read from a memory mapping of the file. read_view() returns
+ * the data without copying it, and keeps the mapping alive as long
+ * as the view exists (even after the file is closed or cleared).
+ *
+ * Const member functions (such as read() and read_view()) may be called
+ * from several threads at once, but not at the same time as any
+ * non-const member function.
+ */
+class MappedCheckpointIO : public CheckpointIO
+{
+    public:
+        MappedCheckpointIO(const std::string & path);
+        ~MappedCheckpointIO();
+
+
+        // no copy or move construction or assignment (the file
+        // descriptor is closed, and the index written, on destruction)
+        MappedCheckpointIO() = delete;
+        MappedCheckpointIO(const MappedCheckpointIO & rhs)             = delete;
+        MappedCheckpointIO(MappedCheckpointIO && rhs)                  = delete;
+        MappedCheckpointIO & operator=(const MappedCheckpointIO & rhs) = delete;
+        MappedCheckpointIO & operator=(MappedCheckpointIO && rhs)      = delete;
+
+        virtual void open(void);
+
+        virtual void close(void);
+
+        virtual size_t count(const std::string & key) const;
+
+        virtual std::set<std::string> all_keys(void) const;
+
+        virtual void write(const std::string & key, const ByteArray & data);
+
+        virtual ByteArray read(const std::string & key) const;
+
+        virtual CheckpointView read_view(const std::string & key) const;
+
+        virtual void erase(const std::string & key);
+
+        virtual void clear(void);
+
+    private:
+        //! A region of the file mapped into memory
+        struct Mapping_;
+
+        //! Where the data for a key is in the file
+        struct Record_
+        {
+            uint64_t offset;  //!< Offset of the data
+            uint64_t size;    //!< Size of the data (in bytes)
+
+            template<typename Archive>
+            void serialize(Archive & ar)
+            {
+                ar(offset, size);
+            }
+        };
+
+        const std::string path_;
+        int fd_;
+
+        //! Where the data for each key is
+        std::map<std::string, Record_> index_;
+
+        //! Number of bytes written to the file (not including buffer_)
+        uint64_t file_size_;
+
+        //! Size of the file when we last closed it (to reuse index_ when reopening)
+        uint64_t closed_size_;
+
+        //! Where to append new records when reopening a file of size closed_size_
+        uint64_t reopen_offset_;
+
+        //! Is there old data (such as the index) past file_size_ to be removed?
+        bool truncate_;
+
+        //! Data appended, but not written to the file yet
+        ByteArray buffer_;
+
+        //! Were records appended since the file was opened?
+        bool dirty_;
+
+        //! Mapping of the file (may not cover recently written data)
+        mutable std::shared_ptr<const Mapping_> mapping_;
+
+        //! Protects mapping_, which is replaced by readers
+        mutable std::mutex mapping_mutex_;
+
+        void check_open_(void) const;
+
+        const Record_ & find_(const std::string & key) const;
+
+        const char * data_ptr_(const Record_ & rec, std::shared_ptr<const Mapping_> & mapping) const;
+
+        void read_at_(uint64_t offset, char * data, size_t size) const;
+
+        void write_at_(uint64_t offset, const char * data, size_t size);
+
+        void flush_(void);
+
+        uint64_t append_record_(const std::string & key, const char * data,
+                                size_t size, uint64_t data_size);
+
+        bool read_index_(uint64_t size);
+
+        void scan_records_(uint64_t size);
+};
+
+} // close namespace pulsar
+
@@ -11,6 +11,7 @@
 
 #include "pulsar/modulemanager/checkpoint_backends/DummyCheckpointIO.hpp"
 #include "pulsar/modulemanager/checkpoint_backends/BDBCheckpointIO.hpp"
+#include "pulsar/modulemanager/checkpoint_backends/MappedCheckpointIO.hpp"
 
 using pulsar::detail::ConstModuleTreeIter;
 using pulsar::detail::ConstModuleFlatTreeIter;
@@ -87,8 +88,12 @@ void export_modulemanager(pybind11::module & m)
     .def("load_lambda_module",&ModuleManager::load_lambda_module_py)
     .def("enable_debug", &ModuleManager::enable_debug)
     .def("enable_debug_all", &ModuleManager::enable_debug_all)
+    .def("enable_fast_dispatch", &ModuleManager::enable_fast_dispatch)
     .def("start_cache_sync", &ModuleManager::start_cache_sync)
     .def("stop_cache_sync", &ModuleManager::stop_cache_sync)
+    .def("set_cache_max_bytes", &ModuleManager::set_cache_max_bytes)
+    .def("set_cache_spill_backend", &ModuleManager::set_cache_spill_backend)
+    .def("cache_stats", &ModuleManager::cache_stats)
     ;
 
     ////////////////////////////////
@@ -125,6 +130,10 @@ void export_modulemanager(pybind11::module & m)
     .def(pybind11::init<const std::string &>())
     ;
 
+    pybind11::class_<MappedCheckpointIO, std::shared_ptr<MappedCheckpointIO>>(m, "MappedCheckpointIO", cpio)
+    .def(pybind11::init<const std::string &>())
+    ;
+
     //////////////////////////////
     // Checkpointing
     //////////////////////////////
@@ -135,6 +144,7 @@ void export_modulemanager(pybind11::module & m)
     .def("load_local_cache", &Checkpoint::load_local_cache)
     .def("save_global_cache", &Checkpoint::save_global_cache)
     .def("load_global_cache", &Checkpoint::load_global_cache)
+    .def("set_lazy_restore", &Checkpoint::set_lazy_restore)
     ;
 
 }
@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <mpi.h>
 #include "pulsar/exception/PulsarException.hpp"
 #include "pulsar/parallel/Parallel.hpp"
@@ -21,11 +22,19 @@ namespace {
     struct EnvManager_
     {
         bool initialized_by_me = false;
+        size_t nthreads = 0;
 
-        void initialize(size_t )
+        void initialize(size_t nthreads_in)
         {
             using namespace pulsar;
 
+            // 0 means use whatever the hardware supports
+            nthreads = nthreads_in;
+            if(nthreads == 0)
+                nthreads = std::thread::hardware_concurrency();
+            if(nthreads == 0)
+                nthreads = 1;
+
             // is MPI already initialized?
             int initialized;
             MPI_Initialized(&initialized);
@@ -89,7 +98,21 @@ void parallel_initialize(size_t nthreads)
 {
     envmanager_.initialize(nthreads);
     std::cout << "Initialized process " << get_proc_id()
-              << " of " << get_nproc() << "\n";
+              << " of " << get_nproc() << " with "
+              << get_nthreads() << " threads\n";
+}
+
+
+size_t get_nthreads(void)
+{
+    // parallel_initialize may not have been called (for example,
+    // from C++ tests)
+    if(envmanager_.nthreads == 0)
+    {
+        const size_t hw = std::thread::hardware_concurrency();
+        return hw ? hw : 1;
+    }
+    return envmanager_.nthreads;
 }
 
 
@@ -20,7 +20,8 @@ namespace pulsar {
  *
  * This is meant to be called from python at the start of the program
  * 
- * \param[in] nthreads The maximum number of threads the program may use
+ * \param[in] nthreads The maximum number of threads the program may use.
+ *                     If zero, the number of hardware threads is used.
  * 
  * 
  * \todo Make an overload that takes an MPI_COMM instance
@@ -45,6 +46,14 @@ long get_proc_id(void);
  */
 long get_nproc(void);
 
+
+/*! \brief Return the maximum number of threads each process may use
+ *
+ * This is the value given to parallel_initialize. If that hasn't
+ * been called, the number of hardware threads is returned.
+ */
+size_t get_nthreads(void);
+
 } // close namespace pulsar
 
 #endif
@@ -16,6 +16,7 @@ void export_parallel(pybind11::module & m)
     m.def("parallel_initialize", parallel_initialize);
     m.def("get_proc_id", get_proc_id);
     m.def("get_nproc", get_nproc);
+    m.def("get_nthreads", get_nthreads);
 }
 
 } // close namespace pulsar
@@ -21,6 +21,68 @@ namespace lut {
 }
 
 
+namespace {
+
+// Builds the tables in the same ordering as generate_ordering.py
+constexpr detail::AOOrderingTables make_ao_ordering_tables_(void)
+{
+    detail::AOOrderingTables ret{};
+
+    size_t n = 0;
+    for(int am = 0; am <= PULSAR_MAX_AO_ORDERING_AM; am++)
+        for(int i = am; i >= 0; i--)
+            for(int k = 0; k <= am-i; k++)
+                ret.cartesian[n++] = IJK{{static_cast<uint8_t>(i),
+                                          static_cast<uint8_t>(am-i-k),
+                                          static_cast<uint8_t>(k)}};
+
+    n = 0;
+    for(int am = 0; am <= PULSAR_MAX_AO_ORDERING_AM; am++)
+        for(int m = -am; m <= am; m++)
+            ret.spherical[n++] = static_cast<int8_t>(m);
+
+    return ret;
+}
+
+
+// Checks that the unchecked index functions invert the tables
+constexpr bool ao_ordering_tables_consistent_(const detail::AOOrderingTables & tables)
+{
+    for(int am = 0; am <= PULSAR_MAX_AO_ORDERING_AM; am++)
+    {
+        const size_t cartoff = detail::cartesian_table_offset(am);
+        for(size_t n = 0; n < static_cast<size_t>(n_cartesian_gaussian_(am)); n++)
+            if(cartesian_index_unchecked(am, tables.cartesian[cartoff+n]) != n ||
+               cartesian_index_unchecked(-am, tables.cartesian[cartoff+n]) != cartoff+n)
+                return false;
+
+        const size_t sphoff = detail::spherical_table_offset(am);
+        for(size_t n = 0; n < static_cast<size_t>(n_spherical_gaussian_(am)); n++)
+            if(spherical_index_unchecked(am, tables.spherical[sphoff+n]) != n)
+                return false;
+    }
+    return true;
+}
+
+static_assert(ao_ordering_tables_consistent_(make_ao_ordering_tables_()),
+              "AO ordering tables are inconsistent with the index functions");
+
+
+// Throws if there is no ordering data for an angular momentum
+void check_am_(int am)
+{
+    if(am < PULSAR_MIN_AO_ORDERING_AM || am > PULSAR_MAX_AO_ORDERING_AM)
+        throw PulsarException("Angular momentum out of range", "am", am);
+}
+
+} // close anonymous namespace
+
+
+namespace detail {
+    extern const AOOrderingTables ao_ordering_tables_ = make_ao_ordering_tables_();
+}
+
+
 
 const AOOrderingMaps & all_ao_orderings(void) noexcept
 {
@@ -32,10 +94,11 @@ const std::vector<int8_t> & spherical_ordering(int am)
 {
     const auto & order = all_ao_orderings().spherical_order;
 
-    if(!order.count(am))
+    const auto it = order.find(am);
+    if(it == order.end())
         throw PulsarException("Angular momentum out of range", "am", am);
 
-    return order.at(am);
+    return it->second;
 }
 
 
@@ -44,22 +107,25 @@ const std::vector<IJK> & cartesian_ordering(int am)
 {
     const auto & order = all_ao_orderings().cartesian_order;
 
-    if(!order.count(am))
+    const auto it = order.find(am);
+    if(it == order.end())
         throw PulsarException("Angular momentum out of range", "am", am);
 
-    return order.at(am);
+    return it->second;
 }
 
 
 size_t cartesian_index(int am, IJK ijk)
 {
-    const auto & ijkvec = cartesian_ordering(am);
-    const auto it = std::find(ijkvec.begin(), ijkvec.end(), ijk);
-    if(it == ijkvec.end())
+    check_am_(am);
+
+    // For combined am, any of the included am
+    const int sum = ijk[0] + ijk[1] + ijk[2];
+    if((am >= 0 && sum != am) || (am < 0 && sum > -am))
         throw PulsarException("Value of IJK not found for this am", "am", am,
                                "i", ijk[0], "j", ijk[1], "k", ijk[2]);
-    else
-        return std::distance(ijkvec.begin(), it);
+
+    return cartesian_index_unchecked(am, ijk);
 }
 
 
@@ -90,13 +156,13 @@ size_t full_spherical_index(int am, int m)
 
 size_t spherical_index(int am, int m)
 {
-    const auto & svec = spherical_ordering(am);
-    const auto it = std::find(svec.begin(), svec.end(), m);
-    if(it == svec.end())
+    check_am_(am);
+
+    if(std::abs(m) > std::abs(am))
         throw PulsarException("Value of m not found for this am", "am", am,
                                "m", m);
-    else
-        return std::distance(svec.begin(), it);
+
+    return spherical_index_unchecked(am, m);
 }
 
 
@@ -7,6 +7,7 @@
 #ifndef PULSAR_GUARD_SYSTEM__AOORDERING_HPP_
 #define PULSAR_GUARD_SYSTEM__AOORDERING_HPP_
 
+#include <array>
 #include <map>
 #include <cstdint>
 #include "pulsar/math/Reorder.hpp"
@@ -45,6 +46,46 @@ typedef std::map<ShellType, AMReorderMap> BSReorderMap;
 
 
 
+//! Largest angular momentum with ordering data
+#define PULSAR_MAX_AO_ORDERING_AM 20
+
+//! Most negative (combined) angular momentum with ordering data
+#define PULSAR_MIN_AO_ORDERING_AM (-4)
+
+
+namespace detail {
+
+/*! \brief Flat tables of the pulsar ordering of all gaussians
+ *         with am in [0, PULSAR_MAX_AO_ORDERING_AM]
+ *
+ * The orderings for each am follow each other, so the beginning
+ * of the table is also the ordering for combined am.
+ */
+struct AOOrderingTables
+{
+    IJK cartesian[(PULSAR_MAX_AO_ORDERING_AM+1)*(PULSAR_MAX_AO_ORDERING_AM+2)*
+                  (PULSAR_MAX_AO_ORDERING_AM+3)/6];
+    int8_t spherical[(PULSAR_MAX_AO_ORDERING_AM+1)*(PULSAR_MAX_AO_ORDERING_AM+1)];
+};
+
+extern const AOOrderingTables ao_ordering_tables_;
+
+//! Position of the ordering for \p am in AOOrderingTables::cartesian
+constexpr size_t cartesian_table_offset(int am) noexcept
+{
+    return (am > 0) ? static_cast<size_t>(am*(am+1)*(am+2)/6) : 0;
+}
+
+//! Position of the ordering for \p am in AOOrderingTables::spherical
+constexpr size_t spherical_table_offset(int am) noexcept
+{
+    return (am > 0) ? static_cast<size_t>(am*am) : 0;
+}
+
+} // close namespace detail
+
+
+
 /*! \brief Obtain the ordering in pulsar for all
  *         available angular momenta */
 const AOOrderingMaps & all_ao_orderings(void) noexcept;
@@ -68,6 +109,69 @@ const std::vector<int8_t> & spherical_ordering(int am);
 const std::vector<IJK> & cartesian_ordering(int am);
 
 
+/*! \brief Obtain the ordering in pulsar of m_l for gaussians of
+ *         a given angular momentum, without any checks
+ *
+ * Same as spherical_ordering(), but returns a pointer to the
+ * n_spherical_gaussian(am) values.
+ *
+ * \warning \p am must be in the range
+ *          [PULSAR_MIN_AO_ORDERING_AM, PULSAR_MAX_AO_ORDERING_AM]
+ */
+inline const int8_t * spherical_ordering_unchecked(int am) noexcept
+{
+    return detail::ao_ordering_tables_.spherical + detail::spherical_table_offset(am);
+}
+
+
+/*! \brief Obtain the ordering in pulsar of cartesian gaussians for
+ *         a given angular momentum, without any checks
+ *
+ * Same as cartesian_ordering(), but returns a pointer to the
+ * n_cartesian_gaussian(am) values.
+ *
+ * \warning \p am must be in the range
+ *          [PULSAR_MIN_AO_ORDERING_AM, PULSAR_MAX_AO_ORDERING_AM]
+ */
+inline const IJK * cartesian_ordering_unchecked(int am) noexcept
+{
+    return detail::ao_ordering_tables_.cartesian + detail::cartesian_table_offset(am);
+}
+
+
+/*! \brief Get the index of a cartesian gaussian basis function
+ *         in pulsar ordering, without any checks
+ *
+ * Same as cartesian_index(), for use in inner loops.
+ *
+ * \warning \p ijk must exist for \p am
+ */
+constexpr size_t cartesian_index_unchecked(int am, const IJK & ijk) noexcept
+{
+    // For a single am, functions are ordered by decreasing i,
+    // then by increasing k
+    return (am < 0 ? detail::cartesian_table_offset(ijk[0]+ijk[1]+ijk[2]) : 0)
+           + static_cast<size_t>((ijk[1]+ijk[2])*(ijk[1]+ijk[2]+1)/2 + ijk[2]);
+}
+
+
+/*! \brief Get the index of a spherical gaussian basis function
+ *         in pulsar ordering, without any checks
+ *
+ * Same as spherical_index(), for use in inner loops. For combined am,
+ * this is the index of \p m in the lowest am it belongs to.
+ *
+ * \warning \p m must exist for \p am
+ */
+constexpr size_t spherical_index_unchecked(int am, int m) noexcept
+{
+    // For a single am, m goes from -am to am
+    return (am < 0) ? detail::spherical_table_offset(m < 0 ? -m : m) +
+                      static_cast<size_t>((m < 0 ? -m : m) + m)
+                    : static_cast<size_t>(am + m);
+}
+
+
 /*! \brief Get the index of a cartesian gaussian basis function
  *         in pulsar ordering
  *
@@ -0,0 +1,323 @@
+/*! \file
+ *
+ * \brief Precomputed reordering of AO basis functions (source)
+ */
+
+
+#include <cstring>
+#include <exception>
+#include <thread>
+#include "pulsar/system/AOReorderPlan.hpp"
+#include "pulsar/system/BasisSet.hpp"
+#include "pulsar/parallel/Parallel.hpp"
+#include "pulsar/exception/PulsarException.hpp"
+
+
+namespace pulsar{
+
+namespace {
+
+// Blocks smaller than this (in elements) are reordered by a single thread
+const size_t min_parallel_elements_ = 65536;
+
+// In-place reordering with a width smaller than this gathers whole
+// blocks through a buffer rather than following cycles
+const size_t min_cycle_width_ = 16;
+
+
+/* Calls func(begin, end, buffer) on contiguous ranges of [0, nitems)
+ * from up to nthreads threads. Each thread has its own buffer of
+ * bufsize elements.
+ */
+template<typename Func>
+void parallel_for_(size_t nthreads, size_t nitems, size_t nelements,
+                   size_t bufsize, Func func)
+{
+    if(nthreads == 0)
+        nthreads = get_nthreads();
+    if(nelements < min_parallel_elements_)
+        nthreads = 1;
+    nthreads = std::max<size_t>(1, std::min(nthreads, nitems));
+
+    std::vector<std::exception_ptr> errors(nthreads);
+
+    auto worker = [&](size_t t)
+    {
+        try {
+            std::vector<double> buffer(bufsize);
+            const size_t begin = (nitems * t) / nthreads;
+            const size_t end = (nitems * (t+1)) / nthreads;
+            func(begin, end, buffer.data());
+        }
+        catch(...)
+        {
+            errors[t] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t t = 1; t < nthreads; t++)
+        threads.emplace_back(worker, t);
+    worker(0);
+    for(auto & th : threads)
+        th.join();
+
+    for(const auto & err : errors)
+        if(err)
+            std::rethrow_exception(err);
+}
+
+
+// Copies n elements. Most runs in AO reorderings are only a few
+// elements long, which are faster to copy directly than with memcpy.
+inline void copy_run_(double * RESTRICT dest, const double * RESTRICT src, size_t n) noexcept
+{
+    if(n < 8)
+        for(size_t i = 0; i < n; i++)
+            dest[i] = src[i];
+    else
+        std::memcpy(dest, src, n * sizeof(double));
+}
+
+} // close anonymous namespace
+
+
+
+AOReorderPlan::AOReorderPlan(std::vector<size_t> neworder)
+    : order_(std::move(neworder))
+{
+    make_plan_();
+}
+
+
+AOReorderPlan::AOReorderPlan(const BasisSet & bs, const BSReorderMap & bm)
+    : order_(make_ao_basis_ordering(bs, bm))
+{
+    make_plan_();
+}
+
+
+void AOReorderPlan::make_plan_(void)
+{
+    const size_t n = order_.size();
+
+    std::vector<bool> seen(n, false);
+    for(size_t i = 0; i < n; i++)
+    {
+        if(order_[i] >= n || seen[order_[i]])
+            throw PulsarException("Ordering is not a permutation",
+                                  "position", i, "index", order_[i], "size", n);
+        seen[order_[i]] = true;
+    }
+
+    // Runs of consecutive source indices
+    for(size_t i = 0; i < n; )
+    {
+        size_t len = 1;
+        while(i + len < n && order_[i+len] == order_[i] + len)
+            len++;
+        runs_.push_back({i, order_[i], len});
+        i += len;
+    }
+
+    // Cycles, not including elements that stay in place
+    std::vector<bool> visited(n, false);
+    cycle_start_.push_back(0);
+    for(size_t i = 0; i < n; i++)
+    {
+        if(visited[i] || order_[i] == i)
+            continue;
+
+        for(size_t pos = i; !visited[pos]; pos = order_[pos])
+        {
+            visited[pos] = true;
+            cycle_pos_.push_back(pos);
+        }
+        cycle_start_.push_back(cycle_pos_.size());
+    }
+}
+
+
+void AOReorderPlan::apply(const double * src, double * dest,
+                          size_t width, size_t niter, size_t nthreads) const
+{
+    const size_t n = size();
+    const size_t nrun = n_runs();
+
+    parallel_for_(nthreads, niter*nrun, niter*n*width, 0,
+    [&](size_t begin, size_t end, double *)
+    {
+        for(size_t item = begin; item < end; item++)
+        {
+            const size_t offset = (item / nrun) * n * width;
+            const Run & run = runs_[item % nrun];
+            copy_run_(dest + offset + run.dest*width,
+                      src + offset + run.src*width,
+                      run.length * width);
+        }
+    });
+}
+
+
+void AOReorderPlan::apply_in_place(double * data, size_t width, size_t niter,
+                                   size_t nthreads) const
+{
+    if(is_identity())
+        return;
+
+    const size_t n = size();
+    const size_t block = n * width;
+
+    if(width < min_cycle_width_)
+    {
+        // Gather each block into a buffer, then copy it back
+        parallel_for_(nthreads, niter, niter*block, block,
+        [&](size_t begin, size_t end, double * buffer)
+        {
+            for(size_t it = begin; it < end; it++)
+            {
+                double * ptr = data + it*block;
+                for(const Run & run : runs_)
+                    copy_run_(buffer + run.dest*width, ptr + run.src*width,
+                              run.length * width);
+                std::memcpy(ptr, buffer, block * sizeof(double));
+            }
+        });
+        return;
+    }
+
+    // Follow each cycle, moving width elements at a time
+    const size_t ncycle = n_cycles();
+    const size_t bytes = width * sizeof(double);
+
+    parallel_for_(nthreads, niter*ncycle, niter*block, width,
+    [&](size_t begin, size_t end, double * buffer)
+    {
+        for(size_t item = begin; item < end; item++)
+        {
+            double * ptr = data + (item / ncycle) * block;
+            const size_t c = item % ncycle;
+            const size_t * pos = cycle_pos_.data() + cycle_start_[c];
+            const size_t len = cycle_start_[c+1] - cycle_start_[c];
+
+            std::memcpy(buffer, ptr + pos[0]*width, bytes);
+            for(size_t i = 0; i+1 < len; i++)
+                std::memcpy(ptr + pos[i]*width, ptr + pos[i+1]*width, bytes);
+            std::memcpy(ptr + pos[len-1]*width, buffer, bytes);
+        }
+    });
+}
+
+
+
+std::shared_ptr<const AOReorderPlan>
+get_ao_reorder_plan(CacheData & cache, const BasisSet & bs, const BSReorderMap & bm)
+{
+    std::string key = "AOReorderPlan:" + bphash::hash_to_string(bs.my_hash());
+    for(const auto & type : bm)
+    {
+        key += std::string(":") + ShellTypeString(type.first);
+        for(const auto & am : type.second)
+        {
+            key += "/" + std::to_string(am.first) + "=";
+            for(size_t idx : am.second)
+                key += std::to_string(idx) + ",";
+        }
+    }
+
+    return cache.get_or_compute(key, CacheData::NoPolicy,
+                                [&](void)
+                                {
+                                    return AOReorderPlan(bs, bm);
+                                });
+}
+
+
+
+template<size_t N>
+void reorder_tensor(const std::array<std::reference_wrapper<const AOReorderPlan>, N> & plans,
+                    const double * src, double * dest, size_t nthreads)
+{
+    // strides[d] is the distance between consecutive values of index d
+    std::array<size_t, N> dims, strides;
+    for(size_t d = 0; d < N; d++)
+        dims[d] = plans[d].get().size();
+    strides[N-1] = 1;
+    for(size_t d = N-1; d > 0; d--)
+        strides[d-1] = strides[d] * dims[d];
+
+    const size_t nlast = dims[N-1];
+    const size_t nrows = (nlast == 0) ? 0 : strides[0] * dims[0] / nlast;
+    const auto & runs = plans[N-1].get().runs();
+
+    // Each row (all values of the last index) of the destination is
+    // gathered from a row of the source
+    parallel_for_(nthreads, nrows, nrows*nlast, 0,
+    [&](size_t begin, size_t end, double *)
+    {
+        // Indices (other than the last) of row 'begin'
+        std::array<size_t, N> idx;
+        idx[N-1] = 0;
+        for(size_t d = 0, rem = begin; d+1 < N; d++)
+        {
+            const size_t rowstride = strides[d] / nlast;
+            idx[d] = rem / rowstride;
+            rem %= rowstride;
+        }
+
+        for(size_t row = begin; row < end; row++)
+        {
+            size_t srcoffset = 0;
+            for(size_t d = 0; d+1 < N; d++)
+                srcoffset += plans[d].get().ordering()[idx[d]] * strides[d];
+
+            double * destrow = dest + row*nlast;
+            for(const auto & run : runs)
+                copy_run_(destrow + run.dest, src + srcoffset + run.src, run.length);
+
+            // next row
+            for(size_t d = N-1; d > 0; d--)
+            {
+                if(++idx[d-1] < dims[d-1])
+                    break;
+                idx[d-1] = 0;
+            }
+        }
+    });
+}
+
+
+template<size_t N>
+void reorder_tensor_in_place(const std::array<std::reference_wrapper<const AOReorderPlan>, N> & plans,
+                             double * data, size_t nthreads)
+{
+    // Each index is reordered separately. Elements before index
+    // d are treated as iterations, and those after it as the width.
+    for(size_t d = 0; d < N; d++)
+    {
+        size_t niter = 1, width = 1;
+        for(size_t i = 0; i < d; i++)
+            niter *= plans[i].get().size();
+        for(size_t i = d+1; i < N; i++)
+            width *= plans[i].get().size();
+
+        plans[d].get().apply_in_place(data, width, niter, nthreads);
+    }
+}
+
+
+template void reorder_tensor<2>(const std::array<std::reference_wrapper<const AOReorderPlan>, 2> &,
+                                const double *, double *, size_t);
+template void reorder_tensor<3>(const std::array<std::reference_wrapper<const AOReorderPlan>, 3> &,
+                                const double *, double *, size_t);
+template void reorder_tensor<4>(const std::array<std::reference_wrapper<const AOReorderPlan>, 4> &,
+                                const double *, double *, size_t);
+
+template void reorder_tensor_in_place<2>(const std::array<std::reference_wrapper<const AOReorderPlan>, 2> &,
+                                         double *, size_t);
+template void reorder_tensor_in_place<3>(const std::array<std::reference_wrapper<const AOReorderPlan>, 3> &,
+                                         double *, size_t);
+template void reorder_tensor_in_place<4>(const std::array<std::reference_wrapper<const AOReorderPlan>, 4> &,
+                                         double *, size_t);
+
+} // close namespace pulsar
@@ -0,0 +1,182 @@
+/*! \file
+ *
+ * \brief Precomputed reordering of AO basis functions (header)
+ */
+
+
+#ifndef PULSAR_GUARD_SYSTEM__AOREORDERPLAN_HPP_
+#define PULSAR_GUARD_SYSTEM__AOREORDERPLAN_HPP_
+
+#include <array>
+#include <functional>
+#include <memory>
+#include "pulsar/system/AOOrdering.hpp"
+#include "pulsar/datastore/CacheData.hpp"
+
+
+namespace pulsar{
+
+/*! \brief A reordering of basis functions, prepared for
+ *         reordering large blocks of data
+ *
+ * The ordering has the same meaning as for reorder_block (element
+ * \p i of the destination is element ordering()[i] of the source).
+ * On construction, it is split into runs of consecutive indices,
+ * which are copied with a single memcpy, and into cycles, which
+ * are used for reordering in place.
+ *
+ * AO reorderings only shuffle functions within a shell, so most
+ * of the functions (s shells, and unchanged functions of other
+ * shells) end up in long runs.
+ *
+ * Data is reordered with up to \p nthreads threads. If \p nthreads
+ * is zero, get_nthreads() is used.
+ */
+class AOReorderPlan
+{
+    public:
+        //! Consecutive elements copied together
+        struct Run
+        {
+            size_t dest;    //!< Start of the run in the destination
+            size_t src;     //!< Start of the run in the source
+            size_t length;  //!< Number of elements in the run
+        };
+
+
+        /*! \brief Create a plan from an ordering (see make_ordering)
+         *
+         * \throw pulsar::PulsarException if \p neworder is not
+         *        a permutation of [0, neworder.size())
+         */
+        explicit AOReorderPlan(std::vector<size_t> neworder);
+
+
+        /*! \brief Create a plan for all AOs of a basis set
+         *
+         * \throw pulsar::PulsarException under the same conditions as
+         *        make_ao_basis_ordering
+         */
+        AOReorderPlan(const BasisSet & bs, const BSReorderMap & bm);
+
+
+        //! Number of elements being reordered
+        size_t size(void) const noexcept { return order_.size(); }
+
+        //! The full ordering
+        const std::vector<size_t> & ordering(void) const noexcept { return order_; }
+
+        //! Runs of consecutive elements, in order of the destination
+        const std::vector<Run> & runs(void) const noexcept { return runs_; }
+
+        //! Number of runs of consecutive elements
+        size_t n_runs(void) const noexcept { return runs_.size(); }
+
+        //! Number of cycles (not including elements that don't move)
+        size_t n_cycles(void) const noexcept { return cycle_start_.size() - 1; }
+
+        //! True if no elements are moved
+        bool is_identity(void) const noexcept { return n_cycles() == 0; }
+
+        //! Estimate of the memory used by the plan (in bytes)
+        size_t memory_size(void) const noexcept
+        {
+            return sizeof(*this) + runs_.capacity() * sizeof(Run)
+                 + (order_.capacity() + cycle_start_.capacity() + cycle_pos_.capacity()) * sizeof(size_t);
+        }
+
+
+        /*! \brief Reorders a block of data
+         *
+         * Same as reorder_block, with each run of \p width elements
+         * copied at once.
+         *
+         * \warning \p src and \p dest should not be aliased
+         */
+        void apply(const double * src, double * dest,
+                   size_t width, size_t niter, size_t nthreads = 0) const;
+
+
+        /*! \brief Reorders a block of data in place
+         *
+         * Same as apply(), but with the result written over \p data.
+         */
+        void apply_in_place(double * data, size_t width, size_t niter,
+                            size_t nthreads = 0) const;
+
+    private:
+        std::vector<size_t> order_;
+        std::vector<Run> runs_;
+
+        // Cycles of the permutation, stored as in CSR. Cycle n
+        // is in [cycle_start_[n], cycle_start_[n+1])
+        std::vector<size_t> cycle_start_;
+        std::vector<size_t> cycle_pos_;
+
+        void make_plan_(void);
+};
+
+
+/*! \brief Obtain the plan for all AOs of a basis set, using a cache
+ *
+ * The plan is created the first time it is requested, and is
+ * shared by everything using the same \p cache afterwards (see
+ * ModuleBase::shared_cache()). Entries are keyed by the hash
+ * of the basis set and the contents of \p bm.
+ */
+std::shared_ptr<const AOReorderPlan>
+get_ao_reorder_plan(CacheData & cache, const BasisSet & bs, const BSReorderMap & bm);
+
+
+/*! \brief Reorders each index of a row-major tensor
+ *
+ * Element (i, j, ...) of \p dest is element
+ * (plans[0].ordering()[i], plans[1].ordering()[j], ...) of \p src. The
+ * dimensions of the tensor are the sizes of the plans.
+ *
+ * All indices are reordered in a single pass over the data.
+ *
+ * \warning \p src and \p dest should not be aliased
+ *
+ * Instantiated for N = 2, 3, and 4.
+ */
+template<size_t N>
+void reorder_tensor(const std::array<std::reference_wrapper<const AOReorderPlan>, N> & plans,
+                    const double * src, double * dest, size_t nthreads = 0);
+
+
+/*! \brief Reorders each index of a row-major tensor in place
+ *
+ * Same as reorder_tensor, but with the result written over \p data.
+ * Each index is reordered in turn, using cycles of blocks for
+ * all but the last index.
+ *
+ * Instantiated for N = 2, 3, and 4.
+ */
+template<size_t N>
+void reorder_tensor_in_place(const std::array<std::reference_wrapper<const AOReorderPlan>, N> & plans,
+                             double * data, size_t nthreads = 0);
+
+
+/*! \brief Reorders the rows and columns of a row-major matrix
+ *
+ * \warning \p src and \p dest should not be aliased
+ */
+inline void reorder_matrix(const AOReorderPlan & rows, const AOReorderPlan & cols,
+                           const double * src, double * dest, size_t nthreads = 0)
+{
+    reorder_tensor<2>({{std::cref(rows), std::cref(cols)}}, src, dest, nthreads);
+}
+
+
+//! Reorders the rows and columns of a row-major matrix in place
+inline void reorder_matrix_in_place(const AOReorderPlan & rows, const AOReorderPlan & cols,
+                                    double * data, size_t nthreads = 0)
+{
+    reorder_tensor_in_place<2>({{std::cref(rows), std::cref(cols)}}, data, nthreads);
+}
+
+} // close namespace pulsar
+
+
+#endif
@@ -18,93 +18,116 @@
 
 namespace pulsar{
 
+BasisSet::BasisSet(void)
+    : data_(std::make_shared<Data_>())
+{
+}
+
+
 BasisSet::BasisSet(size_t nshells, size_t nprim, size_t ncoef, size_t nxyz)
+    : data_(std::make_shared<Data_>())
 {
     allocate_(nshells, nprim, ncoef, nxyz);
 }
 
 
-BasisSet::BasisSet(const BasisSet & rhs)
-    : unique_shells_(rhs.unique_shells_),
-      storage_(rhs.storage_),
-      shellstart_(rhs.shellstart_),
-      max_nxyz_(rhs.max_nxyz_),
-      max_nalpha_(rhs.max_nalpha_),
-      max_ncoef_(rhs.max_ncoef_),
-      xyz_pos_(rhs.xyz_pos_),
-      alpha_pos_(rhs.alpha_pos_),
-      coef_pos_(rhs.coef_pos_)
+BasisSet::BasisSet(BasisSet && rhs)
+    : data_(std::move(rhs.data_))
+{
+    rhs.data_ = std::make_shared<Data_>();
+}
+
+
+BasisSet & BasisSet::operator=(BasisSet && rhs)
+{
+    if(this != &rhs)
+    {
+        data_ = std::move(rhs.data_);
+        rhs.data_ = std::make_shared<Data_>();
+    }
+    return *this;
+}
+
+
+BasisSet::Data_::Data_(const Data_ & rhs)
+    : curid(rhs.curid),
+      unique_shells(rhs.unique_shells),
+      storage(rhs.storage),
+      shellstart(rhs.shellstart),
+      max_nxyz(rhs.max_nxyz),
+      max_nalpha(rhs.max_nalpha),
+      max_ncoef(rhs.max_ncoef),
+      xyz_pos(rhs.xyz_pos),
+      alpha_pos(rhs.alpha_pos),
+      coef_pos(rhs.coef_pos)
 {
     // storage has been copied   
-    // but all the pointers in shells_ would be incorrect
+    // but all the pointers in shells would be incorrect
     // so we have to rebuild them
-    ResetPointers_();
+    reset_pointers();
 
-    shells_.reserve(rhs.shells_.size());
-    for(const auto & it : rhs.shells_)
+    shells.reserve(rhs.shells.size());
+    for(const auto & it : rhs.shells)
     {
         // determine offsets for this shells xyz, alpha, and coefs
-        // They are currently relative to the beginning of rhs.storage_
-        ptrdiff_t alpha_offset = it.alpha_ptr()    - rhs.storage_.data();
-        ptrdiff_t coef_offset =  it.all_coefs_ptr() - rhs.storage_.data();
-        ptrdiff_t xyz_offset =   it.coords_ptr()   - rhs.storage_.data();
-        double * sbegin = storage_.data();
-        shells_.push_back(std::move(BasisSetShell(it, sbegin + alpha_offset,
-                                                  sbegin + coef_offset,
-                                                  sbegin + xyz_offset)));
+        // They are currently relative to the beginning of rhs.storage
+        ptrdiff_t alpha_offset = it.alpha_ptr()    - rhs.storage.data();
+        ptrdiff_t coef_offset =  it.all_coefs_ptr() - rhs.storage.data();
+        ptrdiff_t xyz_offset =   it.coords_ptr()   - rhs.storage.data();
+        double * sbegin = storage.data();
+        shells.push_back(std::move(BasisSetShell(it, sbegin + alpha_offset,
+                                                 sbegin + coef_offset,
+                                                 sbegin + xyz_offset)));
     }
 
     // double check
-    psr_assert(shells_ == rhs.shells_, "Developer error. Inconsistent basis set copying");
+    psr_assert(shells == rhs.shells, "Developer error. Inconsistent basis set copying");
 }
 
 
+void BasisSet::Data_::reset_pointers(void)
+{
+    xyz_base_ptr = storage.data();
+    alpha_base_ptr = xyz_base_ptr + max_nxyz;
+    coef_base_ptr = alpha_base_ptr + max_nalpha;
+}
+
+
+void BasisSet::detach_(void)
+{
+    if(!data_.unique())
+        data_ = std::make_shared<Data_>(*data_);
+}
+
 
 void BasisSet::allocate_(size_t /*nshells*/, size_t nprim, size_t ncoef, size_t nxyz)
 {
+    detach_();
+    Data_ & d = *data_;
+
     // totalstorage = number of doubles to store
     // nshells*3 = storage for xyz
     // nprim = storage for alpha
     // ncoef = storage for coefficients
     size_t totalstorage = nxyz + nprim + ncoef;
 
-    storage_.resize(totalstorage);
+    d.storage.resize(totalstorage);
 
-    max_nalpha_ = nprim;
-    max_ncoef_ = ncoef;
-    max_nxyz_ = nxyz;
+    d.max_nalpha = nprim;
+    d.max_ncoef = ncoef;
+    d.max_nxyz = nxyz;
 
-    ResetPointers_();
-    xyz_pos_ = alpha_pos_ = coef_pos_ = 0;
-}
-
-
-void BasisSet::ResetPointers_(void)
-{
-    xyz_base_ptr_ = storage_.data();
-    alpha_base_ptr_ = xyz_base_ptr_ + max_nxyz_;
-    coef_base_ptr_ = alpha_base_ptr_ + max_nalpha_;
+    d.reset_pointers();
+    d.xyz_pos = d.alpha_pos = d.coef_pos = 0;
 }
 
 
-BasisSet & BasisSet::operator=(const BasisSet & rhs)
-{
-    using std::swap;
-
-    if(this == &rhs)
-        return *this;
-
-    BasisSet tmp(rhs);
-    swap(*this, tmp);
-    return *this;
-}
-
 bool BasisSet::operator==(const BasisSet & rhs) const
 {
     // this will take into account if one is shrinkfit and the
     // other isn't. Will also be true even if storage is different
     // size, etc.
-    return shells_ == rhs.shells_;
+    return data_ == rhs.data_ || data_->shells == rhs.data_->shells;
 }
 
 bool BasisSet::operator!=(const BasisSet & rhs) const
@@ -120,114 +143,118 @@ bphash::HashValue BasisSet::my_hash(void) const
 
 void BasisSet::hash(bphash::Hasher & h) const
 {
-    h(shells_, unique_shells_, storage_);
+    h(data_->shells, data_->unique_shells, data_->storage);
 }
 
 
 std::set<ShellType> BasisSet::get_types(void) const
 {
     std::set<ShellType> types;
-    for(const auto & s : shells_)
+    for(const auto & s : data_->shells)
         types.insert(s.get_type());
     return types;
 }
 
 size_t BasisSet::shell_start(size_t i) const
 {
-    psr_assert(shells_.size() == shellstart_.size(),
+    psr_assert(data_->shells.size() == data_->shellstart.size(),
                               "Developer error. nshells != length of shellstart",
-                              "nshells", shells_.size(), "nshellstart", shellstart_.size());
+                              "nshells", data_->shells.size(), "nshellstart", data_->shellstart.size());
 
-    if(i < shellstart_.size())
-        return shellstart_[i];
+    if(i < data_->shellstart.size())
+        return data_->shellstart[i];
     else
         throw PulsarException("Shell index out of range",
-                                "index", i, "nshells", shellstart_.size());
+                                "index", i, "nshells", data_->shellstart.size());
 }
 
 
 void BasisSet::add_shell_(const BasisShellBase & bshell,
                          const CoordType & xyz)
 {
+    // don't modify data shared with other basis sets
+    detach_();
+    Data_ & d = *data_;
+
     // have the coordinates been added already?
-    auto it = std::find_if(shells_.begin(), shells_.end(),
+    auto it = std::find_if(d.shells.begin(), d.shells.end(),
                            [& xyz](const BasisSetShell & b)
                            { return b.get_coords() == xyz; });
 
     double * my_xyz = nullptr;
 
-    if(it != shells_.end())
+    if(it != d.shells.end())
         my_xyz = it->coords_ptr();
     else
     {
         // do we have enough room for xyz
-        if(xyz_pos_ + 3 > max_nxyz_)
+        if(d.xyz_pos + 3 > d.max_nxyz)
             throw PulsarException("Not enough storage for this shell: too many coordinates to store",
-                                    "max", max_nxyz_,
-                                    "current", xyz_pos_, "toadd", 1);
+                                    "max", d.max_nxyz,
+                                    "current", d.xyz_pos, "toadd", 1);
 
         // need a non-const temporary
-        my_xyz = xyz_base_ptr_ + xyz_pos_;
+        my_xyz = d.xyz_base_ptr + d.xyz_pos;
         std::copy(xyz.begin(), xyz.end(), my_xyz);
-        xyz_pos_ += 3; // advance where we are putting xyz coords
+        d.xyz_pos += 3; // advance where we are putting xyz coords
     }
      
 
 
     // Check to see if alpha & coefs has been added already
-    it = std::find_if(shells_.begin(), shells_.end(),
+    it = std::find_if(d.shells.begin(), d.shells.end(),
                       [& bshell](const BasisSetShell & b) { return b.base_compare_(bshell); });
 
 
-    if(it != shells_.end())
+    if(it != d.shells.end())
     {
         // equivalent shell already exists! Use the primitives,
         // but copy coords, etc from from bshell
-        shells_.push_back(BasisSetShell(bshell,
-                                        it->alpha_ptr(), it->all_coefs_ptr(),
-                                        my_xyz));
+        d.shells.push_back(BasisSetShell(bshell,
+                                         it->alpha_ptr(), it->all_coefs_ptr(),
+                                         my_xyz));
     }
     else
     {
-        if(alpha_pos_ + bshell.n_primitives() > max_nalpha_)
+        if(d.alpha_pos + bshell.n_primitives() > d.max_nalpha)
             throw PulsarException("Not enough storage for this shell: too may primitives",
-                                               "max", max_nalpha_,
-                                               "current", alpha_pos_, "toadd", bshell.n_primitives());  
+                                               "max", d.max_nalpha,
+                                               "current", d.alpha_pos, "toadd", bshell.n_primitives());  
 
-        if(coef_pos_ + bshell.n_coefficients() > max_ncoef_)
+        if(d.coef_pos + bshell.n_coefficients() > d.max_ncoef)
             throw PulsarException("Not enough storage for this shell: too many coefficients",
-                                               "max", max_ncoef_,
-                                               "current", coef_pos_, "toadd", bshell.n_coefficients());  
+                                               "max", d.max_ncoef,
+                                               "current", d.coef_pos, "toadd", bshell.n_coefficients());  
 
         // copy the primitives from bshell
         double const * const old_alphaptr = bshell.alpha_ptr();
         double const * const old_coefptr = bshell.all_coefs_ptr();
-        double * const my_alpha = alpha_base_ptr_ + alpha_pos_;
-        double * const my_coef = coef_base_ptr_ + coef_pos_;
+        double * const my_alpha = d.alpha_base_ptr + d.alpha_pos;
+        double * const my_coef = d.coef_base_ptr + d.coef_pos;
         std::copy(old_alphaptr, old_alphaptr+bshell.n_primitives(), my_alpha);
         std::copy(old_coefptr, old_coefptr+bshell.n_coefficients(), my_coef);
 
-        // unique_shells_ stores the index in the shells_ vector
-        // the index of this new shell will be shells_.size()
-        unique_shells_.push_back(shells_.size());
+        // unique_shells stores the index in the shells vector
+        // the index of this new shell will be shells.size()
+        d.unique_shells.push_back(d.shells.size());
 
         // actually add the shell
-        shells_.push_back(BasisSetShell(bshell, my_alpha, my_coef, my_xyz));
+        d.shells.push_back(BasisSetShell(bshell, my_alpha, my_coef, my_xyz));
 
 
         // advance these
-        alpha_pos_ += bshell.n_primitives();
-        coef_pos_ += bshell.n_coefficients();
+        d.alpha_pos += bshell.n_primitives();
+        d.coef_pos += bshell.n_coefficients();
     }
 
     // add the starting point
     // (which is the previous starting point plus the previous number of functions)
     // Don't forget, we added the new shell already, so we want the next to last
-    // shell in shells_
-    if(shellstart_.size() == 0)
-        shellstart_.push_back(0);
+    // shell in d.shells
+    if(d.shellstart.size() == 0)
+        d.shellstart.push_back(0);
     else
-        shellstart_.push_back(shellstart_.back() + shells_[shells_.size()-2].n_functions());
+        d.shellstart.push_back(d.shellstart.back() + d.shells[d.shells.size()-2].n_functions());
 }
 
 
@@ -249,36 +276,36 @@ void BasisSet::add_shell(const BasisShellInfo & bshell,
 
 size_t BasisSet::n_shell(void) const noexcept
 {
-    return shells_.size();
+    return data_->shells.size();
 }
 
 
 size_t BasisSet::n_unique_shell(void) const noexcept
 {
-    return unique_shells_.size();
+    return data_->unique_shells.size();
 }
 
 
 const BasisSetShell & BasisSet::shell(size_t i) const
 {
-    psr_assert(shells_.size() == shellstart_.size(),
+    psr_assert(data_->shells.size() == data_->shellstart.size(),
                               "Developer error. nshells != length of shellstart",
-                              "nshells", shells_.size(), "nshellstart", shellstart_.size());
+                              "nshells", data_->shells.size(), "nshellstart", data_->shellstart.size());
 
-    if(i < shells_.size())
-        return shells_[i];
+    if(i < data_->shells.size())
+        return data_->shells[i];
     else
         throw PulsarException("Shell index out of range",
-                                "index", i, "nshells", shells_.size());
+                                "index", i, "nshells", data_->shells.size());
 }
 
 const BasisSetShell & BasisSet::unique_shell(size_t i) const
 {
-    if(i < unique_shells_.size())
-        return shell(unique_shells_.at(i));
+    if(i < data_->unique_shells.size())
+        return shell(data_->unique_shells.at(i));
     else
         throw PulsarException("Unique shell index out of range",
-                                "index", i, "nshells", unique_shells_.size());
+                                "index", i, "nshells", data_->unique_shells.size());
 }
 
 BasisShellInfo BasisSet::shell_info(size_t i) const
@@ -354,18 +381,18 @@ size_t BasisSet::max_n_functions(void) const
 
 BasisSet::const_iterator BasisSet::begin(void) const
 {
-    return shells_.begin();
+    return data_->shells.begin();
 }
 
 BasisSet::const_iterator BasisSet::end(void) const
 {
-    return shells_.end();
+    return data_->shells.end();
 }
 
 /*size_t BasisSet::max_property(std::function<size_t(const BasisSetShell &)> func) const
 {
     size_t m = 0;
-    for(const auto & it : shells_)
+    for(const auto & it : data_->shells)
         m = std::max(m, func(it));
     return m;
 }*/
@@ -373,7 +400,7 @@ BasisSet::const_iterator BasisSet::end(void) const
 BasisSet BasisSet::transform(BasisSet::TransformerFunc Transformer) const
 {
     BasisSet bs(n_shell(), n_primitives(), n_coefficients(), 3*n_primitives());
-    for(const auto & shell : shells_)
+    for(const auto & shell : data_->shells)
     {
         BasisShellInfo bsi(shell);
         CoordType xyz = shell.get_coords();
@@ -387,30 +414,31 @@ BasisSet BasisSet::transform(BasisSet::TransformerFunc Transformer) const
 BasisSet BasisSet::shrink_fit(void) const
 {
     using std::swap;
+    const Data_ & d = *data_;
 
     // Be super safe
     // We check <= , since the *_pos variables represent where we would put
     // the next one. If pos_ == max_n, then it is full. If it is greater, then
     // one was already placed where it wasn't supposed to go...
-    psr_assert(xyz_pos_ <= max_nxyz_,
+    psr_assert(d.xyz_pos <= d.max_nxyz,
                               "Developer error. Too many xyz in basis set",
-                              "pos", xyz_pos_, "max", max_nxyz_);
-    psr_assert(alpha_pos_ <= max_nalpha_,
+                              "pos", d.xyz_pos, "max", d.max_nxyz);
+    psr_assert(d.alpha_pos <= d.max_nalpha,
                               "Developer error. Too many alpha in basis set",
-                              "pos", alpha_pos_, "max", max_nalpha_);
-    psr_assert(coef_pos_ <= max_ncoef_,
+                              "pos", d.alpha_pos, "max", d.max_nalpha);
+    psr_assert(d.coef_pos <= d.max_ncoef,
                               "Developer error. Too many coefficients in basis set",
-                              "pos", coef_pos_, "max", max_ncoef_);
+                              "pos", d.coef_pos, "max", d.max_ncoef);
 
 
     // We need to know the actual number of stored primitives and coefficients. These
     // are stored in *_pos_ variables.
-    // shells_.size() is self explanatory
-    BasisSet newbs(shells_.size(), alpha_pos_, coef_pos_, xyz_pos_);
+    // shells.size() is self explanatory
+    BasisSet newbs(d.shells.size(), d.alpha_pos, d.coef_pos, d.xyz_pos);
 
     // Just push through what we have
     // using the private functions. This will check for overflow, etc
-    for(const auto & it : shells_)
+    for(const auto & it : d.shells)
         newbs.add_shell_(it);
 
     return newbs;
@@ -420,15 +448,16 @@ BasisSet BasisSet::shrink_fit(void) const
 void BasisSet::print(std::ostream & os) const
 {
     using namespace pulsar;
+    const Data_ & d = *data_;
 
     size_t nshell = n_shell();
 
     print_output(os, "Basis set with %? shells\n", nshell);
     print_output(os, "NFunc = %? , max_am = %?\n", n_functions(), max_am());
     print_output(os, "MaxNFunction = %? , max_n_primitives = %?\n", max_n_functions(), max_n_primitives());
-    print_debug(os, "Space usage: XYZ: %?/%?  Alpha: %?/%?  Coef %?/%?\n", xyz_pos_, max_nxyz_,
-                                                                     alpha_pos_, max_nalpha_,
-                                                                     coef_pos_, max_ncoef_);
+    print_debug(os, "Space usage: XYZ: %?/%?  Alpha: %?/%?  Coef %?/%?\n", d.xyz_pos, d.max_nxyz,
+                                                                     d.alpha_pos, d.max_nalpha,
+                                                                     d.coef_pos, d.max_ncoef);
 
 
     for(size_t i = 0; i < nshell; i++)
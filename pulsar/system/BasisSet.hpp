@@ -8,6 +8,7 @@
 #define PULSAR_GUARD_SYSTEM__BASISSET_HPP_
 
 #include <functional>
+#include <memory>
 
 #include "pulsar/system/BasisSetShell.hpp"
 #include "pulsar/system/BasisShellInfo.hpp"
@@ -28,6 +29,10 @@ namespace pulsar{
  * Shell information that is actually stored is referred to as
  * the unique shells. That is, information from each unique
  * shell can be shared among several shells.
+ *
+ * Copies of a basis set are cheap, since they share the same
+ * (immutable) data. The data is only copied if a shared basis set
+ * is modified.
  */
 class BasisSet
 {
@@ -51,10 +56,19 @@ class BasisSet
          */
         BasisSet(size_t nshells, size_t nprim, size_t ncoef, size_t nxyz);
 
-        BasisSet(const BasisSet & rhs);
-        BasisSet & operator=(const BasisSet & rhs);
-        BasisSet(BasisSet && rhs)                  = default;
-        BasisSet & operator=(BasisSet && rhs)      = default;
+        /*! \brief Copies share data with \p rhs
+         *
+         * The data is only copied if one of them is modified
+         * later (via add_shell).
+         */
+        BasisSet(const BasisSet & rhs)             = default;
+        BasisSet & operator=(const BasisSet & rhs) = default;
+
+        //! Moves the data of \p rhs, leaving it an empty basis set
+        BasisSet(BasisSet && rhs);
+
+        //! \copydoc BasisSet(BasisSet &&)
+        BasisSet & operator=(BasisSet && rhs);
 
         bool operator==(const BasisSet & rhs) const;
         bool operator!=(const BasisSet & rhs) const;
@@ -222,28 +236,55 @@ class BasisSet
          * \warning NOT FOR USE OUTSIDE OF SERIALIZATION
          * \todo Replace if cereal fixes this
          */
-        BasisSet() = default;
+        BasisSet();
 
 
     private:
-        ID_t curid_;
-        std::vector<BasisSetShell> shells_;
-        std::vector<size_t> unique_shells_;
-        std::vector<double> storage_; // storage for alpha and coef
-        std::vector<size_t> shellstart_;
-
-        // for filling
-        size_t max_nxyz_;
-        size_t max_nalpha_;
-        size_t max_ncoef_;
-        double * xyz_base_ptr_;
-        double * alpha_base_ptr_;
-        double * coef_base_ptr_;
-
-        size_t xyz_pos_;
-        size_t alpha_pos_;
-        size_t coef_pos_;
+        /*! \brief The actual data of a basis set
+         *
+         * Shells contain pointers into \p storage, so copying this
+         * requires rebuilding the shells.
+         */
+        struct Data_
+        {
+            ID_t curid = 0;
+            std::vector<BasisSetShell> shells;
+            std::vector<size_t> unique_shells;
+            std::vector<double> storage; // storage for alpha and coef
+            std::vector<size_t> shellstart;
+
+            // for filling
+            size_t max_nxyz = 0;
+            size_t max_nalpha = 0;
+            size_t max_ncoef = 0;
+            double * xyz_base_ptr = nullptr;
+            double * alpha_base_ptr = nullptr;
+            double * coef_base_ptr = nullptr;
+
+            size_t xyz_pos = 0;
+            size_t alpha_pos = 0;
+            size_t coef_pos = 0;
+
+            Data_() = default;
+            Data_(const Data_ & rhs);
+            Data_ & operator=(const Data_ & rhs) = delete;
+
+            /*! \brief Set the internal pointers to the proper locations */
+            void reset_pointers(void);
+        };
+
+        /*! \brief Data for this basis set
+         *
+         * Copies of a basis set share the same data. It is only
+         * copied when a shared basis set is modified (copy-on-write).
+         */
+        std::shared_ptr<Data_> data_;
 
+        /*! \brief Make sure this basis set is the only owner of its data
+         *
+         * Called before modifying the data
+         */
+        void detach_(void);
 
         /// Adds a shell, copying the information from bshell
         void add_shell_(const BasisShellBase & bshell, const CoordType & xyz);
@@ -252,10 +293,6 @@ class BasisSet
         void add_shell_(const BasisSetShell & bshell);
 
 
-        /*! \brief Set the internal pointers to the proper locations */
-        void ResetPointers_(void);
-
-
         /*! \brief Allocate enough memory for the given information
          *
          * Also set up some pointers
@@ -272,19 +309,21 @@ class BasisSet
         template<class Archive>
         void save(Archive & ar) const
         {
+            const Data_ & d = *data_;
+
             // serialize the size info
-            ar(max_nxyz_, max_nalpha_, max_ncoef_);
-            ar(xyz_pos_, alpha_pos_, coef_pos_, curid_);
+            ar(d.max_nxyz, d.max_nalpha, d.max_ncoef);
+            ar(d.xyz_pos, d.alpha_pos, d.coef_pos, d.curid);
 
             // serialize the storage and shell info
-            ar(storage_, shells_, unique_shells_, shellstart_);
+            ar(d.storage, d.shells, d.unique_shells, d.shellstart);
 
             // offsets for xyz, alpha, and coef for each shell
             std::vector<ptrdiff_t> offsets;
-            offsets.reserve(3*shells_.size());
+            offsets.reserve(3*d.shells.size());
 
-            const uintptr_t base = reinterpret_cast<uintptr_t>(storage_.data());
-            for(const auto & it : shells_)
+            const uintptr_t base = reinterpret_cast<uintptr_t>(d.storage.data());
+            for(const auto & it : d.shells)
             {
                 offsets.push_back(reinterpret_cast<uintptr_t>(it.alpha_ptr())-base);
                 offsets.push_back(reinterpret_cast<uintptr_t>(it.all_coefs_ptr())-base);
@@ -297,22 +336,27 @@ class BasisSet
         template<class Archive>
         void load(Archive & ar)
         {
+            // Never load into data shared with another basis set
+            data_ = std::make_shared<Data_>();
+            Data_ & d = *data_;
+
             // load the size info
-            ar(max_nxyz_, max_nalpha_, max_ncoef_);
-            ar(xyz_pos_, alpha_pos_, coef_pos_, curid_);
+            ar(d.max_nxyz, d.max_nalpha, d.max_ncoef);
+            ar(d.xyz_pos, d.alpha_pos, d.coef_pos, d.curid);
 
             // storage and shell info
-            ar(storage_, shells_, unique_shells_, shellstart_);
+            ar(d.storage, d.shells, d.unique_shells, d.shellstart);
+            d.reset_pointers();
 
             // offsets for xyz, alpha, and coef for each shell
             std::vector<ptrdiff_t> offsets;
             ar(offsets);
 
             // now loop over the shells and set the pointers
-            const uintptr_t base = reinterpret_cast<uintptr_t>(storage_.data());
+            const uintptr_t base = reinterpret_cast<uintptr_t>(d.storage.data());
 
             size_t offsetidx = 0;
-            for(auto & it : shells_)
+            for(auto & it : d.shells)
             {
                 it.set_ptrs_(reinterpret_cast<double *>(base + offsets.at(offsetidx)),
                             reinterpret_cast<double *>(base + offsets.at(offsetidx+1)),
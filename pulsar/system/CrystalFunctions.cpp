@@ -13,6 +13,7 @@
 #include "pulsar/constants.h"
 #include "pulsar/system/Space.hpp"
 #include "pulsar/system/System.hpp"
+#include "pulsar/system/NeighborList.hpp"
 
 
 typedef std::array<double,3> Vector_t;
@@ -54,39 +55,37 @@ AtomSetUniverse MakeSuperCell(const AtomSetUniverse& DaU,
     return NewU;
 }
 
-//Gets all atoms attached to a given atom
-void Recursion(const Conn_t& Conns,const Atom& atomI,AtomSetUniverse& NewU){
-    for(const Atom& atomJ: Conns.at(atomI))
-        if(!NewU.count(atomJ)){
-            NewU.insert(atomJ);
-            Recursion(Conns,atomJ,NewU);
-        }
-}
-
-
 AtomSetUniverse CarveUC(const AtomSetUniverse& SC,
                         const  Vector_t& Sides,
                         double MinScale,
                         double MaxScale){
-    AtomSetUniverse NewU;
-    Conn_t Conns=get_connectivity(System(SC,true));
+    System SCSys(SC,true);
+    const std::vector<Atom> Atoms(SCSys.begin(),SCSys.end());
+    const NeighborList Bonds=get_bonded_neighbors(SCSys);
     std::array<double,3> Low,High;
     std::transform(Sides.begin(),Sides.end(),Low.begin(),
                    [MinScale](const double& a){return a*MinScale;});
     std::transform(Sides.begin(),Sides.end(),High.begin(),
                     [MaxScale](const double& a){return a*MaxScale;});
-    for(auto& ConnI:Conns){
-        if(NewU.count(ConnI.first))continue;
+
+    //Atoms in the cell, and everything bonded to them
+    std::vector<bool> InUC(Atoms.size(),false);
+    for(size_t i=0;i<Atoms.size();++i){
+        if(InUC[i])continue;
         bool InCell=true;
         for(size_t x: Range<0,3>())
-            if(ConnI.first[x]<Low[x]||ConnI.first[x]>High[x]){
+            if(Atoms[i][x]<Low[x]||Atoms[i][x]>High[x]){
                 InCell=false;
                 break;
             }
         if(!InCell) continue;
-        NewU.insert(ConnI.first);
-        Recursion(Conns,ConnI.first,NewU);
-    }            
+        for(size_t j:connected_atoms(Bonds,i))
+            InUC[j]=true;
+    }
+
+    AtomSetUniverse NewU;
+    for(size_t i=0;i<Atoms.size();++i)
+        if(InUC[i])NewU.insert(Atoms[i]);
     Vector_t Trans;
     std::transform(Sides.begin(),Sides.end(),Trans.begin(),
                    [](const double& a){return a*-1.0;});
@@ -118,11 +117,13 @@ AtomSetUniverse CleanUC(const AtomSetUniverse& UC,
     while(true){
         size_t size=NewUC.size();
         System CurrentUC(NewUC,true);
-        Conn_t Conns=get_connectivity(CurrentUC);
+        const NeighborList Bonds=get_bonded_neighbors(CurrentUC);
         while(ActiveAtoms.size()!=0){
+            //The atoms of CurrentUC are in the same order as NewUC
             const Atom& AtomI=*ActiveAtoms.begin();
             AtomSetUniverse MolU;
-            Recursion(Conns,AtomI,MolU);
+            for(size_t j:connected_atoms(Bonds,NewUC.idx(AtomI)))
+                MolU.insert(NewUC[j]);
             System Mol(MolU,true);
             Vector_t Idx;
             if(!CleanUCRecurse(MolU,Mol,NewUC,Sides,Idx,0)){
@@ -72,10 +72,10 @@ class GeneralShellIterator
         GeneralShellIterator(GeneralShellIterator &&) = default;
         GeneralShellIterator & operator=(GeneralShellIterator &&) = default;
 
-        template<int N>
+        template<int I>
         size_t n_general_contractionsShells(void) const noexcept
         {
-            return std::get<N>(ngen_);
+            return std::get<I>(ngen_);
         }
 
         size_t n_general_contractionsShells(int n) const ASSERTIONS_ONLY
@@ -101,10 +101,10 @@ class GeneralShellIterator
             return totalidx_;
         }
 
-        template<int N>
+        template<int I>
         size_t GeneralIdx(void) const noexcept
         {
-            return std::get<N>(genidx_);
+            return std::get<I>(genidx_);
         }
 
         size_t GeneralIdx(int n) const ASSERTIONS_ONLY
@@ -114,10 +114,10 @@ class GeneralShellIterator
             return genidx_[n];
         }
 
-        template<int N>
+        template<int I>
         int AM(void) const noexcept
         {
-            return std::get<N>(curam_);
+            return std::get<I>(curam_);
         }
 
         int AM(int n) const ASSERTIONS_ONLY
@@ -0,0 +1,264 @@
+/*! \file
+ *
+ * \brief Neighbor search for atoms in a system (source)
+ */
+
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "pulsar/system/NeighborList.hpp"
+#include "pulsar/system/System.hpp"
+#include "pulsar/exception/PulsarException.hpp"
+
+
+namespace pulsar{
+
+namespace {
+
+// The total number of cells is kept below this times the number
+// of atoms (plus a constant), so sparse systems don't use lots
+// of memory for empty cells
+const size_t max_cells_per_atom_ = 8;
+
+
+/* Calls pred(i, j, r2) for each pair of atoms i < j that are within
+ * cellsize of each other along every axis, where r2 is their squared
+ * distance. If pred returns true, the pair is added to the list.
+ */
+template<typename Pred>
+NeighborList build_neighbor_list_(const std::vector<std::array<double, 3>> & xyz,
+                                  double cellsize, Pred pred)
+{
+    const size_t natoms = xyz.size();
+    std::vector<size_t> offsets(natoms+1, 0);
+    if(natoms == 0 || !(cellsize > 0.0))
+        return NeighborList(std::move(offsets), {}, {});
+
+    // Bounding box and number of cells along each axis. Cells are
+    // made larger until there aren't too many of them.
+    std::array<double, 3> low = xyz[0], high = xyz[0];
+    for(const auto & x : xyz)
+        for(size_t d = 0; d < 3; d++)
+        {
+            low[d] = std::min(low[d], x[d]);
+            high[d] = std::max(high[d], x[d]);
+        }
+
+    const double maxcells = static_cast<double>(max_cells_per_atom_ * natoms + 64);
+    auto count_cells = [&](size_t d)
+    {
+        return std::floor((high[d] - low[d]) / cellsize) + 1.0;
+    };
+    while(count_cells(0) * count_cells(1) * count_cells(2) > maxcells)
+        cellsize *= 2.0;
+
+    std::array<size_t, 3> ncells;
+    size_t totalcells = 1;
+    for(size_t d = 0; d < 3; d++)
+    {
+        ncells[d] = static_cast<size_t>(count_cells(d));
+        totalcells *= ncells[d];
+    }
+
+    auto cell_of = [&](const std::array<double, 3> & x)
+    {
+        std::array<size_t, 3> c;
+        for(size_t d = 0; d < 3; d++)
+            c[d] = std::min(ncells[d] - 1, static_cast<size_t>((x[d] - low[d]) / cellsize));
+        return c;
+    };
+    auto cell_index = [&](const std::array<size_t, 3> & c)
+    {
+        return (c[0] * ncells[1] + c[1]) * ncells[2] + c[2];
+    };
+
+    // Atoms sorted by cell. The atoms in cell c are
+    // cellatoms[cellstart[c], cellstart[c+1])
+    std::vector<size_t> atomcell(natoms), cellstart(totalcells+1, 0), cellatoms(natoms);
+    for(size_t i = 0; i < natoms; i++)
+    {
+        atomcell[i] = cell_index(cell_of(xyz[i]));
+        cellstart[atomcell[i]+1]++;
+    }
+    for(size_t c = 0; c < totalcells; c++)
+        cellstart[c+1] += cellstart[c];
+    {
+        std::vector<size_t> fill(cellstart.begin(), cellstart.end() - 1);
+        for(size_t i = 0; i < natoms; i++)
+            cellatoms[fill[atomcell[i]]++] = i;
+    }
+
+    // Pairs (i, j) with j > i, in order of i, and then j
+    std::vector<std::pair<size_t, double>> candidates;
+    std::vector<size_t> pairfirst, pairsecond;
+    std::vector<double> pairdist;
+
+    for(size_t i = 0; i < natoms; i++)
+    {
+        candidates.clear();
+        const auto c = cell_of(xyz[i]);
+        for(size_t cx = (c[0] ? c[0]-1 : 0); cx <= std::min(c[0]+1, ncells[0]-1); cx++)
+        for(size_t cy = (c[1] ? c[1]-1 : 0); cy <= std::min(c[1]+1, ncells[1]-1); cy++)
+        for(size_t cz = (c[2] ? c[2]-1 : 0); cz <= std::min(c[2]+1, ncells[2]-1); cz++)
+        {
+            const size_t cell = cell_index({{cx, cy, cz}});
+            for(size_t n = cellstart[cell]; n < cellstart[cell+1]; n++)
+            {
+                const size_t j = cellatoms[n];
+                if(j <= i)
+                    continue;
+                const double dx = xyz[i][0] - xyz[j][0];
+                const double dy = xyz[i][1] - xyz[j][1];
+                const double dz = xyz[i][2] - xyz[j][2];
+                const double r2 = dx*dx + dy*dy + dz*dz;
+                if(pred(i, j, r2))
+                    candidates.emplace_back(j, std::sqrt(r2));
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+        for(const auto & it : candidates)
+        {
+            pairfirst.push_back(i);
+            pairsecond.push_back(it.first);
+            pairdist.push_back(it.second);
+            offsets[i+1]++;
+            offsets[it.first+1]++;
+        }
+    }
+
+    for(size_t i = 0; i < natoms; i++)
+        offsets[i+1] += offsets[i];
+
+    // Since pairs are in order of the first atom, each atom gets
+    // its lower-indexed neighbors before its higher-indexed ones,
+    // and each of those in increasing order
+    std::vector<size_t> neighbors(offsets.back());
+    std::vector<double> distances(offsets.back());
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t p = 0; p < pairfirst.size(); p++)
+    {
+        const size_t i = pairfirst[p], j = pairsecond[p];
+        neighbors[fill[i]] = j;
+        distances[fill[i]++] = pairdist[p];
+        neighbors[fill[j]] = i;
+        distances[fill[j]++] = pairdist[p];
+    }
+
+    return NeighborList(std::move(offsets), std::move(neighbors), std::move(distances));
+}
+
+
+std::vector<std::array<double, 3>> coordinates_(const System & sys)
+{
+    std::vector<std::array<double, 3>> ret;
+    ret.reserve(sys.size());
+    for(const Atom & atom : sys)
+        ret.push_back({{atom[0], atom[1], atom[2]}});
+    return ret;
+}
+
+} // close anonymous namespace
+
+
+
+NeighborList::NeighborList(std::vector<size_t> offsets,
+                           std::vector<size_t> neighbors,
+                           std::vector<double> distances)
+    : offsets_(std::move(offsets)),
+      neighbors_(std::move(neighbors)),
+      distances_(std::move(distances))
+{
+    if(offsets_.empty() || offsets_.back() != neighbors_.size() ||
+       neighbors_.size() != distances_.size())
+        throw PulsarException("Inconsistent sizes for a neighbor list",
+                              "noffsets", offsets_.size(),
+                              "nneighbors", neighbors_.size(),
+                              "ndistances", distances_.size());
+}
+
+
+bool NeighborList::are_neighbors(size_t i, size_t j) const
+{
+    const auto first = neighbors_.begin() + static_cast<std::ptrdiff_t>(offsets_.at(i));
+    const auto last = neighbors_.begin() + static_cast<std::ptrdiff_t>(offsets_.at(i+1));
+    return std::binary_search(first, last, j);
+}
+
+
+
+NeighborList get_neighbor_list(const System & sys, double cutoff)
+{
+    const double cutoff2 = cutoff * cutoff;
+    return build_neighbor_list_(coordinates_(sys), cutoff,
+                                [cutoff2](size_t, size_t, double r2)
+                                {
+                                    return r2 < cutoff2;
+                                });
+}
+
+
+NeighborList get_bonded_neighbors(const System & sys, double Tolerance)
+{
+    std::vector<double> radii;
+    radii.reserve(sys.size());
+    for(const Atom & atom : sys)
+        radii.push_back(Tolerance * atom.cov_radius);
+
+    const double maxradius = radii.empty() ? 0.0 : *std::max_element(radii.begin(), radii.end());
+    return build_neighbor_list_(coordinates_(sys), 2.0 * maxradius,
+                                [&radii](size_t i, size_t j, double r2)
+                                {
+                                    const double bond = radii[i] + radii[j];
+                                    return r2 < bond * bond;
+                                });
+}
+
+
+std::vector<double> get_distance_matrix(const System & sys)
+{
+    const auto xyz = coordinates_(sys);
+    const size_t natoms = xyz.size();
+
+    std::vector<double> ret(natoms * natoms, 0.0);
+    for(size_t i = 0; i < natoms; i++)
+    for(size_t j = 0; j < i; j++)
+    {
+        const double dx = xyz[i][0] - xyz[j][0];
+        const double dy = xyz[i][1] - xyz[j][1];
+        const double dz = xyz[i][2] - xyz[j][2];
+        ret[i*natoms+j] = ret[j*natoms+i] = std::sqrt(dx*dx + dy*dy + dz*dz);
+    }
+    return ret;
+}
+
+
+std::vector<size_t> connected_atoms(const NeighborList & nl, size_t i)
+{
+    std::vector<bool> visited(nl.size(), false);
+    std::vector<size_t> ret{i}, stack{i};
+    visited.at(i) = true;
+
+    const auto & offsets = nl.offsets();
+    const auto & neighbors = nl.neighbors();
+    while(!stack.empty())
+    {
+        const size_t atom = stack.back();
+        stack.pop_back();
+        for(size_t n = offsets[atom]; n < offsets[atom+1]; n++)
+        {
+            const size_t j = neighbors[n];
+            if(visited[j])
+                continue;
+            visited[j] = true;
+            ret.push_back(j);
+            stack.push_back(j);
+        }
+    }
+
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+} // close namespace pulsar
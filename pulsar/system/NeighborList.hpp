@@ -0,0 +1,117 @@
+/*! \file
+ *
+ * \brief Neighbor search for atoms in a system (header)
+ */
+
+
+#ifndef PULSAR_GUARD_SYSTEM__NEIGHBORLIST_HPP_
+#define PULSAR_GUARD_SYSTEM__NEIGHBORLIST_HPP_
+
+#include <vector>
+#include <cstddef>
+
+
+namespace pulsar{
+
+class System;
+
+
+/*! \brief Neighbors of each atom in a system, stored as in CSR
+ *
+ * Atoms are referred to by their position when iterating over the
+ * system (so atom \p i is the \p i -th atom of
+ * <tt>std::vector<Atom>(sys.begin(), sys.end())</tt>).
+ *
+ * The neighbors of atom \p i are in positions
+ * [offsets()[i], offsets()[i+1]) of neighbors() and distances(),
+ * in increasing order of their index. Each pair is stored twice,
+ * once for each atom.
+ */
+class NeighborList
+{
+    public:
+        NeighborList(void) = default;
+
+        /*! \brief Construct from the CSR arrays
+         *
+         * \p offsets has one more element than the number of atoms
+         */
+        NeighborList(std::vector<size_t> offsets,
+                     std::vector<size_t> neighbors,
+                     std::vector<double> distances);
+
+
+        //! Number of atoms
+        size_t size(void) const noexcept { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+
+        //! Number of pairs of neighbors (each counted once)
+        size_t n_pairs(void) const noexcept { return neighbors_.size() / 2; }
+
+        //! Number of neighbors of atom \p i
+        size_t n_neighbors(size_t i) const { return offsets_.at(i+1) - offsets_.at(i); }
+
+        //! Returns true if atoms \p i and \p j are neighbors
+        bool are_neighbors(size_t i, size_t j) const;
+
+        //! Start of each atom's neighbors, and then the total number of entries
+        const std::vector<size_t> & offsets(void) const noexcept { return offsets_; }
+
+        //! Indices of the neighbors of all atoms
+        const std::vector<size_t> & neighbors(void) const noexcept { return neighbors_; }
+
+        //! Distance to each entry of neighbors()
+        const std::vector<double> & distances(void) const noexcept { return distances_; }
+
+    private:
+        std::vector<size_t> offsets_;
+        std::vector<size_t> neighbors_;
+        std::vector<double> distances_;
+};
+
+
+/*! \relates System
+ *
+ * \brief Finds all pairs of atoms closer than \p cutoff
+ *
+ * Atoms are binned into cells with sides of at least \p cutoff,
+ * and only atoms in neighboring cells are compared, so the cost
+ * scales linearly with the number of atoms (for a given density).
+ */
+NeighborList get_neighbor_list(const System & sys, double cutoff);
+
+
+/*! \relates System
+ *
+ * \brief Finds all pairs of bonded atoms, using covalent radii
+ *
+ * Atoms are bonded if their distance is less than \p Tolerance times
+ * the sum of their covalent radii (as for get_connectivity). The
+ * cells are sized from the largest covalent radius.
+ */
+NeighborList get_bonded_neighbors(const System & sys, double Tolerance = 1.20);
+
+
+/*! \relates System
+ *
+ * \brief Returns the distance between each pair of atoms in \p sys
+ *
+ * The result is a row-major, symmetric, N by N matrix, with atoms
+ * indexed as in NeighborList. Its size grows as the square of the number
+ * of atoms (80 GB for 100,000 atoms), so this is only meant for small
+ * systems. For large systems, use get_neighbor_list(), which stores only
+ * the distances of the pairs within a cutoff (see NeighborList::distances()).
+ */
+std::vector<double> get_distance_matrix(const System & sys);
+
+
+/*! \relates NeighborList
+ *
+ * \brief Returns the atoms connected to atom \p i through any number
+ *        of neighbors, including \p i itself, in increasing order
+ */
+std::vector<size_t> connected_atoms(const NeighborList & nl, size_t i);
+
+} // close namespace pulsar
+
+
+#endif
@@ -0,0 +1,181 @@
+/*! \file
+ *
+ * \brief Precomputed data for pairs of shells (source)
+ */
+
+#include "pulsar/system/ShellPairList.hpp"
+#include "pulsar/modulebase/FourCenterIntegral.hpp"
+#include "pulsar/constants.h"
+
+#include <cmath>
+
+
+namespace {
+
+//! Memory used by the data of a vector
+template<typename T>
+size_t vector_bytes(const std::vector<T> & v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+} // close anonymous namespace
+
+
+namespace pulsar {
+
+ShellPairList::ShellPairList(const BasisSet & bs1, const BasisSet & bs2)
+    : symmetric_(bs1 == bs2), schwarz_(false)
+{
+    const size_t nshell1 = bs1.n_shell();
+    const size_t nshell2 = bs2.n_shell();
+
+    // reserve everything, so we don't reallocate
+    size_t npair = 0;
+    size_t nprimpair = 0;
+    for(size_t i = 0; i < nshell1; i++)
+    {
+        const size_t jmax = symmetric_ ? i+1 : nshell2;
+        for(size_t j = 0; j < jmax; j++)
+        {
+            npair++;
+            nprimpair += bs1.shell(i).n_primitives() * bs2.shell(j).n_primitives();
+        }
+    }
+
+    shell1_.reserve(npair);
+    shell2_.reserve(npair);
+    nfunctions_.reserve(npair);
+    prim_start_.reserve(npair+1);
+    bound_.reserve(npair);
+
+    for(auto v : {&alpha1_, &alpha2_, &p_, &mu_, &px_, &py_, &pz_, &kab_})
+        v->reserve(nprimpair);
+    prim1_.reserve(nprimpair);
+    prim2_.reserve(nprimpair);
+
+    for(size_t i = 0; i < nshell1; i++)
+    {
+        const BasisSetShell & sh1 = bs1.shell(i);
+        const CoordType A = sh1.get_coords();
+        const size_t jmax = symmetric_ ? i+1 : nshell2;
+
+        for(size_t j = 0; j < jmax; j++)
+        {
+            const BasisSetShell & sh2 = bs2.shell(j);
+            const CoordType B = sh2.get_coords();
+            const double AB2 = (A[0]-B[0])*(A[0]-B[0]) +
+                               (A[1]-B[1])*(A[1]-B[1]) +
+                               (A[2]-B[2])*(A[2]-B[2]);
+
+            shell1_.push_back(i);
+            shell2_.push_back(j);
+            nfunctions_.push_back(sh1.n_functions() * sh2.n_functions());
+            prim_start_.push_back(alpha1_.size());
+
+            // Estimate of the overlap of the shells, using
+            // the largest coefficient of each primitive
+            double estimate = 0.0;
+
+            for(size_t a = 0; a < sh1.n_primitives(); a++)
+            {
+                double ca = 0.0;
+                for(size_t n = 0; n < sh1.n_general_contractions(); n++)
+                    ca = std::max(ca, std::fabs(sh1.coef(n, a)));
+
+                for(size_t b = 0; b < sh2.n_primitives(); b++)
+                {
+                    double cb = 0.0;
+                    for(size_t n = 0; n < sh2.n_general_contractions(); n++)
+                        cb = std::max(cb, std::fabs(sh2.coef(n, b)));
+
+                    const double alpha = sh1.alpha(a);
+                    const double beta = sh2.alpha(b);
+                    const double p = alpha + beta;
+                    const double mu = alpha * beta / p;
+                    const double kab = std::exp(-mu * AB2);
+
+                    prim1_.push_back(static_cast<uint32_t>(a));
+                    prim2_.push_back(static_cast<uint32_t>(b));
+                    alpha1_.push_back(alpha);
+                    alpha2_.push_back(beta);
+                    p_.push_back(p);
+                    mu_.push_back(mu);
+                    px_.push_back((alpha*A[0] + beta*B[0])/p);
+                    py_.push_back((alpha*A[1] + beta*B[1])/p);
+                    pz_.push_back((alpha*A[2] + beta*B[2])/p);
+                    kab_.push_back(kab);
+
+                    estimate += ca * cb * kab * std::pow(PI/p, 1.5);
+                }
+            }
+
+            bound_.push_back(estimate);
+        }
+    }
+
+    prim_start_.push_back(alpha1_.size());
+}
+
+
+size_t ShellPairList::memory_size(void) const noexcept
+{
+    return sizeof(*this)
+         + vector_bytes(shell1_) + vector_bytes(shell2_) + vector_bytes(nfunctions_)
+         + vector_bytes(prim_start_) + vector_bytes(bound_)
+         + vector_bytes(prim1_) + vector_bytes(prim2_)
+         + vector_bytes(alpha1_) + vector_bytes(alpha2_) + vector_bytes(p_) + vector_bytes(mu_)
+         + vector_bytes(px_) + vector_bytes(py_) + vector_bytes(pz_) + vector_bytes(kab_);
+}
+
+
+void ShellPairList::compute_bounds(FourCenterIntegral & eri)
+{
+    const size_t ncomp = eri.n_components();
+    const size_t npair = n_shell_pairs();
+
+    for(size_t n = 0; n < npair; n++)
+    {
+        const uint64_t i = shell1_[n];
+        const uint64_t j = shell2_[n];
+        const double * ints = eri.calculate(i, j, i, j);
+
+        // only the diagonal elements (ab|ab) are needed
+        const size_t nij = nfunctions_[n];
+        double maxint = 0.0;
+        for(size_t c = 0; c < ncomp; c++)
+        {
+            const double * cints = ints + c*nij*nij;
+            for(size_t ab = 0; ab < nij; ab++)
+                maxint = std::max(maxint, std::fabs(cints[ab*nij + ab]));
+        }
+
+        bound_[n] = std::sqrt(maxint);
+    }
+
+    schwarz_ = true;
+}
+
+
+std::shared_ptr<const ShellPairList>
+get_shell_pair_list(CacheData & cache, unsigned int deriv, const Wavefunction & wfn,
+                    const BasisSet & bs1, const BasisSet & bs2,
+                    FourCenterIntegral & eri)
+{
+    const std::string key = "ShellPairList:" + bphash::hash_to_string(bs1.my_hash())
+                                       + ":" + bphash::hash_to_string(bs2.my_hash())
+                                       + ":" + eri.name() + "_v" + eri.version()
+                                       + ":" + bphash::hash_to_string(eri.options().my_hash())
+                                       + ":" + eri.my_hash(deriv, wfn, bs1, bs2, bs1, bs2);
+
+    return cache.get_or_compute(key, CacheData::NoPolicy,
+                                [&](void)
+                                {
+                                    ShellPairList spl(bs1, bs2);
+                                    spl.compute_bounds(eri);
+                                    return spl;
+                                });
+}
+
+} // close namespace pulsar
+
@@ -0,0 +1,270 @@
+/*! \file
+ *
+ * \brief Precomputed data for pairs of shells (header)
+ */
+
+
+#pragma once
+
+#include "pulsar/system/BasisSet.hpp"
+#include "pulsar/datastore/CacheData.hpp"
+
+#include <iterator>
+
+namespace pulsar {
+
+class FourCenterIntegral;
+class Wavefunction;
+
+
+/*! \brief Precomputed data for all pairs of shells of two basis sets
+ *
+ * Quantities needed by most integral codes (Gaussian product centers,
+ * exponent sums, prefactors) are computed once for every pair of
+ * primitives. They are stored as a structure of arrays, with the
+ * primitive pairs of shell pair \p n in the range
+ * [prim_start(n), prim_start(n+1)).
+ *
+ * If both basis sets are the same, only pairs with shell1 >= shell2
+ * are stored.
+ *
+ * Each shell pair also has a bound on the magnitude of its integrals.
+ * Initially, this is an estimate from the overlap of the primitives
+ * (ignoring angular momentum). After compute_bounds(), it is the
+ * Schwarz bound sqrt(max |(ab|ab)|).
+ */
+class ShellPairList
+{
+    public:
+        //! A pair of shells from the list
+        struct ShellPair
+        {
+            size_t index;     //!< Index of the pair in the list
+            uint64_t shell1;  //!< Shell index in the first basis set
+            uint64_t shell2;  //!< Shell index in the second basis set
+            double bound;     //!< Bound on the magnitude of the integrals
+        };
+
+
+        /*! \brief Iterates over the pairs with a bound above a threshold */
+        class const_iterator
+        {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef ShellPair value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const ShellPair * pointer;
+                typedef const ShellPair & reference;
+
+                const_iterator(const ShellPairList * list, size_t index, double threshold)
+                    : list_(list), threshold_(threshold)
+                {
+                    seek_(index);
+                }
+
+                reference operator*(void) const noexcept { return pair_; }
+                pointer operator->(void) const noexcept { return &pair_; }
+
+                const_iterator & operator++(void)
+                {
+                    seek_(pair_.index+1);
+                    return *this;
+                }
+
+                const_iterator operator++(int)
+                {
+                    const_iterator ret(*this);
+                    ++(*this);
+                    return ret;
+                }
+
+                bool operator==(const const_iterator & rhs) const noexcept
+                {
+                    return pair_.index == rhs.pair_.index;
+                }
+
+                bool operator!=(const const_iterator & rhs) const noexcept
+                {
+                    return !(*this == rhs);
+                }
+
+            private:
+                const ShellPairList * list_;
+                double threshold_;
+                ShellPair pair_;
+
+                //! Move to the first significant pair at or after \p index
+                void seek_(size_t index);
+        };
+
+
+        //! Pairs with a bound above a threshold (for range-based for loops)
+        struct SignificantRange
+        {
+            const_iterator first;
+            const_iterator last;
+
+            const_iterator begin(void) const { return first; }
+            const_iterator end(void) const { return last; }
+        };
+
+
+        /*! \brief Compute the data for all pairs of shells
+         *
+         * \param [in] bs1 Basis set for the first shell of the pairs
+         * \param [in] bs2 Basis set for the second shell of the pairs
+         */
+        ShellPairList(const BasisSet & bs1, const BasisSet & bs2);
+
+        ShellPairList(const ShellPairList &)             = default;
+        ShellPairList(ShellPairList &&)                  = default;
+        ShellPairList & operator=(const ShellPairList &) = default;
+        ShellPairList & operator=(ShellPairList &&)      = default;
+
+
+        /// Are both basis sets the same (so that only unique pairs are stored)?
+        bool is_symmetric(void) const noexcept { return symmetric_; }
+
+        /// Number of shell pairs stored
+        size_t n_shell_pairs(void) const noexcept { return shell1_.size(); }
+
+        /// Number of primitive pairs stored (for all shell pairs)
+        size_t n_primitive_pairs(void) const noexcept { return alpha1_.size(); }
+
+        /// Shell index (in the first basis set) of shell pair \p n
+        uint64_t shell1(size_t n) const { return shell1_.at(n); }
+
+        /// Shell index (in the second basis set) of shell pair \p n
+        uint64_t shell2(size_t n) const { return shell2_.at(n); }
+
+        /// Number of functions in shell pair \p n (product of the functions of each shell)
+        size_t n_functions(size_t n) const { return nfunctions_.at(n); }
+
+        /// Index of the first primitive pair of shell pair \p n (\p n may be n_shell_pairs())
+        size_t prim_start(size_t n) const { return prim_start_.at(n); }
+
+        /*! \brief Bound on the magnitude of the integrals of shell pair \p n
+         *
+         * See the class description
+         */
+        double bound(size_t n) const { return bound_.at(n); }
+
+        /// Have the Schwarz bounds been computed?
+        bool has_schwarz_bounds(void) const noexcept { return schwarz_; }
+
+        //! Estimate of the memory used by the list (in bytes)
+        size_t memory_size(void) const noexcept;
+
+
+        /*! \name Data for each primitive pair
+         *
+         * Each array has n_primitive_pairs() elements
+         */
+        ///@{
+
+        /// Index of the primitive within the first shell
+        const uint32_t * prim1(void) const noexcept { return prim1_.data(); }
+
+        /// Index of the primitive within the second shell
+        const uint32_t * prim2(void) const noexcept { return prim2_.data(); }
+
+        /// Exponent of the primitive on the first shell
+        const double * alpha1(void) const noexcept { return alpha1_.data(); }
+
+        /// Exponent of the primitive on the second shell
+        const double * alpha2(void) const noexcept { return alpha2_.data(); }
+
+        /// Sum of the exponents (p = a + b)
+        const double * exponent_sum(void) const noexcept { return p_.data(); }
+
+        /// Reduced exponent (mu = ab/p)
+        const double * reduced_exponent(void) const noexcept { return mu_.data(); }
+
+        /// Gaussian product center (x, y, and z components)
+        const double * center_x(void) const noexcept { return px_.data(); }
+        const double * center_y(void) const noexcept { return py_.data(); }
+        const double * center_z(void) const noexcept { return pz_.data(); }
+
+        /// exp(-mu |A-B|^2)
+        const double * prefactor(void) const noexcept { return kab_.data(); }
+
+        ///@}
+
+
+        /*! \brief Compute the Schwarz bounds of all shell pairs
+         *
+         * \p eri must already be initialized with the basis sets
+         * (bs1, bs2, bs1, bs2).
+         */
+        void compute_bounds(FourCenterIntegral & eri);
+
+
+        /*! \brief Iterate over shell pairs with a bound of at least \p threshold */
+        SignificantRange significant(double threshold) const
+        {
+            return SignificantRange{const_iterator(this, 0, threshold),
+                                    const_iterator(this, n_shell_pairs(), threshold)};
+        }
+
+
+    private:
+        bool symmetric_;
+        bool schwarz_;
+
+        // Per shell pair
+        std::vector<uint64_t> shell1_;
+        std::vector<uint64_t> shell2_;
+        std::vector<size_t> nfunctions_;
+        std::vector<size_t> prim_start_;
+        std::vector<double> bound_;
+
+        // Per primitive pair
+        std::vector<uint32_t> prim1_;
+        std::vector<uint32_t> prim2_;
+        std::vector<double> alpha1_;
+        std::vector<double> alpha2_;
+        std::vector<double> p_;
+        std::vector<double> mu_;
+        std::vector<double> px_;
+        std::vector<double> py_;
+        std::vector<double> pz_;
+        std::vector<double> kab_;
+};
+
+
+inline void ShellPairList::const_iterator::seek_(size_t index)
+{
+    const size_t npair = list_->n_shell_pairs();
+    while(index < npair && list_->bound_[index] < threshold_)
+        index++;
+
+    pair_.index = index;
+    if(index < npair)
+    {
+        pair_.shell1 = list_->shell1_[index];
+        pair_.shell2 = list_->shell2_[index];
+        pair_.bound = list_->bound_[index];
+    }
+}
+
+
+/*! \brief Obtain the shell pairs of two basis sets, using a cache
+ *
+ * The list (with Schwarz bounds from \p eri) is computed the first
+ * time it is requested, and is shared by everything using the same
+ * \p cache afterwards (see ModuleBase::shared_cache()). Entries
+ * are keyed by the hashes of the basis sets, the name, version, and
+ * options of \p eri, and the hash from eri.my_hash(), so modules
+ * with different options or wavefunctions don't share bounds.
+ *
+ * \p eri must already be initialized with
+ * (deriv, wfn, bs1, bs2, bs1, bs2).
+ */
+std::shared_ptr<const ShellPairList>
+get_shell_pair_list(CacheData & cache, unsigned int deriv, const Wavefunction & wfn,
+                    const BasisSet & bs1, const BasisSet & bs2,
+                    FourCenterIntegral & eri);
+
+
+} // close namespace pulsar
+
@@ -8,6 +8,8 @@
 #include "pulsar/exception/PulsarException.hpp"
 #include "pulsar/system/SphericalTransform.hpp"
 
+#include <algorithm>
+
 
 
 namespace pulsar{
@@ -34,6 +36,37 @@ const std::vector<SphericalTransformCoefficient> & spherical_transform_for_am(in
     return lut::spherical_transform_map_.at(am);
 }
 
+
+const double * spherical_transform_matrix(int am)
+{
+    // Dense versions of the coefficients in the map (built once),
+    // indexed by am
+    static const std::vector<std::vector<double>> matrices = [](void)
+    {
+        std::vector<std::vector<double>> ret;
+        for(const auto & it : lut::spherical_transform_map_)
+        {
+            if(it.first < 0)
+                continue;
+
+            const size_t ncart = n_cartesian_gaussian(it.first);
+            std::vector<double> mat(n_spherical_gaussian(it.first) * ncart, 0.0);
+            for(const auto & c : it.second)
+                mat[static_cast<size_t>(c.sphidx) * ncart + static_cast<size_t>(c.cartidx)] = c.coef;
+
+            ret.resize(std::max(ret.size(), static_cast<size_t>(it.first) + 1));
+            ret[it.first] = std::move(mat);
+        }
+        return ret;
+    }();
+
+    if(am < 0 || static_cast<size_t>(am) >= matrices.size() || matrices[am].empty())
+        throw PulsarException("Angular momentum out of range for spherical transform",
+                               "am", am);
+
+    return matrices[am].data();
+}
+
 } // close namespace pulsar
 
 
@@ -11,6 +11,7 @@
 #include <vector>
 #include <complex>
 
+#include "pulsar/pragma.h"
 #include "pulsar/system/BasisSet.hpp"
 #include "pulsar/system/NFunction.hpp"
 
@@ -85,6 +86,116 @@ inline void spherical_transform_block(const SphericalTransformCoefs & coefs,
 
 
 
+/*! \brief Largest angular momentum with a specialized transform kernel
+ *
+ * See spherical_transform_kernel()
+ */
+#define PULSAR_MAX_SPHERICAL_KERNEL_AM 5
+
+
+/*! \brief Obtain the spherical transformation for an angular momentum as a dense matrix
+ *
+ * The matrix is built from the coefficients of spherical_transform_for_am(),
+ * and is stored row-major with nspherical(am) rows and ncartesian(am) columns.
+ *
+ * \throw pulsar::PulsarException if \p am is negative or out of range
+ */
+const double * spherical_transform_matrix(int am);
+
+
+/*! \brief transform a block of cartesian AO data to spherical harmonics
+ *         for a known angular momentum
+ *
+ * This does the same as spherical_transform_block(), but the size of the
+ * (dense) transformation matrix is known at compile time. For each
+ * spherical function, the cartesian rows are accumulated with a
+ * contiguous loop over \p width, which the compiler can vectorize.
+ *
+ * \param [in] mat The transformation matrix (from spherical_transform_matrix(AM))
+ *
+ * \warning \p src and \p dest must not point to the same location
+ */
+template<int AM>
+inline void spherical_transform_kernel(double const * RESTRICT mat,
+                                       double const * RESTRICT src,
+                                       double * RESTRICT dest,
+                                       size_t width, size_t niter)
+{
+    constexpr size_t ncart = n_cartesian_gaussian_(AM);
+    constexpr size_t nsph = n_spherical_gaussian_(AM);
+
+    if(width == 1)
+    {
+        // Transforming the last index (a small matrix-vector product)
+        for(size_t n = 0; n < niter; n++)
+        {
+            for(size_t s = 0; s < nsph; s++)
+            {
+                double sum = 0.0;
+                for(size_t c = 0; c < ncart; c++)
+                    sum += mat[s*ncart + c] * src[c];
+                dest[s] = sum;
+            }
+
+            src += ncart;
+            dest += nsph;
+        }
+        return;
+    }
+
+    for(size_t n = 0; n < niter; n++)
+    {
+        for(size_t s = 0; s < nsph; s++)
+        {
+            double * RESTRICT d = dest + s*width;
+            std::fill(d, d + width, 0.0);
+
+            for(size_t c = 0; c < ncart; c++)
+            {
+                // most of the matrix is zero
+                const double coef = mat[s*ncart + c];
+                PRAGMA_WARNING_PUSH
+                PRAGMA_WARNING_IGNORE_FP_EQUALITY
+                if(coef == 0.0)
+                    continue;
+                PRAGMA_WARNING_POP
+
+                double const * RESTRICT sr = src + c*width;
+                for(size_t i = 0; i < width; i++)
+                    d[i] += coef * sr[i];
+            }
+        }
+
+        src += ncart*width;
+        dest += nsph*width;
+    }
+}
+
+
+//! Signature of spherical_transform_kernel() (after obtaining the matrix)
+typedef void (*SphericalTransformKernel)(double const *, double const *, double *, size_t, size_t);
+
+
+/*! \brief Obtain the specialized transform kernel for an angular momentum
+ *
+ * \return The kernel, or nullptr if there isn't one for \p am (negative, or
+ *         larger than PULSAR_MAX_SPHERICAL_KERNEL_AM)
+ */
+inline SphericalTransformKernel spherical_transform_kernel_for_am(int am) noexcept
+{
+    static const SphericalTransformKernel kernels[PULSAR_MAX_SPHERICAL_KERNEL_AM+1] = {
+        spherical_transform_kernel<0>, spherical_transform_kernel<1>,
+        spherical_transform_kernel<2>, spherical_transform_kernel<3>,
+        spherical_transform_kernel<4>, spherical_transform_kernel<5>
+    };
+
+    if(am < 0 || am > PULSAR_MAX_SPHERICAL_KERNEL_AM)
+        return nullptr;
+    return kernels[am];
+}
+
+
+
 /*! \brief transform data from cartesian to spherical gaussian functions
  *
  * It is expected that all of \p src is in cartesian form. If the corresponding
@@ -118,7 +229,7 @@ void spherical_transform(const BasisSet & bs,
             if(!smap.count(am))
                 throw PulsarException("AM not available in the spherical transform map", "am", am);
 
-            spherical_transform_block(smap.at(am), src + srcpos, dest + destpos, width);
+            spherical_transform_block(smap.at(am), src + srcpos, dest + destpos, width, am, 1);
 
             srcpos += ncart * width;
             destpos += nsph * width;
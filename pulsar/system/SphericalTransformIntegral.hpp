@@ -14,6 +14,26 @@
 
 namespace pulsar{
 
+namespace detail {
+
+/*! \brief Transform one center of a block of integrals
+ *
+ * Uses the specialized kernel for \p am if there is one
+ * (see spherical_transform_block for the arguments)
+ */
+inline void spherical_transform_center(int am, double const * src, double * dest,
+                                       size_t width, size_t niter)
+{
+    SphericalTransformKernel kernel = spherical_transform_kernel_for_am(am);
+    if(kernel)
+        kernel(spherical_transform_matrix(am), src, dest, width, niter);
+    else
+        spherical_transform_block(spherical_transform_for_am(am), src, dest, width, am, niter);
+}
+
+} // close namespace detail
+
+
 /* transformation of a generic batch of integrals
  *
  * The integrals should all be in cartesian form.
@@ -60,6 +80,60 @@ void CartesianToSpherical(std::array<std::reference_wrapper<const BasisShellBase
     }
 
 
+    // Usual case - no general contractions. The sizes and kernels are
+    // found once, and the last center is transformed directly into dest.
+    bool nogeneral = true;
+    for(int i = 0; i < N; i++)
+        nogeneral = nogeneral && (shells[i].get().n_general_contractions() == 1);
+
+    if(nogeneral)
+    {
+        std::array<int, N> am;
+        std::array<size_t, N> ncart;
+        std::array<size_t, N> nfunc;
+        size_t allnfunc = 1;
+        int lastsph = 0;
+
+        for(int i = 0; i < N; i++)
+        {
+            const BasisShellBase & sh = shells[i].get();
+            am[i] = sh.general_am(0);
+            ncart[i] = n_cartesian_gaussian(am[i]);
+            nfunc[i] = sh.general_n_functions(0);
+            allnfunc *= nfunc[i];
+            if(isspherical[i])
+                lastsph = i;
+        }
+
+        for(int c = 0; c < ncomp; c++)
+        {
+            double * buf1 = source;
+            double * buf2 = work;
+            size_t width = allncart;
+            size_t niter = 1;
+
+            for(int i = 0; i < N; i++)
+            {
+                width /= ncart[i];
+
+                if(isspherical[i])
+                {
+                    double * out = (i == lastsph) ? dest : buf2;
+                    detail::spherical_transform_center(am[i], buf1, out, width, niter);
+                    std::swap(buf1, buf2);
+                }
+
+                niter *= nfunc[i];
+            }
+
+            source += allncart;
+            dest += allnfunc;
+        }
+
+        return;
+    }
+
+
     // loop over the number of specified components
     for(int c = 0; c < ncomp; c++)
     {
@@ -110,9 +184,7 @@ void CartesianToSpherical(std::array<std::reference_wrapper<const BasisShellBase
 
                 if(isspherical[i])
                 {
-                    const auto & coef = spherical_transform_for_am(gam[i]);
-
-                    spherical_transform_block(coef, buf1, buf2, width, gam[i], niter);
+                    detail::spherical_transform_center(gam[i], buf1, buf2, width, niter);
 
                     // swap the source and destination
                     std::swap(buf1, buf2);
@@ -5,6 +5,7 @@
 
 #include "pulsar/pragma.h"
 #include "pulsar/system/System.hpp"
+#include "pulsar/system/NeighborList.hpp"
 #include "pulsar/system/BasisSet.hpp"
 #include "pulsar/system/AtomicInfo.hpp"
 #include "pulsar/constants.h"
@@ -27,6 +28,10 @@ void System::SetDefaults_(void)
     mass=get_sum_mass();
     //! \todo default multiplicity
     multiplicity=1.0;
+
+    // Forget basis sets, etc, formed from the old atoms. The old cache
+    // isn't cleared, since copies of this system may still be using it
+    atom_cache_=std::make_shared<AtomCache_>();
 }
 
 System::System(std::shared_ptr<const AtomSetUniverse> universe,bool fill)
@@ -45,7 +50,11 @@ System::System(const AtomSetUniverse& universe,bool fill):
 {
 }
 
-void System::clear(){atoms_.clear();}
+void System::clear()
+{
+    atoms_.clear();
+    atom_cache_=std::make_shared<AtomCache_>();
+}
 
 double System::get_sum_charge(void) const{
     return std::accumulate(this->begin(),this->end(),static_cast<double>(0.0),
@@ -170,6 +179,51 @@ System System::transform(System::TransformerFunc Trans)const{
     return temp;
 }
 
+System System::with_coordinates(const std::vector<double> & x,
+                                const std::vector<double> & y,
+                                const std::vector<double> & z)const
+{
+    if(x.size()!=size() || y.size()!=size() || z.size()!=size())
+        throw PulsarException("Coordinates are not the same size as the system",
+                              "natoms", size(), "nx", x.size(),
+                              "ny", y.size(), "nz", z.size());
+
+    PRAGMA_WARNING_PUSH
+    PRAGMA_WARNING_IGNORE_FP_EQUALITY
+
+    // Only the atoms that move are replaced in (a copy of) the universe
+    const auto arrays=get_arrays();
+    std::vector<std::pair<size_t,Atom>> moved;
+    size_t i=0;
+    for(const Atom & atom : *this)
+    {
+        if(x[i]!=arrays->x[i] || y[i]!=arrays->y[i] || z[i]!=arrays->z[i])
+        {
+            Atom newatom(atom);
+            newatom.set_coords(x[i],y[i],z[i]);
+            moved.emplace_back(atoms_.idx(atom),std::move(newatom));
+        }
+        ++i;
+    }
+
+    PRAGMA_WARNING_POP
+
+    if(moved.empty())
+        return *this;
+
+    // Moving atoms doesn't change the charge, mass, etc, so those are
+    // kept, and the arrays can be formed from the old ones
+    System temp(*this);
+    temp.atoms_=atoms_.replace(std::move(moved));
+    auto newarrays=std::make_shared<AtomArrays>(*arrays);
+    newarrays->x=x;
+    newarrays->y=y;
+    newarrays->z=z;
+    temp.atom_cache_=std::make_shared<AtomCache_>();
+    temp.atom_cache_->arrays=std::move(newarrays);
+    return temp;
+}
+
 #undef CALL_ATOMS
 
 
@@ -203,6 +257,58 @@ bool System::has_basis_set(const std::string & basislabel) const
 }
 
 BasisSet System::get_basis_set(const std::string & basislabel) const
+{
+    // moved-from systems have no cache
+    if(!atom_cache_)
+        return form_basis_set_(basislabel);
+
+    {
+        std::lock_guard<std::mutex> l(atom_cache_->mutex);
+        auto it=atom_cache_->basis_sets.find(basislabel);
+        if(it!=atom_cache_->basis_sets.end())
+            return it->second;
+    }
+
+    // Form outside the lock. If another thread formed it in the meantime,
+    // theirs is used instead
+    BasisSet bs=form_basis_set_(basislabel);
+
+    std::lock_guard<std::mutex> l(atom_cache_->mutex);
+    return atom_cache_->basis_sets.emplace(basislabel, std::move(bs)).first->second;
+}
+
+std::shared_ptr<const AtomArrays> System::get_arrays(void) const
+{
+    // moved-from systems have no cache
+    if(!atom_cache_)
+        return form_arrays_();
+
+    std::lock_guard<std::mutex> l(atom_cache_->mutex);
+    if(!atom_cache_->arrays)
+        atom_cache_->arrays=form_arrays_();
+    return atom_cache_->arrays;
+}
+
+std::shared_ptr<const AtomArrays> System::form_arrays_(void) const
+{
+    auto ret=std::make_shared<AtomArrays>();
+    const size_t n=size();
+    for(auto * v : {&ret->x, &ret->y, &ret->z, &ret->Z, &ret->mass, &ret->charge})
+        v->reserve(n);
+
+    for(const auto & atom:*this)
+    {
+        ret->x.push_back(atom[0]);
+        ret->y.push_back(atom[1]);
+        ret->z.push_back(atom[2]);
+        ret->Z.push_back(static_cast<double>(atom.Z));
+        ret->mass.push_back(atom.mass);
+        ret->charge.push_back(atom.charge);
+    }
+    return ret;
+}
+
+BasisSet System::form_basis_set_(const std::string & basislabel) const
 {
     if(!has_basis_set(basislabel))
         throw PulsarException("Attempted to get missing basis label", "label", basislabel);
@@ -261,81 +367,112 @@ void System::hash(bphash::Hasher & h) const
     h(charge, multiplicity, nelectrons,mass);
 }
 
+namespace {
+
+// Center of the atoms, with atom i weighted by w[i]
+Point weighted_center_(const AtomArrays & arrays, const std::vector<double> & weights)
+{
+    const size_t n=arrays.size();
+    const double * x=arrays.x.data(),* y=arrays.y.data(),* z=arrays.z.data();
+    const double * w=weights.data();
+
+    double total=0.0,cx=0.0,cy=0.0,cz=0.0;
+    for(size_t i=0;i<n;++i)
+    {
+        total+=w[i];
+        cx+=w[i]*x[i];
+        cy+=w[i]*y[i];
+        cz+=w[i]*z[i];
+    }
+    return Point{cx/total,cy/total,cz/total};
+}
+
+} // close anonymous namespace
+
 Point center_of_mass(const System& Sys)
 {
-    return weighted_points_center<Point>(Sys, &Atom::mass);
+    const auto arrays=Sys.get_arrays();
+    return weighted_center_(*arrays, arrays->mass);
 }
 
 Point center_of_nuclear_charge(const System& Sys)
 {
-    return weighted_points_center<Point>(Sys, &Atom::Z);
+    const auto arrays=Sys.get_arrays();
+    return weighted_center_(*arrays, arrays->Z);
 }
 
 ///Returns the distance between each pair of atoms in sys
 DistMat_t get_distance(const System& sys)
 {
+    const std::vector<Atom> atoms(sys.begin(),sys.end());
+    const auto arrays=sys.get_arrays();
+    const size_t natoms=atoms.size();
+
     DistMat_t DM;
-    for(const Atom& atomI:sys)
-    {
-        for(const Atom& atomJ:sys)
+    DM.reserve(natoms*natoms);
+    for(size_t i=0;i<natoms;++i)
+        for(size_t j=0;j<i;++j)
         {
-            if(atomJ==atomI)break;
-            double dist=atomI.distance(atomJ);
-            DM.emplace(std::make_pair(atomI,atomJ),dist);
-            DM.emplace(std::make_pair(atomJ,atomI),dist);
+            const double dx=arrays->x[i]-arrays->x[j];
+            const double dy=arrays->y[i]-arrays->y[j];
+            const double dz=arrays->z[i]-arrays->z[j];
+            const double dist=std::sqrt(dx*dx+dy*dy+dz*dz);
+            DM.emplace(std::make_pair(atoms[i],atoms[j]),dist);
+            DM.emplace(std::make_pair(atoms[j],atoms[i]),dist);
         }
-    }
     return DM;
 }
 
 Conn_t get_connectivity(const System& sys,double Tolerance)
 {
-    Conn_t Conns;
-    
-    for(const Atom& AtomI:sys)Conns[AtomI]=std::unordered_set<Atom>();
+    const std::vector<Atom> atoms(sys.begin(),sys.end());
+    const NeighborList bonds=get_bonded_neighbors(sys,Tolerance);
+    const auto & offsets=bonds.offsets();
 
-    for(const Atom& atomI:sys)
+    Conn_t Conns;
+    Conns.reserve(atoms.size());
+    for(size_t i=0;i<atoms.size();++i)
     {
-        double radI=atomI.cov_radius;
-        for(const Atom& atomJ:sys)
-        {
-            if(atomI==atomJ)break;
-            if(atomI.distance(atomJ)<Tolerance*(radI+atomJ.cov_radius))
-            {
-                Conns[atomI].insert(atomJ);
-                Conns[atomJ].insert(atomI);
-            }
-        }
+        auto & connI=Conns[atoms[i]];
+        for(size_t n=offsets[i];n<offsets[i+1];++n)
+            connI.insert(atoms[bonds.neighbors()[n]]);
     }
-
     return Conns;
 }
 
 std::array<double,9> inertia_tensor(const System& Mol){
-    std::array<double,9> I;
-    double mass=0.0;
-    for(const Atom& AtomI: Mol){
-        double massI=AtomI.mass;
-        mass+=massI;
-        for(size_t j=0;j<3;++j)
-            for(size_t i=0;i<3;++i)
-                I[j*3+j]+=massI*AtomI[i]*AtomI[i];
+    const auto arrays=Mol.get_arrays();
+    const size_t n=arrays->size();
+    const double * x=arrays->x.data(),* y=arrays->y.data(),* z=arrays->z.data();
+    const double * m=arrays->mass.data();
+
+    //Sum of m_i r_i^2, and of m_i r_ip r_iq
+    double r2=0.0,xx=0.0,xy=0.0,xz=0.0,yy=0.0,yz=0.0,zz=0.0;
+    for(size_t i=0;i<n;++i)
+    {
+        r2+=m[i]*(x[i]*x[i]+y[i]*y[i]+z[i]*z[i]);
+        xx+=m[i]*x[i]*x[i];
+        xy+=m[i]*x[i]*y[i];
+        xz+=m[i]*x[i]*z[i];
+        yy+=m[i]*y[i]*y[i];
+        yz+=m[i]*y[i]*z[i];
+        zz+=m[i]*z[i]*z[i];
     }
-    std::vector<double> TempI=moment<2>(Mol, &Atom::mass);
-    for(size_t i=0;i<9;++i)I[i]-=mass*TempI[i];
-    return I;
-    
+    return {r2-xx,   -xy,   -xz,
+              -xy, r2-yy,   -yz,
+              -xz,   -yz, r2-zz};
 }
 
 System system_to_angstroms(const System& Sys){
-    return Sys.transform([](const Atom& i)->Atom{
-        std::array<double,3> NewCoords;
-        std::transform(i.begin(),i.end(),NewCoords.begin(),
-                       [](const double& a){return a*BOHR_RADIUS_ANGSTROMS;});
-        Atom Clone(i);
-        Clone.set_coords(NewCoords);
-        return Clone;
-    });
+    const auto arrays=Sys.get_arrays();
+    std::vector<double> x(arrays->x),y(arrays->y),z(arrays->z);
+    for(size_t i=0;i<x.size();++i)
+    {
+        x[i]*=BOHR_RADIUS_ANGSTROMS;
+        y[i]*=BOHR_RADIUS_ANGSTROMS;
+        z[i]*=BOHR_RADIUS_ANGSTROMS;
+    }
+    return Sys.with_coordinates(x,y,z);
 }
 
 } // close namespace pulsar
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <map>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include "pulsar/system/Atom.hpp"
@@ -18,6 +20,30 @@
 #include "pulsar/util/Hash.hpp"
 
 
+namespace pulsar{
+namespace detail {
+
+/*! \brief Hashes atoms for the index of a Universe
+ *
+ * Only Z and the coordinates are hashed, which is much cheaper than
+ * Atom::my_hash() and is enough to tell apart the atoms of a system.
+ */
+template<>
+struct UniverseHasher<Atom>
+{
+    size_t operator()(const Atom & atom) const
+    {
+        size_t seed = std::hash<int>()(atom.Z);
+        for(size_t i = 0; i < 3; i++)
+            hash_combine(seed, hash_float(atom[i]));
+        return seed;
+    }
+};
+
+} // close namespace detail
+} // close namespace pulsar
+
+
 // Instantiated in the cpp file
 extern template class pulsar::Universe<pulsar::Atom>;
 extern template class pulsar::MathSet<pulsar::Atom>;
@@ -29,6 +55,28 @@ namespace pulsar{
 /*! \brief All atoms that may be used in a group of Systems */
 typedef Universe<Atom> AtomSetUniverse;
 
+/*! \brief Properties of the atoms of a System, stored as a structure
+ *         of arrays
+ *
+ * Element \p i of each array belongs to the \p i -th atom when
+ * iterating over the system. Loops over these arrays are much
+ * cheaper than over the atoms themselves.
+ *
+ * \see System::get_arrays
+ */
+struct AtomArrays
+{
+    std::vector<double> x;      //!< x coordinate of each atom
+    std::vector<double> y;      //!< y coordinate of each atom
+    std::vector<double> z;      //!< z coordinate of each atom
+    std::vector<double> Z;      //!< Atomic Z number (as a double)
+    std::vector<double> mass;   //!< Atomic mass
+    std::vector<double> charge; //!< Charge on the center
+
+    //! Number of atoms
+    size_t size(void) const noexcept { return x.size(); }
+};
+
 /*! \brief A collection of Atoms and the space around them
  * 
  *  This class is described in detail in the page 
@@ -43,6 +91,27 @@ private:
     using AtomSet=MathSet<Atom>;//!< Type of atom storage container
     AtomSet atoms_;//!< Actual set of atoms
 
+    /*! \brief Data already formed from the atoms of a system
+     *
+     * Shared between copies of a system, until the atoms of one of them
+     * change.
+     */
+    struct AtomCache_
+    {
+        std::mutex mutex;
+        std::map<std::string, BasisSet> basis_sets; //!< By label
+        std::shared_ptr<const AtomArrays> arrays;
+    };
+
+    //! Data formed from the current atoms
+    std::shared_ptr<AtomCache_> atom_cache_=std::make_shared<AtomCache_>();
+
+    //! Forms a basis set from the atoms (no caching)
+    BasisSet form_basis_set_(const std::string & basislabel) const;
+
+    //! Forms the arrays of atomic properties (no caching)
+    std::shared_ptr<const AtomArrays> form_arrays_(void) const;
+
     /*! \brief Construct a system given a universe
      *
      * The universe will be shared with the data that was passed in
@@ -53,7 +122,11 @@ private:
     explicit System(std::shared_ptr<const AtomSetUniverse> universe, bool fill);
 
     
-    /* \brief Sets charge, multiplicity, and nelectrons as determined from the Atoms in this set */
+    /* \brief Sets charge, multiplicity, and nelectrons as determined from the Atoms in this set
+     *
+     * Must be called whenever the atoms change, since this also forgets
+     * the basis sets formed from the previous atoms
+     */
     void SetDefaults_(void);
 
 
@@ -67,6 +140,9 @@ private:
     void serialize(Archive & ar)
     {
         ar(atoms_, mass, charge, multiplicity, nelectrons);
+
+        // (loading may have changed the atoms)
+        atom_cache_=std::make_shared<AtomCache_>();
     }
 
     void hash(bphash::Hasher & h) const;
@@ -149,6 +225,14 @@ public:
     /*! \brief Return an iterator to the end of this system (just past the last atom) */
     const_iterator end(void) const{return atoms_.end();}
 
+    /*! \brief Obtain the properties of the atoms as arrays
+     *
+     * The arrays are formed the first time they are requested, and
+     * are then shared by all later calls (and copies of this system)
+     * until the atoms in this system change.
+     */
+    std::shared_ptr<const AtomArrays> get_arrays(void) const;
+
     ///@}
 
 
@@ -299,6 +383,10 @@ public:
 
 
     /*! \brief Obtain a basis set with the given label
+     *
+     * The basis set is formed the first time it is requested, and
+     * is then shared by all later calls (and copies of this system)
+     * until the atoms in this system change.
      */
     BasisSet get_basis_set(const std::string & basislabel) const;
 
@@ -314,6 +402,24 @@ public:
     /*! \brief Perform a generic transformation to atoms in the system */
     System transform(TransformerFunc Transformer) const;
 
+    /*! \brief Returns a copy of this system with new coordinates
+     *
+     * The \p i -th atom of the system (see get_arrays) is moved to
+     * (x[i], y[i], z[i]). Atoms of the universe that are not in this
+     * system are unchanged, as for transform().
+     *
+     * The universe is copied as is (see MathSet::replace), and only the
+     * atoms that move are hashed and compared again. The charge,
+     * multiplicity, etc, of this system are kept. If no atoms move, the
+     * copy shares this system's universe.
+     *
+     * \throw pulsar::PulsarException if the arrays are not the same
+     *        size as the system, or if two atoms would end up equal
+     */
+    System with_coordinates(const std::vector<double> & x,
+                            const std::vector<double> & y,
+                            const std::vector<double> & z) const;
+
     /*! \brief Obtain the universe in use by this system
      */
     std::shared_ptr<const AtomSetUniverse> get_universe(void) const;
@@ -351,8 +457,16 @@ Point center_of_nuclear_charge(const System& sys);
 template<typename VectorType>
 System translate(const System& Sys,const VectorType & vec)
 {
-    return Sys.transform(std::bind(translate_point_copy<Atom, VectorType>, 
-            std::placeholders::_1, vec));
+    const auto arrays=Sys.get_arrays();
+    std::vector<double> x(arrays->x),y(arrays->y),z(arrays->z);
+    const double v0=vec[0],v1=vec[1],v2=vec[2];
+    for(size_t i=0;i<x.size();++i)
+    {
+        x[i]+=v0;
+        y[i]+=v1;
+        z[i]+=v2;
+    }
+    return Sys.with_coordinates(x,y,z);
 }
 
 /*! \relates System
@@ -367,8 +481,20 @@ System translate(const System& Sys,const VectorType & vec)
 template<typename MatrixType>
 System rotate(const System& Sys,const MatrixType & mat)
 {
-    return Sys.transform(std::bind(rotate_point_copy<Atom, MatrixType>, 
-            std::placeholders::_1, mat));
+    const auto arrays=Sys.get_arrays();
+    const size_t n=arrays->size();
+    const double * x0=arrays->x.data(),* y0=arrays->y.data(),* z0=arrays->z.data();
+    std::vector<double> x(n),y(n),z(n);
+    const double m0=mat[0],m1=mat[1],m2=mat[2],
+                 m3=mat[3],m4=mat[4],m5=mat[5],
+                 m6=mat[6],m7=mat[7],m8=mat[8];
+    for(size_t i=0;i<n;++i)
+    {
+        x[i]=m0*x0[i]+m1*y0[i]+m2*z0[i];
+        y[i]=m3*x0[i]+m4*y0[i]+m5*z0[i];
+        z[i]=m6*x0[i]+m7*y0[i]+m8*z0[i];
+    }
+    return Sys.with_coordinates(x,y,z);
 }
 
 ///Type of a distance matrix
@@ -377,6 +503,11 @@ typedef std::unordered_map<std::pair<Atom,Atom>,double> DistMat_t;
 /*! \relates System
  *
  * \brief Returns the distance between each pair of atoms in \p sys
+ *
+ * Keyed by atoms, which are expensive to hash. This holds every pair
+ * of atoms, so it is only meant for small systems. For large systems,
+ * use get_neighbor_list (see NeighborList.hpp), which only finds the
+ * pairs within a cutoff.
  */
 DistMat_t get_distance(const System& sys);
 
@@ -388,6 +519,9 @@ typedef std::unordered_map<Atom, std::unordered_set<Atom>> Conn_t;
  *
  * Atoms are considered bonded if Tolerance*(sum of covRaddii) is greater than
  * distance
+ *
+ * The bonds are found with get_bonded_neighbors (see NeighborList.hpp),
+ * which returns them indexed by the position of the atoms in \p sys.
  */
 Conn_t get_connectivity(const System& sys, double Tolerance = 1.20);
 
@@ -14,8 +14,10 @@
 #include "pulsar/system/Space.hpp"
 #include "pulsar/system/BasisSet.hpp"
 #include "pulsar/system/AOOrdering.hpp"
+#include "pulsar/system/AOReorderPlan.hpp"
 #include "pulsar/system/SphericalTransform.hpp"
 #include "pulsar/system/CrystalFunctions.hpp"
+#include "pulsar/system/NeighborList.hpp"
 #include "pulsar/math/RegisterMathSet.hpp"
 
 
@@ -38,6 +40,17 @@ void set_alphas(BasisShellBase& bs,pybind11::list as){
     bs.set_alphas(list_to_vector(as));
 }
 
+// Wraps one of the arrays of an AtomArrays in a read-only NumPy array,
+// without copying. The array keeps the Python object for \p arrays alive.
+pybind11::array_t<double> wrap_atom_array(pybind11::object arrays,
+                                          std::vector<double> AtomArrays::* member)
+{
+    const std::vector<double> & v=arrays.cast<const AtomArrays &>().*member;
+    pybind11::array_t<double> ret(std::vector<size_t>{v.size()}, v.data(), arrays);
+    ret.attr("setflags")(false);
+    return ret;
+}
+
 void export_system(pybind11::module & m)
 {
 
@@ -68,6 +81,16 @@ void export_system(pybind11::module & m)
     m.def("make_basis_reorder_map", make_basis_reorder_map);
     m.def("make_ao_basis_ordering", make_ao_basis_ordering);
 
+    pybind11::class_<AOReorderPlan>(m, "AOReorderPlan")
+    .def(pybind11::init<std::vector<size_t>>())
+    .def(pybind11::init<const BasisSet &, const BSReorderMap &>())
+    .def("size", &AOReorderPlan::size)
+    .def("ordering", &AOReorderPlan::ordering, pybind11::return_value_policy::copy)
+    .def("n_runs", &AOReorderPlan::n_runs)
+    .def("n_cycles", &AOReorderPlan::n_cycles)
+    .def("is_identity", &AOReorderPlan::is_identity)
+    ;
+
     ////////////////////////////
     // Spherical transformation
     ////////////////////////////
@@ -240,9 +263,28 @@ void export_system(pybind11::module & m)
     m.def("atomic_multiplicity_from_symbol", atomic_multiplicity_from_symbol);
 
 
+    // Neighbor search
+    pybind11::class_<NeighborList>(m, "NeighborList")
+    .def(pybind11::init<>())
+    .def(pybind11::init<std::vector<size_t>, std::vector<size_t>, std::vector<double>>())
+    .def("size", &NeighborList::size)
+    .def("n_pairs", &NeighborList::n_pairs)
+    .def("n_neighbors", &NeighborList::n_neighbors)
+    .def("are_neighbors", &NeighborList::are_neighbors)
+    .def("offsets", &NeighborList::offsets, pybind11::return_value_policy::copy)
+    .def("neighbors", &NeighborList::neighbors, pybind11::return_value_policy::copy)
+    .def("distances", &NeighborList::distances, pybind11::return_value_policy::copy)
+    ;
+
+
     // Other free functions
     m.def("inertia_tensor",inertia_tensor);
     m.def("get_connectivity",get_connectivity);
+    m.def("get_neighbor_list",get_neighbor_list);
+    m.def("get_bonded_neighbors",get_bonded_neighbors,pybind11::arg("sys"),
+                                 pybind11::arg("Tolerance")=1.20);
+    m.def("get_distance_matrix",get_distance_matrix);
+    m.def("connected_atoms",connected_atoms);
     m.def("translate", translate<std::array<double, 3>>);
     m.def("rotate", rotate<std::array<double, 9>>);
     m.def("center_of_mass", center_of_mass);
@@ -312,6 +354,18 @@ void export_system(pybind11::module & m)
     // No need to export AtomSet (at the moment)
     register_Universe<AtomSetUniverse>(m, "AtomSetUniverse");
 
+    // The arrays are shared with the System (and so are read-only)
+    pybind11::class_<AtomArrays, std::shared_ptr<AtomArrays>>(m,"AtomArrays")
+    .def("size",&AtomArrays::size)
+    .def("__len__",&AtomArrays::size)
+    .def_property_readonly("x",pybind11::cpp_function([](pybind11::object self){return wrap_atom_array(self,&AtomArrays::x);}))
+    .def_property_readonly("y",pybind11::cpp_function([](pybind11::object self){return wrap_atom_array(self,&AtomArrays::y);}))
+    .def_property_readonly("z",pybind11::cpp_function([](pybind11::object self){return wrap_atom_array(self,&AtomArrays::z);}))
+    .def_property_readonly("Z",pybind11::cpp_function([](pybind11::object self){return wrap_atom_array(self,&AtomArrays::Z);}))
+    .def_property_readonly("mass",pybind11::cpp_function([](pybind11::object self){return wrap_atom_array(self,&AtomArrays::mass);}))
+    .def_property_readonly("charge",pybind11::cpp_function([](pybind11::object self){return wrap_atom_array(self,&AtomArrays::charge);}))
+    ;
+
     pybind11::class_<System, std::shared_ptr<System>>(m,"System")
     .def(pybind11::init<const AtomSetUniverse&, bool>())
     .def(pybind11::init<const System &>())
@@ -347,6 +401,8 @@ void export_system(pybind11::module & m)
     .def("is_proper_superset_of", &System::is_proper_superset_of)
     .def("is_superset_of", &System::is_superset_of)
     .def("transform", &System::transform)
+    .def("with_coordinates", &System::with_coordinates)
+    .def("get_arrays", [](const System & s){ return std::const_pointer_cast<AtomArrays>(s.get_arrays()); })
     .def("partition", &System::partition)
     .def("print",&System::print)
     .def(pybind11::self += pybind11::self, pybind11::return_value_policy::reference)
@@ -4,6 +4,7 @@
  * and open the template in the editor.
  */
 #include <array>
+#include <cmath>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
@@ -97,8 +98,19 @@ Vector_t Orient(const T& Axis){
 ///Finds all symmetry equivalent atoms
 
 SEASet_t FindSEAs(const System& Mol,double Tol){
-    DistMat_t DistMat=pulsar::get_distance(Mol);
+    const std::vector<Atom> Atoms(Mol.begin(),Mol.end());
+    const size_t NAtoms=Atoms.size();
     SEASet_t SEAs;
+
+    //Distances are calculated as needed, rather than stored for all pairs
+    const auto Arrays=Mol.get_arrays();
+    auto Distance=[&Arrays](size_t i,size_t j){
+        const double dx=Arrays->x[i]-Arrays->x[j];
+        const double dy=Arrays->y[i]-Arrays->y[j];
+        const double dz=Arrays->z[i]-Arrays->z[j];
+        return std::sqrt(dx*dx+dy*dy+dz*dz);
+    };
+
     //Little class to enforce equality to within a tolerance
 
     struct AreLess{
@@ -110,35 +122,29 @@ SEASet_t FindSEAs(const System& Mol,double Tol){
     } Comparer;
 
     Comparer.Tol=Tol;
-    std::unordered_map<Atom,bool> IsGood;
-    for(Atom atomI:Mol)IsGood.emplace(atomI,true);
-    System::const_iterator atomI=Mol.begin(),atomK=Mol.begin();
-
-    for(;atomI!=Mol.end();++atomI){//Loop over unassigned atoms
-        if(!IsGood.at(*atomI))continue;
-        SEAs.push_back(std::vector<Atom>({*atomI}));
-        IsGood.at(*atomI)=false;
+    std::vector<bool> IsGood(NAtoms,true);
+
+    for(size_t i=0;i<NAtoms;++i){//Loop over unassigned atoms
+        if(!IsGood[i])continue;
+        SEAs.push_back(std::vector<Atom>({Atoms[i]}));
+        IsGood[i]=false;
         std::multiset<double,AreLess> ColI(Comparer);
-        for(const Atom atomJ:Mol){
-            if((*atomI)==atomJ)continue;
-            ColI.insert(DistMat[{*atomI,atomJ}
-            ]);
+        for(size_t j=0;j<NAtoms;++j){
+            if(i==j)continue;
+            ColI.insert(Distance(i,j));
         }
-        atomK=atomI;
-        for(++atomK;atomK!=Mol.end();++atomK){
-            if(!IsGood.at(*atomK)||!atoms_are_equal(*atomI,*atomK))continue;
+        for(size_t k=i+1;k<NAtoms;++k){
+            if(!IsGood[k]||!atoms_are_equal(Atoms[i],Atoms[k]))continue;
             std::multiset<double,AreLess> CopyColI(ColI);
-            for(const Atom atomJ:Mol){
-                if(*atomK==atomJ)continue;
-                double dist=DistMat[{*atomK,atomJ}
-                ];
-                auto Location=CopyColI.find(dist);
+            for(size_t j=0;j<NAtoms;++j){
+                if(k==j)continue;
+                auto Location=CopyColI.find(Distance(k,j));
                 if(Location==CopyColI.end())break;
                 CopyColI.erase(Location);
             }
             if(CopyColI.size()==0){
-                SEAs.back().push_back(*atomK);
-                IsGood.at(*atomK)=false;
+                SEAs.back().push_back(Atoms[k]);
+                IsGood[k]=false;
             }
         }
     }
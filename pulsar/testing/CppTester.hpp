@@ -8,6 +8,8 @@
 #include "pulsar/output/GlobalOutput.hpp"
 #include "pulsar/util/Pybind11.hpp"
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 namespace pulsar {
 
@@ -308,6 +310,20 @@ public:
     }
 };
 
+
+/*! \brief Should benchmarks be run at full size?
+ *
+ * True if the PULSAR_BENCHMARK environment variable is 1, which is set
+ * for the full-size runs of benchmarks (see pulsar_cxx_benchmark in
+ * CTestMacros.cmake). Otherwise, benchmarks should only run cases small
+ * enough to check their results quickly.
+ */
+inline bool full_benchmark(void)
+{
+    const char * env = std::getenv("PULSAR_BENCHMARK");
+    return env != nullptr && std::strcmp(env, "1") == 0;
+}
+
 }
 
 #define TEST_SIMPLE(test_name) \
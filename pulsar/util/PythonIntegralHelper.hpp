@@ -1,5 +1,6 @@
 #pragma once
 #include "pulsar/system/BasisSet.hpp"
+#include "pulsar/exception/PulsarException.hpp"
 
 
 namespace pulsar{
@@ -7,12 +8,38 @@ namespace pulsar{
 /*! \brief Pulsar side code factorization to accomodate Python API to
  *  integrals
  *
+ *  Integrals are exchanged with python as NumPy arrays. Modules reuse
+ *  their buffer between calls, so integrals from C++ modules are copied
+ *  into a new array. Integrals returned from a python module are given
+ *  back as a read-only view of the array the module returned. Anything
+ *  returned from python that supports the buffer protocol is used without
+ *  copying if it is already a contiguous array of doubles.
  */
 class PythonIntegralHelper
 {
 protected:
     std::vector<BasisSet> bs_;
-    std::vector<double> buffer_;
+
+    //! Integrals returned from python (kept alive while the module uses them)
+    pybind11::object pyints_;
+    const double* pydata_=nullptr;
+
+    /*! \brief Wraps \p n integrals in an array
+     *
+     * Integrals returned from python are viewed (read-only) rather than
+     * copied. The view holds a reference to that array, so it stays
+     * valid after the next call.
+     */
+    pybind11::array_t<double> wrap_(const double* ints, size_t n)const
+    {
+        if(!pyints_ || ints!=pydata_)
+            return pybind11::array_t<double>(std::vector<size_t>{n}, ints);
+
+        pybind11::array_t<double> ret(std::vector<size_t>{n}, ints, pyints_);
+        ret.attr("setflags")(false);
+        return ret;
+    }
+
 public:
         /*! \brief initialize the basis sets
          *
@@ -41,31 +68,46 @@ public:
             return n_funcs;
         }
 
+        /*! \brief Puts integrals in a NumPy array
+         *
+         * See the class description for when the integrals are copied.
+         *
+         * \param [in] ints The integrals
+         */
         template<typename...Args>
-        pybind11::list int_2_py(const double* ints,Args...args)const
+        pybind11::array_t<double> int_2_py(const double* ints, Args...args)const
         {
-            pybind11::list rv;
-            for(size_t i=0;i<size(args...);++i)
-                   rv.append(ints[i]);
-            return rv;
+            return wrap_(ints,size(args...));
         }
 
+        //! \copydoc int_2_py
         template<typename...Args>
-        pybind11::list multi_int_2_py(const double* ints,Args...args)const
+        pybind11::array_t<double> multi_int_2_py(const double* ints, Args...args)const
         {
-            pybind11::list rv;
             std::vector<std::vector<size_t>> shells({args...});
-            for(size_t i=0;i<size(shells);++i)
-                    rv.append(ints[i]);
-            return rv;
+            return wrap_(ints,size(shells));
         }
 
-        const double* py_2_int(pybind11::list& ints)
+        /*! \brief Obtains a pointer to integrals returned from python
+         *
+         * \p ints may be any object supporting the buffer protocol (or
+         * a sequence of numbers). It is only copied if it is not already
+         * a contiguous array of doubles.
+         *
+         * \note The GIL must be held when calling this function
+         */
+        const double* py_2_int(const pybind11::object& ints)
         {
-            buffer_=std::vector<double>(ints.size());
-            for(size_t i=0;i<ints.size();++i)
-                buffer_[i]=ints[i].cast<double>();
-            return buffer_.data();
+            typedef pybind11::array_t<double, pybind11::array::c_style |
+                                              pybind11::array::forcecast> ArrayType;
+
+            ArrayType arr=ArrayType::ensure(ints);
+            if(!arr)
+                throw PulsarException("Integrals from python can't be converted to an array of doubles");
+
+            pydata_=static_cast<const double*>(arr.data());
+            pyints_=arr;
+            return pydata_;
         }
 };
 }
@@ -85,33 +85,23 @@ ByteArray to_byte_array(const T & obj)
  * The C++ object must be serializable
  */
 template<typename T>
-T from_byte_array(const ByteArray & arr)
+T from_byte_array(const char * bytes, size_t size)
 {
-    MemoryArchive mar;
-    mar.from_byte_array(arr);
-    mar.begin_unserialization();
+    ByteSpanArchive ar(bytes, size);
     T obj;
-    mar.unserialize(obj);
-    mar.end_unserialization();
+    ar.unserialize(obj);
     return obj; 
 }
 
 
-
 /*! \brief Create c++ object from a byte array
  *
  * The C++ object must be serializable
  */
 template<typename T>
-T from_byte_array(const char * bytes, size_t size)
+T from_byte_array(const ByteArray & arr)
 {
-    MemoryArchive mar;
-    mar.from_byte_array(bytes, size);
-    mar.begin_unserialization();
-    T obj;
-    mar.unserialize(obj);
-    mar.end_unserialization();
-    return obj; 
+    return from_byte_array<T>(arr.data(), arr.size());
 }
 
 
@@ -122,13 +112,27 @@ T from_byte_array(const char * bytes, size_t size)
 template<typename T>
 std::unique_ptr<T> new_from_byte_array(const ByteArray & arr)
 {
-    MemoryArchive mar;
-    mar.from_byte_array(arr);
-    mar.begin_unserialization();
+    ByteSpanArchive ar(arr);
     std::unique_ptr<T> objptr(new T);
-    mar.unserialize(*objptr);
-    mar.end_unserialization();
-    return std::move(objptr);
+    ar.unserialize(*objptr);
+    return objptr;
+}
+
+
+/*! \brief Create a shared c++ object from a byte array
+ *
+ * The object is unserialized in place (into the same allocation
+ * as the control block), directly from the bytes.
+ *
+ * The C++ object must be serializable
+ */
+template<typename T>
+std::shared_ptr<T> make_shared_from_byte_array(const char * bytes, size_t size)
+{
+    ByteSpanArchive ar(bytes, size);
+    std::shared_ptr<T> objptr = std::make_shared<T>();
+    ar.unserialize(*objptr);
+    return objptr;
 }
 
 
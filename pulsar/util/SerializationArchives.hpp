@@ -9,6 +9,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <streambuf>
 #include <cereal/cereal.hpp>
 #include <cereal/access.hpp>
 #include <cereal/archives/binary.hpp>
@@ -281,9 +282,65 @@ class StdStreamArchive
 
 };
 
+
+
+/*! \brief A read-only stream buffer over existing memory
+ *
+ * The memory is not copied, and must outlive the buffer.
+ */
+class ByteSpanBuf : public std::streambuf
+{
+    public:
+        ByteSpanBuf(const char * data, size_t size)
+        {
+            // The get area is never written to, but streambuf wants non-const pointers
+            char * begin = const_cast<char *>(data);
+            setg(begin, begin, begin + size);
+        }
+};
+
 } // close namespace detail
 
 
+/*! \brief Unserialization of data directly from memory
+ *
+ * Unlike MemoryArchive, the data is not copied into a stream first.
+ * The memory must outlive the archive.
+ */
+class ByteSpanArchive
+{
+    public:
+        ByteSpanArchive(const char * data, size_t size)
+            : buf_(data, size), stream_(&buf_), iarchive_(stream_)
+        { }
+
+        explicit ByteSpanArchive(const ByteArray & arr)
+            : ByteSpanArchive(arr.data(), arr.size())
+        { }
+
+        ByteSpanArchive(const ByteSpanArchive &)             = delete;
+        ByteSpanArchive & operator=(const ByteSpanArchive &) = delete;
+
+
+        /*! \brief Extract data from the archive
+         *
+         * \throw cereal::Exception if there isn't enough data
+         */
+        template<typename... Targs>
+        void unserialize(Targs &... args)
+        {
+            iarchive_(args...);
+        }
+
+
+    private:
+        detail::ByteSpanBuf buf_;
+        std::istream stream_;
+        cereal::BinaryInputArchive iarchive_;
+};
+
+
+
 /// Serialization of data to/from memory
 class MemoryArchive : public detail::StdStreamArchive<std::stringstream>
 {
@@ -0,0 +1,113 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/datastore/CacheMap.hpp>
+
+#include <atomic>
+#include <chrono>
+
+using namespace pulsar;
+using namespace std;
+
+// Number of entries stored in the cache
+static const size_t nkeys = 1024;
+
+// Number of lookups done by each thread (fewer unless running
+// the full benchmark)
+static size_t nlookups = 200000;
+
+// Precomputed keys for the entries, and for keys that don't exist
+static vector<CacheKey> keys, not_keys;
+
+/* Each thread looks up (mostly) existing keys in the cache, plus
+ * a key that doesn't exist every 8th lookup. Returns the number of
+ * lookups that returned the wrong thing.
+ *
+ * If precomputed is false, the string keys are formed and used
+ * for every lookup.
+ */
+static size_t lookup_thread(CacheMap & cm, size_t seed, bool precomputed)
+{
+    size_t nwrong = 0;
+
+    for(size_t i = 0; i < nlookups; i++)
+    {
+        const size_t k = (seed + i*7919) % nkeys;
+
+        if(i % 8 == 0)
+        {
+            auto p = precomputed ? cm.get<size_t>(not_keys[k], false)
+                                 : cm.get<size_t>("not_a_key_" + to_string(k), false);
+            if(p)
+                nwrong++;
+        }
+        else
+        {
+            auto p = precomputed ? cm.get<size_t>(keys[k], false)
+                                 : cm.get<size_t>("key_" + to_string(k), false);
+            if(!p || *p != k)
+                nwrong++;
+        }
+    }
+
+    return nwrong;
+}
+
+// Runs the lookups with increasing numbers of threads
+static void run_lookups(CppTester & tester, CacheMap & cm, bool precomputed)
+{
+    size_t maxthreads = std::max<size_t>(thread::hardware_concurrency(), 1);
+    if(!full_benchmark())
+        maxthreads = std::min<size_t>(maxthreads, 4);
+    const string keytype = precomputed ? "precomputed" : "string";
+
+    double base_rate = 0.0;
+    for(size_t nthreads = 1; nthreads <= maxthreads; nthreads *= 2)
+    {
+        atomic<size_t> nwrong(0);
+        vector<thread> threads;
+
+        auto start = chrono::steady_clock::now();
+
+        for(size_t t = 0; t < nthreads; t++)
+            threads.emplace_back([&cm, &nwrong, t, precomputed](void)
+                                 { nwrong += lookup_thread(cm, t, precomputed); });
+
+        for(auto & t : threads)
+            t.join();
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+        const double rate = static_cast<double>(nthreads*nlookups)/elapsed.count();
+        if(nthreads == 1)
+            base_rate = rate;
+
+        print_global_output("%8?  %12?  %12.4?  %14.1?  %8.2?\n", nthreads, keytype,
+                            elapsed.count(), rate, rate/base_rate);
+
+        tester.test_equal("Lookups with " + to_string(nthreads) + " threads and " +
+                          keytype + " keys", 0, nwrong.load());
+    }
+}
+
+TEST_SIMPLE(BenchCacheMap){
+    CppTester tester("Benchmarking multithreaded CacheMap lookups");
+
+    if(!full_benchmark())
+        nlookups = 10000;
+
+    CacheMap cm;
+    for(size_t i = 0; i < nkeys; i++)
+    {
+        cm.set("key_" + to_string(i), i, CacheMap::NoPolicy);
+        keys.push_back(cm.make_key("key_" + to_string(i)));
+        not_keys.push_back(cm.make_key("not_a_key_" + to_string(i)));
+    }
+
+    tester.test_equal("Cache is filled", nkeys, cm.size());
+
+    print_global_output("%8?  %12?  %12?  %14?  %8?\n", "Threads", "Keys", "Time (s)", "Lookups/sec", "Speedup");
+    run_lookups(tester, cm, false);
+    run_lookups(tester, cm, true);
+
+    tester.print_results();
+    return tester.nfailed();
+}
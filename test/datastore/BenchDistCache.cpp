@@ -0,0 +1,159 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/datastore/CacheMap.hpp>
+#include <pulsar/parallel/Parallel.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace pulsar;
+using namespace std;
+
+// Number of entries stored by each rank, and the number of doubles
+// in each entry (fewer unless running the full benchmark)
+static size_t nkeys = 256;
+static size_t nelements = 1024;
+
+// Tag used by the synchronization
+static const int sync_tag = 100;
+
+static string key_name(long rank, size_t i)
+{
+    return "rank" + to_string(rank) + "_key" + to_string(i);
+}
+
+static double key_value(long rank, size_t i)
+{
+    return static_cast<double>(rank*nkeys + i);
+}
+
+// Entries hold whole numbers, so a value within 0.5 is a match
+static bool has_key_value(const vector<double> & v, long rank, size_t i)
+{
+    return !v.empty() && fabs(v[0] - key_value(rank, i)) < 0.5;
+}
+
+// The sync thread of another rank may need our GIL to answer
+// its requests, so it is released during collectives
+static void barrier(void)
+{
+    pybind11::gil_scoped_release nogil;
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+static unsigned long allreduce(unsigned long value, MPI_Op op)
+{
+    pybind11::gil_scoped_release nogil;
+    unsigned long ret = 0;
+    MPI_Allreduce(&value, &ret, 1, MPI_UNSIGNED_LONG, op, MPI_COMM_WORLD);
+    return ret;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+TEST_SIMPLE(BenchDistCache){
+    CppTester tester("Benchmarking the distributed cache");
+
+    if(!full_benchmark())
+    {
+        nkeys = 32;
+        nelements = 128;
+    }
+
+    const long rank = get_proc_id();
+    const long nproc = get_nproc();
+    const long neighbor = (rank + 1) % nproc;
+
+    CacheMap cm;
+    cm.start_sync(sync_tag);
+
+    // Each rank stores its own entries
+    for(size_t i = 0; i < nkeys; i++)
+        cm.set(key_name(rank, i), vector<double>(nelements, key_value(rank, i)),
+               CacheMap::DistributeGlobal);
+
+    cm.flush_sync();
+    barrier();
+
+    // 1. Obtain half of the entries of the next rank, one at a time
+    vector<double> latencies;
+    size_t nwrong = 0;
+    for(size_t i = 0; i < nkeys/2; i++)
+    {
+        const CacheKey key = cm.make_key(key_name(neighbor, i));
+
+        auto start = chrono::steady_clock::now();
+        auto p = cm.get<vector<double>>(key, true);
+        latencies.push_back(elapsed_since(start));
+
+        if(!p || p->size() != nelements || !has_key_value(*p, neighbor, i))
+            nwrong++;
+    }
+
+    tester.test_equal("Single remote gets", 0, nwrong);
+
+    sort(latencies.begin(), latencies.end());
+    print_global_output("Rank %?: remote get latency (us): median %10.2?  max %10.2?\n",
+                        rank, 1e6*latencies[latencies.size()/2], 1e6*latencies.back());
+
+    // 2. Obtain the other half with a single prefetch
+    vector<CacheKey> batch;
+    for(size_t i = nkeys/2; i < nkeys; i++)
+        batch.push_back(cm.make_key(key_name(neighbor, i)));
+
+    auto start = chrono::steady_clock::now();
+    const size_t nprefetched = cm.prefetch(batch);
+    const double prefetch_time = elapsed_since(start);
+
+    print_global_output("Rank %?: prefetch of %? entries: %10.4? s  (%12.1? entries/s)\n",
+                        rank, batch.size(), prefetch_time,
+                        static_cast<double>(batch.size())/prefetch_time);
+
+    if(nproc > 1)
+        tester.test_equal("Prefetched entries", batch.size(), nprefetched);
+
+    nwrong = 0;
+    for(size_t i = 0; i < batch.size(); i++)
+    {
+        auto p = cm.get<vector<double>>(batch[i], false);
+        if(!p || !has_key_value(*p, neighbor, nkeys/2 + i))
+            nwrong++;
+    }
+    tester.test_equal("Prefetched entries are correct", 0, nwrong);
+
+    // 3. Directory lookups of keys that no rank has
+    vector<CacheKey> missing;
+    for(size_t i = 0; i < nkeys; i++)
+        missing.push_back(cm.make_key("missing_" + key_name(rank, i)));
+
+    start = chrono::steady_clock::now();
+    const size_t nmissing = cm.prefetch(missing);
+    const double query_time = elapsed_since(start);
+
+    tester.test_equal("Missing keys are not found", 0, nmissing);
+    print_global_output("Rank %?: directory queries: %12.1? keys/s\n",
+                        rank, static_cast<double>(missing.size())/query_time);
+
+    // 4. The directory should be spread over all ranks
+    cm.flush_sync();
+    barrier();
+
+    const unsigned long ndir = cm.stats().ndirectory;
+    const unsigned long ndir_total = allreduce(ndir, MPI_SUM);
+    const unsigned long ndir_max = allreduce(ndir, MPI_MAX);
+
+    print_global_output("Rank %?: directory entries: %? (total %?, max on a rank %?)\n",
+                        rank, ndir, ndir_total, ndir_max);
+    tester.test_equal("All keys are in the directory", nproc*nkeys, ndir_total);
+
+    cm.stop_sync();
+
+    tester.test_equal("Nothing in the directory after stopping", 0, cm.stats().ndirectory);
+
+    tester.print_results();
+    return tester.nfailed();
+}
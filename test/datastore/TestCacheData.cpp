@@ -20,7 +20,9 @@ TEST_SIMPLE(TestCacheData){
     tester.test_member_return("get_keys",true,keys,&CacheData::get_keys,&cd1);
     shared_ptr<const Vector> pv1=cd1.get<Vector>(key,false),pv2;
     tester.test_equal("get valid key works",v1,*pv1);
-    tester.test_member_return("get invalid key works",true,pv2,&CacheData::get<Vector>,&cd1,not_key,false);
+    auto get_vec=static_cast<shared_ptr<const Vector>(CacheData::*)(const string &,bool)>(&CacheData::get<Vector>);
+    auto erase_str=static_cast<size_t(CacheData::*)(const string &)>(&CacheData::erase);
+    tester.test_member_return("get invalid key works",true,pv2,get_vec,&cd1,not_key,false);
     cd1.set(key,v2,policy);
     pv1=cd1.get<Vector>(key,false);
     tester.test_equal("set overwrites",v2,*pv1);
@@ -30,9 +32,30 @@ TEST_SIMPLE(TestCacheData){
     cd1=move(cd2);
     pv1=cd1.get<Vector>(key,false);
     tester.test_equal("move assignment works",v2,*pv1);
-    tester.test_member_call("erase",true,&CacheData::erase,&cd1,key);
+    tester.test_member_call("erase",true,erase_str,&cd1,key);
     tester.test_member_return("erase works",true,0,&CacheData::size,&cd1);
 
+    // Precomputed keys
+    const CacheKey ck=cd1.make_key(key);
+    cd1.set(ck,v1,policy);
+    tester.test_member_return("set w/precomputed key",true,1,&CacheData::size,&cd1);
+    pv1=cd1.get<Vector>(key,false);
+    tester.test("get w/string key",pv1 && *pv1==v1);
+    CacheData cd3(&cm1,"other module");
+    tester.test("modules are separate",cd3.get<Vector>(key,false)==nullptr);
+    cd3.set(key,v2,policy);
+    cd3.set(not_key,v2,policy);
+    pv1=cd3.get<Vector>(cd3.make_key(key),false);
+    tester.test("get w/precomputed key",pv1 && *pv1==v2);
+    tester.test_member_return("size of other module",true,2,&CacheData::size,&cd3);
+    tester.test_member_return("clear",true,2,&CacheData::clear,&cd3);
+    tester.test_member_return("clear leaves other modules",true,1,&CacheData::size,&cd1);
+    tester.test_member_return("cleared",true,0,&CacheData::size,&cd3);
+    pv1=cd3.get_or_compute(key,policy,[&v1](void){ return v1; });
+    tester.test("get_or_compute computes",pv1 && *pv1==v1);
+    pv1=cd3.get_or_compute(key,policy,[&v2](void){ return v2; });
+    tester.test("get_or_compute uses the stored data",pv1 && *pv1==v1);
+
 
     tester.print_results();
     return tester.nfailed();
@@ -20,5 +20,8 @@ def run_test():
     tester.test_return("set overwrites",True,v2,cd1.get,key,False)
     tester.test_call("erase",True,cd1.erase,key)
     tester.test_return("erase works",True,0,cd1.size)
+    cd1.set(key,v1,policy)
+    tester.test_return("clear",True,1,cd1.clear)
+    tester.test_return("clear works",True,0,cd1.size)
     tester.print_results()
     return tester.nfailed()
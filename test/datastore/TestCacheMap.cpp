@@ -1,9 +1,40 @@
 #include <pulsar/testing/CppTester.hpp>
 #include <pulsar/datastore/CacheMap.hpp>
+#include <pulsar/modulemanager/CheckpointIO.hpp>
+#include <pulsar/datastore/Wavefunction.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 using namespace pulsar;
 using namespace std;
 
+// Checkpoint backend that just stores everything in memory
+class MemoryCheckpointIO : public CheckpointIO
+{
+    public:
+        size_t nopened = 0;
+
+        virtual void open(void) { nopened++; }
+        virtual void close(void) { }
+        virtual size_t count(const std::string & key) const { return data_.count(key); }
+        virtual std::set<std::string> all_keys(void) const
+        {
+            std::set<std::string> keys;
+            for(const auto & it : data_)
+                keys.insert(it.first);
+            return keys;
+        }
+        virtual void write(const std::string & key, const ByteArray & data) { data_[key] = data; }
+        virtual ByteArray read(const std::string & key) const { return data_.at(key); }
+        virtual void erase(const std::string & key) { data_.erase(key); }
+        virtual void clear(void) { data_.clear(); }
+
+    private:
+        std::map<std::string, ByteArray> data_;
+};
+
 TEST_SIMPLE(TestCacheMap){
     CppTester tester("Testing CacheMap class");
 
@@ -16,7 +47,9 @@ TEST_SIMPLE(TestCacheMap){
     const set<string> keys({key});
     tester.test_member_return("get_keys",true,keys,&CacheMap::get_keys,&cm1);
     shared_ptr<const int> pi;
-    tester.test_member_return("get w/non-existent key",true,pi,&CacheMap::get<int>,&cm1,not_key,false);
+    auto get_int=static_cast<shared_ptr<const int>(CacheMap::*)(const string &,bool)>(&CacheMap::get<int>);
+    auto erase_str=static_cast<size_t(CacheMap::*)(const string &)>(&CacheMap::erase);
+    tester.test_member_return("get w/non-existent key",true,pi,get_int,&cm1,not_key,false);
     auto pj=cm1.get<Vector>(key,false);
     tester.test_equal("get_w/real key",v1,*pj);
     tester.test_member_return("size",true,1,&CacheMap::size,&cm1);
@@ -24,13 +57,134 @@ TEST_SIMPLE(TestCacheMap){
 
     pj=cm1.get<Vector>(key,false);
     tester.test_equal("set overwrote",v2,*pj);
-    tester.test_member_call("erase w/non-existent key",true,&CacheMap::erase,&cm1,not_key);
+    tester.test_member_call("erase w/non-existent key",true,erase_str,&cm1,not_key);
     tester.test_member_return("erase did nothing",true,1,&CacheMap::size,&cm1);
-    tester.test_member_call("erase w/real key",true,&CacheMap::erase,&cm1,key);
+    tester.test_member_call("erase w/real key",true,erase_str,&cm1,key);
     tester.test_member_return("erased",true,0,&CacheMap::size,&cm1);
     tester.test_member_call("clear",true,&CacheMap::clear,&cm1);
     tester.test_member_return("cleared",true,0,&CacheMap::size,&cm1);
 
+    // Precomputed keys and module ids
+    uint32_t mod1=cm1.module_id("module1"),mod2=cm1.module_id("module2");
+    tester.test("module ids are not zero",mod1!=0 && mod2!=0);
+    tester.test("module ids are unique",mod1!=mod2);
+    tester.test_equal("module ids are stable",mod1,cm1.module_id("module1"));
+    const CacheKey ck1(mod1,key),ck2(mod2,key);
+    tester.test("keys of different modules differ",ck1!=ck2);
+    tester.test("make_key splits the module key",ck1==cm1.make_key("module1%%"+key));
+    tester.test("key without module",CacheKey(0,key)==cm1.make_key(key));
+    const bphash::HashValue hv({0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,
+                                0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10});
+    const CacheKey ckh(mod1,hv);
+    tester.test_equal("hash string of a key","0123456789abcdeffedcba9876543210",ckh.hash_string());
+    tester.test("hash string converts back to the key",ckh==CacheKey(mod1,ckh.hash_string()));
+    cm1.set("module1%%"+key,v1,policy);
+    cm1.set(ck2,v2,policy);
+    cm1.set(ckh,v2,policy);
+    pj=cm1.get<Vector>(ck1,false);
+    tester.test("precomputed key finds string key",pj && *pj==v1);
+    pj=cm1.get<Vector>("module2%%"+key,false);
+    tester.test("string key finds precomputed key",pj && *pj==v2);
+    const set<string> mod1_keys({"module1%%"+key,"module1%%"+ckh.hash_string()});
+    tester.test_member_return("get_module_keys",true,mod1_keys,&CacheMap::get_module_keys,&cm1,mod1);
+    tester.test_member_return("module_size",true,1,&CacheMap::module_size,&cm1,mod2);
+    tester.test_member_return("clear_module",true,2,&CacheMap::clear_module,&cm1,mod1);
+    tester.test_member_return("other modules are kept",true,1,&CacheMap::size,&cm1);
+    cm1.clear();
+
+    // Memory limits and eviction
+    // Each entry is a vector of 1000 doubles, so a bit more than 8000 bytes
+    CacheMap cm2;
+    const Vector big(1000, 1.0);
+    cm2.set_max_bytes(4*8500+4250);
+    tester.test_member_return("max_bytes",true,4*8500+4250,&CacheMap::max_bytes,&cm2);
+    for(int i = 0; i < 4; i++)
+        cm2.set("Big" + to_string(i), big, policy);
+    tester.test_member_return("all fit within limit",true,4,&CacheMap::size,&cm2);
+    tester.test("get does a hit", cm2.get<Vector>("Big0",false) != nullptr);
+    cm2.set("Big4", big, policy);
+    tester.test_member_return("entry evicted",true,4,&CacheMap::size,&cm2);
+    tester.test("least recently used was evicted", cm2.get<Vector>("Big1",false) == nullptr);
+    tester.test("recently used was not evicted", cm2.get<Vector>("Big0",false) != nullptr);
+    tester.test("new entry was not evicted", cm2.get<Vector>("Big4",false) != nullptr);
+    auto st = cm2.stats();
+    tester.test_equal("number of hits",3,st.nhits);
+    tester.test_equal("number of misses",1,st.nmisses);
+    tester.test_equal("number of evictions",1,st.nevicted);
+    tester.test("within memory budget",st.nbytes <= st.max_bytes);
+
+    // Spilling to a backend
+    CacheMap cm3;
+    auto spill=make_shared<MemoryCheckpointIO>();
+    cm3.set_spill_backend(spill);
+    cm3.set_max_bytes(2*8500);
+    cm3.set("Spill0", big, CacheMap::CheckpointLocal);
+    cm3.set("Drop1", big, policy);
+    cm3.set("Big2", big, policy);
+    tester.test_member_return("spilled entries are counted",true,2,&CacheMap::size,&cm3);
+    tester.test("entry without policy is dropped", cm3.get<Vector>("Drop1",false) == nullptr);
+    const set<string> spill_keys({"Big2","Spill0"});
+    tester.test_member_return("spilled keys are listed",true,spill_keys,&CacheMap::get_keys,&cm3);
+    cm3.set("Drop1", big, policy);
+    cm3.set("Big3", big, policy);
+    pj=cm3.get<Vector>("Spill0",false);
+    tester.test("spilled entry is reloaded", pj && *pj == big);
+    st = cm3.stats();
+    tester.test_equal("number of reloads",1,st.nreloaded);
+    tester.test("reloaded entry is removed from the backend", spill->all_keys().empty());
+    tester.test_equal("backend is only opened once",1,spill->nopened);
+
+    // Data held through pointers counts towards the limit.
+    // A 100x100 matrix is 80000 bytes
+    CacheMap cm5;
+    cm5.set_max_bytes(100000);
+    auto mat=make_shared<IrrepSpinMatrixD>();
+    mat->set(Irrep::A,Spin::alpha,make_shared<EigenMatrixImpl>(Eigen::MatrixXd::Zero(100,100)));
+    tester.test("size of a matrix is estimated", detail::estimate_size(*mat) >= 80000);
+    Wavefunction wfn;
+    wfn.cmat=mat;
+    tester.test("size of a wavefunction is estimated", detail::estimate_size(wfn) >= 80000);
+    cm5.set("Matrix1", mat, policy);
+    tester.test_equal("matrix fits within limit",0,cm5.stats().nevicted);
+    cm5.set("Matrix2", mat, policy);
+    tester.test_equal("large matrix causes eviction",1,cm5.stats().nevicted);
+    tester.test("least recently used matrix was evicted", cm5.get<shared_ptr<IrrepSpinMatrixD>>("Matrix1",false) == nullptr);
+
+    // Single-flight computation
+    CacheMap cm4;
+    atomic<int> ncomputed(0);
+    auto compute=[&ncomputed](void)
+    {
+        ncomputed++;
+        this_thread::sleep_for(chrono::milliseconds(50));
+        return Vector(10, 2.0);
+    };
+    vector<shared_ptr<const Vector>> results(8);
+    vector<thread> threads;
+    for(size_t i = 0; i < results.size(); i++)
+        threads.emplace_back([&cm4,&compute,&results,i,policy](void)
+                             { results[i]=cm4.get_or_compute("Computed",policy,compute); });
+    for(auto & t : threads)
+        t.join();
+    tester.test_equal("computed only once",1,ncomputed.load());
+    bool all_same=true;
+    for(const auto & r : results)
+        all_same = all_same && r && *r==Vector(10, 2.0);
+    tester.test("all threads obtained the result",all_same);
+    tester.test("result is stored",cm4.get<Vector>("Computed",false)!=nullptr);
+    cm4.get_or_compute("Computed",policy,compute);
+    tester.test_equal("stored result is used",1,ncomputed.load());
+    tester.test_equal("lookups shared the computation",results.size()-1,cm4.stats().nshared);
+    bool threw=false;
+    try {
+        cm4.get_or_compute("Failed",policy,[](void) -> Vector { throw runtime_error("failed"); });
+    }
+    catch(const runtime_error &) { threw=true; }
+    tester.test("exception is passed on",threw);
+    tester.test("nothing stored on exception",cm4.get<Vector>("Failed",false)==nullptr);
+    pj=cm4.get_or_compute("Failed",policy,compute);
+    tester.test("computed after a failure",pj && ncomputed==2);
+
     tester.print_results();
     return tester.nfailed();
 }
@@ -0,0 +1,147 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/math/MathSet.hpp>
+
+#include <chrono>
+
+using namespace std;
+using namespace pulsar;
+
+using Universe_t = Universe<double>;
+using BitsetSet_t = MathSet<double, vector<double>, BitsetIndexSet>;
+using TreeSet_t = MathSet<double, vector<double>, TreeIndexSet>;
+
+// Indices in [0, n) that are multiples of stride
+static set<size_t> multiples(size_t n, size_t stride)
+{
+    set<size_t> ret;
+    for(size_t i = 0; i < n; i += stride)
+        ret.insert(ret.end(), i);
+    return ret;
+}
+
+template<typename Set_t>
+static vector<double> contents(const Set_t & s)
+{
+    return vector<double>(s.begin(), s.end());
+}
+
+/* Times each set operation on sets of every second and every third
+ * element of the universe, repeated nrepeat times. Returns the time
+ * per repetition, in ms, of each operation.
+ */
+template<typename Set_t>
+static vector<double> time_operations(const Set_t & a, const Set_t & b, size_t nrepeat,
+                                      vector<vector<double>> & results)
+{
+    vector<double> times;
+    size_t checksum = 0;
+
+    auto time_op = [&](function<Set_t(void)> op)
+    {
+        Set_t result(a.get_universe(), false);
+        const auto start = chrono::steady_clock::now();
+        for(size_t r = 0; r < nrepeat; r++)
+        {
+            result = op();
+            checksum += result.size();
+        }
+        const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        times.push_back(1e3 * elapsed.count() / static_cast<double>(nrepeat));
+        results.push_back(contents(result));
+    };
+
+    time_op([&](void){ return a + b; });
+    time_op([&](void){ return a / b; });
+    time_op([&](void){ return a - b; });
+    time_op([&](void){ return a.complement(); });
+
+    // Iteration and subsets
+    auto start = chrono::steady_clock::now();
+    double sum = 0.0;
+    for(size_t r = 0; r < nrepeat; r++)
+        for(double x : a)
+            sum += x;
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    times.push_back(1e3 * elapsed.count() / static_cast<double>(nrepeat));
+
+    const Set_t ab = a / b;
+    start = chrono::steady_clock::now();
+    for(size_t r = 0; r < nrepeat; r++)
+        checksum += (ab <= a) + (a <= b);
+    elapsed = chrono::steady_clock::now() - start;
+    times.push_back(1e3 * elapsed.count() / static_cast<double>(nrepeat));
+
+    results.push_back({sum, static_cast<double>(checksum)});
+    return times;
+}
+
+TEST_SIMPLE(BenchMathSet){
+    CppTester tester("Benchmarking bitset storage of MathSet");
+
+    // The bitset against the tree across word boundaries
+    auto u = make_shared<Universe_t>();
+    for(size_t i = 0; i < 200; i++)
+        u->insert(static_cast<double>(i));
+    const set<size_t> idx1{0, 1, 63, 64, 65, 127, 128, 199}, idx2{1, 64, 128, 130};
+    BitsetSet_t b1(u, idx1), b2(u, idx2);
+    TreeSet_t t1(u, idx1), t2(u, idx2);
+    tester.test("Size", b1.size() == t1.size() && b2.size() == t2.size());
+    tester.test("Iteration", contents(b1) == contents(t1));
+    tester.test("Union", contents(b1 + b2) == contents(t1 + t2) && (b1 + b2).size() == (t1 + t2).size());
+    tester.test("Intersection", contents(b1 / b2) == contents(t1 / t2) && (b1 / b2).size() == 3);
+    tester.test("Difference", contents(b1 - b2) == contents(t1 - t2) && (b1 - b2).size() == 5);
+    tester.test("Complement", contents(b1.complement()) == contents(t1.complement()) &&
+                              b1.complement().size() == 192);
+    tester.test("Subset", (b1 / b2) <= b2 && !(b1 <= b2) && (b1 / b2) < b1 && !(b1 < b1));
+    tester.test("Equality with a different number of words",
+                BitsetSet_t(u, set<size_t>{1, 2}) == (BitsetSet_t(u, set<size_t>{1, 2, 150}) -
+                                                      BitsetSet_t(u, set<size_t>{150})));
+    tester.test("Empty set", BitsetSet_t(u, false).begin() == BitsetSet_t(u, false).end() &&
+                             BitsetSet_t(u, true).size() == 200);
+    BitsetSet_t moved(b1), movedto(std::move(moved));
+    tester.test("Moved-from set is empty", movedto == b1 && moved.size() == 0 && !moved.count_idx(63));
+    BitsetIndexSet assigned(4, true), source(100, true);
+    assigned = std::move(source);
+    tester.test("Move assignment", assigned.size() == 100 && source.size() == 0 && source.begin() == source.end());
+    tester.test("Partition", contents(b1.partition([](double x){ return x > 64.0; })) ==
+                             contents(t1.partition([](double x){ return x > 64.0; })));
+
+    print_global_output("%8? %-8? %10? %10? %10? %10? %10? %10?   (ms)\n", "n", "storage",
+                        "union", "inter", "diff", "comp", "iterate", "subset");
+
+    // Only the smaller universes unless running the full benchmark. Smaller
+    // universes are repeated, so that each size processes nelements elements
+    const bool full = full_benchmark();
+    const vector<size_t> sizes = full ? vector<size_t>{1000, 10000, 100000, 1000000}
+                                      : vector<size_t>{1000, 10000};
+    const size_t nelements = full ? 1000000 : 10000;
+
+    for(size_t n : sizes)
+    {
+        auto big = make_shared<Universe_t>();
+        for(size_t i = 0; i < n; i++)
+            big->insert(static_cast<double>(i));
+        const set<size_t> evens = multiples(n, 2), threes = multiples(n, 3);
+        const size_t nrepeat = max<size_t>(1, nelements / n);
+
+        vector<vector<double>> bitsetresults, treeresults;
+        const vector<double> bitsettimes =
+            time_operations(BitsetSet_t(big, evens), BitsetSet_t(big, threes), nrepeat, bitsetresults);
+        const vector<double> treetimes =
+            time_operations(TreeSet_t(big, evens), TreeSet_t(big, threes), nrepeat, treeresults);
+
+        print_global_output("%8? %-8? %10.4? %10.4? %10.4? %10.4? %10.4? %10.4?\n", n, "tree",
+                            treetimes[0], treetimes[1], treetimes[2], treetimes[3], treetimes[4], treetimes[5]);
+        print_global_output("%8? %-8? %10.4? %10.4? %10.4? %10.4? %10.4? %10.4?\n", n, "bitset",
+                            bitsettimes[0], bitsettimes[1], bitsettimes[2], bitsettimes[3], bitsettimes[4], bitsettimes[5]);
+        print_global_output("%8? %-8? %10.1? %10.1? %10.1? %10.1? %10.1? %10.1?\n", "", "speedup",
+                            treetimes[0] / bitsettimes[0], treetimes[1] / bitsettimes[1],
+                            treetimes[2] / bitsettimes[2], treetimes[3] / bitsettimes[3],
+                            treetimes[4] / bitsettimes[4], treetimes[5] / bitsettimes[5]);
+
+        tester.test("Universe of " + to_string(n) + " elements", bitsetresults == treeresults);
+    }
+
+    tester.print_results();
+    return tester.nfailed();
+}
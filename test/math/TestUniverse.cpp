@@ -1,5 +1,6 @@
 #include <pulsar/testing/CppTester.hpp>
 #include <pulsar/math/Universe.hpp>
+#include <pulsar/math/Grid.hpp>
 
 using namespace pulsar;
 using Universe_t=pulsar::Universe<double>;
@@ -108,6 +109,27 @@ TEST_SIMPLE(TestUniverse){
     tester.test_return("proper subset true",true,true,subset2,U11,U8);
     tester.test_return("proper subset false",true,false,subset2,U10,U8);   
     
+    //Replacing elements
+    Universe_t U12={1.0,2.0,3.0,4.0};
+    U12.replace(1,7.0);
+    tester.test_equal("replace",Universe_t({1.0,7.0,3.0,4.0}),U12);
+    tester.test_equal("replace keeps indices",3,U12.idx(4.0));
+    tester.test_equal("replaced element is not present",false,U12.count(2.0));
+    U12.replace({{0,3.0},{2,1.0}});
+    tester.test_equal("replace permutation",Universe_t({3.0,7.0,1.0,4.0}),U12);
+    tester.test_equal("replace permutation index",2,U12.idx(1.0));
+    tester.test_call("replace with a present element",false,[&](void){U12.replace(0,4.0);});
+    tester.test_call("replace with equal elements",false,[&](void){U12.replace({{0,5.0},{1,5.0}});});
+    tester.test_call("replace an index twice",false,[&](void){U12.replace({{0,5.0},{0,6.0}});});
+    tester.test_call("replace out of range",false,[&](void){U12.replace(4,5.0);});
+    tester.test_equal("failed replace leaves universe unchanged",Universe_t({3.0,7.0,1.0,4.0}),U12);
+
+    //0.0 and -0.0 compare equal, so are found either way
+    GridUniverse GU;
+    GU.insert(GridPoint{PointT<double>(0.0,1.0,2.0),0.0});
+    tester.test_equal("grid point with -0.0 is found",true,
+                      GU.count(GridPoint{PointT<double>(-0.0,1.0,2.0),-0.0}));
+
     tester.print_results();
     return tester.nfailed();
     
@@ -0,0 +1,101 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/modulemanager/ModuleManager.hpp>
+#include <pulsar/modulebase/FourCenterIntegral.hpp>
+
+#include <chrono>
+
+using namespace std;
+using namespace pulsar;
+
+// Number of calls to time (fewer unless running the full benchmark)
+static size_t ncalls = 10000000;
+
+// A module that does no work, so only the overhead is timed
+class Empty4CInt:public FourCenterIntegral{
+public:
+    Empty4CInt(ID_t id):FourCenterIntegral(id){}
+private:
+    double result_=0.0;
+
+    void initialize_(unsigned int,
+                     const Wavefunction &,
+                     const BasisSet &,
+                     const BasisSet &,
+                     const BasisSet &,
+                     const BasisSet &)
+    {
+    }
+
+    HashType my_hash_(unsigned int,
+                      const Wavefunction &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &){
+        return "";
+    }
+
+    const double* calculate_(uint64_t s1, uint64_t, uint64_t, uint64_t)
+    {
+        if(s1==ncalls)
+            throw PulsarException("Shell out of range");
+        result_+=1.0;
+        return &result_;
+    }
+};
+
+// Time calling calculate() many times, returning the time per call
+static double time_calls(FourCenterIntegral & mod)
+{
+    auto start=chrono::steady_clock::now();
+    for(size_t i=0;i<ncalls;i++)
+        mod.calculate(i,0,0,0);
+    chrono::duration<double> elapsed=chrono::steady_clock::now()-start;
+    return elapsed.count()/static_cast<double>(ncalls);
+}
+
+TEST_SIMPLE(BenchCallFunction){
+    CppTester tester("Benchmarking the dispatch of hot module calls");
+
+    if(!full_benchmark())
+        ncalls=100000;
+
+    auto mm=make_shared<ModuleManager>();
+    mm->load_lambda_module<Empty4CInt>("FourCenterIntegral","slow_module");
+    mm->load_lambda_module<Empty4CInt>("FourCenterIntegral","fast_module");
+    mm->enable_fast_dispatch("fast_module",true);
+
+    auto slow=mm->get_module<FourCenterIntegral>("slow_module",0);
+    auto fast=mm->get_module<FourCenterIntegral>("fast_module",0);
+
+    tester.test("Fast dispatch is off by default",!slow->fast_dispatch_enabled());
+    tester.test("Fast dispatch can be enabled",fast->fast_dispatch_enabled());
+
+    Wavefunction wfn;
+    BasisSet bs;
+    fast->initialize(0,wfn,bs,bs,bs,bs);
+    slow->initialize(0,wfn,bs,bs,bs,bs);
+
+    const double slow_time=time_calls(*slow);
+    const double fast_time=time_calls(*fast);
+
+    print_global_output("call_function:      %8.2? ns per call\n",1e9*slow_time);
+    print_global_output("call_function_fast: %8.2? ns per call\n",1e9*fast_time);
+
+    tester.test_double("Fast dispatch calls the module",
+                       static_cast<double>(ncalls),*fast->calculate(1,0,0,0)-1.0);
+
+    // Exceptions still get information about the module
+    bool has_info=false;
+    try {
+        fast->calculate(ncalls,0,0,0);
+    }
+    catch(PulsarException & ex)
+    {
+        has_info=(string(ex.what()).find("fast_module")!=string::npos);
+    }
+    tester.test("Exceptions from fast dispatch have module info",has_info);
+
+    tester.print_results();
+    return tester.nfailed();
+}
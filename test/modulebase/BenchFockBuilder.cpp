@@ -0,0 +1,306 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/modulemanager/ModuleManager.hpp>
+#include <pulsar/modulebase/ReferenceFockBuilder.hpp>
+#include <pulsar/parallel/Parallel.hpp>
+#include <pulsar/constants.h>
+
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace pulsar;
+
+/* Model "integrals" with the permutational symmetry and decay of real ones.
+ *
+ * Each shell quartet gets the contracted (ss|ss) integral of its
+ * primitives (ignoring angular momentum), scaled by a factor depending on
+ * the functions of the bra and ket.
+ */
+class Model4CInt:public FourCenterIntegral{
+public:
+    Model4CInt(ID_t id):FourCenterIntegral(id){}
+private:
+    BasisSet bs_;
+    unique_ptr<ShellPairList> pairs_;
+    vector<double> buffer_;
+
+    void initialize_(unsigned int,
+                     const Wavefunction &,
+                     const BasisSet & bs,
+                     const BasisSet &,
+                     const BasisSet &,
+                     const BasisSet &)
+    {
+        bs_=bs;
+        pairs_.reset(new ShellPairList(bs,bs));
+        const size_t nmax=bs.max_n_functions();
+        buffer_.resize(nmax*nmax*nmax*nmax);
+    }
+
+    HashType my_hash_(unsigned int,
+                      const Wavefunction &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &){
+        return "";
+    }
+
+    size_t pair_index(uint64_t i, uint64_t j) const
+    {
+        if(i<j)
+            swap(i,j);
+        return i*(i+1)/2+j;
+    }
+
+    double contracted(uint64_t i, uint64_t j, uint64_t k, uint64_t l) const
+    {
+        const ShellPairList & spl=*pairs_;
+        const size_t ij=pair_index(i,j), kl=pair_index(k,l);
+        const BasisSetShell & si=bs_.shell(spl.shell1(ij)), & sj=bs_.shell(spl.shell2(ij));
+        const BasisSetShell & sk=bs_.shell(spl.shell1(kl)), & sl=bs_.shell(spl.shell2(kl));
+
+        double sum=0.0;
+        for(size_t ab=spl.prim_start(ij);ab<spl.prim_start(ij+1);ab++)
+        {
+            const double p=spl.exponent_sum()[ab];
+            const double cab=si.coef(0,spl.prim1()[ab])*sj.coef(0,spl.prim2()[ab])*
+                             spl.prefactor()[ab];
+            for(size_t cd=spl.prim_start(kl);cd<spl.prim_start(kl+1);cd++)
+            {
+                const double q=spl.exponent_sum()[cd];
+                const double ccd=sk.coef(0,spl.prim1()[cd])*sl.coef(0,spl.prim2()[cd])*
+                                 spl.prefactor()[cd];
+                const double dx=spl.center_x()[ab]-spl.center_x()[cd];
+                const double dy=spl.center_y()[ab]-spl.center_y()[cd];
+                const double dz=spl.center_z()[ab]-spl.center_z()[cd];
+                const double T=p*q/(p+q)*(dx*dx+dy*dy+dz*dz);
+                const double F0=(T<1e-12) ? 1.0 : 0.5*sqrt(PI/T)*erf(sqrt(T));
+                sum+=cab*ccd*2.0*pow(PI,2.5)/(p*q*sqrt(p+q))*F0;
+            }
+        }
+        return sum;
+    }
+
+    const double* calculate_(uint64_t i, uint64_t j, uint64_t k, uint64_t l)
+    {
+        const double V=contracted(i,j,k,l);
+        const size_t ni=bs_.shell(i).n_functions(), nj=bs_.shell(j).n_functions();
+        const size_t nk=bs_.shell(k).n_functions(), nl=bs_.shell(l).n_functions();
+        double * v=buffer_.data();
+        for(size_t a=0;a<ni;a++)
+        for(size_t b=0;b<nj;b++)
+        for(size_t c=0;c<nk;c++)
+        for(size_t d=0;d<nl;d++)
+            *v++=V*(1.0+0.1*static_cast<double>(a+b))*(1.0+0.1*static_cast<double>(c+d));
+        return buffer_.data();
+    }
+};
+
+struct AtomCoords{ int Z; double x,y,z; };
+
+// Geometries from lib/systems (in Angstroms)
+static const vector<AtomCoords> water={
+    {1, 0.5080,-0.0515, 0.7596},
+    {8, 0.0248, 0.0050,-0.0574},
+    {1,-0.9021,-0.0284, 0.1521}};
+
+static const vector<AtomCoords> benzene={
+    {1, 1.2194,-0.1652, 2.1600}, {6, 0.6825,-0.0924, 1.2087},
+    {6,-0.7075,-0.0352, 1.1973}, {1,-1.2644,-0.0630, 2.1393},
+    {6,-1.3898, 0.0572,-0.0114}, {1,-2.4836, 0.1021,-0.0204},
+    {6,-0.6824, 0.0925,-1.2088}, {1,-1.2194, 0.1652,-2.1599},
+    {6, 0.7075, 0.0352,-1.1973}, {1, 1.2641, 0.0628,-2.1395},
+    {6, 1.3899,-0.0572, 0.0114}, {1, 2.4836,-0.1022, 0.0205}};
+
+// 6-31G from lib/basis/6-31g.gbs, with SP shells split into S and P
+static vector<BasisShellInfo> shells_631g(int Z)
+{
+    const ShellType type=ShellType::SphericalGaussian;
+    auto shell=[&](int am,vector<double> alpha,vector<double> c)
+    {
+        return BasisShellInfo(type,am,alpha.size(),1,alpha,c);
+    };
+
+    if(Z==1)
+        return {shell(0,{18.7311370,2.8253937,0.6401217},{0.03349460,0.23472695,0.81375733}),
+                shell(0,{0.1612778},{1.0})};
+
+    if(Z==6)
+        return {shell(0,{3047.5249,457.36951,103.94869,29.210155,9.286663,3.163927},
+                        {0.0018347,0.0140373,0.0688426,0.2321844,0.4679413,0.3623120}),
+                shell(0,{7.8682724,1.8812885,0.5442493},{-0.1193324,-0.1608542,1.1434564}),
+                shell(1,{7.8682724,1.8812885,0.5442493},{0.0689991,0.3164240,0.7443083}),
+                shell(0,{0.1687144},{1.0}),
+                shell(1,{0.1687144},{1.0})};
+
+    return {shell(0,{5484.6717,825.23495,188.04696,52.9645,16.89757,5.7996353},
+                    {0.0018311,0.0139501,0.0684451,0.2327143,0.4701930,0.3585209}),
+            shell(0,{15.539616,3.5999336,1.0137618},{-0.1107775,-0.1480263,1.1307670}),
+            shell(1,{15.539616,3.5999336,1.0137618},{0.0708743,0.3397528,0.7271586}),
+            shell(0,{0.2700058},{1.0}),
+            shell(1,{0.2700058},{1.0})};
+}
+
+static BasisSet make_basis(const vector<AtomCoords> & atoms)
+{
+    vector<pair<BasisShellInfo,CoordType>> shells;
+    size_t nprim=0, ncoef=0;
+    for(const auto & atom : atoms)
+    {
+        const CoordType xyz={atom.x/BOHR_RADIUS_ANGSTROMS,
+                             atom.y/BOHR_RADIUS_ANGSTROMS,
+                             atom.z/BOHR_RADIUS_ANGSTROMS};
+        for(const auto & bsi : shells_631g(atom.Z))
+        {
+            shells.emplace_back(bsi,xyz);
+            nprim+=bsi.n_primitives();
+            ncoef+=bsi.n_coefficients();
+        }
+    }
+
+    BasisSet bs(shells.size(),nprim,ncoef,nprim);
+    for(const auto & s : shells)
+        bs.add_shell(s.first,s.second);
+    return bs;
+}
+
+// A symmetric, density-like matrix
+static Eigen::MatrixXd make_density(size_t nbf, double scale)
+{
+    const Eigen::Index n=static_cast<Eigen::Index>(nbf);
+    Eigen::MatrixXd D(n,n);
+    for(Eigen::Index i=0;i<n;i++)
+    for(Eigen::Index j=0;j<n;j++)
+        D(i,j)=scale*exp(-0.1*static_cast<double>((i-j)*(i-j)))/(1.0+0.01*static_cast<double>(i+j));
+    return D;
+}
+
+// J and K from every quartet, without symmetry or screening
+static JKMatrices brute_force_jk(FourCenterIntegral & eri, const BasisSet & bs,
+                                 const Eigen::MatrixXd & D)
+{
+    const Eigen::Index nbf=static_cast<Eigen::Index>(bs.n_functions());
+    JKMatrices ret;
+    ret.J.push_back(Eigen::MatrixXd::Zero(nbf,nbf));
+    ret.K.push_back(Eigen::MatrixXd::Zero(nbf,nbf));
+    Eigen::MatrixXd & J=ret.J[0];
+    Eigen::MatrixXd & K=ret.K[0];
+
+    const uint64_t nshell=bs.n_shell();
+    for(uint64_t i=0;i<nshell;i++)
+    for(uint64_t j=0;j<nshell;j++)
+    for(uint64_t k=0;k<nshell;k++)
+    for(uint64_t l=0;l<nshell;l++)
+    {
+        const double * v=eri.calculate(i,j,k,l);
+        for(size_t a=0;a<bs.shell(i).n_functions();a++)
+        for(size_t b=0;b<bs.shell(j).n_functions();b++)
+        for(size_t c=0;c<bs.shell(k).n_functions();c++)
+        for(size_t d=0;d<bs.shell(l).n_functions();d++,v++)
+        {
+            const Eigen::Index p=static_cast<Eigen::Index>(bs.shell_start(i)+a);
+            const Eigen::Index q=static_cast<Eigen::Index>(bs.shell_start(j)+b);
+            const Eigen::Index r=static_cast<Eigen::Index>(bs.shell_start(k)+c);
+            const Eigen::Index s=static_cast<Eigen::Index>(bs.shell_start(l)+d);
+            J(p,q)+=(*v)*D(r,s);
+            K(p,r)+=(*v)*D(q,s);
+        }
+    }
+    return ret;
+}
+
+static double max_diff(const JKMatrices & a, const JKMatrices & b)
+{
+    double diff=0.0;
+    for(size_t d=0;d<a.J.size();d++)
+    {
+        diff=max(diff,(a.J[d]-b.J[d]).cwiseAbs().maxCoeff());
+        diff=max(diff,(a.K[d]-b.K[d]).cwiseAbs().maxCoeff());
+    }
+    return diff;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed=chrono::steady_clock::now()-start;
+    return elapsed.count();
+}
+
+TEST_SIMPLE(BenchFockBuilder){
+    CppTester tester("Benchmarking the reference J/K builder");
+
+    auto mm=make_shared<ModuleManager>();
+    mm->load_lambda_module<Model4CInt>("FourCenterIntegral","model_eri");
+
+    const size_t nthreads=max<size_t>(get_nthreads(),2);
+    vector<ModulePtr<FourCenterIntegral>> modules;
+    vector<FourCenterIntegral *> eris;
+    for(size_t t=0;t<nthreads;t++)
+    {
+        modules.push_back(mm->get_module<FourCenterIntegral>("model_eri",0));
+        eris.push_back(&(*modules.back()));
+    }
+
+    // Correctness, compared to a calculation without any symmetry
+    const BasisSet bs_water=make_basis(water);
+    for(auto eri : eris)
+        eri->initialize(0,Wavefunction(),bs_water,bs_water,bs_water,bs_water);
+
+    ShellPairList spl_water(bs_water,bs_water);
+    spl_water.compute_bounds(*eris[0]);
+
+    const vector<Eigen::MatrixXd> D_water={make_density(bs_water.n_functions(),1.0),
+                                           make_density(bs_water.n_functions(),0.5)};
+    const JKMatrices ref=brute_force_jk(*eris[0],bs_water,D_water[0]);
+
+    const JKMatrices serial=build_jk({eris[0]},bs_water,spl_water,D_water,0.0);
+    const JKMatrices parallel=build_jk(eris,bs_water,spl_water,D_water,0.0);
+    tester.test("Serial J and K are correct",max_diff(ref,serial)<1e-10);
+    tester.test("Parallel J and K are correct",max_diff(ref,parallel)<1e-10);
+    tester.test("J is linear in the density",
+                (serial.J[1]-0.5*serial.J[0]).cwiseAbs().maxCoeff()<1e-10);
+
+    const JKMatrices screened=build_jk(eris,bs_water,spl_water,D_water,1e-12);
+    tester.test("Screening with a small threshold",max_diff(ref,screened)<1e-10);
+    const JKMatrices all_screened=build_jk(eris,bs_water,spl_water,D_water,1e10);
+    tester.test("Everything screened",all_screened.J[0].cwiseAbs().maxCoeff()<1e-14);
+
+    tester.test_call("No integral modules",false,
+                     [&](void){ build_jk({},bs_water,spl_water,D_water,0.0); });
+    tester.test_call("Wrong density size",false,
+                     [&](void){ build_jk(eris,bs_water,spl_water,
+                                         {make_density(3,1.0)},0.0); });
+    ShellPairList spl_wrong(bs_water,make_basis(benzene));
+    tester.test_call("Shell pairs of two basis sets",false,
+                     [&](void){ build_jk(eris,bs_water,spl_wrong,D_water,0.0); });
+
+    // Timing on a larger molecule (water unless running the full benchmark)
+    const bool full=full_benchmark();
+    const BasisSet bs=make_basis(full ? benzene : water);
+    for(auto eri : eris)
+        eri->initialize(0,Wavefunction(),bs,bs,bs,bs);
+
+    ShellPairList spl(bs,bs);
+    spl.compute_bounds(*eris[0]);
+    const vector<Eigen::MatrixXd> D={make_density(bs.n_functions(),1.0)};
+
+    auto start=chrono::steady_clock::now();
+    const JKMatrices jk1=build_jk({eris[0]},bs,spl,D,1e-12);
+    const double serial_time=elapsed_since(start);
+
+    start=chrono::steady_clock::now();
+    const JKMatrices jkn=build_jk(eris,bs,spl,D,1e-12);
+    const double parallel_time=elapsed_since(start);
+
+    print_global_output("%?/6-31G: %? shells, %? functions\n",full ? "Benzene" : "Water",
+                        bs.n_shell(),bs.n_functions());
+    print_global_output("1 thread:   %10.4? s\n",serial_time);
+    print_global_output("%? threads: %10.4? s  (speedup %6.2?)\n",
+                        nthreads,parallel_time,serial_time/parallel_time);
+
+    tester.test("Serial and parallel results agree",max_diff(jk1,jkn)<1e-8);
+
+    tester.print_results();
+    return tester.nfailed();
+}
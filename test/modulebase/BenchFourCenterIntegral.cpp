@@ -0,0 +1,136 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/modulemanager/ModuleManager.hpp>
+#include <pulsar/modulebase/FourCenterIntegral.hpp>
+
+#include <chrono>
+
+using namespace std;
+using namespace pulsar;
+
+// Cheap "integrals", so that the overhead of the calls dominates
+class Bench4CInt:public FourCenterIntegral{
+public:
+    Bench4CInt(ID_t id):FourCenterIntegral(id){}
+private:
+    BasisSet bs_;
+    vector<double> buffer_;
+
+    void initialize_(unsigned int,
+                     const Wavefunction &,
+                     const BasisSet & bs,
+                     const BasisSet &,
+                     const BasisSet &,
+                     const BasisSet &)
+    {
+        bs_=bs;
+        const size_t nmax=bs.max_n_functions();
+        buffer_.resize(nmax*nmax*nmax*nmax);
+    }
+
+    HashType my_hash_(unsigned int,
+                      const Wavefunction &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &){
+        return "";
+    }
+
+    const double* calculate_(uint64_t s1, uint64_t s2, uint64_t s3, uint64_t s4)
+    {
+        const size_t n=bs_.shell(s1).n_functions()*bs_.shell(s2).n_functions()*
+                       bs_.shell(s3).n_functions()*bs_.shell(s4).n_functions();
+        for(size_t i=0;i<n;i++)
+            buffer_[i]=static_cast<double>(s1+2*s2+3*s3+4*s4+i);
+        return buffer_.data();
+    }
+};
+
+static BasisSet make_basis(size_t nshell)
+{
+    BasisSet bs(nshell,nshell,nshell,3*nshell);
+    for(size_t i=0;i<nshell;i++)
+    {
+        // alternate s and p shells
+        const int am=static_cast<int>(i%2);
+        BasisShellInfo bsi(ShellType::SphericalGaussian,am,1,1,{1.0+i},{1.0});
+        bs.add_shell(bsi,{0.0,0.0,static_cast<double>(i)});
+    }
+    return bs;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed=chrono::steady_clock::now()-start;
+    return elapsed.count();
+}
+
+TEST_SIMPLE(BenchFourCenterIntegral){
+    CppTester tester("Benchmarking batched four-center integrals");
+
+    auto mm=make_shared<ModuleManager>();
+    mm->load_lambda_module<Bench4CInt>("FourCenterIntegral","bench_module");
+    auto mod=mm->get_module<FourCenterIntegral>("bench_module",0);
+
+    // Number of times to loop over all the shell quartets
+    const size_t nrepeat=full_benchmark() ? 20 : 1;
+
+    const BasisSet bs=make_basis(12);
+    mod->initialize(0,Wavefunction(),bs,bs,bs,bs);
+
+    vector<FourCenterIntegral::ShellTuple> quartets;
+    const uint64_t nshell=bs.n_shell();
+    for(uint64_t i=0;i<nshell;i++)
+    for(uint64_t j=0;j<nshell;j++)
+    for(uint64_t k=0;k<nshell;k++)
+    for(uint64_t l=0;l<nshell;l++)
+        quartets.push_back({i,j,k,l});
+
+    size_t nints=0;
+    for(const auto & q : quartets)
+        nints+=bs.shell(q[0]).n_functions()*bs.shell(q[1]).n_functions()*
+               bs.shell(q[2]).n_functions()*bs.shell(q[3]).n_functions();
+
+    vector<double> single(nints), batch(nints);
+    vector<uint64_t> offsets(quartets.size()+1);
+
+    // One call per quartet
+    auto start=chrono::steady_clock::now();
+    for(size_t r=0;r<nrepeat;r++)
+    {
+        size_t pos=0;
+        for(const auto & q : quartets)
+        {
+            const double * ints=mod->calculate(q[0],q[1],q[2],q[3]);
+            const size_t n=bs.shell(q[0]).n_functions()*bs.shell(q[1]).n_functions()*
+                           bs.shell(q[2]).n_functions()*bs.shell(q[3]).n_functions();
+            copy(ints,ints+n,single.data()+pos);
+            pos+=n;
+        }
+    }
+    const double single_time=elapsed_since(start);
+
+    // One call for all of them
+    uint64_t ncalc=0;
+    start=chrono::steady_clock::now();
+    for(size_t r=0;r<nrepeat;r++)
+        ncalc=mod->calculate_batch(quartets,batch.data(),batch.size(),offsets.data());
+    const double batch_time=elapsed_since(start);
+
+    const double nquartets=static_cast<double>(nrepeat*quartets.size());
+    print_global_output("Per-quartet calls: %10.4? s  (%12.1? quartets/s)\n",
+                        single_time,nquartets/single_time);
+    print_global_output("Batched calls:     %10.4? s  (%12.1? quartets/s)\n",
+                        batch_time,nquartets/batch_time);
+
+    tester.test_equal("Number of integrals from a batch",nints,ncalc);
+    tester.test_equal("Batched integrals are the same",single,batch);
+    tester.test("Offset of the first quartet",offsets[0]==0);
+    tester.test_equal("Offset past the last quartet",nints,offsets.back());
+
+    tester.test_call("Buffer that is too small",false,
+                     [&](void){ mod->calculate_batch(quartets,batch.data(),nints-1,offsets.data()); });
+
+    tester.print_results();
+    return tester.nfailed();
+}
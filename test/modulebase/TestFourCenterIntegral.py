@@ -2,6 +2,7 @@ import pulsar as psr
 import numpy as np
 
 Mat1 = [1.1,2.2,3.3]
+Mat2 = np.array([4.4,5.5,6.6])
 
 class Test4CInt(psr.FourCenterIntegral):
     def __init__(self,id):
@@ -16,10 +17,18 @@ class Test4CInt(psr.FourCenterIntegral):
     def my_hash_(self,deriv,wf,bs1,bs2,bs3,bs4):
         return ""
 
+class TestNumPy4CInt(Test4CInt):
+    def __init__(self,id):
+        super(TestNumPy4CInt,self).__init__(id)
+
+    def calculate_(self,shell1,shell2,shell3,shell4):
+        return Mat2
+
 def run_test():
     tester=psr.PyTester("Testing FourCenterIntegral Python Bindings")
     mm=psr.ModuleManager()
     mm.load_lambda_module(Test4CInt,"IntBuilder","test_builder")
+    mm.load_lambda_module(TestNumPy4CInt,"IntBuilder","test_numpy_builder")
     builder=mm.get_module("test_builder",0)
     deriv=1
     wf=psr.Wavefunction()
@@ -29,6 +38,16 @@ def run_test():
     tester.test_call("Can call initialize",True,builder.initialize,deriv,wf,bs,bs,bs,bs)
     temp = builder.calculate(0,0,0,0)
     tester.test_double_vector("Can call calculate",Mat1,temp)
+    tester.test_equal("Integrals are a NumPy array",True,isinstance(temp,np.ndarray))
+    tester.test_equal("Integrals are read-only",False,temp.flags.writeable)
+
+    npbuilder=mm.get_module("test_numpy_builder",0)
+    npbuilder.initialize(deriv,wf,bs,bs,bs,bs)
+    temp = npbuilder.calculate(0,0,0,0)
+    tester.test_double_vector("Can call calculate returning a NumPy array",Mat2,temp)
+    tester.test_equal("NumPy integrals are read-only",False,temp.flags.writeable)
+    npbuilder.calculate(0,0,0,0)
+    tester.test_double_vector("Integrals are valid after another call",Mat2,temp)
 
     tester.print_results()
     return tester.nfailed()
@@ -0,0 +1,214 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/modulemanager/ModuleManager.hpp>
+#include <pulsar/modulebase/StoredFourCenterIntegral.hpp>
+
+#include <cmath>
+
+using namespace std;
+using namespace pulsar;
+
+// Integrals with permutational symmetry, obeying the Schwarz inequality
+// and covering a wide range of magnitudes
+class Counting4CInt:public FourCenterIntegral{
+public:
+    Counting4CInt(ID_t id):FourCenterIntegral(id){}
+    size_t ncalls=0;
+private:
+    BasisSet bs_;
+    vector<double> buffer_;
+
+    void initialize_(unsigned int,
+                     const Wavefunction &,
+                     const BasisSet & bs,
+                     const BasisSet &,
+                     const BasisSet &,
+                     const BasisSet &)
+    {
+        bs_=bs;
+        const size_t nmax=bs.max_n_functions();
+        buffer_.resize(nmax*nmax*nmax*nmax);
+    }
+
+    HashType my_hash_(unsigned int,
+                      const Wavefunction &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &){
+        return "";
+    }
+
+    const double* calculate_(uint64_t i, uint64_t j, uint64_t k, uint64_t l)
+    {
+        ncalls++;
+        const double scale=pow(10.0,-static_cast<double>(i+j+k+l));
+        double * v=buffer_.data();
+        for(size_t a=0;a<bs_.shell(i).n_functions();a++)
+        for(size_t b=0;b<bs_.shell(j).n_functions();b++)
+        for(size_t c=0;c<bs_.shell(k).n_functions();c++)
+        for(size_t d=0;d<bs_.shell(l).n_functions();d++)
+        {
+            const double p=static_cast<double>(bs_.shell_start(i)+a);
+            const double q=static_cast<double>(bs_.shell_start(j)+b);
+            const double r=static_cast<double>(bs_.shell_start(k)+c);
+            const double s=static_cast<double>(bs_.shell_start(l)+d);
+            *v++=scale*((1.0+p+q)*(1.0+r+s)+p*q*r*s);
+        }
+        return buffer_.data();
+    }
+};
+
+static BasisSet make_basis(size_t nshell)
+{
+    BasisSet bs(nshell,nshell,nshell,3*nshell);
+    for(size_t i=0;i<nshell;i++)
+    {
+        // alternate s and p shells
+        const int am=static_cast<int>(i%2);
+        BasisShellInfo bsi(ShellType::SphericalGaussian,am,1,1,{1.0+static_cast<double>(i)},{1.0});
+        bs.add_shell(bsi,{0.0,0.0,static_cast<double>(i)});
+    }
+    return bs;
+}
+
+// Largest difference between the stored and the original integrals
+// for every quartet (in every order)
+static double compare_all(FourCenterIntegralStore & store, FourCenterIntegralStore::Workspace & ws,
+                          FourCenterIntegral & eri, const BasisSet & bs)
+{
+    double diff=0.0;
+    vector<double> expected;
+    const uint64_t nshell=bs.n_shell();
+    for(uint64_t i=0;i<nshell;i++)
+    for(uint64_t j=0;j<nshell;j++)
+    for(uint64_t k=0;k<nshell;k++)
+    for(uint64_t l=0;l<nshell;l++)
+    {
+        const size_t n=bs.shell(i).n_functions()*bs.shell(j).n_functions()*
+                       bs.shell(k).n_functions()*bs.shell(l).n_functions();
+        const double * ints=eri.calculate(i,j,k,l);
+        expected.assign(ints,ints+n);
+
+        const double * stored=store.calculate(eri,ws,i,j,k,l);
+        for(size_t x=0;x<n;x++)
+            diff=max(diff,fabs(stored[x]-expected[x]));
+    }
+    return diff;
+}
+
+// A StoredFourCenterIntegral module storing counting_eri, initialized with bs
+static ModulePtr<StoredFourCenterIntegral> make_stored(ModuleManager & mm, const string & tier,
+                                                       const BasisSet & bs)
+{
+    auto stored=mm.get_module<StoredFourCenterIntegral>("stored_eri",0);
+    OptionMap & opt=stored->options();
+    opt.add_option("KEY_FOUR_CENTER",OptionType::String,true,pybind11::none(),"",pybind11::none());
+    opt.add_option("STORAGE_TIER",OptionType::String,false,pybind11::none(),"",pybind11::none());
+    opt.change("KEY_FOUR_CENTER",string("counting_eri"));
+    opt.change("STORAGE_TIER",tier);
+    stored->initialize(0,Wavefunction(),bs,bs,bs,bs);
+    return stored;
+}
+
+TEST_SIMPLE(TestStoredFourCenterIntegral){
+    CppTester tester("Testing storage of four-center integrals");
+
+    auto mm=make_shared<ModuleManager>();
+    mm->load_lambda_module<Counting4CInt>("FourCenterIntegral","counting_eri");
+    auto eri=mm->get_module<FourCenterIntegral>("counting_eri",0);
+    Counting4CInt & counter=dynamic_cast<Counting4CInt &>(*eri);
+
+    const BasisSet bs=make_basis(6);
+    eri->initialize(0,Wavefunction(),bs,bs,bs,bs);
+
+    ShellPairList pairs(bs,bs);
+    pairs.compute_bounds(*eri);
+    const size_t estimate=FourCenterIntegralStore::estimate_size(pairs,1,1e-12);
+    tester.test("Estimated size",estimate>0);
+    tester.test("Small stores are kept in memory",
+                choose_storage_tier(estimate,false)==IntegralStorageTier::Memory);
+    tester.test("Fewer quartets with a larger precision",
+                FourCenterIntegralStore::estimate_size(pairs,1,1e-3)<estimate);
+
+    const uint64_t nshell=bs.n_shell();
+    const size_t nunique=(nshell*(nshell+1)/2)*(nshell*(nshell+1)/2+1)/2;
+
+    for(auto tier : {IntegralStorageTier::Memory,IntegralStorageTier::Disk})
+    {
+        const string desc=(tier==IntegralStorageTier::Memory) ? "Memory: " : "Disk: ";
+        FourCenterIntegralStore store(bs,pairs,1,tier,1e-12);
+        FourCenterIntegralStore::Workspace ws;
+
+        counter.ncalls=0;
+        const double diff1=compare_all(store,ws,*eri,bs);
+        const size_t ncalls1=counter.ncalls;
+        const double percent1=store.percent_from_storage();
+
+        counter.ncalls=0;
+        const double diff2=compare_all(store,ws,*eri,bs);
+        const auto stats=store.statistics();
+
+        tester.test(desc+"integrals calculated the first time",diff1<1e-12);
+        tester.test(desc+"no slots for quartets below the precision",
+                    store.n_quartets()>0 && store.n_quartets()<nunique);
+        tester.test(desc+"significant quartets calculated once",
+                    ncalls1==nshell*nshell*nshell*nshell+store.n_quartets());
+        tester.test(desc+"most integrals stored on the first pass",percent1>50.0 && percent1<100.0);
+        tester.test(desc+"stored integrals are correct",diff2<1e-12);
+        tester.test(desc+"nothing calculated the second time",counter.ncalls==nshell*nshell*nshell*nshell);
+        tester.test(desc+"integrals are packed",
+                    stats.n_bytes<nunique*bs.max_n_functions()*bs.max_n_functions()*
+                                  bs.max_n_functions()*bs.max_n_functions()*sizeof(double));
+        tester.test(desc+"statistics",stats.n_from_storage<=stats.n_requested && stats.tier==tier);
+    }
+
+    FourCenterIntegralStore recompute(bs,pairs,1,IntegralStorageTier::Recompute,1e-12);
+    FourCenterIntegralStore::Workspace ws;
+    compare_all(recompute,ws,*eri,bs);
+    tester.test("Recompute: nothing stored",recompute.percent_from_storage()<1e-12);
+
+    {
+        FourCenterIntegralStore indir(bs,pairs,1,IntegralStorageTier::Disk,1e-12,".");
+        FourCenterIntegralStore::Workspace dirws;
+        tester.test("Disk: file in a directory",compare_all(indir,dirws,*eri,bs)<1e-12);
+    }
+    tester.test_call("Disk: invalid directory",false,
+                     [&](void){ FourCenterIntegralStore(bs,pairs,1,IntegralStorageTier::Disk,
+                                                        1e-12,"/nonexistent/dir"); });
+    tester.test_call("No Schwarz bounds",false,
+                     [&](void){ FourCenterIntegralStore(bs,ShellPairList(bs,bs),1,
+                                                        IntegralStorageTier::Memory,1e-12); });
+
+    // Through the module
+    mm->load_lambda_module<StoredFourCenterIntegral>("StoredFourCenterIntegral","stored_eri");
+    auto stored=make_stored(*mm,"AUTO",bs);
+    tester.test("Module: small stores are kept in memory",
+                stored->storage_statistics().tier==IntegralStorageTier::Memory);
+
+    double diff=0.0;
+    for(uint64_t i=0;i<nshell;i++)
+    for(uint64_t j=0;j<nshell;j++)
+    {
+        const size_t n=bs.shell(i).n_functions()*bs.shell(j).n_functions();
+        const double * ints=eri->calculate(i,j,j,i);
+        const vector<double> expected(ints,ints+n*n);
+        ints=stored->calculate(i,j,j,i);
+        for(size_t x=0;x<n*n;x++)
+            diff=max(diff,fabs(ints[x]-expected[x]));
+    }
+    tester.test("Module: integrals are correct",diff<1e-12);
+
+    auto other=make_stored(*mm,"AUTO",bs);
+    tester.test("Module: modules share storage",
+                other->storage_statistics().n_requested==stored->storage_statistics().n_requested &&
+                other->storage_statistics().n_requested>0);
+
+    auto notstored=make_stored(*mm,"RECOMPUTE",bs);
+    tester.test_call("Module: nothing stored for RECOMPUTE",false,
+                     [&](void){ notstored->storage_statistics(); });
+    tester.test_call("Module: unknown tier",false,
+                     [&](void){ make_stored(*mm,"NOT_A_TIER",bs); });
+
+    tester.print_results();
+    return tester.nfailed();
+}
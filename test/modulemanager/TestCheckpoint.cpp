@@ -1,6 +1,7 @@
 #include <pulsar/testing/CppTester.hpp>
 #include <pulsar/modulemanager/Checkpoint.hpp>
 #include <pulsar/modulemanager/checkpoint_backends/BDBCheckpointIO.hpp>
+#include <pulsar/modulemanager/checkpoint_backends/MappedCheckpointIO.hpp>
 #include <pulsar/modulebase/TestModule.hpp>
 #include <pulsar/system/Atom.hpp>
 
@@ -44,18 +45,33 @@ bool CXXModule::was_called=false;
 
 TEST_SIMPLE(TestCheckpoint){
     CppTester tester("Testing the Checkpoint class");
-    for(size_t i=0;i<2;++i)
+    for(size_t b=0;b<3;++b)
     {
-        Checkpoint mychk(make_shared<BDBCheckpointIO>("local"),
-                         make_shared<BDBCheckpointIO>("global"));
-        auto pmm=make_shared<ModuleManager>();
-        ModuleManager& mm=*pmm;
-        mm.load_lambda_module<CXXModule>("C++ Module","Module");
-        if(i==1)mychk.load_local_cache(mm);
-        auto my_mod=mm.get_module<TestModule>("Module",0);
-        auto msg=(i==0?"Checkpointing results":"Reading checkpoint");
-        tester.test_member_call(msg,true,&TestModule::run_test,my_mod.operator->());
-        if(i==0)mychk.save_local_cache(mm);
+        CXXModule::was_called=false;
+        for(size_t i=0;i<2;++i)
+        {
+            shared_ptr<CheckpointIO> local,global;
+            if(b==0)
+            {
+                local=make_shared<BDBCheckpointIO>("local");
+                global=make_shared<BDBCheckpointIO>("global");
+            }
+            else
+            {
+                local=make_shared<MappedCheckpointIO>(b==1?"local_mapped":"local_lazy");
+                global=make_shared<MappedCheckpointIO>(b==1?"global_mapped":"global_lazy");
+            }
+            Checkpoint mychk(local,global);
+            mychk.set_lazy_restore(b==2);
+            auto pmm=make_shared<ModuleManager>();
+            ModuleManager& mm=*pmm;
+            mm.load_lambda_module<CXXModule>("C++ Module","Module");
+            if(i==1)mychk.load_local_cache(mm);
+            auto my_mod=mm.get_module<TestModule>("Module",0);
+            auto msg=(i==0?"Checkpointing results":"Reading checkpoint");
+            tester.test_member_call(msg,true,&TestModule::run_test,my_mod.operator->());
+            if(i==0)mychk.save_local_cache(mm);
+        }
     }
     tester.print_results();
     return tester.nfailed();
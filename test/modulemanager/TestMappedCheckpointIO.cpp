@@ -0,0 +1,138 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/modulemanager/checkpoint_backends/MappedCheckpointIO.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+using namespace pulsar;
+
+static const string path = "mapped_checkpoint.dat";
+
+static ByteArray make_data(size_t size, char start)
+{
+    ByteArray ret(size);
+    for(size_t i = 0; i < size; i++)
+        ret[i] = static_cast<char>(start + static_cast<char>(i % 64));
+    return ret;
+}
+
+static ByteArray view_bytes(const CheckpointView & view)
+{
+    return ByteArray(view.data.get(), view.data.get() + view.size);
+}
+
+// Remove the last n bytes of a file
+static void chop_file(const string & filepath, size_t n)
+{
+    ifstream in(filepath, ios::binary);
+    ByteArray contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+
+    ofstream out(filepath, ios::binary | ios::trunc);
+    out.write(contents.data(), static_cast<streamsize>(contents.size() - n));
+}
+
+TEST_SIMPLE(TestMappedCheckpointIO){
+    CppTester tester("Testing the memory-mapped checkpoint backend");
+
+    remove(path.c_str());
+
+    const ByteArray small = make_data(100, 'a');
+    const ByteArray large = make_data(200000, 'A');
+    const ByteArray small2 = make_data(37, '0');
+
+    CheckpointView large_view{nullptr, 0};
+
+    {
+        MappedCheckpointIO io(path);
+        tester.test_call("Can't write when not open", false,
+                         [&io, &small](void){ io.write("small", small); });
+
+        io.open();
+        io.write("small", small);
+        io.write("large", large);
+        io.write("small2", small2);
+
+        tester.test_equal("Count of existing key", 1, io.count("small"));
+        tester.test_equal("Count of missing key", 0, io.count("missing"));
+        tester.test_equal("All keys", set<string>{"large", "small", "small2"}, io.all_keys());
+        tester.test_equal("Read buffered data", small2, io.read("small2"));
+        tester.test_equal("Read large data", large, io.read("large"));
+        tester.test_equal("Read view of buffered data", small, view_bytes(io.read_view("small")));
+        tester.test_call("Can't read missing key", false,
+                         [&io](void){ io.read("missing"); });
+        tester.test_call("Can't write an empty key", false,
+                         [&io, &small](void){ io.write("", small); });
+
+        // overwrite and erase
+        io.write("small", small2);
+        io.erase("small2");
+        tester.test_equal("Read overwritten data", small2, io.read("small"));
+        tester.test_equal("Erased key is gone", 0, io.count("small2"));
+
+        io.close();
+
+        // reopening in the same object
+        io.open();
+        tester.test_equal("Keys after reopening", set<string>{"large", "small"}, io.all_keys());
+        large_view = io.read_view("large");
+        io.close();
+    }
+
+    tester.test_equal("View outlives the backend", large, view_bytes(large_view));
+
+    {
+        // Index is read from the end of the file
+        MappedCheckpointIO io(path);
+        io.open();
+        tester.test_equal("Keys from the index", set<string>{"large", "small"}, io.all_keys());
+        tester.test_equal("Data from the index", small2, io.read("small"));
+        tester.test_equal("Large data from the index", large, io.read("large"));
+
+        // Append after reopening
+        io.write("after", small);
+        io.close();
+    }
+
+    {
+        // Without the index, the records are scanned. Chopping off the
+        // trailer and part of the index looks like a crash while closing
+        chop_file(path, 20);
+
+        MappedCheckpointIO io(path);
+        io.open();
+        tester.test_equal("Keys from scanning", set<string>{"after", "large", "small"}, io.all_keys());
+        tester.test_equal("Data from scanning", small, io.read("after"));
+        tester.test_equal("Overwritten data from scanning", small2, io.read("small"));
+
+        const CheckpointView view = io.read_view("large");
+        io.clear();
+        tester.test_equal("No keys after clearing", 0, io.all_keys().size());
+        tester.test_equal("View survives clearing", large, view_bytes(view));
+
+        io.write("new", small);
+        io.close();
+    }
+
+    {
+        MappedCheckpointIO io(path);
+        io.open();
+        tester.test_equal("Keys after clearing and writing", set<string>{"new"}, io.all_keys());
+        io.close();
+    }
+
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << "This is not a checkpoint file";
+    }
+
+    MappedCheckpointIO bad_io(path);
+    tester.test_call("Opening a file with the wrong format", false,
+                     [&bad_io](void){ bad_io.open(); });
+
+    remove(path.c_str());
+
+    tester.print_results();
+    return tester.nfailed();
+}
@@ -56,5 +56,9 @@ def run_test():
     tester.test_call("add lambda module",True,mm.load_lambda_module,MyPyBase,"Py Module",unq_key)
     tester.test_call("can get module from creation funcs",True,mm.get_module,
         unq_key,0)
+    tester.test_call("set cache memory limit",True,mm.set_cache_max_bytes,1000000)
+    stats=mm.cache_stats()
+    tester.test_equal("cache memory limit",1000000,stats.max_bytes)
+    tester.test_equal("cache entries",0,stats.nentries)
     tester.print_results()
     return tester.nfailed()
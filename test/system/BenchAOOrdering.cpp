@@ -0,0 +1,135 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/system/AOOrdering.hpp>
+#include <pulsar/system/NFunction.hpp>
+
+#include <chrono>
+
+using namespace std;
+using namespace pulsar;
+
+// Number of times all labels are looked up (fewer unless running
+// the full benchmark)
+static size_t nrepeat = 20000;
+
+// Largest am used in the benchmarks
+static const int maxam = 6;
+
+// How cartesian_index worked before the lookup tables
+static size_t find_cartesian_index(int am, IJK ijk)
+{
+    const auto & ijkvec = cartesian_ordering(am);
+    const auto it = find(ijkvec.begin(), ijkvec.end(), ijk);
+    if(it == ijkvec.end())
+        throw PulsarException("Value of IJK not found for this am");
+    return static_cast<size_t>(distance(ijkvec.begin(), it));
+}
+
+// How spherical_index worked before the lookup tables
+static size_t find_spherical_index(int am, int m)
+{
+    const auto & svec = spherical_ordering(am);
+    const auto it = find(svec.begin(), svec.end(), m);
+    if(it == svec.end())
+        throw PulsarException("Value of m not found for this am");
+    return static_cast<size_t>(distance(svec.begin(), it));
+}
+
+/* Calls func(am, label) for every label with am in [0, maxam]
+ * nrepeat times. Prints and returns the time per call, in ns.
+ */
+template<typename Label, typename Func>
+double time_lookup(const string & desc, const vector<pair<int, Label>> & labels, Func func)
+{
+    size_t sum = 0;
+    const auto start = chrono::steady_clock::now();
+    for(size_t r = 0; r < nrepeat; r++)
+        for(const auto & it : labels)
+            sum += func(it.first, it.second);
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // sum is printed so the lookups aren't optimized away
+    const double ns = 1e9 * elapsed.count() / static_cast<double>(nrepeat * labels.size());
+    print_global_output("%-40? %8.3? ns / lookup  (checksum %?)\n", desc, ns, sum);
+    return ns;
+}
+
+TEST_SIMPLE(BenchAOOrdering){
+    CppTester tester("Benchmarking lookup of AO orderings and indices");
+
+    if(!full_benchmark())
+        nrepeat = 100;
+
+    // The tables against the generated orderings
+    bool cart_same = true, sph_same = true, cart_idx = true, sph_idx = true;
+    for(int am = PULSAR_MIN_AO_ORDERING_AM; am <= PULSAR_MAX_AO_ORDERING_AM; am++)
+    {
+        const auto & cart = cartesian_ordering(am);
+        const IJK * cartptr = cartesian_ordering_unchecked(am);
+        cart_same = cart_same && cart.size() == static_cast<size_t>(n_cartesian_gaussian(am));
+        for(size_t i = 0; i < cart.size(); i++)
+        {
+            cart_same = cart_same && cart[i] == cartptr[i];
+            cart_idx = cart_idx && cartesian_index(am, cart[i]) == find_cartesian_index(am, cart[i]);
+        }
+
+        const auto & sph = spherical_ordering(am);
+        const int8_t * sphptr = spherical_ordering_unchecked(am);
+        sph_same = sph_same && sph.size() == static_cast<size_t>(n_spherical_gaussian(am));
+        for(size_t i = 0; i < sph.size(); i++)
+        {
+            sph_same = sph_same && sph[i] == sphptr[i];
+            sph_idx = sph_idx && spherical_index(am, sph[i]) == find_spherical_index(am, sph[i]);
+        }
+    }
+    tester.test("Cartesian tables match the generated orderings", cart_same);
+    tester.test("Spherical tables match the generated orderings", sph_same);
+    tester.test("Cartesian indices match the generated orderings", cart_idx);
+    tester.test("Spherical indices match the generated orderings", sph_idx);
+
+    tester.test_call("Cartesian am out of range", false,
+                     [](void){ cartesian_index(PULSAR_MAX_AO_ORDERING_AM+1, IJK{{0, 0, 0}}); });
+    tester.test_call("Spherical am out of range", false,
+                     [](void){ spherical_index(PULSAR_MIN_AO_ORDERING_AM-1, 0); });
+    tester.test_call("IJK not in am", false,
+                     [](void){ cartesian_index(2, IJK{{1, 0, 0}}); });
+    tester.test_call("IJK not in combined am", false,
+                     [](void){ cartesian_index(-1, IJK{{1, 1, 0}}); });
+    tester.test_call("m not in am", false,
+                     [](void){ spherical_index(2, 3); });
+    tester.test_call("m not in combined am", false,
+                     [](void){ spherical_index(-2, -3); });
+    tester.test_call("Ordering am out of range", false,
+                     [](void){ cartesian_ordering(PULSAR_MAX_AO_ORDERING_AM+1); });
+
+    vector<pair<int, IJK>> cartlabels;
+    vector<pair<int, int>> sphlabels;
+    for(int am = 0; am <= maxam; am++)
+    {
+        for(const auto & ijk : cartesian_ordering(am))
+            cartlabels.emplace_back(am, ijk);
+        for(int8_t m : spherical_ordering(am))
+            sphlabels.emplace_back(am, m);
+    }
+
+    const double cart_find = time_lookup("cartesian_index (std::find)", cartlabels, find_cartesian_index);
+    time_lookup("cartesian_index", cartlabels,
+                [](int am, IJK ijk){ return cartesian_index(am, ijk); });
+    const double cart_unchecked = time_lookup("cartesian_index_unchecked", cartlabels,
+                                              [](int am, IJK ijk){ return cartesian_index_unchecked(am, ijk); });
+    print_global_output("    speedup: %.1?\n", cart_find / cart_unchecked);
+
+    const double sph_find = time_lookup("spherical_index (std::find)", sphlabels, find_spherical_index);
+    time_lookup("spherical_index", sphlabels,
+                [](int am, int m){ return spherical_index(am, m); });
+    const double sph_unchecked = time_lookup("spherical_index_unchecked", sphlabels,
+                                             [](int am, int m){ return spherical_index_unchecked(am, m); });
+    print_global_output("    speedup: %.1?\n", sph_find / sph_unchecked);
+
+    time_lookup("cartesian_ordering", cartlabels,
+                [](int am, IJK){ return static_cast<size_t>(cartesian_ordering(am)[0][0]); });
+    time_lookup("cartesian_ordering_unchecked", cartlabels,
+                [](int am, IJK){ return static_cast<size_t>(cartesian_ordering_unchecked(am)[0][0]); });
+
+    tester.print_results();
+    return tester.nfailed();
+}
@@ -0,0 +1,192 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/modulemanager/ModuleManager.hpp>
+#include <pulsar/system/AOReorderPlan.hpp>
+#include <pulsar/system/BasisSet.hpp>
+#include <pulsar/parallel/Parallel.hpp>
+
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace pulsar;
+
+// Number of times each matrix is reordered
+static const size_t nrepeat = 5;
+
+/* An ordering with m_l as 0, 1, -1, 2, -2, ... for spherical
+ * gaussians, and the reverse of the pulsar ordering for cartesian
+ * gaussians. Only non-negative am are included.
+ */
+static AOOrderingMaps make_other_ordering(void)
+{
+    AOOrderingMaps ret;
+    for(const auto & it : all_ao_orderings().spherical_order)
+    {
+        if(it.first < 0)
+            continue;
+        vector<int8_t> m{0};
+        for(int8_t l = 1; l <= it.first; l++)
+        {
+            m.push_back(l);
+            m.push_back(static_cast<int8_t>(-l));
+        }
+        ret.spherical_order[it.first] = m;
+    }
+    for(const auto & it : all_ao_orderings().cartesian_order)
+        if(it.first >= 0)
+            ret.cartesian_order[it.first].assign(it.second.rbegin(), it.second.rend());
+    return ret;
+}
+
+// Shells of s, p, d, and f (spherical and cartesian) until there
+// are at least nfunc functions
+static BasisSet make_basis(size_t nfunc)
+{
+    const int ams[] = {0, 1, 2, 3, 0, 2};
+    const ShellType types[] = {ShellType::SphericalGaussian, ShellType::SphericalGaussian,
+                               ShellType::SphericalGaussian, ShellType::SphericalGaussian,
+                               ShellType::CartesianGaussian, ShellType::CartesianGaussian};
+
+    vector<BasisShellInfo> shells;
+    for(size_t n = 0, i = 0; n < nfunc; i++)
+    {
+        shells.emplace_back(types[i%6], ams[i%6], 1, 1, vector<double>{1.0}, vector<double>{1.0});
+        n += shells.back().n_functions();
+    }
+
+    BasisSet bs(shells.size(), shells.size(), shells.size(), 3*shells.size());
+    for(size_t i = 0; i < shells.size(); i++)
+        bs.add_shell(shells[i], {0.0, 0.0, static_cast<double>(i)});
+    return bs;
+}
+
+static vector<double> make_data(size_t n)
+{
+    vector<double> ret(n);
+    for(size_t i = 0; i < n; i++)
+        ret[i] = static_cast<double>(i);
+    return ret;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Print the throughput (reading and writing each element once)
+static void print_throughput(const string & desc, size_t nelements, double time)
+{
+    const double gbytes = 2.0 * static_cast<double>(nelements*sizeof(double)) * nrepeat / 1e9;
+    print_global_output("%-36? %8.3? ms  %8.3? GB/s\n", desc, 1e3*time/nrepeat, gbytes/time);
+}
+
+TEST_SIMPLE(BenchAOReorderPlan){
+    CppTester tester("Benchmarking reordering of AOs with precomputed plans");
+
+    const BSReorderMap bm = make_basis_reorder_map(all_ao_orderings(), make_other_ordering());
+
+    tester.test_call("Not a permutation", false,
+                     [](void){ AOReorderPlan(vector<size_t>{0, 2, 2}); });
+    tester.test_call("Index out of range", false,
+                     [](void){ AOReorderPlan(vector<size_t>{0, 3, 1}); });
+
+    AOReorderPlan identity(vector<size_t>{0, 1, 2, 3, 4});
+    tester.test("Identity is a single run", identity.is_identity() && identity.n_runs() == 1);
+
+    AOReorderPlan small(vector<size_t>{3, 5, 1, 2, 4, 6, 0});
+    tester.test("Runs", small.n_runs() == 6);
+    tester.test("Cycles", small.n_cycles() == 1);
+    const vector<double> abc = make_data(14);
+    vector<double> out(14), expected(14);
+    small.apply(abc.data(), out.data(), 2, 1);
+    reorder_block(small.ordering(), abc.data(), expected.data(), 2, 1);
+    tester.test("Apply with width", out == expected);
+    out = abc;
+    small.apply_in_place(out.data(), 1, 2);
+    reorder_block(small.ordering(), abc.data(), expected.data(), 1, 2);
+    tester.test("Apply in place with iterations", out == expected);
+
+    auto mm = make_shared<ModuleManager>();
+    const BasisSet smallbs = make_basis(40);
+    auto plan = get_ao_reorder_plan(mm->shared_cache(), smallbs, bm);
+    tester.test("Plan is cached", plan == get_ao_reorder_plan(mm->shared_cache(), smallbs, bm));
+    tester.test("Plan from the basis set",
+                plan->ordering() == make_ao_basis_ordering(smallbs, bm));
+
+    // Rank-3 and rank-4 tensors against the reordering of each element
+    {
+        const size_t n = plan->size();
+        const auto & o = plan->ordering();
+        const vector<double> src = make_data(n*n*n*n);
+        vector<double> dest3(n*n*n), dest4(n*n*n*n), ref3(n*n*n), ref4(n*n*n*n);
+        for(size_t i = 0; i < n; i++)
+        for(size_t j = 0; j < n; j++)
+        for(size_t k = 0; k < n; k++)
+        {
+            ref3[(i*n+j)*n+k] = src[(o[i]*n+o[j])*n+o[k]];
+            for(size_t l = 0; l < n; l++)
+                ref4[((i*n+j)*n+k)*n+l] = src[((o[i]*n+o[j])*n+o[k])*n+o[l]];
+        }
+
+        reorder_tensor<3>({{*plan, *plan, *plan}}, src.data(), dest3.data());
+        tester.test("Rank-3 tensor", dest3 == ref3);
+        reorder_tensor<4>({{*plan, *plan, *plan, *plan}}, src.data(), dest4.data());
+        tester.test("Rank-4 tensor", dest4 == ref4);
+
+        copy(src.begin(), src.begin() + n*n*n, dest3.begin());
+        reorder_tensor_in_place<3>({{*plan, *plan, *plan}}, dest3.data());
+        tester.test("Rank-3 tensor in place", dest3 == ref3);
+        dest4 = src;
+        reorder_tensor_in_place<4>({{*plan, *plan, *plan, *plan}}, dest4.data());
+        tester.test("Rank-4 tensor in place", dest4 == ref4);
+    }
+
+    // 5000 x 5000 matrices (500 x 500 unless running the full benchmark)
+    const BasisSet bs = make_basis(full_benchmark() ? 5000 : 500);
+    const AOReorderPlan bigplan(bs, bm);
+    const size_t n = bigplan.size();
+    const size_t nthreads = get_nthreads();
+
+    print_global_output("%? x %? matrix: %? runs, %? cycles, %? threads\n",
+                        n, n, bigplan.n_runs(), bigplan.n_cycles(), nthreads);
+
+    const vector<double> src = make_data(n*n);
+    vector<double> tmp(n*n), ref(n*n), dest(n*n);
+
+    // As it was done with reorder_block: rows, then columns
+    auto start = chrono::steady_clock::now();
+    for(size_t r = 0; r < nrepeat; r++)
+    {
+        reorder_block(bigplan.ordering(), src.data(), tmp.data(), n, 1);
+        reorder_block(bigplan.ordering(), tmp.data(), ref.data(), 1, n);
+    }
+    print_throughput("reorder_block (rows, then columns)", n*n, elapsed_since(start));
+
+    start = chrono::steady_clock::now();
+    for(size_t r = 0; r < nrepeat; r++)
+        reorder_matrix(bigplan, bigplan, src.data(), dest.data(), 1);
+    print_throughput("plan, 1 thread", n*n, elapsed_since(start));
+    tester.test("Matrix, 1 thread", dest == ref);
+
+    start = chrono::steady_clock::now();
+    for(size_t r = 0; r < nrepeat; r++)
+        reorder_matrix(bigplan, bigplan, src.data(), dest.data(), nthreads);
+    print_throughput("plan, " + to_string(nthreads) + " threads", n*n, elapsed_since(start));
+    tester.test("Matrix, all threads", dest == ref);
+
+    // Only time the reordering (not restoring the original)
+    double time = 0.0;
+    for(size_t r = 0; r < nrepeat; r++)
+    {
+        dest = src;
+        start = chrono::steady_clock::now();
+        reorder_matrix_in_place(bigplan, bigplan, dest.data(), nthreads);
+        time += elapsed_since(start);
+    }
+    print_throughput("plan in place, " + to_string(nthreads) + " threads", n*n, time);
+    tester.test("Matrix in place", dest == ref);
+
+    tester.print_results();
+    return tester.nfailed();
+}
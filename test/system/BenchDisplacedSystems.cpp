@@ -0,0 +1,109 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/system/System.hpp>
+
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace pulsar;
+
+// Atoms on a simple cubic lattice, alternating H and He
+static AtomSetUniverse make_atoms(size_t natoms)
+{
+    AtomSetUniverse ret;
+    const size_t side = static_cast<size_t>(ceil(cbrt(static_cast<double>(natoms))));
+    for(size_t i = 0; ret.size() < natoms; i++)
+    {
+        const double x = static_cast<double>(i % side);
+        const double y = static_cast<double>((i / side) % side);
+        const double z = static_cast<double>(i / (side*side));
+        ret.insert(create_atom({2.0*x, 2.0*y, 2.0*z}, 1 + static_cast<int>(i % 2)));
+    }
+    return ret;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// How a displaced system was formed before transforms replaced atoms in
+// place (every atom is compared and re-inserted into a new universe)
+static System rebuild_displaced(const System & sys, size_t i, double h)
+{
+    const vector<Atom> atoms(sys.begin(), sys.end());
+    const Atom & old = atoms[i/3];
+    Atom moved(old);
+    moved[i%3] += h;
+
+    AtomSetUniverse newuniverse;
+    for(const Atom & atom : atoms)
+        newuniverse.insert(atom != old ? atom : moved);
+    return System(move(newuniverse), true);
+}
+
+// As in EnergyMethod::finite_difference_
+static System displaced(const System & sys, size_t i, double h)
+{
+    const auto arrays = sys.get_arrays();
+    vector<double> x(arrays->x), y(arrays->y), z(arrays->z);
+    (i%3 == 0 ? x : (i%3 == 1 ? y : z))[i/3] += h;
+    return sys.with_coordinates(x, y, z);
+}
+
+TEST_SIMPLE(BenchDisplacedSystems){
+    CppTester tester("Benchmarking the systems for finite differences");
+
+    const System sys(make_atoms(100), true);
+    bool all_same = true, others_shared = true;
+    for(size_t i = 0; i < 3*sys.size(); i++)
+    {
+        const System a = displaced(sys, i, 0.005), b = rebuild_displaced(sys, i, 0.005);
+        all_same = all_same && a == b && a.get_arrays()->x == b.get_arrays()->x &&
+                   a.get_arrays()->z == b.get_arrays()->z;
+
+        // Atoms that didn't move keep their place in the universe
+        const Atom & other = *std::next(sys.begin(), static_cast<ptrdiff_t>((i/3 + 1) % sys.size()));
+        others_shared = others_shared && a.get_universe()->idx(other) == sys.get_universe()->idx(other);
+    }
+    tester.test("Displaced systems", all_same);
+    tester.test("Unmoved atoms keep their index", others_shared);
+
+    const System there_and_back = displaced(displaced(sys, 7, 0.005), 7, -0.005);
+    tester.test("Displacing back", there_and_back == sys);
+
+    // Scaling with the number of atoms, for all 6N displacements of a
+    // central difference (only the smaller systems unless running the full
+    // benchmark). Rebuilding is only timed for the smaller systems.
+    const vector<size_t> sizes = full_benchmark() ? vector<size_t>{100, 200, 400, 800, 1600}
+                                                  : vector<size_t>{100, 200};
+    print_global_output("%8? %12? %12?\n", "natoms", "rebuild", "replace");
+    for(size_t natoms : sizes)
+    {
+        const System big(make_atoms(natoms), true);
+
+        string rebuild("-");
+        if(natoms <= 400)
+        {
+            const auto start = chrono::steady_clock::now();
+            for(size_t i = 0; i < 3*natoms; i++)
+                for(double h : {-0.005, 0.005})
+                    rebuild_displaced(big, i, h);
+            rebuild = to_string(elapsed_since(start));
+        }
+
+        const auto start = chrono::steady_clock::now();
+        size_t nsame = 0;
+        for(size_t i = 0; i < 3*natoms; i++)
+            for(double h : {-0.005, 0.005})
+                nsame += (displaced(big, i, h).size() == natoms);
+        const double replace = elapsed_since(start);
+
+        print_global_output("%8? %12? %12.4?\n", natoms, rebuild, replace);
+        tester.test("System of " + to_string(natoms) + " atoms", nsame == 6*natoms);
+    }
+
+    tester.print_results();
+    return tester.nfailed();
+}
@@ -0,0 +1,195 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/system/System.hpp>
+#include <pulsar/system/NeighborList.hpp>
+#include <pulsar/system/CrystalFunctions.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace std;
+using namespace pulsar;
+
+// Atoms (H, C, N, and O) at random positions, at roughly the density of
+// a molecular liquid
+static AtomSetUniverse make_atoms(size_t natoms)
+{
+    const int zs[] = {1, 1, 6, 7, 8};
+    const double side = cbrt(static_cast<double>(natoms) * 25.0);
+    mt19937 gen(42);
+    uniform_real_distribution<double> coord(0.0, side);
+
+    AtomSetUniverse ret;
+    for(size_t i = 0; i < natoms; i++)
+        ret.insert(create_atom({coord(gen), coord(gen), coord(gen)}, zs[i % 5]));
+    return ret;
+}
+
+// H2 molecules on a cubic lattice with a side of 6 bohr
+static AtomSetUniverse make_h2_lattice(size_t n)
+{
+    AtomSetUniverse ret;
+    for(size_t x = 0; x < n; x++)
+    for(size_t y = 0; y < n; y++)
+    for(size_t z = 0; z < n; z++)
+    {
+        const double dx = 6.0*static_cast<double>(x), dy = 6.0*static_cast<double>(y),
+                     dz = 6.0*static_cast<double>(z);
+        ret.insert(create_atom({dx + 0.5, dy + 0.5, dz + 0.5}, 1));
+        ret.insert(create_atom({dx + 0.5, dy + 0.5, dz + 1.9}, 1));
+    }
+    return ret;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// How bonds were found before the neighbor list (comparing all pairs)
+static vector<pair<size_t, size_t>> all_pairs_bonds(const vector<Atom> & atoms, double tol)
+{
+    vector<pair<size_t, size_t>> ret;
+    for(size_t i = 0; i < atoms.size(); i++)
+        for(size_t j = 0; j < i; j++)
+            if(atoms[i].distance(atoms[j]) < tol*(atoms[i].cov_radius + atoms[j].cov_radius))
+                ret.emplace_back(j, i);
+    sort(ret.begin(), ret.end());
+    return ret;
+}
+
+static vector<pair<size_t, size_t>> list_bonds(const NeighborList & nl)
+{
+    vector<pair<size_t, size_t>> ret;
+    for(size_t i = 0; i < nl.size(); i++)
+        for(size_t n = nl.offsets()[i]; n < nl.offsets()[i+1]; n++)
+            if(nl.neighbors()[n] > i)
+                ret.emplace_back(i, nl.neighbors()[n]);
+    return ret;
+}
+
+TEST_SIMPLE(BenchNeighborList){
+    CppTester tester("Benchmarking neighbor search with cell lists");
+
+    const System sys(make_atoms(2000), true);
+    const vector<Atom> atoms(sys.begin(), sys.end());
+
+    const NeighborList bonds = get_bonded_neighbors(sys);
+    tester.test("Bonds match all pairs", list_bonds(bonds) == all_pairs_bonds(atoms, 1.20));
+    tester.test("Some atoms are bonded", bonds.n_pairs() > 0);
+    tester.test("Bonds with a larger tolerance",
+                list_bonds(get_bonded_neighbors(sys, 2.0)) == all_pairs_bonds(atoms, 2.0));
+
+    bool sorted = true, symmetric = true, distances = true;
+    for(size_t i = 0; i < bonds.size(); i++)
+        for(size_t n = bonds.offsets()[i]; n < bonds.offsets()[i+1]; n++)
+        {
+            const size_t j = bonds.neighbors()[n];
+            sorted = sorted && (n == bonds.offsets()[i] || bonds.neighbors()[n-1] < j);
+            symmetric = symmetric && bonds.are_neighbors(j, i);
+            distances = distances && fabs(bonds.distances()[n] - atoms[i].distance(atoms[j])) < 1e-12;
+        }
+    tester.test("Neighbors are sorted", sorted);
+    tester.test("Neighbors are symmetric", symmetric);
+    tester.test("Neighbor distances", distances);
+
+    const NeighborList within = get_neighbor_list(sys, 4.0);
+    size_t npairs = 0;
+    for(size_t i = 0; i < atoms.size(); i++)
+        for(size_t j = 0; j < i; j++)
+            npairs += (atoms[i].distance(atoms[j]) < 4.0);
+    tester.test("Pairs within a cutoff", within.n_pairs() == npairs);
+
+    const vector<double> dm = get_distance_matrix(sys);
+    tester.test("Distance matrix", dm.size() == atoms.size()*atoms.size() &&
+                                   fabs(dm[5*atoms.size()+17] - atoms[5].distance(atoms[17])) < 1e-12 &&
+                                   fabs(dm[17*atoms.size()+5] - dm[5*atoms.size()+17]) < 1e-12);
+
+    const Conn_t conns = get_connectivity(sys);
+    size_t nconns = 0;
+    bool conns_match = conns.size() == atoms.size();
+    for(size_t i = 0; i < atoms.size(); i++)
+    {
+        nconns += conns.at(atoms[i]).size();
+        for(size_t n = bonds.offsets()[i]; n < bonds.offsets()[i+1]; n++)
+            conns_match = conns_match && conns.at(atoms[i]).count(atoms[bonds.neighbors()[n]]);
+    }
+    tester.test("Connectivity", conns_match && nconns == 2*bonds.n_pairs());
+
+    const AtomSetUniverse h2 = make_h2_lattice(3);
+    const NeighborList h2bonds = get_bonded_neighbors(System(h2, true));
+    tester.test("H2 lattice bonds", h2bonds.n_pairs() == 27 && connected_atoms(h2bonds, 7).size() == 2);
+    tester.test("Isolated atom", connected_atoms(get_bonded_neighbors(System(make_h2_lattice(1), true), 0.1), 1) ==
+                                 vector<size_t>{1});
+    tester.test("Empty system", get_bonded_neighbors(System(AtomSetUniverse(), true)).size() == 0);
+
+    const AtomSetUniverse uc = CarveUC(h2, {{6.0, 6.0, 6.0}}, 1.0, 2.0);
+    tester.test("CarveUC", uc.size() == 2 && uc.count(create_atom({0.5, 0.5, 0.5}, 1)));
+
+    AtomSetUniverse replica(create_atom({0.5, 0.5, 0.5}, 1), create_atom({0.5, 0.5, 1.9}, 1));
+    replica.insert(create_atom({6.5, 0.5, 0.5}, 1));
+    replica.insert(create_atom({6.5, 0.5, 1.9}, 1));
+    tester.test("CleanUC", CleanUC(replica, {{6.0, 6.0, 6.0}}).size() == 2);
+
+    // Scaling with the number of atoms (only the smaller systems unless
+    // running the full benchmark). Comparing all pairs (which scales as
+    // N^2) and building the connectivity table (which hashes whole atoms)
+    // are only timed for the smaller systems.
+    const bool full = full_benchmark();
+    const vector<size_t> sizes = full ? vector<size_t>{1000, 4000, 16000, 64000, 128000}
+                                      : vector<size_t>{1000, 4000};
+    print_global_output("%8? %12? %12? %12? %12?\n", "natoms", "all pairs", "bonded",
+                        "cutoff 6.0", "connectivity");
+    for(size_t natoms : sizes)
+    {
+        const System big(make_atoms(natoms), true);
+        const vector<Atom> bigatoms(big.begin(), big.end());
+
+        string allpairs("-");
+        vector<pair<size_t, size_t>> ref;
+        if(natoms <= 4000)
+        {
+            const auto start = chrono::steady_clock::now();
+            ref = all_pairs_bonds(bigatoms, 1.20);
+            allpairs = to_string(elapsed_since(start));
+        }
+
+        auto start = chrono::steady_clock::now();
+        const NeighborList bigbonds = get_bonded_neighbors(big);
+        const double bonded = elapsed_since(start);
+
+        start = chrono::steady_clock::now();
+        const NeighborList bigwithin = get_neighbor_list(big, 6.0);
+        const double cutoff = elapsed_since(start);
+
+        string conntime("-");
+        if(natoms <= 4000)
+        {
+            start = chrono::steady_clock::now();
+            const Conn_t bigconns = get_connectivity(big);
+            conntime = to_string(elapsed_since(start));
+            tester.test("Connectivity of " + to_string(natoms) + " atoms", bigconns.size() == natoms);
+        }
+
+        print_global_output("%8? %12? %12.4? %12.4? %12?\n", natoms, allpairs, bonded, cutoff, conntime);
+
+        tester.test("System of " + to_string(natoms) + " atoms",
+                    bigbonds.size() == natoms &&
+                    bigwithin.n_pairs() >= bigbonds.n_pairs() &&
+                    (ref.empty() || ref == list_bonds(bigbonds)));
+    }
+
+    // Carving the central cell from a 40 x 40 x 40 (or 10 x 10 x 10)
+    // lattice of H2 (128000 or 2000 atoms)
+    const size_t ncells = full ? 40 : 10;
+    const double center = static_cast<double>(ncells/2);
+    const AtomSetUniverse bigh2 = make_h2_lattice(ncells);
+    auto start = chrono::steady_clock::now();
+    const AtomSetUniverse biguc = CarveUC(bigh2, {{6.0, 6.0, 6.0}}, center, center + 1.0);
+    print_global_output("CarveUC (%? atoms): %.4? s\n", bigh2.size(), elapsed_since(start));
+    tester.test("CarveUC of a large supercell", biguc.size() == 2);
+
+    tester.print_results();
+    return tester.nfailed();
+}
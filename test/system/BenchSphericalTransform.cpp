@@ -0,0 +1,184 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/system/SphericalTransformIntegral.hpp>
+#include <pulsar/system/BasisShellInfo.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+using namespace std;
+using namespace pulsar;
+
+// Number of times each block is transformed (fewer unless running
+// the full benchmark)
+static size_t nrepeat = 2000;
+
+// The transformation using only spherical_transform_block
+// (how CartesianToSpherical worked before the specialized kernels)
+template<int N>
+void reference_transform(array<reference_wrapper<const BasisShellBase>, N> shells,
+                         double * source, double * dest, double * work)
+{
+    GeneralShellIterator<N> gsi(shells, false);
+    do {
+        double * buf1 = source;
+        double * buf2 = work;
+        size_t width = 1, niter = 1, source_adv = 1, dest_adv = 1;
+        array<size_t, N> gncart, gnfunc;
+        for(int i = 0; i < N; i++)
+        {
+            gncart[i] = n_cartesian_gaussian(gsi.AM(i));
+            gnfunc[i] = shells[i].get().general_n_functions(gsi.GeneralIdx(i));
+            width *= gncart[i];
+            source_adv *= gncart[i];
+            dest_adv *= gnfunc[i];
+        }
+
+        for(int i = 0; i < N; i++)
+        {
+            width /= gncart[i];
+            if(shells[i].get().get_type() == ShellType::SphericalGaussian)
+            {
+                spherical_transform_block(spherical_transform_for_am(gsi.AM(i)),
+                                          buf1, buf2, width, gsi.AM(i), niter);
+                swap(buf1, buf2);
+            }
+            niter *= gnfunc[i];
+        }
+
+        copy(buf1, buf1 + dest_adv, dest);
+        source += source_adv;
+        dest += dest_adv;
+    } while(gsi.Next());
+}
+
+// Negative am is a combined shell (sp, spd, ...)
+static BasisShellInfo make_shell(int am)
+{
+    const size_t ngen = (am < 0) ? static_cast<size_t>(1-am) : 1;
+    return BasisShellInfo(ShellType::SphericalGaussian, am, 1, ngen,
+                          vector<double>{1.0}, vector<double>(ngen, 1.0));
+}
+
+template<size_t... I>
+array<reference_wrapper<const BasisShellBase>, sizeof...(I)>
+make_refs(const vector<BasisShellInfo> & shells, index_sequence<I...>)
+{
+    return {{shells[I]...}};
+}
+
+static vector<double> make_source(size_t n)
+{
+    vector<double> ret(n);
+    for(size_t i = 0; i < n; i++)
+        ret[i] = sin(static_cast<double>(i) + 0.5);
+    return ret;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Transform a block with both paths, checking that they agree and
+ * printing the time for each. The source is overwritten by the
+ * transformations, so it is restored each time.
+ */
+template<int N>
+bool bench_block(const string & desc, const array<int, N> & ams)
+{
+    vector<BasisShellInfo> shellinfo;
+    for(int am : ams)
+        shellinfo.push_back(make_shell(am));
+
+    const auto shells = make_refs(shellinfo, make_index_sequence<N>());
+
+    size_t ncart = 1, nsph = 1;
+    for(int am : ams)
+    {
+        ncart *= n_cartesian_gaussian(am);
+        nsph *= n_spherical_gaussian(am);
+    }
+
+    const vector<double> orig = make_source(ncart);
+    vector<double> source(orig), work(ncart), ref(nsph), dest(nsph);
+
+    auto start = chrono::steady_clock::now();
+    for(size_t r = 0; r < nrepeat; r++)
+    {
+        copy(orig.begin(), orig.end(), source.begin());
+        reference_transform<N>(shells, source.data(), ref.data(), work.data());
+    }
+    const double ref_time = elapsed_since(start);
+
+    start = chrono::steady_clock::now();
+    for(size_t r = 0; r < nrepeat; r++)
+    {
+        copy(orig.begin(), orig.end(), source.begin());
+        CartesianToSpherical<N>(shells, source.data(), dest.data(), work.data(), 1);
+    }
+    const double new_time = elapsed_since(start);
+
+    const double n = static_cast<double>(nrepeat);
+    print_global_output("%-12? %8? ints  reference: %8.3? us  kernels: %8.3? us  (speedup %5.2?)\n",
+                        desc, ncart, 1e6*ref_time/n, 1e6*new_time/n, ref_time/new_time);
+
+    double diff = 0.0;
+    for(size_t i = 0; i < nsph; i++)
+        diff = max(diff, fabs(ref[i] - dest[i]));
+    return diff < 1e-12;
+}
+
+TEST_SIMPLE(BenchSphericalTransform){
+    CppTester tester("Benchmarking specialized spherical transform kernels");
+
+    if(!full_benchmark())
+        nrepeat = 10;
+
+    // Each kernel against the general transformation
+    for(int am = 0; am <= PULSAR_MAX_SPHERICAL_KERNEL_AM; am++)
+    {
+        const size_t ncart = n_cartesian_gaussian(am);
+        const size_t nsph = n_spherical_gaussian(am);
+        for(size_t width : {1u, 7u})
+        {
+            const size_t niter = 3;
+            const vector<double> src = make_source(ncart*width*niter);
+            vector<double> ref(nsph*width*niter), dest(nsph*width*niter);
+
+            spherical_transform_block(spherical_transform_for_am(am), src.data(), ref.data(),
+                                      width, am, niter);
+            spherical_transform_kernel_for_am(am)(spherical_transform_matrix(am), src.data(),
+                                                  dest.data(), width, niter);
+
+            double diff = 0.0;
+            for(size_t i = 0; i < ref.size(); i++)
+                diff = max(diff, fabs(ref[i] - dest[i]));
+            tester.test("Kernel for am = " + to_string(am) + ", width = " + to_string(width),
+                        diff < 1e-12);
+        }
+    }
+
+    tester.test("No kernel for combined am", spherical_transform_kernel_for_am(-1) == nullptr);
+    tester.test("No kernel for high am",
+                spherical_transform_kernel_for_am(PULSAR_MAX_SPHERICAL_KERNEL_AM+1) == nullptr);
+    tester.test_call("No matrix for combined am", false,
+                     [](void){ spherical_transform_matrix(-1); });
+
+    tester.test("(dd)", bench_block<2>("(dd)", {{2, 2}}));
+    tester.test("(ff)", bench_block<2>("(ff)", {{3, 3}}));
+    tester.test("(gh)", bench_block<2>("(gh)", {{4, 5}}));
+    tester.test("(dd|f)", bench_block<3>("(dd|f)", {{2, 2, 3}}));
+    tester.test("(gg|g)", bench_block<3>("(gg|g)", {{4, 4, 4}}));
+    tester.test("(pd|fd)", bench_block<4>("(pd|fd)", {{1, 2, 3, 2}}));
+    tester.test("(dd|dd)", bench_block<4>("(dd|dd)", {{2, 2, 2, 2}}));
+    tester.test("(ff|ff)", bench_block<4>("(ff|ff)", {{3, 3, 3, 3}}));
+    tester.test("(gg|gg)", bench_block<4>("(gg|gg)", {{4, 4, 4, 4}}));
+
+    // A combined (sp) shell uses the general path
+    tester.test("(sp|d)", bench_block<2>("(sp|d)", {{-1, 2}}));
+
+    tester.print_results();
+    return tester.nfailed();
+}
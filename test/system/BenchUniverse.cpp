@@ -0,0 +1,151 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/system/System.hpp>
+#include <pulsar/system/CrystalFunctions.hpp>
+#include <pulsar/util/Format.hpp>
+
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace pulsar;
+
+// Atoms on a simple cubic lattice, alternating H and He
+static vector<Atom> make_atoms(size_t natoms)
+{
+    vector<Atom> ret;
+    ret.reserve(natoms);
+    const size_t side = static_cast<size_t>(ceil(cbrt(static_cast<double>(natoms))));
+    for(size_t i = 0; ret.size() < natoms; i++)
+    {
+        const double x = static_cast<double>(i % side);
+        const double y = static_cast<double>((i / side) % side);
+        const double z = static_cast<double>(i / (side*side));
+        ret.push_back(create_atom({2.0*x, 2.0*y, 2.0*z}, 1 + static_cast<int>(i % 2)));
+    }
+    return ret;
+}
+
+static double elapsed_since(chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// How a universe was built before it had an index (std::find for each insert)
+static double time_linear_build(const vector<Atom> & atoms)
+{
+    const auto start = chrono::steady_clock::now();
+    vector<Atom> storage;
+    for(const auto & atom : atoms)
+        if(find(storage.begin(), storage.end(), atom) == storage.end())
+            storage.push_back(atom);
+    return elapsed_since(start);
+}
+
+TEST_SIMPLE(BenchUniverse){
+    CppTester tester("Benchmarking the hash index of Universe");
+
+    // Correctness of the index
+    const vector<Atom> atoms = make_atoms(1000);
+    AtomSetUniverse u;
+    u.insert(atoms.begin(), atoms.end());
+    u.insert(atoms.begin(), atoms.end());
+    tester.test("Duplicates are not inserted", u.size() == atoms.size());
+
+    bool all_idx = true;
+    for(size_t i = 0; i < atoms.size(); i++)
+        all_idx = all_idx && u.count(atoms[i]) && u.idx(atoms[i]) == i;
+    tester.test("Index of every atom", all_idx);
+
+    // Same Z and coordinates (and so the same hash), but different atoms
+    Atom ion = atoms[5];
+    ion.charge = 1.0;
+    tester.test("Atom with the same hash is not present", !u.count(ion));
+    u.insert(ion);
+    tester.test("Atom with the same hash is inserted",
+                u.count(ion) && u.idx(ion) == atoms.size() && u.idx(atoms[5]) == 5);
+
+    Atom negzero = create_atom({-0.0, 0.0, -0.0}, 1);
+    tester.test("Negative zero coordinates", u.count(negzero) && u.idx(negzero) == 0);
+
+    AtomSetUniverse half(atoms[1], atoms[3], atoms[5]);
+    AtomSetUniverse inter = u.intersection(half);
+    tester.test("Index after intersection", inter.size() == 3 && inter.idx(atoms[5]) == 2);
+    AtomSetUniverse diff = u.difference(half);
+    tester.test("Index after difference",
+                diff.idx(atoms[4]) == 2 && diff.idx(ion) == atoms.size() - 3 && !diff.count(atoms[3]));
+
+    AtomSetUniverse copied(u), moved(std::move(copied));
+    tester.test("Index after copy and move", moved.idx(ion) == atoms.size() && moved == u);
+    tester.test_call("Missing atom", false,
+                     [&](void){ half.idx(atoms[0]); });
+
+    System sys(u, false);
+    sys.insert(atoms[7]);
+    const System comp = sys.complement();
+    tester.test("Complement", comp.size() == u.size() - 1 && !comp.count(atoms[7]) && comp.count(ion));
+
+    // Scaling with the number of atoms (only the smaller universes unless
+    // running the full benchmark). The linear search is only timed for
+    // the smaller universes, since it scales as N^2
+    const bool full = full_benchmark();
+    const vector<size_t> sizes = full ? vector<size_t>{1000, 4000, 16000, 64000, 256000}
+                                      : vector<size_t>{1000, 4000};
+    print_global_output("%8? %12? %12? %12? %12? %12? %12?\n", "natoms", "build (find)",
+                        "build", "idx", "union", "partition", "complement");
+    for(size_t natoms : sizes)
+    {
+        const vector<Atom> all = make_atoms(natoms);
+        const vector<Atom> firsthalf(all.begin(), all.begin() + natoms/2);
+        const vector<Atom> secondhalf(all.begin() + natoms/2, all.end());
+
+        const string linear = (natoms <= 16000) ? format_string("%.4?", time_linear_build(all))
+                                                : string("-");
+
+        auto start = chrono::steady_clock::now();
+        AtomSetUniverse big;
+        big.insert(all.begin(), all.end());
+        const double build = elapsed_since(start);
+
+        start = chrono::steady_clock::now();
+        size_t sum = 0;
+        for(const auto & atom : all)
+            sum += big.idx(atom);
+        const double idx = elapsed_since(start);
+
+        AtomSetUniverse u1, u2;
+        u1.insert(firsthalf.begin(), firsthalf.end());
+        u2.insert(secondhalf.begin(), secondhalf.end());
+        start = chrono::steady_clock::now();
+        u1 += u2;
+        const bool same = (u1 == big);
+        const double uniontime = elapsed_since(start);
+
+        // The hydrogens, and then everything else
+        start = chrono::steady_clock::now();
+        const System bigsys = System(big, true).partition([](const Atom & a){ return a.Z == 1; });
+        const double systime = elapsed_since(start);
+
+        start = chrono::steady_clock::now();
+        const System bigcomp = bigsys.complement();
+        const double comptime = elapsed_since(start);
+
+        print_global_output("%8? %12? %12.4? %12.4? %12.4? %12.4? %12.4?\n", natoms, linear,
+                            build, idx, uniontime, systime, comptime);
+
+        tester.test("Universe of " + to_string(natoms) + " atoms",
+                    big.size() == natoms && sum == natoms*(natoms-1)/2 && same &&
+                    bigcomp.size() == natoms/2);
+    }
+
+    // A 20 x 20 x 20 (or 5 x 5 x 5) supercell of a two-atom cell
+    const size_t ncells = full ? 20 : 5;
+    AtomSetUniverse cell(create_atom({0.0, 0.0, 0.0}, 11), create_atom({1.0, 1.0, 1.0}, 17));
+    auto start = chrono::steady_clock::now();
+    AtomSetUniverse supercell = MakeSuperCell(cell, {{ncells, ncells, ncells}}, {{2.0, 2.0, 2.0}});
+    print_global_output("MakeSuperCell (%? atoms): %.4? s\n", supercell.size(), elapsed_since(start));
+    tester.test("Supercell", supercell.size() == 2*ncells*ncells*ncells);
+
+    tester.print_results();
+    return tester.nfailed();
+}
@@ -31,6 +31,7 @@ TEST_SIMPLE(TestBasisSet){
     tester.test_equal("Inequality works",true,BS3!=BS2);
     BS3=std::move(BS2);
     tester.test_equal("Move assignment works",BS3,BS);
+    tester.test_equal("Moved-from basis set is empty",0,BS2.n_shell());
     BS2=BS3;
     tester.test_equal("Copy assignment works",BS2,BS);
     
@@ -88,7 +89,23 @@ TEST_SIMPLE(TestBasisSet){
 
     tester.test_equal("Hash BS",BS.my_hash(),BS2.my_hash());
     tester.test_equal("Hash BS2",BS.my_hash(),BS3.my_hash());
-    
+
+    //Copies share data until one of them is modified
+    BasisSet BS6(Mol.get_basis_set("PRIMARY"));
+    tester.test_equal("Basis set from a system is reused",true,
+                      &BS6.shell(0)==&Mol.get_basis_set("PRIMARY").shell(0));
+    BasisSet BS7(BS4);
+    tester.test_equal("Copies share shells",true,&BS7.shell(0)==&BS4.shell(0));
+    BasisSet BS8(2,6,6,6);
+    BS8.add_shell(FakeD,carts);
+    BasisSet BS9(BS8);
+    BS9.add_shell(FakeD2,carts);
+    tester.test_member_return("Modified copy has the new shell",true,2,
+                              &BasisSet::n_shell,&BS9);
+    tester.test_member_return("Original is not modified",true,1,
+                              &BasisSet::n_shell,&BS8);
+    tester.test_equal("Shells of the original are kept",BS8.shell(0),BS9.shell(0));
+
     tester.print_results();
     return tester.nfailed();
 }
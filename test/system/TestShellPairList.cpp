@@ -0,0 +1,127 @@
+#include <pulsar/testing/CppTester.hpp>
+#include <pulsar/modulemanager/ModuleManager.hpp>
+#include <pulsar/modulebase/FourCenterIntegral.hpp>
+#include <pulsar/system/ShellPairList.hpp>
+
+using namespace std;
+using namespace pulsar;
+
+// "Integrals" where (ab|ab) for shells i and j is 1/(1+i+j)
+class Fake4CInt:public FourCenterIntegral{
+public:
+    Fake4CInt(ID_t id):FourCenterIntegral(id){}
+private:
+    BasisSet bs_;
+    vector<double> buffer_;
+
+    void initialize_(unsigned int,
+                     const Wavefunction &,
+                     const BasisSet & bs,
+                     const BasisSet &,
+                     const BasisSet &,
+                     const BasisSet &)
+    {
+        bs_=bs;
+        const size_t nmax=bs.max_n_functions();
+        buffer_.resize(nmax*nmax*nmax*nmax);
+    }
+
+    HashType my_hash_(unsigned int,
+                      const Wavefunction &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &){
+        return "";
+    }
+
+    const double* calculate_(uint64_t s1, uint64_t s2, uint64_t, uint64_t)
+    {
+        fill(buffer_.begin(),buffer_.end(),1.0/static_cast<double>(1+s1+s2));
+        return buffer_.data();
+    }
+};
+
+// Same "integrals", but a module that hashes differently
+class OtherFake4CInt:public Fake4CInt{
+public:
+    OtherFake4CInt(ID_t id):Fake4CInt(id){}
+private:
+    HashType my_hash_(unsigned int,
+                      const Wavefunction &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &,
+                      const BasisSet &){
+        return "other";
+    }
+};
+
+TEST_SIMPLE(TestShellPairList){
+    CppTester tester("Testing ShellPairList");
+
+    const size_t nshell=6;
+    BasisSet bs(nshell,2*nshell,2*nshell,3*nshell);
+    for(size_t i=0;i<nshell;i++)
+    {
+        const int am=static_cast<int>(i%2);
+        BasisShellInfo bsi(ShellType::SphericalGaussian,am,2,1,{1.0+i,0.5},{0.5,0.5});
+        bs.add_shell(bsi,{0.0,0.0,static_cast<double>(i)});
+    }
+    BasisSet bs2(1,1,1,3);
+    bs2.add_shell(BasisShellInfo(ShellType::SphericalGaussian,0,1,1,{1.0},{1.0}),{0.0,0.0,0.0});
+
+    ShellPairList sym(bs,bs);
+    tester.test("Same basis sets are symmetric",sym.is_symmetric());
+    tester.test("Unique shell pairs",sym.n_shell_pairs()==nshell*(nshell+1)/2);
+    tester.test("Primitive pairs",sym.n_primitive_pairs()==4*sym.n_shell_pairs());
+    tester.test("Primitive pairs of the last shell pair",
+                sym.prim_start(sym.n_shell_pairs())-sym.prim_start(sym.n_shell_pairs()-1)==4);
+    tester.test("Memory used includes the primitive pairs",
+                sym.memory_size()>=8*sizeof(double)*sym.n_primitive_pairs());
+
+    ShellPairList nosym(bs,bs2);
+    tester.test("Different basis sets are not symmetric",!nosym.is_symmetric());
+    tester.test("All shell pairs",nosym.n_shell_pairs()==nshell);
+    tester.test_call("Shell pair out of range",false,
+                     [&nosym](void){ nosym.shell1(nshell); });
+
+    // shells 1 and 0 are one apart, with exponents 2.0 and 1.0 for the first primitives
+    tester.test_double("Exponent sum",3.0,sym.exponent_sum()[sym.prim_start(1)]);
+    tester.test_double("Reduced exponent",2.0/3.0,sym.reduced_exponent()[sym.prim_start(1)]);
+    tester.test_double("Product center",2.0/3.0,sym.center_z()[sym.prim_start(1)]);
+    tester.test_double("Prefactor",exp(-2.0/3.0),sym.prefactor()[sym.prim_start(1)]);
+
+    auto mm=make_shared<ModuleManager>();
+    mm->load_lambda_module<Fake4CInt>("FourCenterIntegral","fake_eri");
+    auto eri=mm->get_module<FourCenterIntegral>("fake_eri",0);
+    eri->initialize(0,Wavefunction(),bs,bs,bs,bs);
+
+    auto spl=get_shell_pair_list(mm->shared_cache(),0,Wavefunction(),bs,bs,*eri);
+    tester.test("Schwarz bounds are computed",spl->has_schwarz_bounds());
+    tester.test_double("Schwarz bound",sqrt(1.0/11.0),spl->bound(spl->n_shell_pairs()-1));
+    tester.test("Shell pair list is cached",
+                spl==get_shell_pair_list(mm->shared_cache(),0,Wavefunction(),bs,bs,*eri));
+
+    mm->load_lambda_module<OtherFake4CInt>("FourCenterIntegral","other_eri");
+    auto other=mm->get_module<FourCenterIntegral>("other_eri",0);
+    other->initialize(0,Wavefunction(),bs,bs,bs,bs);
+    tester.test("Differently hashed modules get their own list",
+                spl!=get_shell_pair_list(mm->shared_cache(),0,Wavefunction(),bs,bs,*other));
+
+    // Pairs with 1/(1+i+j) >= 1/4
+    size_t nsig=0;
+    bool all_significant=true;
+    for(const auto & sp : spl->significant(0.5))
+    {
+        all_significant=all_significant && (sp.shell1+sp.shell2<=3);
+        nsig++;
+    }
+    tester.test("Number of significant pairs",nsig==6);
+    tester.test("Only significant pairs are visited",all_significant);
+    tester.test("No significant pairs",
+                spl->significant(2.0).begin()==spl->significant(2.0).end());
+
+    tester.print_results();
+    return tester.nfailed();
+}
@@ -105,6 +105,40 @@ TEST_SIMPLE(TestSystem){
     tester.test_equal("transform",System(MyU3,true),H22.transform([](const Atom& a){
         Atom temp(a);temp[0]=1.0;return temp;
     }));
+    tester.test_equal("with coordinates",System(MyU3,true),
+                      H22.with_coordinates({1.0,1.0},{0.0,0.0},{0.0,0.89}));
+    tester.test_call("with coordinates of the wrong size",false,[&](void){
+        H22.with_coordinates({1.0},{0.0},{0.0});});
+    tester.test_equal("translate",System(MyU3,true),
+                      translate(H22,std::array<double,3>{{1.0,0.0,0.0}}));
+    tester.test_equal("unmoved system shares the universe",H22.get_universe(),
+                      H22.with_coordinates({0.0,0.0},{0.0,0.0},{0.0,0.89}).get_universe());
+    tester.test_call("moving atoms on top of each other",false,[&](void){
+        H22.with_coordinates({0.0,0.0},{0.0,0.0},{0.0,0.0});});
+    System Triplet(H22);
+    Triplet.multiplicity=3;
+    tester.test_equal("moving atoms keeps the multiplicity",3,
+                      Triplet.with_coordinates({0.0,0.0},{0.0,0.0},{0.1,0.89}).multiplicity);
+    tester.test_equal("swapping atoms",H22,
+                      H22.with_coordinates({0.0,0.0},{0.0,0.0},{0.89,0.0}));
+
+    //Arrays of atomic properties
+    auto arrays=ChargedH2.get_arrays();
+    tester.test_equal("arrays size",3,arrays->size());
+    tester.test_equal("arrays coordinates",std::vector<double>({0.0,0.89,-0.89}),arrays->z);
+    tester.test_equal("arrays charges",std::vector<double>({0.0,0.0,-1.0}),arrays->charge);
+    tester.test_equal("arrays are cached",arrays,ChargedH2.get_arrays());
+    tester.test_equal("arrays are shared with copies",arrays,System(ChargedH2).get_arrays());
+    System H211(MyU,false);
+    tester.test_equal("arrays of empty system",0,H211.get_arrays()->size());
+    H211.insert(H1);
+    tester.test_equal("arrays change with atoms",std::vector<double>({0.89}),H211.get_arrays()->z);
+    tester.test_double("center of mass",0.445,center_of_mass(H2)[2]);
+    tester.test_double_vector("inertia tensor",std::vector<double>({0.39920,0.0,0.0,
+                                                                   0.0,0.39920,0.0,
+                                                                   0.0,0.0,0.0}),
+                              inertia_tensor(translate(H2,std::array<double,3>{{0.0,0.0,-0.445}})));
+
     tester.test_equal("get universe works",MyU,*H27.get_universe());
     tester.test_equal("as universe works",MyU,ChargedH2.as_universe());
 
@@ -118,6 +152,10 @@ TEST_SIMPLE(TestSystem){
     H27.clear();
     tester.test_equal("Clear works",0,H27.size());
 
+    //-0.0 compares equal to 0.0, so the atom is found
+    tester.test_equal("Atom with a -0.0 coordinate is found",true,
+                      MyU.count(create_atom({-0.0,0.0,0.0},1)));
+
     tester.print_results();
     return tester.nfailed();
     
@@ -91,6 +91,15 @@ def run_test():
         return temp
 
     tester.test_return("transform",True,psr.System(MyU3,True),H22.transform,translate_by_1)
+    tester.test_return("with coordinates",True,psr.System(MyU3,True),H22.with_coordinates,
+                       [1.0,1.0],[0.0,0.0],[0.0,0.89])
+    tester.test_call("with coordinates of the wrong size",False,H22.with_coordinates,[1.0],[0.0],[0.0])
+
+    arrays=H22.get_arrays()
+    tester.test_equal("arrays size",2,len(arrays))
+    tester.test_equal("arrays coordinates",[0.0,0.89],list(arrays.z))
+    tester.test_equal("arrays masses",[1.007975,1.007975],list(arrays.mass))
+    tester.test_equal("arrays are read-only",False,arrays.x.flags.writeable)
     tester.test_return("get universe works",True,MyU,H27.get_universe)
     tester.test_return("as universe works",True,MyU,H28.as_universe)
 
@@ -49,6 +49,21 @@ TEST_SIMPLE(TestSerialization){
     tester.test_member_return("From byte array pointer worked",true,size,&stream_t::size,ar3.get());
 
 
+    // Unserializing directly from the bytes
+    vector<double> in_vec{1.0, 2.0, 3.0, 4.0};
+    ByteArray vec_data=to_byte_array(in_vec);
+    tester.test_equal("From byte array (no copy)",in_vec,from_byte_array<vector<double>>(vec_data));
+    tester.test_equal("Shared from byte array",in_vec,
+                      *make_shared_from_byte_array<vector<double>>(vec_data.data(),vec_data.size()));
+    tester.test_call("Can't unserialize truncated data",false,
+                     [&vec_data](void){ from_byte_array<vector<double>>(vec_data.data(),vec_data.size()-1); });
+
+    ByteSpanArchive span_ar(vec_data);
+    vector<double> out_vec;
+    span_ar.unserialize(out_vec);
+    tester.test_equal("Span archive",in_vec,out_vec);
+
+
     pybind11::list a_list;
     a_list.append(pybind11::int_(1));
     a_list.append(pybind11::int_(2));